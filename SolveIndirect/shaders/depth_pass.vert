@@ -43,7 +43,7 @@ struct ObjectData{
 	vec4 pad;
 }; 
 
-layout(set = 0, binding = 6) readonly buffer ObjectBuffer{   
+layout(set = 0, binding = 1) readonly buffer ObjectBuffer{   
 	ObjectData objects[];
 } objectBuffer;
 
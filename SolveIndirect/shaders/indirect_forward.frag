@@ -26,8 +26,9 @@ vec3 specularContribution(vec3 L, vec3 V, vec3 N, vec3 C, vec3 F0, float metalli
 vec3 CalcDiffuseContribution(vec3 L, vec3 N, vec3 C);
 vec3 PointLightContribution(vec3 L, vec3 V, vec3 N, vec3 C, vec3 F0, float metallic, float roughness);
 vec3 CalculateNormalFromMap();
+void WriteTextureFeedback();
 float textureProj(vec4 shadowCoord, vec2 offset, int cascadeIndex);
-float filterPCF(vec4 sc, int cascadeIndex, float depthValue);
+float filterPCF(vec4 sc, int cascadeIndex);
 
 const mat4 biasMat = mat4( 
 	0.5, 0.0, 0.0, 0.0,
@@ -47,16 +48,18 @@ layout( push_constant ) uniform constants
 
 void main() 
 {
+    WriteTextureFeedback();
+
     //vec4 colorVal = texture(colorTex, inUV).rgba;
-    vec4 colorVal = texture(material_textures[nonuniformEXT(inMaterialIndex)],inUV).rgba;
+    vec4 colorVal = texture(material_textures[nonuniformEXT(MaterialTextureSlot(inMaterialIndex, 0))],inUV).rgba * materials[inMaterialIndex].colorFactors;
     vec3 albedo =  pow(colorVal.rgb,vec3(2.2));
     float ao = colorVal.a;
 
-    vec2 metallicRough  = texture(material_textures[nonuniformEXT(inMaterialIndex+1)],inUV).gb;
+    vec2 metallicRough  = texture(material_textures[nonuniformEXT(MaterialTextureSlot(inMaterialIndex, 1))],inUV).gb;
     //vec2 metallicRough  = texture(metalRoughTex, inUV).gb;
     
-	float roughness = metallicRough.x;
-    float metallic = metallicRough.y;
+	float roughness = metallicRough.x * materials[inMaterialIndex].metalRoughFactors.y;
+    float metallic = metallicRough.y * materials[inMaterialIndex].metalRoughFactors.x;
     
     vec3 N = CalculateNormalFromMap();
 	
@@ -189,7 +192,7 @@ vec3 specularContribution(vec3 L, vec3 V, vec3 N, vec3 C, vec3 F0, float metalli
 		vec3 F = F_Schlick(dotNV, F0);		
 		vec3 spec = D * F * G / (4.0 * dotNL * dotNV + 0.001);		
 		vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);			
-		color += (kD * pow(texture(material_textures[nonuniformEXT(inMaterialIndex)],inUV).rgb,vec3(2.2)) / PI + spec) * dotNL;
+		color += (kD * pow(texture(material_textures[nonuniformEXT(MaterialTextureSlot(inMaterialIndex, 0))],inUV).rgb,vec3(2.2)) * materials[inMaterialIndex].colorFactors.rgb / PI + spec) * dotNL;
 		color *= C;
 	}
 
@@ -230,15 +233,29 @@ vec3 PointLightContribution(vec3 L, vec3 V, vec3 N, vec3 C, vec3 F0, float metal
 		vec3 F = F_Schlick(dotNV, F0);		
 		vec3 spec = D * F * G / (4.0 * dotNL * dotNV + 0.001);		
 		vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);			
-		color += (kD * pow(texture(material_textures[nonuniformEXT(inMaterialIndex)],inUV).rgb,vec3(2.2)) / PI + spec) * radiance * dotNL;
+		color += (kD * pow(texture(material_textures[nonuniformEXT(MaterialTextureSlot(inMaterialIndex, 0))],inUV).rgb,vec3(2.2)) * materials[inMaterialIndex].colorFactors.rgb / PI + spec) * radiance * dotNL;
 	}
 
 	return color;
 }
 
+//Only one pixel in each 8x8 block reports, which is plenty to pick a mip and keeps the atomics cheap
+void WriteTextureFeedback()
+{
+    //derivatives have to be taken before the branch
+    float footprint = max(length(dFdx(inUV)), length(dFdy(inUV)));
+    if (((uint(gl_FragCoord.x) | uint(gl_FragCoord.y)) & 7u) != 0u)
+        return;
+
+    uint wantedExtent = uint(clamp(1.0 / max(footprint, 1e-6), 1.0, 65536.0));
+    uint material = inMaterialIndex;
+    if (textureFeedback[material] < wantedExtent)
+        atomicMax(textureFeedback[material], wantedExtent);
+}
+
 vec3 CalculateNormalFromMap()
 {
-    vec3 tangentNormal = normalize(texture(material_textures[nonuniformEXT(inMaterialIndex+2)],inUV).rgb * 2.0 - vec3(1.0));
+    vec3 tangentNormal = normalize(texture(material_textures[nonuniformEXT(MaterialTextureSlot(inMaterialIndex, 2))],inUV).rgb * 2.0 - vec3(1.0));
     vec3 N = normalize(inNormal);
 	vec3 T = normalize(inTangent.xyz);
 	vec3 B = cross(N, T) * inTangent.w;
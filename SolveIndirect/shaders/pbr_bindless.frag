@@ -48,15 +48,15 @@ void main()
 {
 	uint material_index = PushConstants.material_index;
     //vec4 colorVal = texture(colorTex, inUV).rgba;
-    vec4 colorVal = texture(material_textures[nonuniformEXT(material_index)],inUV).rgba;
+    vec4 colorVal = texture(material_textures[nonuniformEXT(MaterialTextureSlot(material_index, 0))],inUV).rgba * materials[material_index].colorFactors;
     vec3 albedo =  pow(colorVal.rgb,vec3(2.2));
     float ao = colorVal.a;
 
-    vec2 metallicRough  = texture(material_textures[nonuniformEXT(material_index+1)],inUV).gb;
+    vec2 metallicRough  = texture(material_textures[nonuniformEXT(MaterialTextureSlot(material_index, 1))],inUV).gb;
     //vec2 metallicRough  = texture(metalRoughTex, inUV).gb;
     
-	float roughness = metallicRough.x;
-    float metallic = metallicRough.y;
+	float roughness = metallicRough.x * materials[material_index].metalRoughFactors.y;
+    float metallic = metallicRough.y * materials[material_index].metalRoughFactors.x;
     
     vec3 N = CalculateNormalFromMap();
 	
@@ -118,7 +118,7 @@ void main()
 		}
 	}
 
-    vec4 shadowCoord = (biasMat * sceneData.lightMatrices[layer]) * vec4(inFragPos, 1.0);	
+    vec4 shadowCoord = (biasMat * shadowData.shadowMatrices[layer]) * vec4(inFragPos, 1.0);	
 
     float shadow = filterPCF(shadowCoord/shadowCoord.w,layer);
     //float shadow = textureProj(shadowCoord/shadowCoord.w, vec2(0.0), layer);
@@ -188,7 +188,7 @@ vec3 specularContribution(vec3 L, vec3 V, vec3 N, vec3 C, vec3 F0, float metalli
 		vec3 F = F_Schlick(dotNV, F0);		
 		vec3 spec = D * F * G / (4.0 * dotNL * dotNV + 0.001);		
 		vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);			
-		color += (kD * pow(texture(material_textures[nonuniformEXT(material_index)],inUV).rgb,vec3(2.2)) / PI + spec) * dotNL;
+		color += (kD * pow(texture(material_textures[nonuniformEXT(MaterialTextureSlot(material_index, 0))],inUV).rgb,vec3(2.2)) * materials[material_index].colorFactors.rgb / PI + spec) * dotNL;
 		color *= C;
 	}
 
@@ -230,7 +230,7 @@ vec3 PointLightContribution(vec3 L, vec3 V, vec3 N, vec3 C, vec3 F0, float metal
 		vec3 F = F_Schlick(dotNV, F0);		
 		vec3 spec = D * F * G / (4.0 * dotNL * dotNV + 0.001);		
 		vec3 kD = (vec3(1.0) - F) * (1.0 - metallic);			
-		color += (kD * pow(texture(material_textures[nonuniformEXT(material_index)],inUV).rgb,vec3(2.2)) / PI + spec) * radiance * dotNL;
+		color += (kD * pow(texture(material_textures[nonuniformEXT(MaterialTextureSlot(material_index, 0))],inUV).rgb,vec3(2.2)) * materials[material_index].colorFactors.rgb / PI + spec) * radiance * dotNL;
 	}
 
 	return color;
@@ -239,7 +239,7 @@ vec3 PointLightContribution(vec3 L, vec3 V, vec3 N, vec3 C, vec3 F0, float metal
 vec3 CalculateNormalFromMap()
 {
 	uint material_index = PushConstants.material_index;
-    vec3 tangentNormal = normalize(texture(material_textures[nonuniformEXT(material_index+2)],inUV).rgb * 2.0 - vec3(1.0));
+    vec3 tangentNormal = normalize(texture(material_textures[nonuniformEXT(MaterialTextureSlot(material_index, 2))],inUV).rgb * 2.0 - vec3(1.0));
     vec3 N = normalize(inNormal);
 	vec3 T = normalize(inTangent.xyz);
 	vec3 B = cross(N, T) * inTangent.w;
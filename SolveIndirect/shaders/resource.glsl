@@ -1,6 +1,5 @@
 //Scene resources to be updated once per frame
 #include "lights.glsl"
-#define MAX_MATERIAL_COUNT 65536
 
 
 struct Vertex {
@@ -59,16 +58,27 @@ layout(set = 0, binding = 11) uniform  ShadowData{
 	mat4 shadowMatrices[4];
 } shadowData;
 
+//Texture streaming feedback, per material the texture size at which one texel covers one pixel
+layout (set = 0, binding = 12) buffer textureFeedbackSSBO{
+    uint textureFeedback[];
+};
+
+
+layout(set = 1, binding = 1) uniform sampler2D material_textures[];
+layout(rgba8, set = 1, binding = 2) uniform image2D storage_image[];
 
-struct GLTFMaterialData{   
+//Matches GPUMaterial, textures holds the slots of the color, metal rough, normal and occlusion textures in material_textures
+struct Material{
+	uvec4 textures;
 	vec4 colorFactors;
-	vec4 metal_rough_factors;
-	int colorTexID;
-	int metalRoughTexID;
+	vec4 metalRoughFactors;
 };
 
-layout(set = 1, binding = 0) uniform GLTFMaterialDataBuffer{
-	GLTFMaterialData material_data[MAX_MATERIAL_COUNT];	
+layout(set = 1, binding = 3) readonly buffer MaterialTable{
+	Material materials[];
 };
-layout(set = 1, binding = 1) uniform sampler2D material_textures[];
-layout(rgba8, set = 1, binding = 2) uniform image2D storage_image[];
\ No newline at end of file
+
+uint MaterialTextureSlot(uint material, uint texture)
+{
+	return materials[material].textures[texture];
+}
\ No newline at end of file
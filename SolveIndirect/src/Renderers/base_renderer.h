@@ -11,6 +11,7 @@
 #include "../vk_loader.h"
 #include "../resource_manager.h"
 #include "../scene_manager.h"
+#include "../world_partition.h"
 
 struct BaseRenderer
 {
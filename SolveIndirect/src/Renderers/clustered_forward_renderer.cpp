@@ -10,7 +10,7 @@
 #include <iostream>
 #include <random>
 
-#include "../../../tracy/public/tracy/Tracy.hpp"
+#include "../profiling.h"
 
 #include <string>
 #include <glm/glm.hpp>
@@ -26,14 +26,22 @@ using namespace std::literals::string_literals;
 
 void ClusteredForwardRenderer::Init(VulkanEngine* engine)
 {
+	TRACE_SCOPE("Init");
 	assert(engine != nullptr);
 	this->engine = engine;
 
 	InitEngine();
 
-	ConfigureRenderWindow();
-
-	InitSwapchain();
+	if (headless)
+	{
+		//the draw extent is clamped to the swapchain's, headless it is the size asked for
+		_swapchainExtent = _windowExtent;
+	}
+	else
+	{
+		ConfigureRenderWindow();
+		InitSwapchain();
+	}
 
 	InitRenderTargets();
 
@@ -49,7 +57,8 @@ void ClusteredForwardRenderer::Init(VulkanEngine* engine)
 
 	InitPipelines();
 
-	InitImgui();
+	if (!headless)
+		InitImgui();
 
 	LoadAssets();
 
@@ -69,6 +78,7 @@ void ClusteredForwardRenderer::ConfigureRenderWindow()
 
 void ClusteredForwardRenderer::InitEngine()
 {
+	TRACE_SCOPE("InitEngine");
 	//Request required GPU features and extensions
 	//vulkan 1.3 features
 	VkPhysicalDeviceVulkan13Features features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES };
@@ -83,6 +93,7 @@ void ClusteredForwardRenderer::InitEngine()
 	features12.descriptorBindingSampledImageUpdateAfterBind = true;
 	features12.descriptorBindingUniformBufferUpdateAfterBind = true;
 	features12.descriptorBindingStorageImageUpdateAfterBind = true;
+	features12.descriptorBindingStorageBufferUpdateAfterBind = true;
 	features12.shaderSampledImageArrayNonUniformIndexing = true;
 	features12.descriptorBindingUpdateUnusedWhilePending = true;
 	features12.descriptorBindingVariableDescriptorCount = true;
@@ -99,28 +110,27 @@ void ClusteredForwardRenderer::InitEngine()
 	baseFeatures.drawIndirectFirstInstance = true;
 	baseFeatures.multiDrawIndirect = true;
 
-	engine->init(baseFeatures, features11, features12, features);
+	engine->init(baseFeatures, features11, features12, features, headless);
 	resource_manager = std::make_shared<ResourceManager>(engine);
 	scene_manager = std::make_shared<SceneManager>();
-	scene_manager->Init(resource_manager, engine);
+	scene_manager->Init(resource_manager, engine, FRAME_OVERLAP);
 }
 
 void ClusteredForwardRenderer::InitSwapchain()
 {
+	TRACE_SCOPE("InitSwapchain");
 	CreateSwapchain(_windowExtent.width, _windowExtent.height);
 }
 
 void ClusteredForwardRenderer::InitRenderTargets()
 {
+	TRACE_SCOPE("InitRenderTargets");
 	VkExtent3D drawImageExtent = {
 	_windowExtent.width,
 	_windowExtent.height,
 	1
 	};
 
-	//Allocate images larger than swapchain to avoid 
-	const GLFWvidmode* mode = glfwGetVideoMode(glfwGetPrimaryMonitor());
-
 	msaa_samples = engine->GetMSAASampleCount();
 	/*VkExtent3D drawImageExtent = {
 		mode->width,
@@ -155,14 +165,17 @@ void ClusteredForwardRenderer::InitRenderTargets()
 
 	//allocate and create the image
 	vmaCreateImage(engine->_allocator, &rimg_info, &rimg_allocinfo, &_drawImage.image, &_drawImage.allocation, nullptr);
+	engine->_memoryBudget.Track(_drawImage.allocation, MemoryCategory::RenderTargets);
 	vmaSetAllocationName(engine->_allocator, _drawImage.allocation, "Draw image");
 
 	//Create resolve image for multisampling
 	VkImageCreateInfo resolve_img_info = vkinit::image_create_info(_resolveImage.imageFormat, resolveImageUsages, drawImageExtent, 1);
 	vmaCreateImage(engine->_allocator, &resolve_img_info, &rimg_allocinfo, &_resolveImage.image, &_resolveImage.allocation, nullptr);
+	engine->_memoryBudget.Track(_resolveImage.allocation, MemoryCategory::RenderTargets);
 	vmaSetAllocationName(engine->_allocator, _resolveImage.allocation, "resolve image");
 
 	vmaCreateImage(engine->_allocator, &resolve_img_info, &rimg_allocinfo, &_hdrImage.image, &_hdrImage.allocation, nullptr);
+	engine->_memoryBudget.Track(_hdrImage.allocation, MemoryCategory::RenderTargets);
 	vmaSetAllocationName(engine->_allocator, _hdrImage.allocation, "hdr image");
 
 	//build a image-view for the draw image to use for rendering
@@ -184,6 +197,7 @@ void ClusteredForwardRenderer::InitRenderTargets()
 
 	//allocate and create the image
 	vmaCreateImage(engine->_allocator, &dresolve_info, &rimg_allocinfo, &_depthResolveImage.image, &_depthResolveImage.allocation, nullptr);
+	engine->_memoryBudget.Track(_depthResolveImage.allocation, MemoryCategory::RenderTargets);
 
 	//build a image-view for the draw image to use for rendering
 	VkImageViewCreateInfo dRview_info = vkinit::imageview_create_info(_depthImage.imageFormat, _depthResolveImage.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_VIEW_TYPE_2D);
@@ -196,6 +210,7 @@ void ClusteredForwardRenderer::InitRenderTargets()
 
 	//allocate and create the image
 	vmaCreateImage(engine->_allocator, &dimg_info, &rimg_allocinfo, &_depthImage.image, &_depthImage.allocation, nullptr);
+	engine->_memoryBudget.Track(_depthImage.allocation, MemoryCategory::RenderTargets);
 
 	//build a image-view for the draw image to use for rendering
 	VkImageViewCreateInfo dview_info = vkinit::imageview_create_info(_depthImage.imageFormat, _depthImage.image, VK_IMAGE_ASPECT_DEPTH_BIT, VK_IMAGE_VIEW_TYPE_2D);
@@ -224,6 +239,7 @@ void ClusteredForwardRenderer::InitRenderTargets()
 
 void ClusteredForwardRenderer::InitCommands()
 {
+	TRACE_SCOPE("InitCommands");
 	VkCommandPoolCreateInfo commandPoolInfo = vkinit::command_pool_create_info(engine->_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
 
 	for (int i = 0; i < FRAME_OVERLAP; i++) {
@@ -241,6 +257,7 @@ void ClusteredForwardRenderer::InitCommands()
 
 void ClusteredForwardRenderer::InitSyncStructures()
 {
+	TRACE_SCOPE("InitSyncStructures");
 	VkFenceCreateInfo fenceCreateInfo = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
 	for (int i = 0; i < FRAME_OVERLAP; i++) {
 
@@ -261,6 +278,7 @@ void ClusteredForwardRenderer::InitSyncStructures()
 
 void ClusteredForwardRenderer::InitDescriptors()
 {
+	TRACE_SCOPE("InitDescriptors");
 	//create a descriptor pool that will hold 10 sets with 1 image each
 	std::vector<DescriptorAllocator::PoolSizeRatio> sizes = {
 		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 3 },
@@ -278,46 +296,60 @@ void ClusteredForwardRenderer::InitDescriptors()
 		builder.add_binding(0, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		_drawImageDescriptorLayout = builder.build(engine->_device, VK_SHADER_STAGE_FRAGMENT_BIT);
+		pass_templates.hdr = builder.build_template(engine->_device, _drawImageDescriptorLayout);
 	}
 
 	{
 		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 		builder.add_binding(2, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		builder.add_binding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		builder.add_binding(4, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		builder.add_binding(5, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		builder.add_binding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		builder.add_binding(6, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
 		builder.add_binding(7, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		builder.add_binding(8, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		builder.add_binding(9, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		builder.add_binding(10, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-		builder.add_binding(11, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		builder.add_binding(11, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+		builder.add_binding(12, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		_gpuSceneDataDescriptorLayout = builder.build(engine->_device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT | VK_SHADER_STAGE_GEOMETRY_BIT);
+		pass_templates.geometry = builder.build_template(engine->_device, _gpuSceneDataDescriptorLayout);
+		assert(pass_templates.geometry.entryCount <= PASS_TEMPLATE_ENTRIES);
 	}
 	{
 		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		cascaded_shadows_descriptor_layout = builder.build(engine->_device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_GEOMETRY_BIT);
+		pass_templates.shadows = builder.build_template(engine->_device, cascaded_shadows_descriptor_layout);
+	}
+	{
+		DescriptorLayoutBuilder builder;
+		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
+		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		early_depth_descriptor_layout = builder.build(engine->_device, VK_SHADER_STAGE_VERTEX_BIT);
+		pass_templates.early_depth = builder.build_template(engine->_device, early_depth_descriptor_layout);
 	}
 
 	{
 		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		_skyboxDescriptorLayout = builder.build(engine->_device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT);
+		pass_templates.sky = builder.build_template(engine->_device, _skyboxDescriptorLayout);
 	}
 
 	{
 		DescriptorLayoutBuilder builder;
 		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
 		builder.add_binding(3, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		builder.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-		builder.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+		builder.add_binding(5, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC);
 		_cullLightsDescriptorLayout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT);
+		pass_templates.cull_lights = builder.build_template(engine->_device, _cullLightsDescriptorLayout);
 	}
 
 	{
@@ -329,19 +361,22 @@ void ClusteredForwardRenderer::InitDescriptors()
 
 	{
 		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 65536);
-		builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 65536);
-		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 65536);
+		builder.add_binding(BINDLESS_TEXTURE_BINDING, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, BINDLESS_TEXTURE_CAPACITY);
+		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
+		builder.add_binding(BINDLESS_MATERIAL_TABLE_BINDING, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		resource_manager->bindless_descriptor_layout = builder.build(engine->_device, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, nullptr, VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT);
+		resource_manager->InitBindless();
 	}
 
 	{
 		DescriptorLayoutBuilder builder;
-		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
+		builder.add_binding(0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		builder.add_binding(2, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		builder.add_binding(3, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+		builder.add_binding(4, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
 		compute_cull_descriptor_layout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT, nullptr);
+		pass_templates.cull = builder.build_template(engine->_device, compute_cull_descriptor_layout);
 	}
 
 	{
@@ -349,6 +384,7 @@ void ClusteredForwardRenderer::InitDescriptors()
 		builder.add_binding(0, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
 		builder.add_binding(1, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
 		depth_reduce_descriptor_layout = builder.build(engine->_device, VK_SHADER_STAGE_COMPUTE_BIT, nullptr);
+		pass_templates.depth_reduce = builder.build_template(engine->_device, depth_reduce_descriptor_layout);
 	}
 
 	_mainDeletionQueue.push_function([&]() {
@@ -356,11 +392,15 @@ void ClusteredForwardRenderer::InitDescriptors()
 		vkDestroyDescriptorSetLayout(engine->_device, _gpuSceneDataDescriptorLayout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, _skyboxDescriptorLayout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, cascaded_shadows_descriptor_layout, nullptr);
+		vkDestroyDescriptorSetLayout(engine->_device, early_depth_descriptor_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, _cullLightsDescriptorLayout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, _buildClustersDescriptorLayout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, resource_manager->bindless_descriptor_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, compute_cull_descriptor_layout, nullptr);
 		vkDestroyDescriptorSetLayout(engine->_device, depth_reduce_descriptor_layout, nullptr);
+		for (DescriptorUpdateTemplate* updateTemplate : { &pass_templates.geometry, &pass_templates.early_depth, &pass_templates.shadows, &pass_templates.sky,
+			&pass_templates.hdr, &pass_templates.cull_lights, &pass_templates.cull, &pass_templates.depth_reduce })
+			updateTemplate->destroy(engine->_device);
 		});
 
 	for (int i = 0; i < FRAME_OVERLAP; i++) {
@@ -372,27 +412,58 @@ void ClusteredForwardRenderer::InitDescriptors()
 			{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 4 },
 		};
 
-		std::vector<DescriptorAllocator::PoolSizeRatio> bindless_sizes = {
-		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
-		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
-		};
-
 		_frames[i]._frameDescriptors = DescriptorAllocatorGrowable{};
 		_frames[i]._frameDescriptors.init(engine->_device, 1000, frame_sizes);
-		_frames[i].bindless_material_descriptor = DescriptorAllocator{};
-		_frames[i].bindless_material_descriptor.init_pool(engine->_device, 65536, bindless_sizes);
 		_mainDeletionQueue.push_function([&, i]() {
 			_frames[i]._frameDescriptors.destroy_pools(engine->_device);
-			_frames[i].bindless_material_descriptor.destroy_pool(engine->_device);
 			});
 	}
+
+	//the pass sets live as long as the renderer, they are rewritten in place
+	std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> pass_sizes = {
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 4 },
+		{ VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER_DYNAMIC, 1 },
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 2 },
+	};
+	pass_descriptor_allocator.init(engine->_device, 16 * FRAME_OVERLAP, pass_sizes);
+	_mainDeletionQueue.push_function([&]() {
+		pass_descriptor_allocator.destroy_pools(engine->_device);
+		});
+
+	//the point lights are pushed every frame, a stress scene can have far more than the default capacity holds
+	const VkDeviceSize stress_lights = stress_scene.has_value() ? stress_scene->lights * sizeof(PointLight) : 0;
+	frame_ring.Init(resource_manager.get(), FRAME_RING_DEFAULT_CAPACITY + stress_lights, FRAME_OVERLAP);
+	_mainDeletionQueue.push_function([&]() {
+		frame_ring.Cleanup();
+		});
+
+	frame_arena.Init();
+	_mainDeletionQueue.push_function([&]() {
+		frame_arena.Cleanup();
+		});
+	frame_history.Init();
+
+	gpu_profiler.Init(engine, FRAME_OVERLAP);
+	_mainDeletionQueue.push_function([&]() {
+		gpu_profiler.Cleanup();
+		});
+
+	gpu_statistics.Init(resource_manager.get(), FRAME_OVERLAP);
+	_mainDeletionQueue.push_function([&]() {
+		gpu_statistics.Cleanup();
+		});
 }
 
 
 void ClusteredForwardRenderer::InitPipelines()
 {
+	TRACE_SCOPE("InitPipelines");
+	//everything below is only declared, the batch creates it all at once at the end
+	PipelineBatch batch;
 	PipelineCreationInfo info;
+	info.batch = &batch;
 	info.layouts.push_back(_gpuSceneDataDescriptorLayout);
 	info.layouts.push_back(resource_manager->bindless_descriptor_layout);
 	info.imageFormat = _drawImage.imageFormat;
@@ -401,26 +472,31 @@ void ClusteredForwardRenderer::InitPipelines()
 	resource_manager->PBRpipeline = &metalRoughMaterial;
 
 	PipelineCreationInfo shadowInfo;
+	shadowInfo.batch = &batch;
 	shadowInfo.layouts.push_back(cascaded_shadows_descriptor_layout);
 	shadowInfo.depthFormat = _shadowDepthImage.imageFormat;
 	cascadedShadows.build_pipelines(engine, shadowInfo);
 
 	PipelineCreationInfo skyInfo;
+	skyInfo.batch = &batch;
 	skyInfo.layouts.push_back(_skyboxDescriptorLayout);
 	skyInfo.depthFormat = _depthImage.imageFormat;
 	skyInfo.imageFormat = _drawImage.imageFormat;
 	skyBoxPSO.build_pipelines(engine,skyInfo);
 
 	PipelineCreationInfo HDRinfo;
+	HDRinfo.batch = &batch;
 	HDRinfo.layouts.push_back(_drawImageDescriptorLayout);
 	HDRinfo.imageFormat = _drawImage.imageFormat;
 	HdrPSO.build_pipelines(engine,HDRinfo);
 
 	PipelineCreationInfo earlyDepthInfo;
-	earlyDepthInfo.layouts.push_back(_gpuSceneDataDescriptorLayout);
+	earlyDepthInfo.batch = &batch;
+	earlyDepthInfo.layouts.push_back(early_depth_descriptor_layout);
 	earlyDepthInfo.depthFormat = _depthImage.imageFormat;
 	depthPrePassPSO.build_pipelines(engine, earlyDepthInfo);
-	InitComputePipelines();
+	InitComputePipelines(batch);
+	batch.create(engine->_device, engine->_pipelineCache);
 	_mainDeletionQueue.push_function([&]()
 		{
 			depthPrePassPSO.clear_resources(engine->_device);
@@ -437,8 +513,9 @@ void ClusteredForwardRenderer::InitPipelines()
 }
 
 
-void ClusteredForwardRenderer::InitComputePipelines()
+void ClusteredForwardRenderer::InitComputePipelines(PipelineBatch& batch)
 {
+	TRACE_SCOPE("InitComputePipelines");
 	VkPipelineLayoutCreateInfo cullLightsLayoutInfo = {};
 	cullLightsLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	cullLightsLayoutInfo.pNext = nullptr;
@@ -461,20 +538,8 @@ void ClusteredForwardRenderer::InitComputePipelines()
 		fmt::print("Error when building the compute shader \n");
 	}
 
-	VkPipelineShaderStageCreateInfo stageinfo{};
-	stageinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	stageinfo.pNext = nullptr;
-	stageinfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-	stageinfo.module = cullLightShader;
-	stageinfo.pName = "main";
-
-	VkComputePipelineCreateInfo computePipelineCreateInfo{};
-	computePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-	computePipelineCreateInfo.pNext = nullptr;
-	computePipelineCreateInfo.layout = cull_lights_pso.layout;
-	computePipelineCreateInfo.stage = stageinfo;
-
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &cull_lights_pso.pipeline));
+	batch.add_compute("cull lights", cull_lights_pso.layout, cullLightShader, &cull_lights_pso.pipeline);
+	batch.add_shader_module(cullLightShader);
 
 
 	VkPipelineLayoutCreateInfo cullObjectsLayoutInfo = {};
@@ -495,17 +560,8 @@ void ClusteredForwardRenderer::InitComputePipelines()
 		fmt::print("Error when building the compute shader \n");
 	}
 
-	VkPipelineShaderStageCreateInfo stageinfoObj{};
-	stageinfoObj.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	stageinfoObj.pNext = nullptr;
-	stageinfoObj.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-	stageinfoObj.module = cullObjectsShader;
-	stageinfoObj.pName = "main";
-
-	computePipelineCreateInfo.layout = cull_objects_pso.layout;
-	computePipelineCreateInfo.stage = stageinfoObj;
-
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &cull_objects_pso.pipeline));
+	batch.add_compute("cull objects", cull_objects_pso.layout, cullObjectsShader, &cull_objects_pso.pipeline);
+	batch.add_shader_module(cullObjectsShader);
 
 	VkPipelineLayoutCreateInfo depthReduceLayoutInfo = {};
 	depthReduceLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -525,20 +581,8 @@ void ClusteredForwardRenderer::InitComputePipelines()
 	}
 
 
-	VkPipelineShaderStageCreateInfo depthReduceStageinfo{};
-	depthReduceStageinfo.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-	depthReduceStageinfo.pNext = nullptr;
-	depthReduceStageinfo.stage = VK_SHADER_STAGE_COMPUTE_BIT;
-	depthReduceStageinfo.module = depthReduceShader;
-	depthReduceStageinfo.pName = "main";
-
-	VkComputePipelineCreateInfo depthComputePipelineCreateInfo{};
-	depthComputePipelineCreateInfo.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
-	depthComputePipelineCreateInfo.pNext = nullptr;
-	depthComputePipelineCreateInfo.layout = depth_reduce_pso.layout;
-	depthComputePipelineCreateInfo.stage = depthReduceStageinfo;
-
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &depthComputePipelineCreateInfo, nullptr, &depth_reduce_pso.pipeline));
+	batch.add_compute("depth reduce", depth_reduce_pso.layout, depthReduceShader, &depth_reduce_pso.pipeline);
+	batch.add_shader_module(depthReduceShader);
 
 
 
@@ -554,6 +598,7 @@ void ClusteredForwardRenderer::InitComputePipelines()
 
 void ClusteredForwardRenderer::InitDefaultData()
 {
+	TRACE_SCOPE("InitDefaultData");
 	forward_passes.push_back(vkutil::MaterialPass::forward);
 	forward_passes.push_back(vkutil::MaterialPass::transparency);
 
@@ -608,16 +653,21 @@ void ClusteredForwardRenderer::InitDefaultData()
 	}
 
 	//Populate point light list
-	int numOfLights = 4;
-	std::random_device dev;
-	std::mt19937 rng(dev());
-	std::uniform_real_distribution<> distFloat(0.0f, 15.0f);
-	for (int i = 0; i < numOfLights; i++)
+	if (stress_scene.has_value())
+		pointData.pointLights = BuildStressLights(*stress_scene);
+	else
 	{
-		pointData.pointLights.push_back(PointLight(glm::vec4(distFloat(rng), 5.0f, distFloat(rng), 1.0f), glm::vec4(1), 12.0f, 1.0f));
+		int numOfLights = 4;
+		std::random_device dev;
+		std::mt19937 rng(dev());
+		std::uniform_real_distribution<> distFloat(0.0f, 15.0f);
+		for (int i = 0; i < numOfLights; i++)
+		{
+			pointData.pointLights.push_back(PointLight(glm::vec4(distFloat(rng), 5.0f, distFloat(rng), 1.0f), glm::vec4(1), 12.0f, 1.0f));
+		}
+		pointData.pointLights.push_back(PointLight(glm::vec4(-257.0f, 130.0f, 5.25f, -256.0f), glm::vec4(1), 15.0f, 1.0f));
+		pointData.pointLights.push_back(PointLight(glm::vec4(-0.12f, -5.14f, -5.25f, 1.0f), glm::vec4(1), 15.0f, 1.0f));
 	}
-	pointData.pointLights.push_back(PointLight(glm::vec4(-257.0f, 130.0f, 5.25f, -256.0f), glm::vec4(1), 15.0f, 1.0f));
-	pointData.pointLights.push_back(PointLight(glm::vec4(-0.12f, -5.14f, -5.25f, 1.0f), glm::vec4(1), 15.0f, 1.0f));
 
 	//Prepare Depth Pyramid
 
@@ -725,6 +775,7 @@ void ClusteredForwardRenderer::CreateSwapchain(uint32_t width, uint32_t height)
 
 void ClusteredForwardRenderer::InitBuffers()
 {
+	TRACE_SCOPE("InitBuffers");
 	ClusterValues.AABBVolumeGridSSBO = resource_manager->CreateBuffer(ClusterValues.numClusters * sizeof(VolumeTileAABB), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
 	float zNear = mainCamera.getNearClip();
 	float zFar = mainCamera.getFarClip();
@@ -747,23 +798,19 @@ void ClusteredForwardRenderer::InitBuffers()
 
 	ClusterValues.screenToViewSSBO = resource_manager->CreateAndUpload(sizeof(ScreenToView), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &screen);
 
-	ClusterValues.lightSSBO = resource_manager->CreateAndUpload(pointData.pointLights.size() * sizeof(PointLight), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, pointData.pointLights.data());
 	auto totalLightCount = ClusterValues.maxLightsPerTile * ClusterValues.numClusters;
 	ClusterValues.lightIndexListSSBO = resource_manager->CreateBuffer(sizeof(uint32_t) * totalLightCount, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
 
 	ClusterValues.lightGridSSBO = resource_manager->CreateBuffer(ClusterValues.numClusters * sizeof(LightGrid), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
 
-	uint32_t val = 0;
-	for (uint32_t i = 0; i < 2; i++)
-	{
-		ClusterValues.lightGlobalIndex[i] = resource_manager->CreateAndUpload(sizeof(uint32_t), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, &val);
-	}
+	resource_manager->InitTextureFeedback(FRAME_OVERLAP);
 	
 }
 
 
 void ClusteredForwardRenderer::InitImgui()
 {
+	TRACE_SCOPE("InitImgui");
 
 	// 1: create descriptor pool for IMGUI
 	//  the size of the pool is very oversize, but it's copied from imgui demo
@@ -844,9 +891,14 @@ void ClusteredForwardRenderer::DestroySwapchain()
 
 void ClusteredForwardRenderer::UpdateScene()
 {
-	float currentFrame = glfwGetTime();
-	float deltaTime = currentFrame - delta.lastFrame;
-	delta.lastFrame = currentFrame;
+	ZoneScoped;
+	float deltaTime = fixed_timestep;
+	if (fixed_timestep == 0.0f)
+	{
+		float currentFrame = glfwGetTime();
+		deltaTime = currentFrame - delta.lastFrame;
+		delta.lastFrame = currentFrame;
+	}
 	mainCamera.update(deltaTime);
 	mainDrawContext.OpaqueSurfaces.clear();
 
@@ -873,21 +925,6 @@ void ClusteredForwardRenderer::UpdateScene()
 	scene_data.sunlightDirection = directLight.direction;
 	scene_data.lightCount = pointData.pointLights.size();
 
-	void* data = nullptr;
-	vmaMapMemory(engine->_allocator, ClusterValues.lightSSBO.allocation, &data);
-	memcpy(data, pointData.pointLights.data(), pointData.pointLights.size() * sizeof(PointLight));
-	vmaUnmapMemory(engine->_allocator, ClusterValues.lightSSBO.allocation);
-
-
-	//uint32_t* val = (uint32_t*)ClusterValues.lightGlobalIndex[_frameNumber % FRAME_OVERLAP].allocation->GetMappedData();
-	//*val = 0;
-	void* val = nullptr;
-	vmaMapMemory(engine->_allocator, ClusterValues.lightGlobalIndex[_frameNumber % FRAME_OVERLAP].allocation, &val);
-	uint32_t* value = (uint32_t*)val;
-	*value = 0;
-	vmaUnmapMemory(engine->_allocator, ClusterValues.lightGlobalIndex[_frameNumber % FRAME_OVERLAP].allocation);
-
-
 	cascadeData = shadows.getCascades(engine, mainCamera, scene_data);
 	if (mainCamera.updated || directLight.direction != directLight.lastDirection)
 	{
@@ -911,20 +948,17 @@ void ClusteredForwardRenderer::UpdateScene()
 	scene_data.ConfigData.y = mainCamera.getFarClip();
 
 	//Prepare Render objects
-	loadedScenes["sponza"]->Draw(glm::mat4{ 1.f }, drawCommands);
+	loadedScenes[main_scene]->Draw(glm::mat4{ 1.f }, drawCommands);
 	loadedScenes["cube"]->Draw(glm::mat4{ 1.f }, skyDrawCommands);
 	loadedScenes["plane"]->Draw(glm::mat4{ 1.f }, imageDrawCommands);
 }
 
 void ClusteredForwardRenderer::LoadAssets()
 {
+	TRACE_SCOPE("LoadAssets");
 	//Load in skyBox image
 	_skyImage = vkutil::load_cubemap_image("assets/textures/hdris/overcast.ktx", VkExtent3D{ 1,1,1 }, engine, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT, true);
 
-	std::string structurePath{ "assets/sponza/Sponza.gltf" };
-	auto structureFile = resource_manager->loadGltf(engine, structurePath, true);
-	assert(structureFile.has_value());
-
 	std::string cubePath{ "assets/cube.gltf" };
 	auto cubeFile = resource_manager->loadGltf(engine, cubePath);
 	assert(cubeFile.has_value());
@@ -933,18 +967,26 @@ void ClusteredForwardRenderer::LoadAssets()
 	auto planeFile = resource_manager->loadGltf(engine, planePath);
 	assert(planeFile.has_value());
 
-	loadedScenes["sponza"] = *structureFile;
+	if (stress_scene.has_value())
+	{
+		main_scene = "stress";
+		loadedScenes[main_scene] = BuildStressScene(resource_manager.get(), *stress_scene);
+	}
+	else
+	{
+		auto structureFile = resource_manager->loadGltf(engine, scene_path, true);
+		assert(structureFile.has_value());
+		loadedScenes[main_scene] = *structureFile;
+	}
 	loadedScenes["cube"] = *cubeFile;
 	loadedScenes["plane"] = *planeFile;
 
-	loadedScenes["sponza"]->Draw(glm::mat4{ 1.f }, drawCommands);
-	scene_manager->RegisterMeshAssetReference("sponza");
-	//Register render objects for draw indirect
-	scene_manager->RegisterObjectBatch(drawCommands);
-	scene_manager->MergeMeshes();
-	scene_manager->PrepareIndirectBuffers();
-	scene_manager->BuildBatches();
+	scene_manager->RegisterMeshAssetReference(main_scene);
+	//Register render objects for draw indirect, world cells are added around it as the camera moves
+	scene_manager->AddScene(0, loadedScenes[main_scene]);
+	scene_manager->CommitSceneChanges();
 	resource_manager->write_material_array();
+	world_partition.Init(engine, resource_manager, scene_manager, "assets/world/cells.txt", FRAME_OVERLAP);
 }
 
 void ClusteredForwardRenderer::KeyCallback(GLFWwindow* window, int key, int scancode, int action, int mods)
@@ -971,6 +1013,7 @@ void ClusteredForwardRenderer::FramebufferResizeCallback(GLFWwindow* window, int
 
 void ClusteredForwardRenderer::PreProcessPass()
 {
+	TRACE_SCOPE("PreProcessPass");
 	GenerateIrradianceCube();
 	GeneratePrefilteredCubemap();
 	black_key::generate_brdf_lut(engine, IBL);
@@ -990,6 +1033,7 @@ void ClusteredForwardRenderer::PreProcessPass()
 
 void ClusteredForwardRenderer::BuildClusters()
 {
+	TRACE_SCOPE("BuildClusters");
 	VkPipelineLayoutCreateInfo ClusterLayoutInfo = {};
 	ClusterLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
 	ClusterLayoutInfo.pNext = nullptr;
@@ -1028,7 +1072,7 @@ void ClusteredForwardRenderer::BuildClusters()
 	VkPipeline clusterPipeline;
 	//default colors
 
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &clusterPipeline));
+	VK_CHECK(engine->_pipelineCache.CreateComputePipeline(computePipelineCreateInfo, "build clusters", &clusterPipeline));
 
 	VkDescriptorSet globalDescriptor = globalDescriptorAllocator.allocate(engine->_device, _buildClustersDescriptorLayout);
 
@@ -1053,6 +1097,7 @@ void ClusteredForwardRenderer::BuildClusters()
 
 void ClusteredForwardRenderer::GeneratePrefilteredCubemap()
 {
+	TRACE_SCOPE("GeneratePrefilteredCubemap");
 	VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
 	uint32_t dim = 512;
 	uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
@@ -1130,7 +1175,7 @@ void ClusteredForwardRenderer::GeneratePrefilteredCubemap()
 	pipelineBuilder._pipelineLayout = irradianceLayout;
 	pipelineBuilder.set_color_attachment_format(drawImage.imageFormat);
 
-	auto irradiancePipeline = pipelineBuilder.build_pipeline(engine->_device);
+	auto irradiancePipeline = pipelineBuilder.build_pipeline(engine->_pipelineCache, "pre filter envmap");
 
 	std::vector<glm::mat4> matrices = {
 		// POSITIVE_X
@@ -1185,6 +1230,7 @@ void ClusteredForwardRenderer::GeneratePrefilteredCubemap()
 
 	{
 		VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+		VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
 		black_key::PushBlock pushBlock;
 		for (uint32_t m = 0; m < numMips; m++) {
 			pushBlock.roughness = (float)m / (float)(numMips - 1);
@@ -1198,10 +1244,11 @@ void ClusteredForwardRenderer::GeneratePrefilteredCubemap()
 				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, irradiancePipeline);
 				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, irradianceLayout, 0, 1, &globalDescriptor, 0, NULL);
 
-				if (r.indexBuffer != lastIndexBuffer)
+				if (r.indexBuffer != lastIndexBuffer || r.indexType != lastIndexType)
 				{
 					lastIndexBuffer = r.indexBuffer;
-					vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+					lastIndexType = r.indexType;
+					vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, r.indexType);
 				}
 				// Update shader push constant block
 				pushBlock.mvp = glm::perspective((float)(M_PI / 2.0), 1.0f, 0.1f, 512.0f) * matrices[f];
@@ -1209,7 +1256,7 @@ void ClusteredForwardRenderer::GeneratePrefilteredCubemap()
 				pushBlock.vertexBuffer = r.vertexBufferAddress;
 				vkCmdPushConstants(cmd, irradianceLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(black_key::PushBlock), &pushBlock);
 
-				vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
+				vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, r.firstVertex, 0);
 				vkCmdEndRendering(cmd);
 
 				vkutil::transition_image(cmd, drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
@@ -1256,6 +1303,7 @@ void ClusteredForwardRenderer::GeneratePrefilteredCubemap()
 
 void ClusteredForwardRenderer::GenerateIrradianceCube()
 {
+	TRACE_SCOPE("GenerateIrradianceCube");
 	VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
 	uint32_t dim = 64;
 	uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
@@ -1346,7 +1394,7 @@ void ClusteredForwardRenderer::GenerateIrradianceCube()
 	pipelineBuilder._pipelineLayout = irradianceLayout;
 	pipelineBuilder.set_color_attachment_format(drawImage.imageFormat);
 
-	auto irradiancePipeline = pipelineBuilder.build_pipeline(engine->_device);
+	auto irradiancePipeline = pipelineBuilder.build_pipeline(engine->_pipelineCache, "irradiance");
 
 	std::vector<glm::mat4> matrices = {
 		// POSITIVE_X
@@ -1389,6 +1437,7 @@ void ClusteredForwardRenderer::GenerateIrradianceCube()
 
 	{
 		VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+		VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
 
 		for (uint32_t m = 0; m < numMips; m++) {
 			for (uint32_t f = 0; f < 6; f++)
@@ -1410,10 +1459,11 @@ void ClusteredForwardRenderer::GenerateIrradianceCube()
 				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, irradiancePipeline);
 				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, irradianceLayout, 0, 1, &globalDescriptor, 0, NULL);
 
-				if (r.indexBuffer != lastIndexBuffer)
+				if (r.indexBuffer != lastIndexBuffer || r.indexType != lastIndexType)
 				{
 					lastIndexBuffer = r.indexBuffer;
-					vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+					lastIndexType = r.indexType;
+					vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, r.indexType);
 				}
 
 				black_key::PushBlock pushBlock;
@@ -1422,7 +1472,7 @@ void ClusteredForwardRenderer::GenerateIrradianceCube()
 				pushBlock.mvp[1][1] *= -1;
 				pushBlock.vertexBuffer = r.vertexBufferAddress;
 				vkCmdPushConstants(cmd, irradianceLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(black_key::PushBlock), &pushBlock);
-				vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
+				vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, r.firstVertex, 0);
 
 				vkCmdEndRendering(cmd);
 				vkutil::transition_image(cmd, drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
@@ -1472,13 +1522,12 @@ void ClusteredForwardRenderer::Cleanup()
 	{
 		vkDeviceWaitIdle(engine->_device);
 
+		world_partition.Cleanup();
 		loadedScenes.clear();
+		scene_manager->Cleanup();
 
-		for (auto& frame : _frames) {
-			frame._deletionQueue.flush();
-		}
-
-		DestroySwapchain();
+		if (!headless)
+			DestroySwapchain();
 		engine->cleanup();
 	}
 	engine = nullptr;
@@ -1488,6 +1537,7 @@ void ClusteredForwardRenderer::Draw()
 {
 	ZoneScoped;
 	auto start_update = std::chrono::system_clock::now();
+	frame_history.BeginPhase("fence wait");
 	//wait until the gpu has finished rendering the last frame. Timeout of 1 second
 	VK_CHECK(vkWaitForFences(engine->_device, 1, &get_current_frame()._renderFence, true, 1000000000));
 
@@ -1495,13 +1545,34 @@ void ClusteredForwardRenderer::Draw()
 	auto end_update = std::chrono::system_clock::now();
 	auto elapsed_update = std::chrono::duration_cast<std::chrono::microseconds>(end_update - start_update);
 	stats.update_time = elapsed_update.count() / 1000.f;
+	frame_history.BeginPhase("frame setup");
 
-	get_current_frame()._deletionQueue.flush();
+	gpu_profiler.ReadResults(_frameNumber);
+	gpu_statistics.ReadResults(_frameNumber);
+	resource_manager->retire_queue.BeginFrame(_frameNumber);
+	resource_manager->bindless_table.BeginFrame(_frameNumber);
 	get_current_frame()._frameDescriptors.clear_pools(engine->_device);
-
-	//request image from the swapchain
-	uint32_t swapchainImageIndex;
-	VkResult e = vkAcquireNextImageKHR(engine->_device, _swapchain, 1000000000, get_current_frame()._swapchainSemaphore, nullptr, &swapchainImageIndex);
+	resource_manager->geometry_heap.BeginFrame(_frameNumber);
+	frame_ring.BeginFrame(_frameNumber);
+	frame_arena.Reset();
+	//the reset took back its storage
+	cullBarriers = std::pmr::vector<VkBufferMemoryBarrier>(&frame_arena);
+	world_partition.Update(glm::vec3(scene_data.cameraPos), _frameNumber);
+
+	engine->_memoryBudget.Update(_frameNumber);
+	resource_manager->ReadTextureFeedback(_frameNumber % FRAME_OVERLAP, _frameNumber);
+	resource_manager->EnforceMemoryBudget(_frameNumber);
+	resource_manager->StreamTextures(_frameNumber);
+
+	//after the world update, a commit there replaces the scene buffers
+	UpdatePassDescriptors();
+	WriteFrameUniforms();
+
+	//request image from the swapchain, headless frames end in the HDR image
+	uint32_t swapchainImageIndex = 0;
+	VkResult e = VK_SUCCESS;
+	if (!headless)
+		e = vkAcquireNextImageKHR(engine->_device, _swapchain, 1000000000, get_current_frame()._swapchainSemaphore, nullptr, &swapchainImageIndex);
 
 	if (e == VK_ERROR_OUT_OF_DATE_KHR) {
 		resize_requested = true;
@@ -1523,7 +1594,15 @@ void ClusteredForwardRenderer::Draw()
 	VkCommandBufferBeginInfo cmdBeginInfo = vkinit::command_buffer_begin_info(VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT);
 
 	//> draw_first
+	frame_history.BeginPhase("record");
 	VK_CHECK(vkBeginCommandBuffer(cmd, &cmdBeginInfo));
+	gpu_profiler.BeginFrame(cmd, _frameNumber);
+	gpu_statistics.BeginFrame(cmd, _frameNumber);
+
+	//compact the geometry heap before culling and drawing read it
+	scene_manager->UpdateGeometry(cmd);
+	resource_manager->RecordTextureUpdates(cmd);
+	resource_manager->ResetTextureFeedback(cmd);
 
 	// transition our main draw image into general layout so we can write into it
 	// we will overwrite it all so we dont care about what was the older layout
@@ -1536,8 +1615,25 @@ void ClusteredForwardRenderer::Draw()
 	vkutil::transition_image(cmd, _depthPyramid.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_GENERAL);
 
 	DrawMain(cmd);
+	resource_manager->CopyTextureFeedback(cmd, _frameNumber % FRAME_OVERLAP);
+	gpu_statistics.EndFrame(cmd);
+
+	{
+		GpuProfileScope scope(gpu_profiler, cmd, "hdr");
+		DrawPostProcess(cmd);
+	}
+	frame_ring.Flush();
 
-	DrawPostProcess(cmd);
+	if (headless)
+	{
+		VK_CHECK(vkEndCommandBuffer(cmd));
+		frame_history.BeginPhase("submit");
+		VkCommandBufferSubmitInfo cmdinfo = vkinit::command_buffer_submit_info(cmd);
+		VkSubmitInfo2 submit = vkinit::submit_info(&cmdinfo, nullptr, nullptr);
+		VK_CHECK(vkQueueSubmit2(engine->_graphicsQueue, 1, &submit, get_current_frame()._renderFence));
+		_frameNumber++;
+		return;
+	}
 
 	//transtion the draw image and the swapchain image into their correct transfer layouts
 	vkutil::transition_image(cmd, _hdrImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
@@ -1560,6 +1656,7 @@ void ClusteredForwardRenderer::Draw()
 
 	//finalize the command buffer (we can no longer add commands, but it can now be executed)
 	VK_CHECK(vkEndCommandBuffer(cmd));
+	frame_history.BeginPhase("submit");
 
 	//prepare the submission to the queue. 
 	//we want to wait on the _presentSemaphore, as that semaphore is signaled when the swapchain is ready
@@ -1599,79 +1696,137 @@ void ClusteredForwardRenderer::Draw()
 	_frameNumber++;
 }
 
-void ClusteredForwardRenderer::DrawShadows(VkCommandBuffer cmd)
+void ClusteredForwardRenderer::UpdatePassDescriptors()
 {
-	AllocatedBuffer shadowDataBuffer = vkutil::create_buffer(sizeof(shadowData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, engine);
-
-	//add it to the deletion queue of this frame so it gets deleted once its been used
-	get_current_frame()._deletionQueue.push_function([=, this]() {
-		vkutil::destroy_buffer(shadowDataBuffer,engine);
-		});
-
-	//write the buffer
-	void* sceneDataPtr = nullptr;
-	vmaMapMemory(engine->_allocator, shadowDataBuffer.allocation, &sceneDataPtr);
-	shadowData* ptr = (shadowData*)sceneDataPtr;
-	*ptr = shadow_data;
-	vmaUnmapMemory(engine->_allocator, shadowDataBuffer.allocation);
-
-	VkDescriptorSet globalDescriptor = get_current_frame()._frameDescriptors.allocate(engine->_device, cascaded_shadows_descriptor_layout);
-
-	DescriptorWriter writer;
-	writer.write_buffer(0, shadowDataBuffer.buffer, sizeof(shadowData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.write_buffer(1, scene_manager->GetObjectDataBuffer()->buffer,
-		sizeof(vkutil::GPUModelInformation) * scene_manager->GetModelCount(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.update_set(engine->_device, globalDescriptor);
-
+	ZoneScoped;
+	PassDescriptorSets& sets = pass_sets[_frameNumber % FRAME_OVERLAP];
+	const uint32_t scene_generation = scene_manager->GetBufferGeneration();
+	//the light bindings are sized by the light count, a new count needs new ranges
+	const uint32_t light_count = static_cast<uint32_t>(pointData.pointLights.size());
+	if (sets.scene_generation == scene_generation && sets.target_generation == target_generation && sets.light_count == light_count)
+		return;
 
-	/*
-	VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+	if (sets.geometry == VK_NULL_HANDLE)
+	{
+		sets.geometry = pass_descriptor_allocator.allocate(engine->_device, _gpuSceneDataDescriptorLayout);
+		sets.early_depth = pass_descriptor_allocator.allocate(engine->_device, early_depth_descriptor_layout);
+		sets.shadows = pass_descriptor_allocator.allocate(engine->_device, cascaded_shadows_descriptor_layout);
+		sets.sky = pass_descriptor_allocator.allocate(engine->_device, _skyboxDescriptorLayout);
+		sets.hdr = pass_descriptor_allocator.allocate(engine->_device, _drawImageDescriptorLayout);
+		sets.cull_lights = pass_descriptor_allocator.allocate(engine->_device, _cullLightsDescriptorLayout);
+		for (vkutil::MaterialPass pass : { vkutil::MaterialPass::early_depth, vkutil::MaterialPass::shadow_pass })
+			sets.cull[scene_manager->GetMeshPass(pass)] = pass_descriptor_allocator.allocate(engine->_device, compute_cull_descriptor_layout);
+		sets.depth_reduce.resize(depthPyramidLevels);
+		for (VkDescriptorSet& set : sets.depth_reduce)
+			set = pass_descriptor_allocator.allocate(engine->_device, depth_reduce_descriptor_layout);
+	}
 
-	auto draw = [&](const RenderObject& r) {
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, cascadedShadows.shadowPipeline.pipeline);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, cascadedShadows.shadowPipeline.layout, 0, 1,
-			&globalDescriptor, 0, nullptr);
+	const uint32_t totalLightCount = ClusterValues.maxLightsPerTile * ClusterValues.numClusters;
+	const size_t objectDataSize = sizeof(vkutil::GPUModelInformation) * scene_manager->GetModelCount();
+
+	//every set is written whole from a packed array with one call, nothing here allocates.
+	//The frame ring bindings are written at offset 0, this frame's copy is picked when the set is bound
+	DescriptorTemplateEntry entries[PASS_TEMPLATE_ENTRIES];
+	WriteGeometryEntries(entries);
+	pass_templates.geometry.update_set(engine->_device, sets.geometry, entries);
+
+	const DescriptorUpdateTemplate& earlyDepth = pass_templates.early_depth;
+	earlyDepth.write_buffer(entries, 0, frame_ring.buffer.buffer, sizeof(GPUSceneData), 0);
+	earlyDepth.write_buffer(entries, 1, scene_manager->GetObjectDataBuffer()->buffer, objectDataSize, 0);
+	earlyDepth.update_set(engine->_device, sets.early_depth, entries);
+
+	const DescriptorUpdateTemplate& shadows = pass_templates.shadows;
+	shadows.write_buffer(entries, 0, frame_ring.buffer.buffer, sizeof(shadowData), 0);
+	shadows.write_buffer(entries, 1, scene_manager->GetObjectDataBuffer()->buffer, objectDataSize, 0);
+	shadows.update_set(engine->_device, sets.shadows, entries);
+
+	const DescriptorUpdateTemplate& sky = pass_templates.sky;
+	sky.write_buffer(entries, 0, frame_ring.buffer.buffer, sizeof(GPUSceneData), 0);
+	sky.write_image(entries, 1, _skyImage.imageView, cubeMapSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	sky.update_set(engine->_device, sets.sky, entries);
+
+	const DescriptorUpdateTemplate& hdr = pass_templates.hdr;
+	hdr.write_image(entries, 0, _resolveImage.imageView, defaultSamplerLinear, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	hdr.write_image(entries, 1, _depthResolveImage.imageView, defaultSamplerLinear, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	hdr.update_set(engine->_device, sets.hdr, entries);
+
+	const DescriptorUpdateTemplate& cullLights = pass_templates.cull_lights;
+	cullLights.write_buffer(entries, 0, ClusterValues.AABBVolumeGridSSBO.buffer, ClusterValues.numClusters * sizeof(VolumeTileAABB), 0);
+	cullLights.write_buffer(entries, 1, ClusterValues.screenToViewSSBO.buffer, sizeof(ScreenToView), 0);
+	cullLights.write_buffer(entries, 2, frame_ring.buffer.buffer, pointData.pointLights.size() * sizeof(PointLight), 0);
+	cullLights.write_buffer(entries, 3, ClusterValues.lightIndexListSSBO.buffer, sizeof(uint32_t) * totalLightCount, 0);
+	cullLights.write_buffer(entries, 4, ClusterValues.lightGridSSBO.buffer, ClusterValues.numClusters * sizeof(LightGrid), 0);
+	cullLights.write_buffer(entries, 5, frame_ring.buffer.buffer, sizeof(uint32_t), 0);
+	cullLights.update_set(engine->_device, sets.cull_lights, entries);
+
+	const DescriptorUpdateTemplate& cull = pass_templates.cull;
+	cull.write_buffer(entries, 0, frame_ring.buffer.buffer, sizeof(GPUSceneData), 0);
+	cull.write_buffer(entries, 1, scene_manager->GetObjectDataBuffer()->buffer, objectDataSize, 0);
+	cull.write_image(entries, 3, _depthPyramid.imageView, depthReductionSampler, VK_IMAGE_LAYOUT_GENERAL);
+	cull.write_buffer(entries, 4, gpu_statistics.GetCounterBuffer().buffer, gpu_statistics.GetCounterBufferSize(), 0);
+	for (auto& [meshPass, set] : sets.cull)
+	{
+		cull.write_buffer(entries, 2, meshPass->drawIndirectBuffer.buffer, sizeof(SceneManager::GPUIndirectObject) * meshPass->flat_objects.size(), 0);
+		cull.update_set(engine->_device, set, entries);
+	}
 
+	const DescriptorUpdateTemplate& depthReduce = pass_templates.depth_reduce;
+	for (uint32_t i = 0; i < sets.depth_reduce.size(); i++)
+	{
+		depthReduce.write_image(entries, 0, depthPyramidMips[i], depthReductionSampler, VK_IMAGE_LAYOUT_GENERAL);
+		if (i == 0)
+			depthReduce.write_image(entries, 1, _depthResolveImage.imageView, depthReductionSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+		else
+			depthReduce.write_image(entries, 1, depthPyramidMips[i - 1], depthReductionSampler, VK_IMAGE_LAYOUT_GENERAL);
+		depthReduce.update_set(engine->_device, sets.depth_reduce[i], entries);
+	}
 
-		VkViewport viewport = {};
-		viewport.x = 0;
-		viewport.y = 0;
-		viewport.width = (float)_shadowDepthImage.imageExtent.width;
-		viewport.height = (float)_shadowDepthImage.imageExtent.height;
-		viewport.minDepth = 0.f;
-		viewport.maxDepth = 1.f;
+	sets.scene_generation = scene_generation;
+	sets.target_generation = target_generation;
+	sets.light_count = light_count;
+}
 
-		vkCmdSetViewport(cmd, 0, 1, &viewport);
+void ClusteredForwardRenderer::WriteGeometryEntries(DescriptorTemplateEntry* entries)
+{
+	const uint32_t totalLightCount = ClusterValues.maxLightsPerTile * ClusterValues.numClusters;
+	const size_t objectDataSize = sizeof(vkutil::GPUModelInformation) * scene_manager->GetModelCount();
+
+	const DescriptorUpdateTemplate& geometry = pass_templates.geometry;
+	geometry.write_buffer(entries, 0, frame_ring.buffer.buffer, sizeof(GPUSceneData), 0);
+	geometry.write_image(entries, 2, _shadowDepthImage.imageView, depthSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	geometry.write_image(entries, 3, IBL._irradianceCube.imageView, IBL._irradianceCubeSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	geometry.write_image(entries, 4, IBL._lutBRDF.imageView, IBL._lutBRDFSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	geometry.write_image(entries, 5, IBL._preFilteredCube.imageView, IBL._irradianceCubeSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+	geometry.write_buffer(entries, 6, frame_ring.buffer.buffer, pointData.pointLights.size() * sizeof(PointLight), 0);
+	geometry.write_buffer(entries, 7, ClusterValues.screenToViewSSBO.buffer, sizeof(ScreenToView), 0);
+	geometry.write_buffer(entries, 8, ClusterValues.lightIndexListSSBO.buffer, totalLightCount * sizeof(uint32_t), 0);
+	geometry.write_buffer(entries, 9, ClusterValues.lightGridSSBO.buffer, ClusterValues.numClusters * sizeof(LightGrid), 0);
+	geometry.write_buffer(entries, 10, scene_manager->GetObjectDataBuffer()->buffer, objectDataSize, 0);
+	geometry.write_buffer(entries, 11, frame_ring.buffer.buffer, sizeof(shadowData), 0);
+	geometry.write_buffer(entries, 12, resource_manager->GetTextureFeedbackBuffer()->buffer, TEXTURE_FEEDBACK_MAX_MATERIALS * sizeof(uint32_t), 0);
+}
 
-		VkRect2D scissor = {};
-		scissor.offset.x = 0;
-		scissor.offset.y = 0;
-		scissor.extent.width = _shadowDepthImage.imageExtent.width;
-		scissor.extent.height = _shadowDepthImage.imageExtent.height;
-		vkCmdSetScissor(cmd, 0, 1, &scissor);
-		if (r.indexBuffer != lastIndexBuffer)
-		{
-			lastIndexBuffer = r.indexBuffer;
-			vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		}
-		// calculate final mesh matrix
-		GPUDrawPushConstants push_constants;
-		push_constants.worldMatrix = r.transform;
-		push_constants.vertexBuffer = r.vertexBufferAddress;
+void ClusteredForwardRenderer::WriteFrameUniforms()
+{
+	ZoneScoped;
+	frame_offsets.scene = frame_ring.Push(&scene_data, sizeof(GPUSceneData)).offset;
+	frame_offsets.shadow = frame_ring.Push(&shadow_data, sizeof(shadowData)).offset;
+	frame_offsets.lights = frame_ring.Push(pointData.pointLights.data(), pointData.pointLights.size() * sizeof(PointLight)).offset;
+	//the light cull shader counts up from it
+	const uint32_t lightIndexStart = 0;
+	frame_offsets.light_index = frame_ring.Push(&lightIndexStart, sizeof(uint32_t)).offset;
+}
 
-		vkCmdPushConstants(cmd, cascadedShadows.shadowPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &push_constants);
+void ClusteredForwardRenderer::DrawShadows(VkCommandBuffer cmd)
+{
+	ZoneScoped;
+	VkDescriptorSet globalDescriptor = pass_sets[_frameNumber % FRAME_OVERLAP].shadows;
+	const uint32_t shadowOffset = frame_offsets.shadow;
 
-		stats.shadow_drawcall_count++;
-		vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
-		};
-	for (auto& r : draws) {
-		draw(drawCommands.OpaqueSurfaces[r]);
-	}
-	*/
 	{
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, cascadedShadows.shadowPipeline.pipeline);
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, cascadedShadows.shadowPipeline.layout, 0, 1,
-			&globalDescriptor, 0, nullptr);
+			&globalDescriptor, 1, &shadowOffset);
 
 		VkViewport viewport = {};
 		viewport.x = 0;
@@ -1690,32 +1845,38 @@ void ClusteredForwardRenderer::DrawShadows(VkCommandBuffer cmd)
 		scissor.extent.height = _shadowDepthImage.imageExtent.height;
 		vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-		vkCmdBindIndexBuffer(cmd, scene_manager->GetMergedIndexBuffer()->buffer, 0, VK_INDEX_TYPE_UINT32);
 		//calculate final mesh matrix
 		GPUDrawPushConstants push_constants;
-		push_constants.vertexBuffer = *scene_manager->GetMergedDeviceAddress();
+		push_constants.vertexBuffer = scene_manager->GetGeometryDeviceAddress();
 		vkCmdPushConstants(cmd, cascadedShadows.shadowPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &push_constants);
 
-		vkCmdDrawIndexedIndirect(cmd, scene_manager->GetMeshPass(vkutil::MaterialPass::shadow_pass)->drawIndirectBuffer.buffer, 0,
-			scene_manager->GetMeshPass(vkutil::MaterialPass::shadow_pass)->flat_objects.size(), sizeof(SceneManager::GPUIndirectObject));
+		auto shadow_pass = scene_manager->GetMeshPass(vkutil::MaterialPass::shadow_pass);
+		for (const auto& range : shadow_pass->draw_ranges)
+		{
+			vkCmdBindIndexBuffer(cmd, scene_manager->GetGeometryIndexBuffer()->buffer, 0, range.indexType);
+			vkCmdDrawIndexedIndirect(cmd, shadow_pass->drawIndirectBuffer.buffer, range.first * sizeof(SceneManager::GPUIndirectObject),
+				range.count, sizeof(SceneManager::GPUIndirectObject));
+		}
 	};
 
 }
 void ClusteredForwardRenderer::DrawMain(VkCommandBuffer cmd)
 {
 	ZoneScoped;
-	auto main_start = std::chrono::system_clock::now();
 	cullBarriers.clear();
 
 	//Begin Compute shader culling passes
 	vkutil::cullParams earlyDepthCull;
 	earlyDepthCull.viewmat = scene_data.view;
 	earlyDepthCull.projmat = scene_data.proj;
-	earlyDepthCull.frustrumCull = true;
-	earlyDepthCull.occlusionCull = true;
+	earlyDepthCull.frustrumCull = frustum_culling;
+	earlyDepthCull.occlusionCull = occlusion_culling;
 	earlyDepthCull.aabb = false;
 	earlyDepthCull.drawDist = mainCamera.getFarClip();
-	ExecuteComputeCull(cmd, earlyDepthCull, scene_manager->GetMeshPass(vkutil::MaterialPass::early_depth));
+	{
+		GpuProfileScope scope(gpu_profiler, cmd, "cull early depth");
+		ExecuteComputeCull(cmd, earlyDepthCull, scene_manager->GetMeshPass(vkutil::MaterialPass::early_depth), "early depth");
+	}
 
 	vkutil::cullParams shadowCull;
 	shadowCull.viewmat = cascadeData.lightViewMatrices[1];
@@ -1728,7 +1889,10 @@ void ClusteredForwardRenderer::DrawMain(VkCommandBuffer cmd)
 	shadowCull.aabbmin = aabbCenter - aabbExtent;
 	shadowCull.aabbmax = aabbCenter + aabbExtent;
 	shadowCull.drawDist = mainCamera.getFarClip();
-	ExecuteComputeCull(cmd, shadowCull, scene_manager->GetMeshPass(vkutil::MaterialPass::shadow_pass));
+	{
+		GpuProfileScope scope(gpu_profiler, cmd, "cull shadows");
+		ExecuteComputeCull(cmd, shadowCull, scene_manager->GetMeshPass(vkutil::MaterialPass::shadow_pass), "shadows");
+	}
 
 
 	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT, 0, 0, nullptr, cullBarriers.size(), cullBarriers.data(), 0, nullptr);
@@ -1740,11 +1904,13 @@ void ClusteredForwardRenderer::DrawMain(VkCommandBuffer cmd)
 
 	VkRenderingAttachmentInfo depthAttachment = vkinit::depth_attachment_info(_depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL);
 	VkRenderingInfo earlyDepthRenderInfo = vkinit::rendering_info(_windowExtent, nullptr, &depthAttachment);
-	vkCmdBeginRendering(cmd, &earlyDepthRenderInfo);
-
-	DrawEarlyDepth(cmd);
-
-	vkCmdEndRendering(cmd);
+	{
+		GpuProfileScope scope(gpu_profiler, cmd, "early depth");
+		GpuStatisticsScope statistics(gpu_statistics, cmd, "early depth");
+		vkCmdBeginRendering(cmd, &earlyDepthRenderInfo);
+		DrawEarlyDepth(cmd);
+		vkCmdEndRendering(cmd);
+	}
 
 	if (render_shadowMap)
 	{
@@ -1753,20 +1919,20 @@ void ClusteredForwardRenderer::DrawMain(VkCommandBuffer cmd)
 		shadowExtent.width = _shadowDepthImage.imageExtent.width;
 		shadowExtent.height = _shadowDepthImage.imageExtent.height;
 		VkRenderingInfo shadowRenderInfo = vkinit::rendering_info(shadowExtent, nullptr, &shadowDepthAttachment, shadows.getCascadeLevels());
-		auto startShadow = std::chrono::system_clock::now();
+		GpuProfileScope scope(gpu_profiler, cmd, "shadows");
+		GpuStatisticsScope statistics(gpu_statistics, cmd, "shadows");
 		vkCmdBeginRendering(cmd, &shadowRenderInfo);
-
 		DrawShadows(cmd);
-
 		vkCmdEndRendering(cmd);
-		auto endShadow = std::chrono::system_clock::now();
-		auto elapsedShadow = std::chrono::duration_cast<std::chrono::microseconds>(endShadow - startShadow);
-		stats.shadow_pass_time = elapsedShadow.count() / 1000.f;
 		render_shadowMap = false;
 	}
 
 	//Compute shader pass for clustered light culling
-	CullLights(cmd);
+	{
+		GpuProfileScope scope(gpu_profiler, cmd, "light culling");
+		GpuStatisticsScope statistics(gpu_statistics, cmd, "light culling");
+		CullLights(cmd);
+	}
 
 	VkClearValue geometryClear{ 1.0,1.0,1.0,1.0f };
 	VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(_drawImage.imageView, &_resolveImage.imageView, &geometryClear, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, true);
@@ -1777,52 +1943,33 @@ void ClusteredForwardRenderer::DrawMain(VkCommandBuffer cmd)
 	vkutil::transition_image(cmd, _shadowDepthImage.image, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
 	VkRenderingInfo renderInfo = vkinit::rendering_info(_windowExtent, &colorAttachment, &depthAttachment2);
 
-	auto start = std::chrono::system_clock::now();
-	vkCmdBeginRendering(cmd, &renderInfo);
-
-	DrawGeometry(cmd);
-
-	vkCmdEndRendering(cmd);
-	auto end = std::chrono::system_clock::now();
-	auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
-	stats.mesh_draw_time = elapsed.count() / 1000.f;
+	{
+		GpuProfileScope scope(gpu_profiler, cmd, "geometry");
+		GpuStatisticsScope statistics(gpu_statistics, cmd, "geometry");
+		vkCmdBeginRendering(cmd, &renderInfo);
+		DrawGeometry(cmd);
+		vkCmdEndRendering(cmd);
+	}
 
-	auto main_end = std::chrono::system_clock::now();
-	auto main_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(main_end - main_start);
-	//stats.frametime = main_elapsed.count() / 1000.f;
 	VkRenderingAttachmentInfo colorAttachment2 = vkinit::attachment_info(_drawImage.imageView, &_resolveImage.imageView, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 	VkRenderingAttachmentInfo depthAttachment3 = vkinit::depth_attachment_info(_depthImage.imageView, VK_IMAGE_LAYOUT_DEPTH_ATTACHMENT_OPTIMAL, VK_ATTACHMENT_LOAD_OP_LOAD, VK_ATTACHMENT_STORE_OP_DONT_CARE);
 	VkRenderingInfo backRenderInfo = vkinit::rendering_info(_windowExtent, &colorAttachment2, &depthAttachment3);
-	vkCmdBeginRendering(cmd, &backRenderInfo);
+	{
+		GpuProfileScope scope(gpu_profiler, cmd, "background");
+		vkCmdBeginRendering(cmd, &backRenderInfo);
+		DrawBackground(cmd);
+		vkCmdEndRendering(cmd);
+	}
 
-	DrawBackground(cmd);
-	vkCmdEndRendering(cmd);
+	GpuProfileScope scope(gpu_profiler, cmd, "depth reduce");
 	ReduceDepth(cmd);
 }
 
-void ClusteredForwardRenderer::ExecuteComputeCull(VkCommandBuffer cmd, vkutil::cullParams& cullParams, SceneManager::MeshPass* meshPass)
+void ClusteredForwardRenderer::ExecuteComputeCull(VkCommandBuffer cmd, vkutil::cullParams& cullParams, SceneManager::MeshPass* meshPass, const char* name)
 {
-	AllocatedBuffer gpuSceneDataBuffer = vkutil::create_buffer(sizeof(GPUSceneData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,engine);
-
-	//add it to the deletion queue of this frame so it gets deleted once its been used
-	get_current_frame()._deletionQueue.push_function([=, this]() {
-		vkutil::destroy_buffer(gpuSceneDataBuffer,engine);
-		});
-
-	//write the buffer
-	void* sceneDataPtr = nullptr;
-	vmaMapMemory(engine->_allocator, gpuSceneDataBuffer.allocation, &sceneDataPtr);
-	GPUSceneData* sceneUniformData = (GPUSceneData*)sceneDataPtr;
-	*sceneUniformData = scene_data;
-	vmaUnmapMemory(engine->_allocator, gpuSceneDataBuffer.allocation);
-
-	VkDescriptorSet computeCullDescriptor = get_current_frame()._frameDescriptors.allocate(engine->_device, compute_cull_descriptor_layout);
-	DescriptorWriter writer;
-	writer.write_buffer(0, gpuSceneDataBuffer.buffer, sizeof(GPUSceneData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.write_buffer(1, scene_manager->GetObjectDataBuffer()->buffer, sizeof(vkutil::GPUModelInformation) * scene_manager->GetModelCount(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(2, meshPass->drawIndirectBuffer.buffer, sizeof(SceneManager::GPUIndirectObject) * meshPass->flat_objects.size(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_image(3, _depthPyramid.imageView, depthReductionSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.update_set(engine->_device, computeCullDescriptor);
+	ZoneScoped;
+	VkDescriptorSet computeCullDescriptor = pass_sets[_frameNumber % FRAME_OVERLAP].cull.at(meshPass);
+	const uint32_t sceneOffset = frame_offsets.scene;
 
 	glm::mat4 projection = cullParams.projmat;
 	auto projectionT = glm::transpose(projection);
@@ -1857,6 +2004,7 @@ void ClusteredForwardRenderer::ExecuteComputeCull(VkCommandBuffer cmd, vkutil::c
 	cullData.aabbmax_x = cullParams.aabbmax.x;
 	cullData.aabbmax_y = cullParams.aabbmax.y;
 	cullData.aabbmax_z = cullParams.aabbmax.z;
+	cullData.counterIndex = gpu_statistics.AddCullPass(name);
 
 	if (cullParams.drawDist > 10000)
 	{
@@ -1871,7 +2019,7 @@ void ClusteredForwardRenderer::ExecuteComputeCull(VkCommandBuffer cmd, vkutil::c
 
 	vkCmdPushConstants(cmd, cull_objects_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(vkutil::DrawCullData), &cullData);
 
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull_objects_pso.layout, 0, 1, &computeCullDescriptor, 0, nullptr);
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull_objects_pso.layout, 0, 1, &computeCullDescriptor, 1, &sceneOffset);
 
 	vkCmdDispatch(cmd, static_cast<uint32_t>((meshPass->flat_objects.size() / 256) + 1), 1, 1);
 
@@ -1891,6 +2039,7 @@ inline uint32_t GetGroupCount(uint32_t threadCount, uint32_t localSize)
 
 void ClusteredForwardRenderer::ReduceDepth(VkCommandBuffer cmd)
 {
+	ZoneScoped;
 	VkImageMemoryBarrier depthReadBarriers[] =
 	{
 		vkinit::image_barrier(_depthResolveImage.image, VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_ACCESS_SHADER_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_ASPECT_DEPTH_BIT),
@@ -1902,16 +2051,7 @@ void ClusteredForwardRenderer::ReduceDepth(VkCommandBuffer cmd)
 
 	for (int32_t i = 0; i < depthPyramidLevels; ++i)
 	{
-		VkDescriptorSet depthDescriptor = get_current_frame()._frameDescriptors.allocate(engine->_device, depth_reduce_descriptor_layout);
-
-		DescriptorWriter writer;
-
-		writer.write_image(0, depthPyramidMips[i], depthReductionSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE);
-		if (i == 0)
-			writer.write_image(1, _depthResolveImage.imageView, depthReductionSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		else
-			writer.write_image(1, depthPyramidMips[i - 1], depthReductionSampler, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-		writer.update_set(engine->_device, depthDescriptor);
+		VkDescriptorSet depthDescriptor = pass_sets[_frameNumber % FRAME_OVERLAP].depth_reduce[i];
 
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, depth_reduce_pso.layout, 0, 1, &depthDescriptor, 0, nullptr);
 
@@ -1952,18 +2092,10 @@ void ClusteredForwardRenderer::DrawPostProcess(VkCommandBuffer cmd)
 void ClusteredForwardRenderer::DrawHdr(VkCommandBuffer cmd)
 {
 	ZoneScoped;
-	std::vector<uint32_t> draws;
-	draws.reserve(imageDrawCommands.OpaqueSurfaces.size());
-
-	//create a descriptor set that binds that buffer and update it
-	VkDescriptorSet globalDescriptor = get_current_frame()._frameDescriptors.allocate(engine->_device, _drawImageDescriptorLayout);
-
-	DescriptorWriter writer;
-	writer.write_image(0, _resolveImage.imageView, defaultSamplerLinear, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.write_image(1, _depthResolveImage.imageView, defaultSamplerLinear, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.update_set(engine->_device, globalDescriptor);
+	VkDescriptorSet globalDescriptor = pass_sets[_frameNumber % FRAME_OVERLAP].hdr;
 
 	VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+	VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
 	auto draw = [&](const RenderObject& r) {
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, HdrPSO.renderImagePipeline.pipeline);
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, HdrPSO.renderImagePipeline.layout, 0, 1,
@@ -1985,10 +2117,11 @@ void ClusteredForwardRenderer::DrawHdr(VkCommandBuffer cmd)
 		scissor.extent.height = _windowExtent.height;
 		vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-		if (r.indexBuffer != lastIndexBuffer)
+		if (r.indexBuffer != lastIndexBuffer || r.indexType != lastIndexType)
 		{
 			lastIndexBuffer = r.indexBuffer;
-			vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			lastIndexType = r.indexType;
+			vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, r.indexType);
 		}
 		// calculate final mesh matrix
 		GPUDrawPushConstants push_constants;
@@ -2005,36 +2138,15 @@ void ClusteredForwardRenderer::DrawHdr(VkCommandBuffer cmd)
 void ClusteredForwardRenderer::DrawBackground(VkCommandBuffer cmd)
 {
 	ZoneScoped;
-	std::vector<uint32_t> b_draws;
-	b_draws.reserve(skyDrawCommands.OpaqueSurfaces.size());
-	//allocate a new uniform buffer for the scene data
-	AllocatedBuffer skySceneDataBuffer = vkutil::create_buffer(sizeof(GPUSceneData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, engine);
-
-	//add it to the deletion queue of this frame so it gets deleted once its been used
-	get_current_frame()._deletionQueue.push_function([=, this]() {
-		vkutil::destroy_buffer(skySceneDataBuffer,engine);
-		});
-
-	//write the buffer
-	void* sceneDataPtr = nullptr;
-	vmaMapMemory(engine->_allocator, skySceneDataBuffer.allocation, &sceneDataPtr);
-	GPUSceneData* sceneUniformData = (GPUSceneData*)sceneDataPtr;
-	*sceneUniformData = scene_data;
-	vmaUnmapMemory(engine->_allocator, skySceneDataBuffer.allocation);
-
-	//create a descriptor set that binds that buffer and update it
-	VkDescriptorSet globalDescriptor = get_current_frame()._frameDescriptors.allocate(engine->_device, _skyboxDescriptorLayout);
-
-	DescriptorWriter writer;
-	writer.write_buffer(0, skySceneDataBuffer.buffer, sizeof(GPUSceneData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.write_image(1, _skyImage.imageView, cubeMapSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.update_set(engine->_device, globalDescriptor);
+	VkDescriptorSet globalDescriptor = pass_sets[_frameNumber % FRAME_OVERLAP].sky;
+	const uint32_t sceneOffset = frame_offsets.scene;
 
 	VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+	VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
 	auto b_draw = [&](const RenderObject& r) {
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, skyBoxPSO.skyPipeline.pipeline);
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, skyBoxPSO.skyPipeline.layout, 0, 1,
-			&globalDescriptor, 0, nullptr);
+			&globalDescriptor, 1, &sceneOffset);
 
 		VkViewport viewport = {};
 		viewport.x = 0;
@@ -2053,10 +2165,11 @@ void ClusteredForwardRenderer::DrawBackground(VkCommandBuffer cmd)
 		scissor.extent.height = _windowExtent.height;
 		vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-		if (r.indexBuffer != lastIndexBuffer)
+		if (r.indexBuffer != lastIndexBuffer || r.indexType != lastIndexType)
 		{
 			lastIndexBuffer = r.indexBuffer;
-			vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+			lastIndexType = r.indexType;
+			vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, r.indexType);
 		}
 		// calculate final mesh matrix
 		GPUDrawPushConstants push_constants;
@@ -2064,7 +2177,7 @@ void ClusteredForwardRenderer::DrawBackground(VkCommandBuffer cmd)
 		push_constants.vertexBuffer = r.vertexBufferAddress;
 
 		vkCmdPushConstants(cmd, skyBoxPSO.skyPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &push_constants);
-		vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
+		vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, r.firstVertex, 0);
 		};
 	b_draw(skyDrawCommands.OpaqueSurfaces[0]);
 	skyDrawCommands.OpaqueSurfaces.clear();
@@ -2073,123 +2186,9 @@ void ClusteredForwardRenderer::DrawBackground(VkCommandBuffer cmd)
 void ClusteredForwardRenderer::DrawGeometry(VkCommandBuffer cmd)
 {
 	ZoneScoped;
-	//allocate a new uniform buffer for the scene data
-	AllocatedBuffer gpuSceneDataBuffer = vkutil::create_buffer(sizeof(GPUSceneData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,engine);
-
-	AllocatedBuffer shadowDataBuffer = vkutil::create_buffer(sizeof(shadowData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, engine);
-
-	get_current_frame()._deletionQueue.push_function([=, this]() {
-		vkutil::destroy_buffer(gpuSceneDataBuffer,engine);
-		vkutil::destroy_buffer(shadowDataBuffer, engine);
-		});
-
-
-	//write the buffer
-	void* shadowDataPtr = nullptr;
-	vmaMapMemory(engine->_allocator, shadowDataBuffer.allocation, &shadowDataPtr);
-	shadowData* ptr = (shadowData*)shadowDataPtr;
-	*ptr = shadow_data;
-	//memcpy(sceneDataPtr, &shadow_data.lightSpaceMatrices, sizeof(shadowData));
-	vmaUnmapMemory(engine->_allocator, shadowDataBuffer.allocation);
-
-	//add it to the deletion queue of this frame so it gets deleted once its been used
-	void* sceneDataPtr = nullptr;
-	vmaMapMemory(engine->_allocator, gpuSceneDataBuffer.allocation, &sceneDataPtr);
-	GPUSceneData* sceneUniformData = (GPUSceneData*)sceneDataPtr;
-	*sceneUniformData = scene_data;
-	vmaUnmapMemory(engine->_allocator, gpuSceneDataBuffer.allocation);
-
-	//create a descriptor set that binds that buffer and update it
-	VkDescriptorSet globalDescriptor = get_current_frame()._frameDescriptors.allocate(engine->_device, _gpuSceneDataDescriptorLayout);
-
-	static auto totalLightCount = ClusterValues.maxLightsPerTile * ClusterValues.numClusters;
-
-	DescriptorWriter writer;
-	writer.write_buffer(0, gpuSceneDataBuffer.buffer, sizeof(GPUSceneData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.write_image(2, _shadowDepthImage.imageView, depthSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.write_image(3, IBL._irradianceCube.imageView, IBL._irradianceCubeSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.write_image(4, IBL._lutBRDF.imageView, IBL._lutBRDFSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.write_image(5, IBL._preFilteredCube.imageView, IBL._irradianceCubeSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
-	writer.write_buffer(6, ClusterValues.lightSSBO.buffer, pointData.pointLights.size() * sizeof(PointLight), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(7, ClusterValues.screenToViewSSBO.buffer, sizeof(ScreenToView), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(8, ClusterValues.lightIndexListSSBO.buffer, totalLightCount * sizeof(uint32_t), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(9, ClusterValues.lightGridSSBO.buffer, ClusterValues.numClusters * sizeof(LightGrid), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(10, scene_manager->GetObjectDataBuffer()->buffer,
-		sizeof(vkutil::GPUModelInformation) * scene_manager->GetModelCount(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(11, shadowDataBuffer.buffer, sizeof(shadowData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.update_set(engine->_device, globalDescriptor);
-
-
-	//allocate bindless descriptor
-
-	/*MaterialPipeline* lastPipeline = nullptr;
-	MaterialInstance* lastMaterial = nullptr;
-	VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
-
-	auto draw = [&](const RenderObject& r) {
-		if (r.material != lastMaterial) {
-			lastMaterial = r.material;
-			if (r.material->pipeline != lastPipeline) {
-
-				lastPipeline = r.material->pipeline;
-				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->pipeline);
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 0, 1,
-					&globalDescriptor, 0, nullptr);
-
-				VkViewport viewport = {};
-				viewport.x = 0;
-				viewport.y = 0;
-				viewport.width = (float)_windowExtent.width;
-				viewport.height = (float)_windowExtent.height;
-				viewport.minDepth = 0.f;
-				viewport.maxDepth = 1.f;
-				vkCmdSetViewport(cmd, 0, 1, &viewport);
-
-				VkRect2D scissor = {};
-				scissor.offset.x = 0;
-				scissor.offset.y = 0;
-				scissor.extent.width = _windowExtent.width;
-				scissor.extent.height = _windowExtent.height;
-
-				vkCmdSetScissor(cmd, 0, 1, &scissor);
-
-				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 1, 1, resource_manager.GetBindlessSet(), 0, nullptr);
-
-			}
-
-			//vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, r.material->pipeline->layout, 1, 1,
-				//&r.material->materialSet, 0, nullptr);
-		}
-		if (r.indexBuffer != lastIndexBuffer) {
-			lastIndexBuffer = r.indexBuffer;
-			vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		}
-		// calculate final mesh matrix
-		GPUDrawPushConstants push_constants;
-		push_constants.worldMatrix = r.transform;
-		push_constants.vertexBuffer = r.vertexBufferAddress;
-		push_constants.material_index = r.material->material_index;
-
-		vkCmdPushConstants(cmd, r.material->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GPUDrawPushConstants), &push_constants);
-
-		stats.drawcall_count++;
-		stats.triangle_count += r.indexCount / 3;
-		vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
-		};
-
-
-	stats.drawcall_count = 0;
-	stats.triangle_count = 0;
-
-	for (auto& r : draws) {
-		draw(drawCommands.OpaqueSurfaces[r]);
-	}
-
-	for (auto& r : drawCommands.TransparentSurfaces) {
-		draw(r);
-	}
-	*/
-
+	VkDescriptorSet globalDescriptor = pass_sets[_frameNumber % FRAME_OVERLAP].geometry;
+	//in binding order, the scene data at 0, the point lights at 6 and the shadow data at 11
+	const uint32_t uniformOffsets[] = { frame_offsets.scene, frame_offsets.lights, frame_offsets.shadow };
 
 	{
 		for (auto pass_enum : forward_passes)
@@ -2199,7 +2198,7 @@ void ClusteredForwardRenderer::DrawGeometry(VkCommandBuffer cmd)
 			{
 				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pass->flat_objects[0].material->pipeline->pipeline);
 				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pass->flat_objects[0].material->pipeline->layout, 0, 1,
-					&globalDescriptor, 0, nullptr);
+					&globalDescriptor, 3, uniformOffsets);
 				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, pass->flat_objects[0].material->pipeline->layout, 1, 1, resource_manager->GetBindlessSet(), 0, nullptr);
 
 
@@ -2220,13 +2219,16 @@ void ClusteredForwardRenderer::DrawGeometry(VkCommandBuffer cmd)
 				scissor.extent.height = _windowExtent.height;
 				vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-				vkCmdBindIndexBuffer(cmd, scene_manager->GetMergedIndexBuffer()->buffer, 0, VK_INDEX_TYPE_UINT32);
 				//calculate final mesh matrix
 				GPUDrawPushConstants push_constants;
-				push_constants.vertexBuffer = *scene_manager->GetMergedDeviceAddress();
+				push_constants.vertexBuffer = scene_manager->GetGeometryDeviceAddress();
 				vkCmdPushConstants(cmd, pass->flat_objects[0].material->pipeline->layout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(GPUDrawPushConstants), &push_constants);
-				vkCmdDrawIndexedIndirect(cmd, scene_manager->GetMeshPass(vkutil::MaterialPass::early_depth)->drawIndirectBuffer.buffer, 0,
-					pass->flat_objects.size(), sizeof(SceneManager::GPUIndirectObject));
+				for (const auto& range : pass->draw_ranges)
+				{
+					vkCmdBindIndexBuffer(cmd, scene_manager->GetGeometryIndexBuffer()->buffer, 0, range.indexType);
+					vkCmdDrawIndexedIndirect(cmd, scene_manager->GetMeshPass(vkutil::MaterialPass::early_depth)->drawIndirectBuffer.buffer, range.first * sizeof(SceneManager::GPUIndirectObject),
+						range.count, sizeof(SceneManager::GPUIndirectObject));
+				}
 
 			}
 		}
@@ -2234,34 +2236,21 @@ void ClusteredForwardRenderer::DrawGeometry(VkCommandBuffer cmd)
 	// we delete the draw commands now that we processed them
 	drawCommands.OpaqueSurfaces.clear();
 	drawCommands.TransparentSurfaces.clear();
-	draws.clear();
 }
 
 void ClusteredForwardRenderer::CullLights(VkCommandBuffer cmd)
 {
+	ZoneScoped;
 	CullData culling_information;
 
-	VkDescriptorSet cullingDescriptor = get_current_frame()._frameDescriptors.allocate(engine->_device, _cullLightsDescriptorLayout);
-
-	//write the buffer
-	//auto* pointBuffer = ClusterValues.lightSSBO.allocation->GetMappedData();
-	//memcpy(pointBuffer, pointData.pointLights.data(), pointData.pointLights.size() * sizeof(PointLight));
-
-	DescriptorWriter writer;
-	writer.write_buffer(0, ClusterValues.AABBVolumeGridSSBO.buffer, ClusterValues.numClusters * sizeof(VolumeTileAABB), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(1, ClusterValues.screenToViewSSBO.buffer, sizeof(ScreenToView), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(2, ClusterValues.lightSSBO.buffer, pointData.pointLights.size() * sizeof(PointLight), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	auto totalLightCount = ClusterValues.maxLightsPerTile * ClusterValues.numClusters;
-	writer.write_buffer(3, ClusterValues.lightIndexListSSBO.buffer, sizeof(uint32_t) * totalLightCount, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(4, ClusterValues.lightGridSSBO.buffer, ClusterValues.numClusters * sizeof(LightGrid), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.write_buffer(5, ClusterValues.lightGlobalIndex[_frameNumber % FRAME_OVERLAP].buffer, sizeof(uint32_t), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.update_set(engine->_device, cullingDescriptor);
+	VkDescriptorSet cullingDescriptor = pass_sets[_frameNumber % FRAME_OVERLAP].cull_lights;
 
 	culling_information.view = mainCamera.matrices.view;
 	culling_information.lightCount = pointData.pointLights.size();
 	vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull_lights_pso.pipeline);
 
-	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull_lights_pso.layout, 0, 1, &cullingDescriptor, 0, nullptr);
+	const uint32_t lightOffsets[] = { frame_offsets.lights, frame_offsets.light_index };
+	vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_COMPUTE, cull_lights_pso.layout, 0, 1, &cullingDescriptor, 2, lightOffsets);
 
 	vkCmdPushConstants(cmd, cull_lights_pso.layout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(CullData), &culling_information);
 	vkCmdDispatch(cmd, 16, 9, 24);
@@ -2269,7 +2258,8 @@ void ClusteredForwardRenderer::CullLights(VkCommandBuffer cmd)
 
 void ClusteredForwardRenderer::DrawImgui(VkCommandBuffer cmd, VkImageView targetImageView)
 {
-	auto start_imgui = std::chrono::system_clock::now();
+	ZoneScoped;
+	GpuProfileScope scope(gpu_profiler, cmd, "imgui");
 	VkRenderingAttachmentInfo colorAttachment = vkinit::attachment_info(targetImageView, nullptr, nullptr, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL);
 	VkRenderingInfo renderInfo = vkinit::rendering_info(_swapchainExtent, &colorAttachment, nullptr);
 
@@ -2278,104 +2268,17 @@ void ClusteredForwardRenderer::DrawImgui(VkCommandBuffer cmd, VkImageView target
 	ImGui_ImplVulkan_RenderDrawData(ImGui::GetDrawData(), cmd);
 
 	vkCmdEndRendering(cmd);
-	auto end_imgui = std::chrono::system_clock::now();
-	auto elapsed_imgui = std::chrono::duration_cast<std::chrono::microseconds>(end_imgui - start_imgui);
-	stats.ui_draw_time = elapsed_imgui.count() / 1000.f;
 }
 
 void ClusteredForwardRenderer::DrawEarlyDepth(VkCommandBuffer cmd)
 {
-	draws.reserve(drawCommands.OpaqueSurfaces.size());
-	for (int i = 0; i < drawCommands.OpaqueSurfaces.size(); i++) {
-		if (black_key::is_visible(drawCommands.OpaqueSurfaces[i], scene_data.viewproj)) {
-			draws.push_back(i);
-		}
-	}
-
-	std::sort(draws.begin(), draws.end(), [&](const auto& iA, const auto& iB) {
-		const RenderObject& A = drawCommands.OpaqueSurfaces[iA];
-		const RenderObject& B = drawCommands.OpaqueSurfaces[iB];
-		if (A.material == B.material) {
-			return A.indexBuffer < B.indexBuffer;
-		}
-		else {
-			return A.material < B.material;
-		}
-		});
-
-	//allocate a new uniform buffer for the scene data
-	AllocatedBuffer gpuSceneDataBuffer = vkutil::create_buffer(sizeof(GPUSceneData), VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, engine);
-
-	//add it to the deletion queue of this frame so it gets deleted once its been used
-	get_current_frame()._deletionQueue.push_function([=, this]() {
-		vkutil::destroy_buffer(gpuSceneDataBuffer,engine);
-		});
-
-	//write the buffer
-	void* sceneDataPtr = nullptr;
-	vmaMapMemory(engine->_allocator, gpuSceneDataBuffer.allocation, &sceneDataPtr);
-	GPUSceneData* sceneUniformData = (GPUSceneData*)sceneDataPtr;
-	*sceneUniformData = scene_data;
-	vmaUnmapMemory(engine->_allocator, gpuSceneDataBuffer.allocation);
-
-	VkDescriptorSet globalDescriptor = get_current_frame()._frameDescriptors.allocate(engine->_device, _gpuSceneDataDescriptorLayout);
-
-	DescriptorWriter writer;
-	writer.write_buffer(0, gpuSceneDataBuffer.buffer, sizeof(GPUSceneData), 0, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER);
-	writer.write_buffer(6, scene_manager->GetObjectDataBuffer()->buffer,
-		sizeof(vkutil::GPUModelInformation) * scene_manager->GetModelCount(), 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
-	writer.update_set(engine->_device, globalDescriptor);
-
-	/*
-	VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
-
-	auto draw = [&](const RenderObject& r) {
-		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrePassPSO.earlyDepthPipeline.pipeline);
-		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrePassPSO.earlyDepthPipeline.layout, 0, 1,
-			&globalDescriptor, 0, nullptr);
-
-		VkViewport viewport = {};
-		viewport.x = 0;
-		viewport.y = 0;
-		viewport.width = (float)_windowExtent.width;
-		viewport.height = (float)_windowExtent.height;
-		viewport.minDepth = 0.f;
-		viewport.maxDepth = 1.f;
-
-		vkCmdSetViewport(cmd, 0, 1, &viewport);
-
-		VkRect2D scissor = {};
-		scissor.offset.x = 0;
-		scissor.offset.y = 0;
-		scissor.extent.width = _windowExtent.width;
-		scissor.extent.height = _windowExtent.height;
-		vkCmdSetScissor(cmd, 0, 1, &scissor);
-		if (r.indexBuffer != lastIndexBuffer)
-		{
-			lastIndexBuffer = r.indexBuffer;
-			vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
-		}
-
-		// calculate final mesh matrix
-		GPUDrawPushConstants push_constants;
-		push_constants.worldMatrix = r.transform;
-		push_constants.vertexBuffer = r.vertexBufferAddress;
-		push_constants.material_index = r.material->material_index;
-
-		vkCmdPushConstants(cmd, depthPrePassPSO.earlyDepthPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &push_constants);
-		vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
-		};
-
-	for (auto& r : draws) {
-		draw(drawCommands.OpaqueSurfaces[r]);
-	}
-	*/
-
+	ZoneScoped;
+	VkDescriptorSet globalDescriptor = pass_sets[_frameNumber % FRAME_OVERLAP].early_depth;
 
 	{
 		vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrePassPSO.earlyDepthPipeline.pipeline);
 		vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, depthPrePassPSO.earlyDepthPipeline.layout, 0, 1,
-			&globalDescriptor, 0, nullptr);
+			&globalDescriptor, 1, &frame_offsets.scene);
 
 		VkViewport viewport = {};
 		viewport.x = 0;
@@ -2394,14 +2297,18 @@ void ClusteredForwardRenderer::DrawEarlyDepth(VkCommandBuffer cmd)
 		scissor.extent.height = _windowExtent.height;
 		vkCmdSetScissor(cmd, 0, 1, &scissor);
 
-		vkCmdBindIndexBuffer(cmd, scene_manager->GetMergedIndexBuffer()->buffer, 0, VK_INDEX_TYPE_UINT32);
 		//calculate final mesh matrix
 		GPUDrawPushConstants push_constants;
-		push_constants.vertexBuffer = *scene_manager->GetMergedDeviceAddress();
+		push_constants.vertexBuffer = scene_manager->GetGeometryDeviceAddress();
 		vkCmdPushConstants(cmd, depthPrePassPSO.earlyDepthPipeline.layout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(GPUDrawPushConstants), &push_constants);
 
-		vkCmdDrawIndexedIndirect(cmd, scene_manager->GetMeshPass(vkutil::MaterialPass::early_depth)->drawIndirectBuffer.buffer, 0,
-			scene_manager->GetMeshPass(vkutil::MaterialPass::early_depth)->flat_objects.size(), sizeof(SceneManager::GPUIndirectObject));
+		auto early_depth_pass = scene_manager->GetMeshPass(vkutil::MaterialPass::early_depth);
+		for (const auto& range : early_depth_pass->draw_ranges)
+		{
+			vkCmdBindIndexBuffer(cmd, scene_manager->GetGeometryIndexBuffer()->buffer, 0, range.indexType);
+			vkCmdDrawIndexedIndirect(cmd, early_depth_pass->drawIndirectBuffer.buffer, range.first * sizeof(SceneManager::GPUIndirectObject),
+				range.count, sizeof(SceneManager::GPUIndirectObject));
+		}
 	}
 }
 
@@ -2413,7 +2320,10 @@ void ClusteredForwardRenderer::Run()
 	// main loop
 	while (!glfwWindowShouldClose(engine->window)) {
 		auto start = std::chrono::system_clock::now();
+		const uint64_t heap_start = GetHeapAllocationCount();
+		frame_history.BeginFrame(_frameNumber);
 		if (resize_requested) {
+			frame_history.BeginPhase("resize");
 			ResizeSwapchain();
 		}
 		// do not draw if we are minimized
@@ -2423,6 +2333,7 @@ void ClusteredForwardRenderer::Run()
 			continue;
 		}
 
+		frame_history.BeginPhase("ui");
 		ImGui_ImplVulkan_NewFrame();
 		ImGui_ImplGlfw_NewFrame();
 
@@ -2433,18 +2344,212 @@ void ClusteredForwardRenderer::Run()
 		ImGui::Render();
 
 		auto start_update = std::chrono::system_clock::now();
+		frame_history.BeginPhase("update");
 		UpdateScene();
+		capture_writer.Write(CaptureFrame(), pointData.pointLights);
 		auto end_update = std::chrono::system_clock::now();
 		auto elapsed_update = std::chrono::duration_cast<std::chrono::microseconds>(end_update - start_update);
 		Draw();
+		//the startup trace covers everything up to the first frame being submitted
+		if (startup_trace::IsEnabled())
+		{
+			startup_trace::Mark("first frame submitted");
+			startup_trace::Finish();
+		}
+		frame_history.BeginPhase("events");
 		glfwPollEvents();
 		auto end = std::chrono::system_clock::now();
 
 		//convert to microseconds (integer), and then come back to miliseconds
 		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(end - start);
 		stats.frametime = elapsed.count() / 1000.f;
+
+		stats.heap_allocations = static_cast<uint32_t>(GetHeapAllocationCount() - heap_start);
+		assert(!assert_no_heap_allocations || stats.heap_allocations == 0);
+		frame_history.EndFrame();
+		//Draw read back the timestamps of a frame FRAME_OVERLAP frames old, the same frame again if there was nothing new
+		if (gpu_profiler.GetLastFrameNumber() != UINT64_MAX)
+			frame_history.AddGpuFrame(gpu_profiler.GetLastFrameNumber(), gpu_profiler.GetLastFrameTime(), gpu_profiler.GetLastFrameTimings());
+		FrameMark;
 	}
-	FrameMark;
+	capture_writer.Close();
+}
+
+void ClusteredForwardRenderer::SetBenchmark(const BenchmarkOptions& options)
+{
+	benchmark_options = options;
+	headless = true;
+	_windowExtent = VkExtent2D{ options.width, options.height };
+	_aspect_width = static_cast<float>(options.width);
+	_aspect_height = static_cast<float>(options.height);
+	if (!options.scene_path.empty())
+		scene_path = options.scene_path;
+}
+
+void ClusteredForwardRenderer::SetStressScene(const StressSceneOptions& options)
+{
+	stress_scene = options;
+}
+
+bool ClusteredForwardRenderer::RunBenchmark()
+{
+	assert(headless && benchmark_options.has_value());
+	const BenchmarkOptions& options = *benchmark_options;
+
+	CameraPath path;
+	FrameCapture capture;
+	const bool replay = !options.capture_path.empty();
+	if (replay ? !capture.Load(options.capture_path) : !path.Load(options.camera_path))
+		return false;
+	for (const std::string& setting : options.settings)
+	{
+		if (!ApplySetting(setting))
+			return false;
+	}
+	//a replay measures each captured frame once, its warmup frames hold the first
+	const uint32_t measured_frames = replay ? capture.GetFrameCount() : options.frames;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(engine->_chosenGPU, &properties);
+	fmt::println("Benchmarking {} frames after {} warmup frames at {}x{} on {}", measured_frames, options.warmup_frames,
+		options.width, options.height, properties.deviceName);
+
+	BenchmarkReport report;
+	fixed_timestep = options.timestep;
+	const uint32_t total_frames = options.warmup_frames + measured_frames;
+	uint64_t last_gpu_frame = UINT64_MAX;
+	auto add_gpu_frame = [&]() {
+		if (gpu_profiler.GetLastFrameNumber() == last_gpu_frame)
+			return;
+		last_gpu_frame = gpu_profiler.GetLastFrameNumber();
+		report.AddGpuFrame(last_gpu_frame, gpu_profiler.GetLastFrameTime(), gpu_profiler.GetLastFrameTimings());
+	};
+
+	for (uint32_t i = 0; i < total_frames; i++)
+	{
+		auto start = std::chrono::system_clock::now();
+		const uint64_t heap_start = GetHeapAllocationCount();
+		const uint64_t frame = _frameNumber;
+
+		if (replay)
+			ApplyCapturedFrame(capture, i < options.warmup_frames ? 0 : i - options.warmup_frames);
+		else
+		{
+			const CameraKey key = path.Sample(i * options.timestep);
+			mainCamera.setPosition(key.position);
+			mainCamera.setRotation(key.rotation);
+		}
+		UpdateScene();
+		Draw();
+		if (startup_trace::IsEnabled())
+		{
+			startup_trace::Mark("first frame submitted");
+			startup_trace::Finish();
+		}
+
+		auto elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - start);
+		stats.frametime = elapsed.count() / 1000.f;
+		stats.heap_allocations = static_cast<uint32_t>(GetHeapAllocationCount() - heap_start);
+		FrameMark;
+
+		//the timings read back during this frame's Draw belong to a frame FRAME_OVERLAP earlier
+		if (i >= options.warmup_frames)
+		{
+			report.AddCpuFrame(frame, stats.frametime);
+			report.TrackMemory(resource_manager->GetMemoryStats(), frame_arena.GetStats(), stats.heap_allocations);
+		}
+		add_gpu_frame();
+	}
+
+	//the last frames in flight haven't been read back yet
+	vkDeviceWaitIdle(engine->_device);
+	for (uint32_t i = 0; i < FRAME_OVERLAP; i++)
+	{
+		gpu_profiler.ReadResults(_frameNumber + i);
+		gpu_statistics.ReadResults(_frameNumber + i);
+		add_gpu_frame();
+	}
+	fixed_timestep = 0.0f;
+
+	if (!report.Write(options, properties.deviceName, gpu_statistics.GetCullStats(), gpu_statistics.GetPipelineStats()))
+		return false;
+	fmt::println("Benchmark report written to {}", options.report_path);
+	return true;
+}
+
+bool ClusteredForwardRenderer::SetRecording(std::string_view capturePath)
+{
+	assert(!headless);
+	if (!capture_writer.Open(capturePath))
+		return false;
+	fmt::println("Recording frames to {}", capturePath);
+	return true;
+}
+
+bool ClusteredForwardRenderer::ApplySetting(std::string_view setting)
+{
+	const size_t split = setting.find('=');
+	if (split == std::string_view::npos)
+	{
+		fmt::println("Setting {} isn't of the form name=value", setting);
+		return false;
+	}
+	const std::string_view name = setting.substr(0, split);
+	const std::string value{ setting.substr(split + 1) };
+
+	auto parse_bool = [&](bool& target) {
+		if (value != "0" && value != "1" && value != "false" && value != "true")
+			return false;
+		target = value == "1" || value == "true";
+		return true;
+	};
+	bool parsed = false;
+	if (name == "frustum_culling")
+		parsed = parse_bool(frustum_culling);
+	else if (name == "occlusion_culling")
+		parsed = parse_bool(occlusion_culling);
+	else if (name == "vram_limit_mb")
+	{
+		char* end = nullptr;
+		const long limit = strtol(value.c_str(), &end, 10);
+		parsed = !value.empty() && *end == '\0' && limit >= 0;
+		if (parsed)
+		{
+			vram_limit_mb = static_cast<int>(limit);
+			engine->_memoryBudget.SetBudgetLimit(VkDeviceSize(vram_limit_mb) * 1024 * 1024);
+		}
+	}
+	else
+	{
+		fmt::println("Unknown setting {}, expected frustum_culling, occlusion_culling or vram_limit_mb", name);
+		return false;
+	}
+
+	if (!parsed)
+		fmt::println("Bad value for setting {}: {}", name, value);
+	return parsed;
+}
+
+CapturedFrame ClusteredForwardRenderer::CaptureFrame() const
+{
+	CapturedFrame frame;
+	frame.camera_position = mainCamera.position;
+	frame.camera_rotation = mainCamera.rotation;
+	frame.light_direction = directLight.direction;
+	frame.light_color = directLight.color;
+	frame.flags = debugShadowMap ? CAPTURE_DEBUG_SHADOW_MAP : 0;
+	return frame;
+}
+
+void ClusteredForwardRenderer::ApplyCapturedFrame(const FrameCapture& capture, uint32_t frame)
+{
+	const CapturedFrame& captured = capture.GetFrame(frame);
+	mainCamera.setPosition(captured.camera_position);
+	mainCamera.setRotation(captured.camera_rotation);
+	directLight.direction = captured.light_direction;
+	directLight.color = captured.light_color;
+	debugShadowMap = (captured.flags & CAPTURE_DEBUG_SHADOW_MAP) != 0;
+	capture.ApplyLightChanges(frame, pointData.pointLights);
 }
 
 void ClusteredForwardRenderer::ResizeSwapchain()
@@ -2477,11 +2582,14 @@ void ClusteredForwardRenderer::ResizeSwapchain()
 	_hdrImage = vkutil::create_image_empty(ImageExtent, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, engine);
 	_resolveImage = vkutil::create_image_empty(ImageExtent, VK_FORMAT_R16G16B16A16_SFLOAT, VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, engine);
 
+	//the HDR pass samples the recreated resolve image
+	target_generation++;
 	resize_requested = false;
 }
 
 void ClusteredForwardRenderer::DrawUI()
 { 
+	ZoneScoped;
 	// Demonstrate the various window flags. Typically you would just use the default!
 	static bool no_titlebar = false;
 	static bool no_scrollbar = false;
@@ -2580,6 +2688,8 @@ void ClusteredForwardRenderer::DrawUI()
 	if (ImGui::CollapsingHeader("Debugging"))
 	{
 		ImGui::Checkbox("Visualize shadow cascades", &debugShadowMap);
+		ImGui::Checkbox("Frustum culling", &frustum_culling);
+		ImGui::Checkbox("Occlusion culling", &occlusion_culling);
 		ImGui::Checkbox("Read buffer", &readDebugBuffer);
 		ImGui::Checkbox("Display buffer", &debugBuffer);
 		ImGui::Checkbox("Visualize depth texure", &debugDepthTexture);
@@ -2615,12 +2725,103 @@ void ClusteredForwardRenderer::DrawUI()
 		ImGui::SeparatorText("Render timings");
 		ImGui::Text("FPS %f ", 1000.0f / stats.frametime);
 		ImGui::Text("frametime %f ms", stats.frametime);
-		ImGui::Text("drawtime %f ms", stats.mesh_draw_time);
-		ImGui::Text("triangles %i", stats.triangle_count);
-		ImGui::Text("draws %i", stats.drawcall_count);
-		ImGui::Text("UI render time %f ms", stats.ui_draw_time);
 		ImGui::Text("Update time %f ms", stats.update_time);
-		ImGui::Text("Shadow Pass time %f ms", stats.shadow_pass_time);
+
+		ImGui::SeparatorText("Frame history");
+		const BenchmarkSummary cpu_summary = frame_history.GetCpuSummary();
+		const BenchmarkSummary gpu_summary = frame_history.GetGpuSummary();
+		ImGui::Text("last %u frames", frame_history.GetFrameCount());
+		ImGui::Text("CPU p50 %.2f p95 %.2f p99 %.2f max %.2f ms", cpu_summary.p50, cpu_summary.p95, cpu_summary.p99, cpu_summary.max);
+		ImGui::Text("GPU p50 %.2f p95 %.2f p99 %.2f max %.2f ms", gpu_summary.p50, gpu_summary.p95, gpu_summary.p99, gpu_summary.max);
+		ImGui::Text("%llu hitches", (unsigned long long)frame_history.GetHitchCount());
+		if (frame_history.GetKeptHitchCount() > 0)
+		{
+			const FrameHitch& hitch = frame_history.GetHitch(frame_history.GetKeptHitchCount() - 1);
+			ImGui::Text("last on frame %llu, %s %.2f ms over %.2f ms", (unsigned long long)hitch.sample.frame, hitch.gpu ? "GPU" : "CPU",
+				hitch.gpu ? hitch.sample.gpu_ms : hitch.sample.cpu_ms, hitch.threshold_ms);
+			ImGui::Text("  %u heap, %u device allocations, %u descriptor pools", hitch.sample.heap_allocations, hitch.sample.device_allocations,
+				hitch.sample.descriptor_pools);
+		}
+		ImGui::SliderFloat("Hitch budget (ms)", &frame_history.budget_ms, 1.0f, 100.0f);
+		if (ImGui::Button("Dump frame history"))
+			frame_history.Dump("frame_history.json");
+		ImGui::SameLine();
+		if (ImGui::Button("Clear frame history"))
+			frame_history.Reset();
+
+		ImGui::SeparatorText("GPU timings");
+		if (gpu_profiler.IsSupported())
+		{
+			ImGui::Text("frame %.3f ms", gpu_profiler.GetFrameTime());
+			for (const GpuScopeTiming& timing : gpu_profiler.GetTimings())
+				ImGui::Text("%s %.3f ms", timing.name, timing.smoothed_ms);
+		}
+		else
+			ImGui::Text("timestamps aren't supported on the graphics queue");
+
+		ImGui::SeparatorText("Culling");
+		for (const CullPassStats& pass : gpu_statistics.GetCullStats())
+		{
+			const GPUCullCounters& counters = pass.counters;
+			ImGui::Text("%s: %u visible, %u triangles", pass.name, counters.visible, counters.triangles);
+			ImGui::Text("  culled %u frustum, %u occlusion", counters.frustum_culled, counters.occlusion_culled);
+		}
+
+		ImGui::SeparatorText("Pipeline statistics");
+		if (!gpu_statistics.HasPipelineStatistics())
+			ImGui::Text("pipeline statistics queries aren't supported");
+		for (const PipelinePassStats& pass : gpu_statistics.GetPipelineStats())
+		{
+			auto value = [&](PipelineStatistic statistic) { return pass.values[static_cast<size_t>(statistic)]; };
+			if (ImGui::TreeNode(pass.name))
+			{
+				ImGui::Text("primitives %llu", value(PipelineStatistic::InputAssemblyPrimitives));
+				ImGui::Text("vertex invocations %llu", value(PipelineStatistic::VertexShaderInvocations));
+				ImGui::Text("primitives after clipping %llu", value(PipelineStatistic::ClippingPrimitives));
+				ImGui::Text("fragment invocations %llu", value(PipelineStatistic::FragmentShaderInvocations));
+				ImGui::Text("compute invocations %llu", value(PipelineStatistic::ComputeShaderInvocations));
+				ImGui::TreePop();
+			}
+		}
+
+		ImGui::SeparatorText("Memory");
+		const MemoryBudgetStats& memory = resource_manager->GetMemoryStats();
+		constexpr float MB = 1024.0f * 1024.0f;
+		ImGui::Text("device local %.1f / %.1f MB%s", memory.device_local_usage / MB, memory.device_local_budget / MB,
+			memory.driver_budget ? "" : " (estimated)");
+		for (size_t i = 0; i < memory.category_bytes.size(); i++)
+			ImGui::Text("%s %.1f MB in %u allocations", MemoryCategoryName(MemoryCategory(i)), memory.category_bytes[i] / MB, memory.category_allocations[i]);
+		ImGui::Text("untracked %.1f MB", memory.untracked_bytes / MB);
+
+		TextureEvictionStats eviction = resource_manager->GetTextureEvictionStats();
+		ImGui::Text("dropped %u mips over %u textures, %.1f MB released", eviction.dropped_mips, eviction.resident_textures, eviction.bytes_released / MB);
+		TextureStreamingStats streaming = resource_manager->GetTextureStreamingStats();
+		ImGui::Text("streamed %u mips, %.1f MB uploaded, %u textures waiting", streaming.streamed_mips, streaming.bytes_uploaded / MB, streaming.pending_textures);
+		ImGui::Text("CPU mip chains %.1f MB", streaming.cpu_bytes / MB);
+		BindlessTableStats bindless = resource_manager->bindless_table.GetStats();
+		ImGui::Text("bindless %u textures for %u references, %u materials in %.1f KB, last flush wrote %u", bindless.texture_slots, bindless.texture_references,
+			bindless.materials, bindless.material_table_bytes / 1024.0f, bindless.last_flush_writes);
+		GeometryHeapStats heap = resource_manager->geometry_heap.GetStats();
+		ImGui::Text("geometry heap %u / %u vertices, %u / %u index words, %u meshes, largest holes %u vertices %u index words", heap.vertices_used,
+			heap.vertex_capacity, heap.index_words_used, heap.index_capacity, heap.allocation_count, heap.largest_free_vertex_range, heap.largest_free_index_range);
+		RetireQueueStats retire = resource_manager->retire_queue.GetStats();
+		ImGui::Text("retiring %u buffers %u images %u views %u samplers, %llu destroyed", retire.pending_buffers, retire.pending_images,
+			retire.pending_views, retire.pending_samplers, (unsigned long long)retire.destroyed);
+		FrameRingStats ring = frame_ring.GetStats();
+		ImGui::Text("frame ring %.1f KB used, %.1f KB peak of %.1f KB per frame", ring.frame_used / 1024.0f, ring.peak_used / 1024.0f, ring.frame_capacity / 1024.0f);
+		FrameArenaStats arena = frame_arena.GetStats();
+		ImGui::Text("frame arena %.1f KB used, %.1f KB peak of %.1f KB, %u overflowed", arena.frame_used / 1024.0f, arena.peak_used / 1024.0f,
+			arena.capacity / 1024.0f, arena.overflow_allocations);
+		ImGui::Text("heap allocations last frame %u", stats.heap_allocations);
+		ImGui::Checkbox("Assert on frame heap allocations", &assert_no_heap_allocations);
+		WorldPartitionStats world = world_partition.GetStats();
+		ImGui::Text("world cells %u / %u loaded, %u loading, %u files, %u loads %u unloads", world.loaded_cells, world.cells, world.loading_cells,
+			world.resident_files, world.loads, world.unloads);
+		if (ImGui::InputInt("VRAM limit (MB, 0 = driver budget)", &vram_limit_mb))
+		{
+			vram_limit_mb = std::max(vram_limit_mb, 0);
+			engine->_memoryBudget.SetBudgetLimit(VkDeviceSize(vram_limit_mb) * 1024 * 1024);
+		}
 	}
 	ImGui::End();
 }
@@ -1,5 +1,13 @@
 #pragma once
 #include "base_renderer.h"
+#include "../frame_ring_buffer.h"
+#include "../frame_arena.h"
+#include "../gpu_profiler.h"
+#include "../gpu_statistics.h"
+#include "../benchmark.h"
+#include "../frame_capture.h"
+#include "../stress_scene.h"
+#include "../frame_history.h"
 #include <memory>
 
 constexpr unsigned int FRAME_OVERLAP = 2;
@@ -13,6 +21,17 @@ struct ClusteredForwardRenderer : BaseRenderer
 	void DrawUI() override;
 	void Run() override;
 
+	//Call before Init, the renderer then starts headless at the benchmark's size and RunBenchmark replaces Run
+	void SetBenchmark(const BenchmarkOptions& options);
+	//Plays the camera path for the benchmark's frames and writes the report, returns false if either file failed
+	bool RunBenchmark();
+	//Writes the camera, lights and debug views of every frame Run draws to the capture, call before Run
+	bool SetRecording(std::string_view capturePath);
+	//Takes a "name=value" setting the benchmark compares runs over, returns false for unknown names or bad values
+	bool ApplySetting(std::string_view setting);
+	//Call before Init, the generated scene and its point lights then replace the glTF scene and the default lights
+	void SetStressScene(const StressSceneOptions& options);
+
 	void InitImgui() override;
 
 	void LoadAssets() override;
@@ -26,7 +45,8 @@ struct ClusteredForwardRenderer : BaseRenderer
 	void BuildClusters();
 	void CullLights(VkCommandBuffer cmd);
 	void ReduceDepth(VkCommandBuffer cmd);
-	void ExecuteComputeCull(VkCommandBuffer cmd, vkutil::cullParams& cullParams, SceneManager::MeshPass* meshPass);
+	//name labels the dispatch's counters in the cull statistics
+	void ExecuteComputeCull(VkCommandBuffer cmd, vkutil::cullParams& cullParams, SceneManager::MeshPass* meshPass, const char* name);
 
 
 	void DrawShadows(VkCommandBuffer cmd);
@@ -43,13 +63,23 @@ struct ClusteredForwardRenderer : BaseRenderer
 	void InitCommands();
 	void InitRenderTargets();
 	void InitSwapchain();
-	void InitComputePipelines();
+	//Adds the culling and depth reduce pipelines to the batch
+	void InitComputePipelines(PipelineBatch& batch);
 	void InitDefaultData();
 	void InitSyncStructures();
 	void InitDescriptors();
 	void InitBuffers();
 	void InitPipelines();
 
+	//Rewrites the current frame's pass descriptor sets if a resource they point at was replaced
+	void UpdatePassDescriptors();
+	//Pushes the scene and shadow uniforms, the point lights and the light cull counter into the frame ring
+	void WriteFrameUniforms();
+	//Fills the template entries of the geometry set
+	void WriteGeometryEntries(DescriptorTemplateEntry* entries);
+	CapturedFrame CaptureFrame() const;
+	void ApplyCapturedFrame(const FrameCapture& capture, uint32_t frame);
+
 	void CreateSwapchain(uint32_t width, uint32_t height);
 	void DestroySwapchain();
 	void ResizeSwapchain();
@@ -64,6 +94,7 @@ private:
 	Camera mainCamera;
 	std::shared_ptr<ResourceManager> resource_manager;
 	std::shared_ptr<SceneManager> scene_manager;
+	WorldPartition world_partition;
 
 	VkSwapchainKHR _swapchain;
 	VkFormat _swapchainImageFormat;
@@ -88,7 +119,72 @@ private:
 	BlackKey::FrameData _frames[FRAME_OVERLAP];
 	BlackKey::FrameData& get_current_frame() { return _frames[_frameNumber % FRAME_OVERLAP]; };
 
+	//Descriptor sets of one frame in flight's passes. They are written once and rewritten only when a buffer or
+	//image they point at is replaced, the uniforms that change every frame are picked through dynamic offsets
+	struct PassDescriptorSets {
+		VkDescriptorSet geometry = VK_NULL_HANDLE;
+		VkDescriptorSet early_depth = VK_NULL_HANDLE;
+		VkDescriptorSet shadows = VK_NULL_HANDLE;
+		VkDescriptorSet sky = VK_NULL_HANDLE;
+		VkDescriptorSet hdr = VK_NULL_HANDLE;
+		VkDescriptorSet cull_lights = VK_NULL_HANDLE;
+		//by the mesh pass being culled
+		std::unordered_map<SceneManager::MeshPass*, VkDescriptorSet> cull;
+		//one per depth pyramid mip
+		std::vector<VkDescriptorSet> depth_reduce;
+		//scene buffer and render target generations and the light count the sets were written for
+		uint32_t scene_generation = UINT32_MAX;
+		uint32_t target_generation = UINT32_MAX;
+		uint32_t light_count = UINT32_MAX;
+	};
+
+	PassDescriptorSets pass_sets[FRAME_OVERLAP];
+	DescriptorAllocatorGrowable pass_descriptor_allocator;
+	//Entries a pass template can take, the geometry layout is the largest
+	static constexpr uint32_t PASS_TEMPLATE_ENTRIES = 16;
+	struct {
+		DescriptorUpdateTemplate geometry;
+		DescriptorUpdateTemplate early_depth;
+		DescriptorUpdateTemplate shadows;
+		DescriptorUpdateTemplate sky;
+		DescriptorUpdateTemplate hdr;
+		DescriptorUpdateTemplate cull_lights;
+		DescriptorUpdateTemplate cull;
+		DescriptorUpdateTemplate depth_reduce;
+	} pass_templates;
+
+	//bumped when the swapchain sized render targets are recreated
+	uint32_t target_generation = 0;
+	//everything the CPU rewrites each frame, the pass sets read it through dynamic offsets
+	FrameRingBuffer frame_ring;
+	//dynamic offsets of this frame's pushes into frame_ring
+	struct {
+		uint32_t scene = 0;
+		uint32_t shadow = 0;
+		uint32_t lights = 0;
+		uint32_t light_index = 0;
+	} frame_offsets;
+	//lists only needed while the frame is recorded, rebuilt on it after each reset
+	FrameArena frame_arena;
+	//timestamps around each pass, read back FRAME_OVERLAP frames later
+	GpuProfiler gpu_profiler;
+	//cull counters and pipeline statistics, read back FRAME_OVERLAP frames later
+	GpuStatistics gpu_statistics;
+	//the last frames of the interactive loop, their percentiles and the ones that went over the budget
+	FrameHistory frame_history;
+
 	bool resize_requested = false;
+	//no window or swapchain, frames are submitted without being presented
+	bool headless = false;
+	std::optional<BenchmarkOptions> benchmark_options;
+	//seconds UpdateScene advances the camera by each frame, 0 takes the time since the last frame
+	float fixed_timestep = 0.0f;
+	//open while Run records
+	FrameCaptureWriter capture_writer;
+	std::string scene_path = "assets/sponza/Sponza.gltf";
+	std::optional<StressSceneOptions> stress_scene;
+	//key in loadedScenes of the scene registered with the scene manager
+	std::string main_scene = "sponza";
 	bool _isInitialized{ false };
 	int _frameNumber{ 0 };
 	bool render_shadowMap{ true };
@@ -97,6 +193,11 @@ private:
 	bool use_bindless = true;
 	bool debugBuffer = false;
 	bool readDebugBuffer = false;
+	//caps the device local memory budget below the driver's, 0 leaves it uncapped
+	int vram_limit_mb = 0;
+	//cull tests of the main view, the shadow pass draws everything either way
+	bool frustum_culling = true;
+	bool occlusion_culling = true;
 
 	struct {
 		float lastFrame;
@@ -142,6 +243,7 @@ private:
 	VkDescriptorSetLayout compute_cull_descriptor_layout;
 	VkDescriptorSetLayout depth_reduce_descriptor_layout;
 	VkDescriptorSetLayout cascaded_shadows_descriptor_layout;
+	VkDescriptorSetLayout early_depth_descriptor_layout;
 	//VkDescriptorSetLayout _
 
 	AllocatedImage _whiteImage;
@@ -173,8 +275,10 @@ private:
 	VkSampleCountFlagBits msaa_samples;
 
 	bool debugDepthTexture = false;
+	//asserts once a frame touches the heap, for checking that the steady state is allocation free
+	bool assert_no_heap_allocations = false;
 
-	std::vector<VkBufferMemoryBarrier> cullBarriers;
+	std::pmr::vector<VkBufferMemoryBarrier> cullBarriers{ &frame_arena };
 
 	//Clustered culling  values
 	struct {
@@ -183,19 +287,17 @@ private:
 		const uint32_t gridSizeY = 9;
 		const uint32_t gridSizeZ = 24;
 		const uint32_t numClusters = gridSizeX * gridSizeY * gridSizeZ;
-		const uint32_t maxLightsPerTile = 50;
+		//must match MAX_LIGHTS_PER_CLUSTER in cluster_cull_light_shader.comp, the light index list is sized from it
+		const uint32_t maxLightsPerTile = 100;
 		uint32_t sizeX, sizeY;
 
 		//Storage Buffers
 		AllocatedBuffer AABBVolumeGridSSBO;
 		AllocatedBuffer screenToViewSSBO;
-		AllocatedBuffer lightSSBO;
 		AllocatedBuffer lightIndexListSSBO;
 		AllocatedBuffer lightGridSSBO;
-		AllocatedBuffer lightGlobalIndex[2];
 	} ClusterValues;
 
-	std::vector<uint32_t> draws;
 	std::unordered_map<std::string, std::shared_ptr<LoadedGLTF>> loadedScenes;
 
 	//lights
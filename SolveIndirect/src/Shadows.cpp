@@ -1,12 +1,11 @@
 #include "Shadows.h"
 #include "vk_engine.h"
+#include "profiling.h"
 
 Cascade ShadowCascades::getCascades(VulkanEngine* engine, Camera& mainCamera, GPUSceneData& scene_data)
 {
+	ZoneScoped;
 	Cascade cascades;
-	const int SHADOW_MAP_CASCADE_COUNT = 4;
-	cascades.lightSpaceMatrix.resize(SHADOW_MAP_CASCADE_COUNT);
-	cascades.cascadeDistances.resize(SHADOW_MAP_CASCADE_COUNT);
 
 	float cascadeSplits[SHADOW_MAP_CASCADE_COUNT];
 
@@ -95,8 +94,8 @@ Cascade ShadowCascades::getCascades(VulkanEngine* engine, Camera& mainCamera, GP
 		// Store split distance and matrix in cascade
 		cascades.cascadeDistances[i] = (mainCamera.getNearClip() + splitDist * clipRange) * -1.0f;
 		cascades.lightSpaceMatrix[i] = lightOrthoMatrix * lightViewMatrix;
-		cascades.lightViewMatrices.push_back(lightViewMatrix);
-		cascades.lightProjMatrices.push_back(lightOrthoMatrix);
+		cascades.lightViewMatrices[i] = lightViewMatrix;
+		cascades.lightProjMatrices[i] = lightOrthoMatrix;
 
 		lastSplitDist = cascadeSplits[i];
 	}
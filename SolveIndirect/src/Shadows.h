@@ -5,11 +5,14 @@
 
 class VulkanEngine;
 
+constexpr int SHADOW_MAP_CASCADE_COUNT = 4;
+
+//Fixed size so computing the cascades every frame doesn't touch the heap
 struct Cascade{
-    std::vector<glm::mat4> lightSpaceMatrix;
-    std::vector<float> cascadeDistances;
-    std::vector<glm::mat4> lightViewMatrices;
-    std::vector<glm::mat4> lightProjMatrices;
+    std::array<glm::mat4, SHADOW_MAP_CASCADE_COUNT> lightSpaceMatrix;
+    std::array<float, SHADOW_MAP_CASCADE_COUNT> cascadeDistances;
+    std::array<glm::mat4, SHADOW_MAP_CASCADE_COUNT> lightViewMatrices;
+    std::array<glm::mat4, SHADOW_MAP_CASCADE_COUNT> lightProjMatrices;
 };
 
 struct ShadowCascades
@@ -22,7 +25,7 @@ struct ShadowCascades
     };
 private:
     float cascadeSplitLambda = 0.95f;
-    int cascadeCount = 4;
+    int cascadeCount = SHADOW_MAP_CASCADE_COUNT;
     uint32_t shadowMapTextureSize;
 
 };
\ No newline at end of file
@@ -0,0 +1,281 @@
+#include "benchmark.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+bool CameraPath::Load(std::string_view path)
+{
+	std::ifstream file{ std::string(path) };
+	if (!file.is_open())
+	{
+		fmt::println("No camera path at {}", path);
+		return false;
+	}
+
+	keys.clear();
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		CameraKey key;
+		std::istringstream stream(line);
+		if (!(stream >> key.time >> key.position.x >> key.position.y >> key.position.z >> key.rotation.x >> key.rotation.y >> key.rotation.z))
+		{
+			fmt::println("Skipping malformed camera key: {}", line);
+			continue;
+		}
+		if (!keys.empty() && key.time < keys.back().time)
+		{
+			fmt::println("Skipping camera key going back in time: {}", line);
+			continue;
+		}
+		keys.push_back(key);
+	}
+	return !keys.empty();
+}
+
+CameraKey CameraPath::Sample(float time) const
+{
+	if (time <= keys.front().time)
+		return keys.front();
+	if (time >= keys.back().time)
+		return keys.back();
+
+	auto next = std::upper_bound(keys.begin(), keys.end(), time, [](float t, const CameraKey& key) { return t < key.time; });
+	const CameraKey& a = *(next - 1);
+	const CameraKey& b = *next;
+	const float span = b.time - a.time;
+	const float t = span > 0.0f ? (time - a.time) / span : 1.0f;
+	return CameraKey{ .time = time, .position = glm::mix(a.position, b.position, t), .rotation = glm::mix(a.rotation, b.rotation, t) };
+}
+
+std::optional<BenchmarkOptions> BenchmarkOptions::Parse(int argc, char* argv[])
+{
+	std::optional<BenchmarkOptions> options;
+	for (int i = 1; i < argc; i++)
+	{
+		const bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--benchmark") == 0 && has_value)
+		{
+			options.emplace();
+			options->camera_path = argv[++i];
+		}
+		else if (strcmp(argv[i], "--replay") == 0 && has_value)
+		{
+			options.emplace();
+			options->capture_path = argv[++i];
+		}
+	}
+	if (!options.has_value())
+		return options;
+
+	for (int i = 1; i < argc; i++)
+	{
+		const bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--frames") == 0 && has_value)
+			options->frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--warmup") == 0 && has_value)
+			options->warmup_frames = static_cast<uint32_t>(std::stoul(argv[++i]));
+		else if (strcmp(argv[i], "--size") == 0 && i + 2 < argc)
+		{
+			options->width = static_cast<uint32_t>(std::stoul(argv[++i]));
+			options->height = static_cast<uint32_t>(std::stoul(argv[++i]));
+		}
+		else if (strcmp(argv[i], "--scene") == 0 && has_value)
+			options->scene_path = argv[++i];
+		else if (strcmp(argv[i], "--report") == 0 && has_value)
+			options->report_path = argv[++i];
+		else if (strcmp(argv[i], "--set") == 0 && has_value)
+			options->settings.push_back(argv[++i]);
+	}
+	return options;
+}
+
+BenchmarkSummary Summarize(std::vector<float> samples)
+{
+	return SummarizeInPlace(samples);
+}
+
+BenchmarkSummary SummarizeInPlace(std::span<float> samples)
+{
+	BenchmarkSummary summary;
+	if (samples.empty())
+		return summary;
+
+	std::sort(samples.begin(), samples.end());
+	auto percentile = [&](float p) {
+		const size_t rank = static_cast<size_t>(std::ceil(p * samples.size()));
+		return samples[std::clamp<size_t>(rank, 1, samples.size()) - 1];
+	};
+
+	double total = 0.0;
+	for (float sample : samples)
+		total += sample;
+	summary.mean = static_cast<float>(total / samples.size());
+	summary.p50 = percentile(0.50f);
+	summary.p95 = percentile(0.95f);
+	summary.p99 = percentile(0.99f);
+	summary.max = samples.back();
+	return summary;
+}
+
+BenchmarkReport::Frame* BenchmarkReport::FindFrame(uint64_t frame)
+{
+	//the frame asked for is nearly always one of the last few
+	for (auto it = frames.rbegin(); it != frames.rend(); ++it)
+	{
+		if (it->frame == frame)
+			return &*it;
+		if (it->frame < frame)
+			break;
+	}
+	return nullptr;
+}
+
+void BenchmarkReport::AddCpuFrame(uint64_t frame, float cpu_ms)
+{
+	frames.push_back(Frame{ .frame = frame, .cpu_ms = cpu_ms });
+}
+
+void BenchmarkReport::AddGpuFrame(uint64_t frame, float gpu_ms, const std::vector<GpuScopeTiming>& scopes)
+{
+	Frame* measured = FindFrame(frame);
+	if (measured == nullptr)
+		return;
+
+	measured->gpu_ms = gpu_ms;
+	for (const GpuScopeTiming& scope : scopes)
+		measured->passes.emplace_back(scope.name, scope.last_ms);
+}
+
+void BenchmarkReport::TrackMemory(const MemoryBudgetStats& memory, const FrameArenaStats& arena, uint32_t heapAllocations)
+{
+	for (size_t i = 0; i < category_peak.size(); i++)
+		category_peak[i] = std::max(category_peak[i], memory.category_bytes[i]);
+	device_local_peak = std::max(device_local_peak, memory.device_local_usage);
+	arena_peak = std::max(arena_peak, arena.peak_used);
+	heap_allocations_peak = std::max(heap_allocations_peak, heapAllocations);
+}
+
+//Quoted with the characters JSON doesn't take as they are escaped, paths on Windows are full of backslashes
+std::string JsonString(std::string_view value)
+{
+	std::string quoted = "\"";
+	for (char c : value)
+	{
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		if (static_cast<unsigned char>(c) < 0x20)
+		{
+			quoted += fmt::format("\\u{:04x}", int(c));
+			continue;
+		}
+		quoted += c;
+	}
+	return quoted + "\"";
+}
+
+std::string JsonSummary(const BenchmarkSummary& summary)
+{
+	return fmt::format("{{ \"mean\": {:.4f}, \"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }}",
+		summary.mean, summary.p50, summary.p95, summary.p99, summary.max);
+}
+
+bool BenchmarkReport::Write(const BenchmarkOptions& options, std::string_view deviceName, const std::vector<CullPassStats>& culling,
+	const std::vector<PipelinePassStats>& pipeline) const
+{
+	std::vector<float> cpu_samples;
+	std::vector<float> gpu_samples;
+	//by pass name in the order the passes were first seen
+	std::vector<std::pair<std::string, std::vector<float>>> pass_samples;
+	for (const Frame& frame : frames)
+	{
+		cpu_samples.push_back(frame.cpu_ms);
+		if (frame.gpu_ms < 0.0f)
+			continue;
+		gpu_samples.push_back(frame.gpu_ms);
+		for (const auto& [name, ms] : frame.passes)
+		{
+			auto samples = std::find_if(pass_samples.begin(), pass_samples.end(), [&](const auto& entry) { return entry.first == name; });
+			if (samples == pass_samples.end())
+				samples = pass_samples.insert(pass_samples.end(), { name, {} });
+			samples->second.push_back(ms);
+		}
+	}
+
+	std::string json = "{\n";
+	json += fmt::format("\t\"device\": {},\n", JsonString(deviceName));
+	json += fmt::format("\t\"scene\": {},\n", JsonString(options.scene_path));
+	json += fmt::format("\t\"stress_scene\": {},\n", JsonString(options.stress_scene));
+	json += fmt::format("\t\"camera_path\": {},\n", JsonString(options.camera_path));
+	json += fmt::format("\t\"capture\": {},\n", JsonString(options.capture_path));
+	json += "\t\"settings\": [";
+	for (size_t i = 0; i < options.settings.size(); i++)
+		json += fmt::format("{}{}", i == 0 ? " " : ", ", JsonString(options.settings[i]));
+	json += " ],\n";
+	json += fmt::format("\t\"width\": {},\n\t\"height\": {},\n", options.width, options.height);
+	json += fmt::format("\t\"frames\": {},\n\t\"warmup_frames\": {},\n", frames.size(), options.warmup_frames);
+
+	json += fmt::format("\t\"cpu_ms\": {},\n", JsonSummary(Summarize(cpu_samples)));
+	json += fmt::format("\t\"gpu_ms\": {},\n", JsonSummary(Summarize(gpu_samples)));
+	json += "\t\"gpu_passes_ms\": {";
+	for (size_t i = 0; i < pass_samples.size(); i++)
+		json += fmt::format("{}\n\t\t{}: {}", i == 0 ? "" : ",", JsonString(pass_samples[i].first), JsonSummary(Summarize(pass_samples[i].second)));
+	json += "\n\t},\n";
+
+	json += "\t\"memory_peak_bytes\": {\n";
+	json += fmt::format("\t\t\"device_local\": {},\n", device_local_peak);
+	for (size_t i = 0; i < category_peak.size(); i++)
+		json += fmt::format("\t\t{}: {},\n", JsonString(MemoryCategoryName(MemoryCategory(i))), category_peak[i]);
+	json += fmt::format("\t\t\"frame_arena\": {}\n\t}},\n", arena_peak);
+	json += fmt::format("\t\"heap_allocations_peak\": {},\n", heap_allocations_peak);
+
+	json += "\t\"culling\": {";
+	for (size_t i = 0; i < culling.size(); i++)
+	{
+		const GPUCullCounters& counters = culling[i].counters;
+		json += fmt::format("{}\n\t\t{}: {{ \"visible\": {}, \"frustum_culled\": {}, \"occlusion_culled\": {}, \"triangles\": {} }}", i == 0 ? "" : ",",
+			JsonString(culling[i].name), counters.visible, counters.frustum_culled, counters.occlusion_culled, counters.triangles);
+	}
+	json += "\n\t},\n";
+
+	json += "\t\"pipeline_statistics\": {";
+	for (size_t i = 0; i < pipeline.size(); i++)
+	{
+		auto value = [&](PipelineStatistic statistic) { return pipeline[i].values[static_cast<size_t>(statistic)]; };
+		json += fmt::format("{}\n\t\t{}: {{ \"primitives\": {}, \"vertex_invocations\": {}, \"clipped_primitives\": {}, \"fragment_invocations\": {}, \"compute_invocations\": {} }}",
+			i == 0 ? "" : ",", JsonString(pipeline[i].name), value(PipelineStatistic::InputAssemblyPrimitives), value(PipelineStatistic::VertexShaderInvocations),
+			value(PipelineStatistic::ClippingPrimitives), value(PipelineStatistic::FragmentShaderInvocations), value(PipelineStatistic::ComputeShaderInvocations));
+	}
+	json += "\n\t},\n";
+
+	json += "\t\"frame_records\": [";
+	for (size_t i = 0; i < frames.size(); i++)
+	{
+		const Frame& frame = frames[i];
+		json += fmt::format("{}\n\t\t{{ \"frame\": {}, \"cpu_ms\": {:.4f}", i == 0 ? "" : ",", frame.frame, frame.cpu_ms);
+		if (frame.gpu_ms >= 0.0f)
+		{
+			json += fmt::format(", \"gpu_ms\": {:.4f}, \"passes\": {{", frame.gpu_ms);
+			for (size_t p = 0; p < frame.passes.size(); p++)
+				json += fmt::format("{}{}: {:.4f}", p == 0 ? " " : ", ", JsonString(frame.passes[p].first), frame.passes[p].second);
+			json += " }";
+		}
+		json += " }";
+	}
+	json += "\n\t]\n}\n";
+
+	std::ofstream file(options.report_path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		fmt::println("Failed to open the benchmark report {}", options.report_path);
+		return false;
+	}
+	file << json;
+	return file.good();
+}
@@ -0,0 +1,94 @@
+#pragma once
+#include "vk_types.h"
+#include "gpu_profiler.h"
+#include "gpu_statistics.h"
+#include "memory_budget.h"
+#include "frame_arena.h"
+
+//One key of a camera path, in the position and rotation the Camera keeps, seconds from the start of the path
+struct CameraKey {
+	float time = 0.0f;
+	glm::vec3 position{ 0.0f };
+	glm::vec3 rotation{ 0.0f };
+};
+
+//Keys the camera is moved between, linearly
+struct CameraPath {
+	//Reads one "time px py pz rx ry rz" line per key in increasing time, lines starting with # are skipped.
+	//Returns false if the file is missing or holds no keys
+	bool Load(std::string_view path);
+	//Held at the first and last key outside the path
+	CameraKey Sample(float time) const;
+
+	std::vector<CameraKey> keys;
+};
+
+//Everything a headless benchmark run is given on the command line
+struct BenchmarkOptions {
+	std::string camera_path;
+	//frame capture replayed instead of a camera path, its frames are the measured ones
+	std::string capture_path;
+	//"name=value" renderer settings applied before the first frame
+	std::vector<std::string> settings;
+	std::string report_path = "benchmark.json";
+	//glTF drawn instead of the default scene, empty keeps it
+	std::string scene_path;
+	//options of the generated scene drawn instead, set by whoever parsed them so the report lists them
+	std::string stress_scene;
+	uint32_t frames = 600;
+	//frames drawn before any is measured, pipelines and streamed textures settle in them
+	uint32_t warmup_frames = 30;
+	uint32_t width = 1920;
+	uint32_t height = 1080;
+	//seconds of camera path each frame advances, fixed so every run draws the same frames
+	float timestep = 1.0f / 60.0f;
+
+	//Reads --benchmark <camera path> or --replay <capture> and the options after it: --frames, --warmup, --size <w> <h>,
+	//--scene, --report and any number of --set <name=value>. Returns nothing if neither --benchmark nor --replay is given
+	static std::optional<BenchmarkOptions> Parse(int argc, char* argv[]);
+};
+
+//Percentiles over a set of samples, nearest rank
+struct BenchmarkSummary {
+	float mean = 0.0f;
+	float p50 = 0.0f;
+	float p95 = 0.0f;
+	float p99 = 0.0f;
+	float max = 0.0f;
+};
+BenchmarkSummary Summarize(std::vector<float> samples);
+//Sorts the samples where they are instead of copying them, for callers that can't allocate
+BenchmarkSummary SummarizeInPlace(std::span<float> samples);
+
+//JSON text of a string, quoted and escaped, and of a summary as an object
+std::string JsonString(std::string_view value);
+std::string JsonSummary(const BenchmarkSummary& summary);
+
+//Collects the measured frames of a benchmark run and writes them out as JSON.
+//GPU timings arrive FRAME_OVERLAP frames after the CPU time of the same frame, they are matched by frame number
+struct BenchmarkReport {
+	void AddCpuFrame(uint64_t frame, float cpu_ms);
+	void AddGpuFrame(uint64_t frame, float gpu_ms, const std::vector<GpuScopeTiming>& scopes);
+	//Keeps the highest values seen, call once per measured frame
+	void TrackMemory(const MemoryBudgetStats& memory, const FrameArenaStats& arena, uint32_t heapAllocations);
+
+	bool Write(const BenchmarkOptions& options, std::string_view deviceName, const std::vector<CullPassStats>& culling,
+		const std::vector<PipelinePassStats>& pipeline) const;
+
+private:
+	struct Frame {
+		uint64_t frame = 0;
+		float cpu_ms = 0.0f;
+		float gpu_ms = -1.0f;
+		std::vector<std::pair<std::string, float>> passes;
+	};
+
+	//null for frames that weren't measured
+	Frame* FindFrame(uint64_t frame);
+
+	std::vector<Frame> frames;
+	std::array<VkDeviceSize, size_t(MemoryCategory::Count)> category_peak{};
+	VkDeviceSize device_local_peak = 0;
+	uint32_t arena_peak = 0;
+	uint32_t heap_allocations_peak = 0;
+};
@@ -0,0 +1,289 @@
+#include "bindless_table.h"
+#include "resource_manager.h"
+#include "vk_engine.h"
+#include "vk_descriptors.h"
+#include "profiling.h"
+#include <algorithm>
+
+size_t BindlessTable::TextureKeyHash::operator()(const TextureKey& key) const
+{
+	const size_t view = std::hash<uint64_t>()(uint64_t(key.view));
+	const size_t sampler = std::hash<uint64_t>()(uint64_t(key.sampler));
+	return view ^ (sampler + 0x9e3779b9 + (view << 6) + (view >> 2));
+}
+
+void BindlessTable::Init(ResourceManager* rm, VkDescriptorSetLayout layout, VkImageView defaultView, VkSampler defaultSampler, uint32_t framesInFlight)
+{
+	resource_manager = rm;
+	frames_in_flight = framesInFlight;
+	VkDevice device = resource_manager->engine->_device;
+
+	//the storage image isn't written by the table, it still counts against the pool
+	std::array<VkDescriptorPoolSize, 3> pool_sizes = { {
+		{ VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, BINDLESS_TEXTURE_CAPACITY },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
+		{ VK_DESCRIPTOR_TYPE_STORAGE_BUFFER, 1 },
+	} };
+
+	VkDescriptorPoolCreateInfo pool_info = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO };
+	pool_info.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+	pool_info.maxSets = 1;
+	pool_info.poolSizeCount = static_cast<uint32_t>(pool_sizes.size());
+	pool_info.pPoolSizes = pool_sizes.data();
+	VK_CHECK(vkCreateDescriptorPool(device, &pool_info, nullptr, &pool));
+
+	VkDescriptorSetAllocateInfo alloc_info = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO };
+	alloc_info.descriptorPool = pool;
+	alloc_info.descriptorSetCount = 1;
+	alloc_info.pSetLayouts = &layout;
+	VK_CHECK(vkAllocateDescriptorSets(device, &alloc_info, &set));
+
+	material_capacity = BINDLESS_MATERIAL_INITIAL_CAPACITY;
+	material_table = resource_manager->CreateBuffer(sizeof(GPUMaterial) * material_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Buffers, false);
+	WriteMaterialTable();
+
+	is_initialized = true;
+
+	//never released, every default texture of every material lands here
+	const uint32_t default_slot = AcquireTexture(defaultView, defaultSampler);
+	assert(default_slot == BINDLESS_DEFAULT_TEXTURE);
+	Flush();
+}
+
+void BindlessTable::Cleanup()
+{
+	if (!is_initialized)
+		return;
+
+	resource_manager->DestroyBuffer(material_table);
+	vkDestroyDescriptorPool(resource_manager->engine->_device, pool, nullptr);
+	set = VK_NULL_HANDLE;
+	is_initialized = false;
+}
+
+void BindlessTable::BeginFrame(uint64_t frame)
+{
+	current_frame = frame;
+
+	auto last = std::find_if(retired_texture_slots.begin(), retired_texture_slots.end(), [&](const RetiredSlot& retired) {
+		return retired.retireFrame > frame;
+		});
+	for (auto it = retired_texture_slots.begin(); it != last; it++)
+		free_texture_slots.push_back(it->slot);
+	retired_texture_slots.erase(retired_texture_slots.begin(), last);
+}
+
+std::optional<uint32_t> BindlessTable::TakeFreeSlot()
+{
+	if (!free_texture_slots.empty())
+	{
+		const uint32_t slot = free_texture_slots.back();
+		free_texture_slots.pop_back();
+		return slot;
+	}
+	if (texture_slots.size() < BINDLESS_TEXTURE_CAPACITY)
+	{
+		texture_slots.emplace_back();
+		return static_cast<uint32_t>(texture_slots.size() - 1);
+	}
+	return std::nullopt;
+}
+
+uint32_t BindlessTable::AcquireTexture(VkImageView view, VkSampler sampler)
+{
+	texture_references++;
+
+	auto it = texture_lookup.find(TextureKey{ view, sampler });
+	if (it != texture_lookup.end())
+	{
+		texture_slots[it->second].references++;
+		return it->second;
+	}
+
+	const std::optional<uint32_t> slot = TakeFreeSlot();
+	if (!slot)
+	{
+		fmt::println("Bindless texture slots exhausted, falling back to the default texture");
+		texture_slots[BINDLESS_DEFAULT_TEXTURE].references++;
+		return BINDLESS_DEFAULT_TEXTURE;
+	}
+
+	texture_slots[*slot] = TextureSlot{ .view = view, .sampler = sampler, .references = 1 };
+	texture_lookup.emplace(TextureKey{ view, sampler }, *slot);
+	dirty_texture_slots.push_back(*slot);
+	return *slot;
+}
+
+void BindlessTable::ReleaseTexture(uint32_t slot)
+{
+	TextureSlot& texture = texture_slots[slot];
+	assert(texture.references > 0);
+	texture_references--;
+	if (--texture.references > 0)
+		return;
+
+	//the descriptor is left as it is, nothing indexes a free slot
+	texture_lookup.erase(TextureKey{ texture.view, texture.sampler });
+	texture.view = VK_NULL_HANDLE;
+	texture.sampler = VK_NULL_HANDLE;
+	free_texture_slots.push_back(slot);
+}
+
+void BindlessTable::ReplaceView(VkImageView oldView, VkImageView newView)
+{
+	for (uint32_t slot = 0; slot < texture_slots.size(); slot++)
+	{
+		//copied, taking a slot can grow the array
+		const TextureSlot texture = texture_slots[slot];
+		if (texture.view != oldView || texture.references == 0)
+			continue;
+		texture_lookup.erase(TextureKey{ oldView, texture.sampler });
+
+		const std::optional<uint32_t> new_slot = TakeFreeSlot();
+		if (!new_slot)
+		{
+			//nowhere to move to, the slot can only be rewritten once no frame reads it
+			fmt::println("Bindless texture slots exhausted, waiting for the queue to replace a texture in place");
+			vkQueueWaitIdle(resource_manager->engine->_graphicsQueue);
+			texture_slots[slot].view = newView;
+			texture_lookup.emplace(TextureKey{ newView, texture.sampler }, slot);
+			dirty_texture_slots.push_back(slot);
+			continue;
+		}
+
+		texture_slots[*new_slot] = TextureSlot{ .view = newView, .sampler = texture.sampler, .references = texture.references };
+		texture_lookup.emplace(TextureKey{ newView, texture.sampler }, *new_slot);
+		dirty_texture_slots.push_back(*new_slot);
+
+		//the frames in flight may sample the old slot, it stays as it is until they are done
+		texture_slots[slot] = TextureSlot{ .view = VK_NULL_HANDLE, .sampler = VK_NULL_HANDLE, .references = 0 };
+		retired_texture_slots.push_back(RetiredSlot{ slot, current_frame + frames_in_flight });
+
+		for (uint32_t material = 0; material < materials.size(); material++)
+		{
+			MaterialTextureSlots& textures = materials[material].textures;
+			bool changed = false;
+			for (uint32_t* texture_slot : { &textures.color, &textures.metalRough, &textures.normal, &textures.occlusion })
+			{
+				if (*texture_slot != slot)
+					continue;
+				*texture_slot = *new_slot;
+				changed = true;
+			}
+			if (changed)
+				dirty_materials.push_back(material);
+		}
+	}
+}
+
+uint32_t BindlessTable::AllocateMaterial(const GPUMaterial& gpuMaterial)
+{
+	uint32_t material;
+	if (!free_materials.empty())
+	{
+		material = free_materials.back();
+		free_materials.pop_back();
+	}
+	else
+	{
+		assert(materials.size() < BINDLESS_MATERIAL_CAPACITY);
+		if (materials.size() == material_capacity)
+			GrowMaterialTable();
+		material = static_cast<uint32_t>(materials.size());
+		materials.emplace_back();
+	}
+
+	materials[material] = gpuMaterial;
+	GPUMaterial* table = (GPUMaterial*)material_table.info.pMappedData;
+	table[material] = gpuMaterial;
+	return material;
+}
+
+void BindlessTable::FreeMaterial(uint32_t material)
+{
+	const MaterialTextureSlots& textures = materials[material].textures;
+	for (uint32_t slot : { textures.color, textures.metalRough, textures.normal, textures.occlusion })
+		ReleaseTexture(slot);
+	free_materials.push_back(material);
+}
+
+void BindlessTable::Flush()
+{
+	ZoneScoped;
+	if (dirty_texture_slots.empty())
+		return;
+
+	//a slot can be replaced more than once or freed and taken again between flushes
+	std::sort(dirty_texture_slots.begin(), dirty_texture_slots.end());
+	dirty_texture_slots.erase(std::unique(dirty_texture_slots.begin(), dirty_texture_slots.end()), dirty_texture_slots.end());
+
+	DescriptorWriter writer;
+	for (uint32_t slot : dirty_texture_slots)
+	{
+		const TextureSlot& texture = texture_slots[slot];
+		if (texture.references == 0)
+			continue;
+		writer.write_image(BINDLESS_TEXTURE_BINDING, texture.view, texture.sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL,
+			VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, slot);
+	}
+	writer.update_set(resource_manager->engine->_device, set);
+
+	last_flush_writes = static_cast<uint32_t>(writer.writes.size());
+	dirty_texture_slots.clear();
+}
+
+void BindlessTable::RecordMaterialWrites(VkCommandBuffer cmd)
+{
+	if (dirty_materials.empty())
+		return;
+
+	std::sort(dirty_materials.begin(), dirty_materials.end());
+	dirty_materials.erase(std::unique(dirty_materials.begin(), dirty_materials.end()), dirty_materials.end());
+
+	//the earlier frames on the queue read the entries before they are overwritten
+	const VkPipelineStageFlags shader_stages = VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT;
+	VkBufferMemoryBarrier barrier = vkinit::buffer_barrier(material_table.buffer, resource_manager->engine->_graphicsQueueFamily);
+	barrier.srcAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, shader_stages, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	for (uint32_t material : dirty_materials)
+		vkCmdUpdateBuffer(cmd, material_table.buffer, sizeof(GPUMaterial) * material, sizeof(GPUMaterial), &materials[material]);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, shader_stages, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+	dirty_materials.clear();
+}
+
+void BindlessTable::GrowMaterialTable()
+{
+	//the binding is read by the frames in flight, it can't be pointed at the new buffer under them
+	vkQueueWaitIdle(resource_manager->engine->_graphicsQueue);
+
+	resource_manager->DestroyBuffer(material_table);
+	material_capacity = std::min(material_capacity * 2, BINDLESS_MATERIAL_CAPACITY);
+	material_table = resource_manager->CreateBuffer(sizeof(GPUMaterial) * material_capacity, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Buffers, false);
+	memcpy(material_table.info.pMappedData, materials.data(), sizeof(GPUMaterial) * materials.size());
+	WriteMaterialTable();
+}
+
+void BindlessTable::WriteMaterialTable()
+{
+	DescriptorWriter writer;
+	writer.write_buffer(BINDLESS_MATERIAL_TABLE_BINDING, material_table.buffer, sizeof(GPUMaterial) * material_capacity, 0, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	writer.update_set(resource_manager->engine->_device, set);
+}
+
+BindlessTableStats BindlessTable::GetStats() const
+{
+	BindlessTableStats stats;
+	stats.texture_slots = static_cast<uint32_t>(texture_slots.size() - free_texture_slots.size());
+	stats.texture_references = texture_references;
+	stats.materials = static_cast<uint32_t>(materials.size() - free_materials.size());
+	stats.material_table_bytes = static_cast<uint32_t>(sizeof(GPUMaterial) * material_capacity);
+	stats.last_flush_writes = last_flush_writes;
+	return stats;
+}
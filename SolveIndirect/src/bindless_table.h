@@ -0,0 +1,134 @@
+#pragma once
+#include "vk_types.h"
+#include <unordered_map>
+
+struct ResourceManager;
+
+//Bindings of the bindless set
+constexpr uint32_t BINDLESS_TEXTURE_BINDING = 1;
+constexpr uint32_t BINDLESS_MATERIAL_TABLE_BINDING = 3;
+//Sampled images in the set, identical image and sampler pairs share one slot
+constexpr uint32_t BINDLESS_TEXTURE_CAPACITY = 32768;
+//Entries the material table starts with, it doubles when full
+constexpr uint32_t BINDLESS_MATERIAL_INITIAL_CAPACITY = 256;
+//Entries in the material table at most
+constexpr uint32_t BINDLESS_MATERIAL_CAPACITY = 16384;
+//Slot 0 always holds the default texture, materials fall back to it once the set is full
+constexpr uint32_t BINDLESS_DEFAULT_TEXTURE = 0;
+
+//The texture slots of a material in the order the shaders read them
+struct MaterialTextureSlots {
+	uint32_t color = BINDLESS_DEFAULT_TEXTURE;
+	uint32_t metalRough = BINDLESS_DEFAULT_TEXTURE;
+	uint32_t normal = BINDLESS_DEFAULT_TEXTURE;
+	uint32_t occlusion = BINDLESS_DEFAULT_TEXTURE;
+};
+
+//One material table entry, laid out as the Material struct of resource.glsl
+struct GPUMaterial {
+	MaterialTextureSlots textures;
+	glm::vec4 colorFactors{ 1.0f };
+	//x metallic, y roughness
+	glm::vec4 metalRoughFactors{ 1.0f };
+};
+static_assert(sizeof(GPUMaterial) == 48, "GPUMaterial must match the std430 layout of Material");
+static_assert(offsetof(GPUMaterial, colorFactors) == 16 && offsetof(GPUMaterial, metalRoughFactors) == 32, "Material reads the factors at these offsets");
+
+struct BindlessTableStats {
+	uint32_t texture_slots = 0;
+	//acquires sharing those slots
+	uint32_t texture_references = 0;
+	uint32_t materials = 0;
+	//bytes of the material table buffer
+	uint32_t material_table_bytes = 0;
+	//descriptors written by the last flush that had anything to write
+	uint32_t last_flush_writes = 0;
+};
+
+//The bindless texture array and the material table holding each material's constants and slots in it.
+//Slots are refcounted and handed out from a free list, so assets that unload give theirs back, and only slots that
+//were acquired or changed are written on a flush. The set is update after bind, a slot that no frame in flight reads
+//can be written while those frames run
+struct BindlessTable {
+	//layout is the bindless set layout, the pool is sized to hold exactly one such set
+	void Init(ResourceManager* rm, VkDescriptorSetLayout layout, VkImageView defaultView, VkSampler defaultSampler, uint32_t framesInFlight = 2);
+	void Cleanup();
+	//Call once per frame after waiting on that frame's fence, frees the slots replaced framesInFlight or more frames ago
+	void BeginFrame(uint64_t frame);
+
+	//Returns the slot holding the pair, putting it in a free slot the first time it is seen
+	uint32_t AcquireTexture(VkImageView view, VkSampler sampler);
+	//The slot is freed once nothing holds it, only release slots no frame in flight reads anymore
+	void ReleaseTexture(uint32_t slot);
+	//Moves every slot holding oldView to a free slot holding newView and points the materials using it there. The new
+	//slots are written on the next flush and the materials by RecordMaterialWrites, the old slots are freed once the
+	//frames in flight are done with them. Only waits for the queue to idle if the set has no free slot left
+	void ReplaceView(VkImageView oldView, VkImageView newView);
+
+	//Takes one reference to each texture slot, they are released with the material.
+	//Growing the table waits for the queue to idle, the frames in flight read the old buffer
+	uint32_t AllocateMaterial(const GPUMaterial& material);
+	void FreeMaterial(uint32_t material);
+
+	//Writes the slots acquired or changed since the last flush
+	void Flush();
+	//Records the material entries ReplaceView changed into the frame, before anything reads the table.
+	//The frames still in flight keep reading the old entries, which point at slots that stay valid until they finish
+	void RecordMaterialWrites(VkCommandBuffer cmd);
+
+	VkDescriptorSet* GetSet() { return &set; }
+	BindlessTableStats GetStats() const;
+
+private:
+	struct TextureSlot {
+		VkImageView view;
+		VkSampler sampler;
+		uint32_t references;
+	};
+
+	struct TextureKey {
+		VkImageView view;
+		VkSampler sampler;
+		bool operator==(const TextureKey& other) const { return view == other.view && sampler == other.sampler; }
+	};
+
+	struct TextureKeyHash {
+		size_t operator()(const TextureKey& key) const;
+	};
+
+	struct RetiredSlot {
+		uint32_t slot;
+		uint64_t retireFrame;
+	};
+
+	//A free slot, or none once the set is full
+	std::optional<uint32_t> TakeFreeSlot();
+
+	ResourceManager* resource_manager = nullptr;
+	VkDescriptorPool pool = VK_NULL_HANDLE;
+	VkDescriptorSet set = VK_NULL_HANDLE;
+
+	std::vector<TextureSlot> texture_slots;
+	std::vector<uint32_t> free_texture_slots;
+	std::unordered_map<TextureKey, uint32_t, TextureKeyHash> texture_lookup;
+	std::vector<uint32_t> dirty_texture_slots;
+	//replaced slots that frames in flight may still sample, in frame order
+	std::vector<RetiredSlot> retired_texture_slots;
+	uint64_t current_frame = 0;
+	uint32_t frames_in_flight = 2;
+
+	void GrowMaterialTable();
+	void WriteMaterialTable();
+
+	//host visible and written in place, a material entry is only rewritten once no frame reads it
+	AllocatedBuffer material_table;
+	uint32_t material_capacity = 0;
+	std::vector<GPUMaterial> materials;
+	std::vector<uint32_t> free_materials;
+	//entries whose texture slots changed since the last RecordMaterialWrites
+	std::vector<uint32_t> dirty_materials;
+
+	uint32_t texture_references = 0;
+	uint32_t last_flush_writes = 0;
+	bool is_initialized = false;
+};
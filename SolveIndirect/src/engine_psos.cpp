@@ -2,11 +2,13 @@
 #include "vk_pipelines.h"
 #include "vk_engine.h"
 #include "vk_initializers.h"
+#include "profiling.h"
 #include "vk_images.h"
 #include <ktx.h>
 
 void ShadowPipelineResources::build_pipelines(VulkanEngine* engine, PipelineCreationInfo& info)
 {
+	TRACE_SCOPE("ShadowPipelineResources::build_pipelines");
 	VkShaderModule shadowVertexShader;
 	if (!vkutil::load_shader_module("shaders/cascaded_shadows.vert.spv", engine->_device, &shadowVertexShader)) {
 		fmt::print("Error when building the shadow vertex shader module\n");
@@ -54,11 +56,11 @@ void ShadowPipelineResources::build_pipelines(VulkanEngine* engine, PipelineCrea
 
 	pipelineBuilder._pipelineLayout = newLayout;
 
-	shadowPipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
+	info.batch->add_graphics("cascaded shadows", pipelineBuilder, &shadowPipeline.pipeline);
 
-	vkDestroyShaderModule(engine->_device, shadowVertexShader, nullptr);
-	vkDestroyShaderModule(engine->_device, shadowFragmentShader, nullptr);
-	vkDestroyShaderModule(engine->_device, shadowGeometryShader, nullptr);
+	info.batch->add_shader_module(shadowVertexShader);
+	info.batch->add_shader_module(shadowFragmentShader);
+	info.batch->add_shader_module(shadowGeometryShader);
 }
 
 ShadowPipelineResources::MaterialResources ShadowPipelineResources::AllocateResources(VulkanEngine* engine)
@@ -94,6 +96,7 @@ void ShadowPipelineResources::clear_resources(VkDevice device)
 
 void SkyBoxPipelineResources::build_pipelines(VulkanEngine* engine, PipelineCreationInfo& info)
 {
+	TRACE_SCOPE("SkyBoxPipelineResources::build_pipelines");
 	VkShaderModule skyVertexShader;
 	if (!vkutil::load_shader_module("shaders/skybox.vert.spv", engine->_device, &skyVertexShader)) {
 		fmt::print("Error when building the shadow vertex shader module\n");
@@ -133,10 +136,10 @@ void SkyBoxPipelineResources::build_pipelines(VulkanEngine* engine, PipelineCrea
 	pipelineBuilder.set_color_attachment_format(info.imageFormat);
 	pipelineBuilder.set_depth_format(info.depthFormat);
 
-	skyPipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
+	info.batch->add_graphics("skybox", pipelineBuilder, &skyPipeline.pipeline);
 
-	vkDestroyShaderModule(engine->_device, skyVertexShader, nullptr);
-	vkDestroyShaderModule(engine->_device, skyFragmentShader, nullptr);
+	info.batch->add_shader_module(skyVertexShader);
+	info.batch->add_shader_module(skyFragmentShader);
 }
 
 void SkyBoxPipelineResources::clear_resources(VkDevice device)
@@ -156,6 +159,7 @@ MaterialInstance SkyBoxPipelineResources::write_material(VkDevice device, vkutil
 
 void BloomBlurPipelineObject::build_pipelines(VulkanEngine* engine, PipelineCreationInfo& info)
 {
+	TRACE_SCOPE("BloomBlurPipelineObject::build_pipelines");
 
 }
 
@@ -173,6 +177,7 @@ MaterialInstance BloomBlurPipelineObject::write_material(VkDevice device, vkutil
 
 void RenderImagePipelineObject::build_pipelines(VulkanEngine* engine, PipelineCreationInfo& info)
 {
+	TRACE_SCOPE("RenderImagePipelineObject::build_pipelines");
 	VkShaderModule HDRVertexShader;
 	if (!vkutil::load_shader_module("shaders/hdr.vert.spv", engine->_device, &HDRVertexShader)) {
 		fmt::print("Error when building the shadow vertex shader module\n");
@@ -211,10 +216,10 @@ void RenderImagePipelineObject::build_pipelines(VulkanEngine* engine, PipelineCr
 
 	pipelineBuilder.set_color_attachment_format(info.imageFormat);
 
-	renderImagePipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
+	info.batch->add_graphics("hdr", pipelineBuilder, &renderImagePipeline.pipeline);
 
-	vkDestroyShaderModule(engine->_device, HDRVertexShader, nullptr);
-	vkDestroyShaderModule(engine->_device, HDRFragmentShader, nullptr);
+	info.batch->add_shader_module(HDRVertexShader);
+	info.batch->add_shader_module(HDRFragmentShader);
 
 }
 
@@ -229,6 +234,7 @@ void RenderImagePipelineObject::clear_resources(VkDevice device)
 
 void EarlyDepthPipelineObject::build_pipelines(VulkanEngine* engine, PipelineCreationInfo& info)
 {
+	TRACE_SCOPE("EarlyDepthPipelineObject::build_pipelines");
 	VkShaderModule depthVertexShader;
 	if (!vkutil::load_shader_module("shaders/depth_pass.vert.spv", engine->_device, &depthVertexShader)) {
 		fmt::print("Error when building the shadow vertex shader module\n");
@@ -270,10 +276,10 @@ void EarlyDepthPipelineObject::build_pipelines(VulkanEngine* engine, PipelineCre
 
 	pipelineBuilder._pipelineLayout = newLayout;
 
-	earlyDepthPipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
+	info.batch->add_graphics("early depth", pipelineBuilder, &earlyDepthPipeline.pipeline);
 
-	vkDestroyShaderModule(engine->_device, depthVertexShader, nullptr);
-	vkDestroyShaderModule(engine->_device, depthFragmentShader, nullptr);
+	info.batch->add_shader_module(depthVertexShader);
+	info.batch->add_shader_module(depthFragmentShader);
 }
 
 void EarlyDepthPipelineObject::clear_resources(VkDevice device)
@@ -45,10 +45,7 @@ namespace BlackKey{
 		VkSemaphore _swapchainSemaphore, _renderSemaphore;
 		VkFence _renderFence;
 
-		DeletionQueue _deletionQueue;
 		DescriptorAllocatorGrowable _frameDescriptors;
-
-		DescriptorAllocator bindless_material_descriptor;
 	};
 
 }
@@ -0,0 +1,125 @@
+#include "frame_arena.h"
+#include "profiling.h"
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> heap_allocations{ 0 };
+
+uint64_t GetHeapAllocationCount()
+{
+	return heap_allocations.load(std::memory_order_relaxed);
+}
+
+//The array, nothrow and sized forms of the default operators forward to these four, replacing them counts all of them
+void* operator new(size_t size)
+{
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1))
+	{
+		TracyAlloc(p, size);
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void* operator new(size_t size, std::align_val_t alignment)
+{
+	heap_allocations.fetch_add(1, std::memory_order_relaxed);
+	const size_t align = static_cast<size_t>(alignment);
+#ifdef _MSC_VER
+	void* p = _aligned_malloc(size ? size : 1, align);
+#else
+	void* p = std::aligned_alloc(align, ((size ? size : 1) + align - 1) & ~(align - 1));
+#endif
+	if (p)
+	{
+		TracyAlloc(p, size);
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+	TracyFree(p);
+	std::free(p);
+}
+
+void operator delete(void* p, std::align_val_t) noexcept
+{
+	TracyFree(p);
+#ifdef _MSC_VER
+	_aligned_free(p);
+#else
+	std::free(p);
+#endif
+}
+
+void FrameArena::Init(size_t initialCapacity)
+{
+	capacity = initialCapacity;
+	block = std::make_unique<std::byte[]>(capacity);
+	head = 0;
+}
+
+void FrameArena::Cleanup()
+{
+	ReleaseOverflows();
+	block.reset();
+	capacity = 0;
+	head = 0;
+}
+
+void FrameArena::Reset()
+{
+	last_used = frame_used;
+	last_overflows = static_cast<uint32_t>(overflows.size());
+	ReleaseOverflows();
+
+	//sized for the frame that overflowed with some room to spare, so a slightly busier one doesn't overflow again
+	if (last_overflows > 0)
+	{
+		capacity = std::max(capacity * 2, last_used + last_used / 2);
+		block = std::make_unique<std::byte[]>(capacity);
+	}
+	head = 0;
+	frame_used = 0;
+}
+
+void* FrameArena::do_allocate(size_t bytes, size_t alignment)
+{
+	frame_used += bytes;
+	peak_used = std::max(peak_used, frame_used);
+
+	//aligned by address, the block itself is only aligned for the fundamental types
+	const uintptr_t base = reinterpret_cast<uintptr_t>(block.get());
+	const size_t start = ((base + head + alignment - 1) & ~uintptr_t(alignment - 1)) - base;
+	if (start + bytes <= capacity)
+	{
+		head = start + bytes;
+		return block.get() + start;
+	}
+
+	void* data = std::pmr::new_delete_resource()->allocate(bytes, alignment);
+	overflows.push_back(Overflow{ data, bytes, alignment });
+	return data;
+}
+
+void FrameArena::ReleaseOverflows()
+{
+	for (const Overflow& overflow : overflows)
+		std::pmr::new_delete_resource()->deallocate(overflow.data, overflow.bytes, overflow.alignment);
+	overflows.clear();
+}
+
+FrameArenaStats FrameArena::GetStats() const
+{
+	FrameArenaStats stats;
+	stats.capacity = static_cast<uint32_t>(capacity);
+	stats.frame_used = static_cast<uint32_t>(last_used);
+	stats.peak_used = static_cast<uint32_t>(peak_used);
+	stats.overflow_allocations = last_overflows;
+	return stats;
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+#include <vector>
+
+//Bytes the arena starts with, it grows to the busiest frame's worth once a frame overflows it
+constexpr size_t FRAME_ARENA_DEFAULT_CAPACITY = 1024 * 1024;
+
+//Allocations made through the global operator new since startup from any thread, including the libraries linked in.
+//Counted in frame_arena.cpp, which replaces the global operator new and delete and reports them to Tracy when it is on
+uint64_t GetHeapAllocationCount();
+
+struct FrameArenaStats {
+	uint32_t capacity = 0;
+	//bytes the last frame took and the most any frame has
+	uint32_t frame_used = 0;
+	uint32_t peak_used = 0;
+	//allocations the last frame made that didn't fit and went to the heap
+	uint32_t overflow_allocations = 0;
+};
+
+//Bump allocator for CPU data that only lives while a frame is recorded, handed to std::pmr containers.
+//Deallocating does nothing, everything is released at once by Reset. A frame that runs out of room takes the rest from the
+//heap, and the next reset grows the block to cover it, so once the arena has seen the busiest frame it never allocates
+struct FrameArena : std::pmr::memory_resource {
+	void Init(size_t capacity = FRAME_ARENA_DEFAULT_CAPACITY);
+	void Cleanup();
+
+	//Call once per frame before anything is allocated from the arena, every container still using it must be rebuilt
+	void Reset();
+
+	FrameArenaStats GetStats() const;
+
+private:
+	void* do_allocate(size_t bytes, size_t alignment) override;
+	void do_deallocate(void* p, size_t bytes, size_t alignment) override {}
+	bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override { return this == &other; }
+
+	struct Overflow {
+		void* data;
+		size_t bytes;
+		size_t alignment;
+	};
+
+	void ReleaseOverflows();
+
+	std::unique_ptr<std::byte[]> block;
+	size_t capacity = 0;
+	size_t head = 0;
+	//bytes asked for this frame, overflows included
+	size_t frame_used = 0;
+	size_t last_used = 0;
+	size_t peak_used = 0;
+	std::vector<Overflow> overflows;
+	uint32_t last_overflows = 0;
+};
@@ -0,0 +1,114 @@
+#include "frame_capture.h"
+#include <cstring>
+
+//"SICP" read as a little endian uint32_t
+constexpr uint32_t CAPTURE_MAGIC = 0x50434953;
+//bumped whenever CapturedFrame or CapturedLightChange change layout
+constexpr uint32_t CAPTURE_VERSION = 1;
+
+struct CaptureHeader {
+	uint32_t magic = CAPTURE_MAGIC;
+	uint32_t version = CAPTURE_VERSION;
+	uint32_t frame_size = sizeof(CapturedFrame);
+	uint32_t light_size = sizeof(PointLight);
+};
+
+bool FrameCaptureWriter::Open(std::string_view path)
+{
+	Close();
+	file.open(std::string(path), std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		fmt::println("Failed to open the capture {}", path);
+		return false;
+	}
+
+	const CaptureHeader header;
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	last_lights.clear();
+	frames = 0;
+	return true;
+}
+
+void FrameCaptureWriter::Write(CapturedFrame frame, const std::vector<PointLight>& pointLights)
+{
+	if (!file.is_open())
+		return;
+
+	changes.clear();
+	for (uint32_t i = 0; i < pointLights.size(); i++)
+	{
+		//PointLight has no padding the compiler adds, its bytes are its values
+		if (i < last_lights.size() && memcmp(&last_lights[i], &pointLights[i], sizeof(PointLight)) == 0)
+			continue;
+		changes.push_back(CapturedLightChange{ .index = i, .light = pointLights[i] });
+	}
+	last_lights = pointLights;
+
+	frame.light_count = static_cast<uint32_t>(pointLights.size());
+	frame.light_changes = static_cast<uint32_t>(changes.size());
+	file.write(reinterpret_cast<const char*>(&frame), sizeof(frame));
+	for (const CapturedLightChange& change : changes)
+	{
+		file.write(reinterpret_cast<const char*>(&change.index), sizeof(change.index));
+		file.write(reinterpret_cast<const char*>(&change.light), sizeof(change.light));
+	}
+	frames++;
+}
+
+void FrameCaptureWriter::Close()
+{
+	if (!file.is_open())
+		return;
+	file.close();
+	fmt::println("Captured {} frames", frames);
+}
+
+bool FrameCapture::Load(std::string_view path)
+{
+	std::ifstream file(std::string(path), std::ios::binary);
+	if (!file.is_open())
+	{
+		fmt::println("No capture at {}", path);
+		return false;
+	}
+
+	CaptureHeader header;
+	const CaptureHeader expected;
+	if (!file.read(reinterpret_cast<char*>(&header), sizeof(header)) || memcmp(&header, &expected, sizeof(header)) != 0)
+	{
+		fmt::println("{} isn't a capture this build can read", path);
+		return false;
+	}
+
+	frames.clear();
+	light_changes.clear();
+	first_light_change.clear();
+	CapturedFrame frame;
+	while (file.read(reinterpret_cast<char*>(&frame), sizeof(frame)))
+	{
+		first_light_change.push_back(static_cast<uint32_t>(light_changes.size()));
+		for (uint32_t i = 0; i < frame.light_changes; i++)
+		{
+			CapturedLightChange change;
+			file.read(reinterpret_cast<char*>(&change.index), sizeof(change.index));
+			file.read(reinterpret_cast<char*>(&change.light), sizeof(change.light));
+			if (!file || change.index >= frame.light_count)
+			{
+				fmt::println("Capture {} is cut short after {} frames", path, frames.size());
+				return false;
+			}
+			light_changes.push_back(change);
+		}
+		frames.push_back(frame);
+	}
+	return !frames.empty();
+}
+
+void FrameCapture::ApplyLightChanges(uint32_t frame, std::vector<PointLight>& pointLights) const
+{
+	pointLights.resize(frames[frame].light_count);
+	const uint32_t first = first_light_change[frame];
+	for (uint32_t i = first; i < first + frames[frame].light_changes; i++)
+		pointLights[light_changes[i].index] = light_changes[i].light;
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include "vk_types.h"
+#include "Lights.h"
+#include <fstream>
+#include <type_traits>
+
+//Flags of the debug views a captured frame was drawn with
+enum CaptureFlags : uint32_t {
+	CAPTURE_DEBUG_SHADOW_MAP = 1 << 0,
+};
+
+//Scene state the user drove a frame with, written as it is to the capture file.
+//Renderer settings aren't part of it, a capture is replayed against whichever settings are being compared
+struct CapturedFrame {
+	glm::vec3 camera_position{ 0.0f };
+	glm::vec3 camera_rotation{ 0.0f };
+	glm::vec4 light_direction{ 0.0f };
+	glm::vec4 light_color{ 0.0f };
+	uint32_t flags = 0;
+	uint32_t light_count = 0;
+	//point lights changed since the previous frame, they follow the frame in the file
+	uint32_t light_changes = 0;
+};
+static_assert(std::is_trivially_copyable_v<CapturedFrame>, "CapturedFrame is written to the capture file as it is");
+
+//A point light a frame changed, every light counts as changed in the first frame
+struct CapturedLightChange {
+	uint32_t index = 0;
+	PointLight light;
+};
+
+//Writes one CapturedFrame per frame after a small header, point lights are compared against the last frame written
+//so a capture of a few minutes stays a few megabytes
+struct FrameCaptureWriter {
+	~FrameCaptureWriter() { Close(); }
+
+	bool Open(std::string_view path);
+	void Write(CapturedFrame frame, const std::vector<PointLight>& pointLights);
+	void Close();
+
+	bool IsOpen() const { return file.is_open(); }
+	uint32_t GetFrameCount() const { return frames; }
+
+private:
+	std::ofstream file;
+	std::vector<PointLight> last_lights;
+	std::vector<CapturedLightChange> changes;
+	uint32_t frames = 0;
+};
+
+//A capture read back whole, frames are played in order so every light change before a frame has been applied
+struct FrameCapture {
+	//Returns false if the file is missing, isn't a capture of this version or is cut short
+	bool Load(std::string_view path);
+
+	uint32_t GetFrameCount() const { return static_cast<uint32_t>(frames.size()); }
+	const CapturedFrame& GetFrame(uint32_t frame) const { return frames[frame]; }
+	//Resizes the lights to the frame's count and overwrites the ones it changed
+	void ApplyLightChanges(uint32_t frame, std::vector<PointLight>& pointLights) const;
+
+private:
+	std::vector<CapturedFrame> frames;
+	std::vector<CapturedLightChange> light_changes;
+	//index of each frame's first change in light_changes
+	std::vector<uint32_t> first_light_change;
+};
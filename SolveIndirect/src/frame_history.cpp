@@ -0,0 +1,201 @@
+#include "frame_history.h"
+#include "frame_arena.h"
+#include "memory_budget.h"
+#include "vk_descriptors.h"
+#include <algorithm>
+#include <fstream>
+
+void FrameHistory::Init()
+{
+	samples.resize(FRAME_HISTORY_SIZE);
+	hitches.resize(FRAME_HISTORY_MAX_HITCHES);
+	scratch.resize(FRAME_HISTORY_SIZE);
+	Reset();
+}
+
+void FrameHistory::Reset()
+{
+	recorded = 0;
+	hitch_total = 0;
+}
+
+void FrameHistory::BeginFrame(uint64_t frame)
+{
+	current = FrameSample{ .frame = frame };
+	frame_start = phase_start = std::chrono::steady_clock::now();
+	heap_start = GetHeapAllocationCount();
+	device_start = GetDeviceMemoryAllocationCount();
+	descriptor_pool_start = GetDescriptorPoolCreationCount();
+}
+
+void FrameHistory::BeginPhase(const char* name)
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (current.phase_count > 0)
+		current.phases[current.phase_count - 1].ms += std::chrono::duration<float, std::milli>(now - phase_start).count();
+	if (current.phase_count < FRAME_HISTORY_MAX_PHASES)
+		current.phases[current.phase_count++] = CpuPhaseTiming{ .name = name };
+	phase_start = now;
+}
+
+void FrameHistory::EndFrame()
+{
+	const auto now = std::chrono::steady_clock::now();
+	if (current.phase_count > 0)
+		current.phases[current.phase_count - 1].ms += std::chrono::duration<float, std::milli>(now - phase_start).count();
+	current.cpu_ms = std::chrono::duration<float, std::milli>(now - frame_start).count();
+	current.heap_allocations = static_cast<uint32_t>(GetHeapAllocationCount() - heap_start);
+	current.device_allocations = static_cast<uint32_t>(GetDeviceMemoryAllocationCount() - device_start);
+	current.descriptor_pools = static_cast<uint32_t>(GetDescriptorPoolCreationCount() - descriptor_pool_start);
+	current.device_bytes = GetDeviceMemoryAllocatedBytes();
+
+	//the median is taken before the frame joins the history, a long hitch doesn't raise its own threshold
+	if (current.cpu_ms > budget_ms)
+	{
+		const float threshold = HitchThreshold([](const FrameSample& sample) { return sample.cpu_ms; });
+		if (current.cpu_ms > threshold)
+			AddHitch(current, threshold, false);
+	}
+
+	samples[recorded % FRAME_HISTORY_SIZE] = current;
+	recorded++;
+}
+
+void FrameHistory::AddGpuFrame(uint64_t frame, float gpu_ms, const std::vector<GpuScopeTiming>& scopes)
+{
+	FrameSample* sample = FindFrame(frame);
+	if (sample == nullptr || sample->gpu_ms >= 0.0f)
+		return;
+
+	FrameHitch* hitch = nullptr;
+	for (uint32_t i = 0; i < GetKeptHitchCount(); i++)
+	{
+		if (hitches[i].sample.frame == frame)
+			hitch = &hitches[i];
+	}
+	if (hitch == nullptr && gpu_ms > budget_ms)
+	{
+		const float threshold = HitchThreshold([](const FrameSample& sample) { return sample.gpu_ms; });
+		if (gpu_ms > threshold)
+			hitch = &AddHitch(*sample, threshold, true);
+	}
+
+	sample->gpu_ms = gpu_ms;
+	if (hitch == nullptr)
+		return;
+	hitch->sample.gpu_ms = gpu_ms;
+	hitch->gpu_scope_count = static_cast<uint32_t>(std::min<size_t>(scopes.size(), GPU_PROFILER_MAX_SCOPES));
+	std::copy_n(scopes.begin(), hitch->gpu_scope_count, hitch->gpu_scopes.begin());
+}
+
+template<typename Select>
+float FrameHistory::HitchThreshold(Select select)
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < GetFrameCount(); i++)
+	{
+		const float value = select(samples[i]);
+		if (value >= 0.0f)
+			scratch[count++] = value;
+	}
+	if (count == 0)
+		return budget_ms;
+
+	auto median = scratch.begin() + count / 2;
+	std::nth_element(scratch.begin(), median, scratch.begin() + count);
+	return std::max(budget_ms, FRAME_HISTORY_HITCH_FACTOR * *median);
+}
+
+FrameSample* FrameHistory::FindFrame(uint64_t frame)
+{
+	//the frame asked for is nearly always one of the last few
+	for (uint32_t i = 1; i <= GetFrameCount(); i++)
+	{
+		FrameSample& sample = samples[(recorded - i) % FRAME_HISTORY_SIZE];
+		if (sample.frame == frame)
+			return &sample;
+		if (sample.frame < frame)
+			break;
+	}
+	return nullptr;
+}
+
+FrameHitch& FrameHistory::AddHitch(const FrameSample& sample, float threshold_ms, bool gpu)
+{
+	FrameHitch& hitch = hitches[hitch_total % FRAME_HISTORY_MAX_HITCHES];
+	hitch = FrameHitch{ .sample = sample, .threshold_ms = threshold_ms, .gpu = gpu };
+	hitch_total++;
+	return hitch;
+}
+
+const FrameHitch& FrameHistory::GetHitch(uint32_t index) const
+{
+	const uint64_t oldest = hitch_total > FRAME_HISTORY_MAX_HITCHES ? hitch_total % FRAME_HISTORY_MAX_HITCHES : 0;
+	return hitches[(oldest + index) % FRAME_HISTORY_MAX_HITCHES];
+}
+
+BenchmarkSummary FrameHistory::GetCpuSummary()
+{
+	const uint32_t count = GetFrameCount();
+	for (uint32_t i = 0; i < count; i++)
+		scratch[i] = samples[i].cpu_ms;
+	return SummarizeInPlace(std::span(scratch.data(), count));
+}
+
+BenchmarkSummary FrameHistory::GetGpuSummary()
+{
+	uint32_t count = 0;
+	for (uint32_t i = 0; i < GetFrameCount(); i++)
+	{
+		if (samples[i].gpu_ms >= 0.0f)
+			scratch[count++] = samples[i].gpu_ms;
+	}
+	return SummarizeInPlace(std::span(scratch.data(), count));
+}
+
+static std::string json_sample(const FrameSample& sample)
+{
+	std::string json = fmt::format("\"frame\": {}, \"cpu_ms\": {:.4f}, \"gpu_ms\": {:.4f}, \"heap_allocations\": {}, \"device_allocations\": {}, "
+		"\"descriptor_pools\": {}, \"device_bytes\": {}, \"phases\": {{", sample.frame, sample.cpu_ms, sample.gpu_ms, sample.heap_allocations,
+		sample.device_allocations, sample.descriptor_pools, sample.device_bytes);
+	for (uint32_t i = 0; i < sample.phase_count; i++)
+		json += fmt::format("{}{}: {:.4f}", i == 0 ? " " : ", ", JsonString(sample.phases[i].name), sample.phases[i].ms);
+	return json + " }";
+}
+
+bool FrameHistory::Dump(std::string_view path)
+{
+	std::string json = "{\n";
+	json += fmt::format("\t\"budget_ms\": {:.4f},\n\t\"frames\": {},\n\t\"hitches\": {},\n", budget_ms, GetFrameCount(), hitch_total);
+	json += fmt::format("\t\"cpu_ms\": {},\n", JsonSummary(GetCpuSummary()));
+	json += fmt::format("\t\"gpu_ms\": {},\n", JsonSummary(GetGpuSummary()));
+
+	json += "\t\"hitch_records\": [";
+	for (uint32_t i = 0; i < GetKeptHitchCount(); i++)
+	{
+		const FrameHitch& hitch = GetHitch(i);
+		json += fmt::format("{}\n\t\t{{ {}, \"threshold_ms\": {:.4f}, \"over\": \"{}\", \"gpu_passes\": {{", i == 0 ? "" : ",", json_sample(hitch.sample),
+			hitch.threshold_ms, hitch.gpu ? "gpu" : "cpu");
+		for (uint32_t s = 0; s < hitch.gpu_scope_count; s++)
+			json += fmt::format("{}{}: {:.4f}", s == 0 ? " " : ", ", JsonString(hitch.gpu_scopes[s].name), hitch.gpu_scopes[s].last_ms);
+		json += " } }";
+	}
+	json += "\n\t],\n";
+
+	//oldest first
+	json += "\t\"frame_records\": [";
+	const uint32_t count = GetFrameCount();
+	for (uint32_t i = 0; i < count; i++)
+		json += fmt::format("{}\n\t\t{{ {} }}", i == 0 ? "" : ",", json_sample(samples[(recorded - count + i) % FRAME_HISTORY_SIZE]));
+	json += "\n\t]\n}\n";
+
+	std::ofstream file{ std::string(path), std::ios::binary | std::ios::trunc };
+	if (!file.is_open())
+	{
+		fmt::println("Failed to open {}", path);
+		return false;
+	}
+	file << json;
+	fmt::println("Frame history of {} frames and {} hitches written to {}", count, GetKeptHitchCount(), path);
+	return file.good();
+}
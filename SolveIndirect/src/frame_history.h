@@ -0,0 +1,102 @@
+#pragma once
+#include "vk_types.h"
+#include "benchmark.h"
+#include <chrono>
+
+//Frames the history keeps, the percentiles are over these
+constexpr uint32_t FRAME_HISTORY_SIZE = 1024;
+//Hitches kept, a new one replaces the oldest
+constexpr uint32_t FRAME_HISTORY_MAX_HITCHES = 64;
+//CPU phases a frame can time, later ones are folded into the last
+constexpr uint32_t FRAME_HISTORY_MAX_PHASES = 8;
+//A frame has to take this many times the recent median as well as go over the budget to be a hitch,
+//so a scene that is steadily slower than the budget doesn't flag every frame
+constexpr float FRAME_HISTORY_HITCH_FACTOR = 2.0f;
+
+struct CpuPhaseTiming {
+	const char* name = nullptr;
+	float ms = 0.0f;
+};
+
+//What one frame cost, the counters are what the frame added to them
+struct FrameSample {
+	uint64_t frame = 0;
+	float cpu_ms = 0.0f;
+	//until the frame's timestamps are read back, FRAME_OVERLAP frames later
+	float gpu_ms = -1.0f;
+	std::array<CpuPhaseTiming, FRAME_HISTORY_MAX_PHASES> phases{};
+	uint32_t phase_count = 0;
+	//global operator new calls, blocks of device memory and descriptor pools
+	uint32_t heap_allocations = 0;
+	uint32_t device_allocations = 0;
+	uint32_t descriptor_pools = 0;
+	//device memory VMA held once the frame ended
+	VkDeviceSize device_bytes = 0;
+};
+
+//A frame that went over the budget, with the GPU passes of the same frame once they arrive
+struct FrameHitch {
+	FrameSample sample;
+	float threshold_ms = 0.0f;
+	//true if the GPU time, not the CPU time, went over
+	bool gpu = false;
+	std::array<GpuScopeTiming, GPU_PROFILER_MAX_SCOPES> gpu_scopes{};
+	uint32_t gpu_scope_count = 0;
+};
+
+//Rolling record of the last frames, for percentiles that stay meaningful while the app runs and for catching the
+//frames that stutter. Everything is allocated by Init, recording a frame never touches the heap, so the history can be on
+//while frames are asserted to be free of heap allocations
+struct FrameHistory {
+	void Init();
+
+	//Starts timing a frame and the counters it is charged for
+	void BeginFrame(uint64_t frame);
+	//Ends the phase before it, if any. name must outlive the history, a string literal
+	void BeginPhase(const char* name);
+	//Ends the last phase, adds the frame and checks it against the budget
+	void EndFrame();
+	//The GPU time of a frame read back by the profiler, dropped if the frame has left the history. Frames over the budget
+	//on the GPU are hitches as well, the CPU ones are given their passes
+	void AddGpuFrame(uint64_t frame, float gpu_ms, const std::vector<GpuScopeTiming>& scopes);
+
+	BenchmarkSummary GetCpuSummary();
+	BenchmarkSummary GetGpuSummary();
+	uint32_t GetFrameCount() const { return uint32_t(std::min<uint64_t>(recorded, FRAME_HISTORY_SIZE)); }
+	//Every hitch since Init, including the ones no longer kept
+	uint64_t GetHitchCount() const { return hitch_total; }
+	//Kept hitches, oldest first, up to FRAME_HISTORY_MAX_HITCHES
+	const FrameHitch& GetHitch(uint32_t index) const;
+	uint32_t GetKeptHitchCount() const { return uint32_t(std::min<uint64_t>(hitch_total, FRAME_HISTORY_MAX_HITCHES)); }
+	//Clears the frames and the hitches, the budget stays
+	void Reset();
+
+	//Writes the summaries, every kept frame and every kept hitch as JSON
+	bool Dump(std::string_view path);
+
+	//CPU or GPU milliseconds a frame may take
+	float budget_ms = 1000.0f / 60.0f;
+
+private:
+	//The budget or FRAME_HISTORY_HITCH_FACTOR times the median of what select takes from the kept frames, whichever is higher.
+	//select returns a negative value for frames it skips
+	template<typename Select>
+	float HitchThreshold(Select select);
+	FrameSample* FindFrame(uint64_t frame);
+	FrameHitch& AddHitch(const FrameSample& sample, float threshold_ms, bool gpu);
+
+	std::vector<FrameSample> samples;
+	//frames added since Init, the next one goes to recorded % FRAME_HISTORY_SIZE
+	uint64_t recorded = 0;
+	std::vector<FrameHitch> hitches;
+	uint64_t hitch_total = 0;
+	//percentiles sort a copy here
+	std::vector<float> scratch;
+
+	FrameSample current;
+	std::chrono::steady_clock::time_point frame_start;
+	std::chrono::steady_clock::time_point phase_start;
+	uint64_t heap_start = 0;
+	uint64_t device_start = 0;
+	uint64_t descriptor_pool_start = 0;
+};
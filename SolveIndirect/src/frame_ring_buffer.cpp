@@ -0,0 +1,74 @@
+#include "frame_ring_buffer.h"
+#include "resource_manager.h"
+#include "vk_engine.h"
+#include <algorithm>
+
+void FrameRingBuffer::Init(ResourceManager* rm, VkDeviceSize frameCapacity, uint32_t framesInFlight)
+{
+	resource_manager = rm;
+	frames_in_flight = framesInFlight;
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(resource_manager->engine->_chosenGPU, &properties);
+	//both are powers of two, the larger one satisfies the other
+	alignment = std::max(properties.limits.minUniformBufferOffsetAlignment, properties.limits.minStorageBufferOffsetAlignment);
+	frame_capacity = (frameCapacity + alignment - 1) & ~(alignment - 1);
+
+	buffer = resource_manager->CreateBuffer(frame_capacity * frames_in_flight, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT,
+		VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::PerFrame, false);
+	region_end = frame_capacity;
+	is_initialized = true;
+}
+
+void FrameRingBuffer::Cleanup()
+{
+	if (!is_initialized)
+		return;
+
+	resource_manager->DestroyBuffer(buffer);
+	is_initialized = false;
+}
+
+void FrameRingBuffer::BeginFrame(uint64_t frameNumber)
+{
+	last_used = head - region_start;
+	region_start = frame_capacity * (frameNumber % frames_in_flight);
+	region_end = region_start + frame_capacity;
+	head = region_start;
+}
+
+FrameAllocation FrameRingBuffer::Allocate(VkDeviceSize size)
+{
+	const VkDeviceSize offset = head;
+	assert(offset + size <= region_end && "frame ring region is full, raise its capacity");
+
+	head = std::min(region_end, (offset + size + alignment - 1) & ~(alignment - 1));
+	peak_used = std::max(peak_used, head - region_start);
+	return FrameAllocation{
+		.data = (uint8_t*)buffer.info.pMappedData + offset,
+		.offset = static_cast<uint32_t>(offset)
+	};
+}
+
+FrameAllocation FrameRingBuffer::Push(const void* data, VkDeviceSize size)
+{
+	FrameAllocation allocation = Allocate(size);
+	memcpy(allocation.data, data, size);
+	return allocation;
+}
+
+void FrameRingBuffer::Flush()
+{
+	//does nothing on host coherent memory, which CPU_TO_GPU isn't guaranteed to get
+	if (head > region_start)
+		VK_CHECK(vmaFlushAllocation(resource_manager->engine->_allocator, buffer.allocation, region_start, head - region_start));
+}
+
+FrameRingStats FrameRingBuffer::GetStats() const
+{
+	FrameRingStats stats;
+	stats.frame_capacity = static_cast<uint32_t>(frame_capacity);
+	stats.frame_used = static_cast<uint32_t>(last_used);
+	stats.peak_used = static_cast<uint32_t>(peak_used);
+	return stats;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "vk_types.h"
+
+struct ResourceManager;
+
+//Bytes each frame in flight can push, the scene and shadow uniforms and the point lights fit many times over
+constexpr VkDeviceSize FRAME_RING_DEFAULT_CAPACITY = 1024 * 1024;
+
+//A range pushed this frame. offset is from the start of the buffer and is what gets passed as the dynamic offset
+struct FrameAllocation {
+	void* data = nullptr;
+	uint32_t offset = 0;
+};
+
+struct FrameRingStats {
+	uint32_t frame_capacity = 0;
+	//bytes the last frame pushed and the most any frame has
+	uint32_t frame_used = 0;
+	uint32_t peak_used = 0;
+};
+
+//One persistently mapped buffer split into a region per frame in flight. Data rewritten every frame is bump allocated
+//from the current frame's region and reached through dynamic offsets, so the descriptors point at the buffer once and a
+//steady frame neither allocates nor maps anything. The descriptors take the buffer at offset 0 with the range of
+//what they read, the offset of each frame's copy is given when the set is bound
+struct FrameRingBuffer {
+	void Init(ResourceManager* rm, VkDeviceSize frameCapacity = FRAME_RING_DEFAULT_CAPACITY, uint32_t framesInFlight = 2);
+	void Cleanup();
+
+	//Call once per frame after waiting on that frame's fence, it resets the region that frame pushed into last time
+	void BeginFrame(uint64_t frameNumber);
+
+	//size bytes aligned for both uniform and storage buffer offsets, the region must have room for them
+	FrameAllocation Allocate(VkDeviceSize size);
+	FrameAllocation Push(const void* data, VkDeviceSize size);
+	//Makes what this frame pushed visible to the device, call after the last push and before the submit
+	void Flush();
+
+	FrameRingStats GetStats() const;
+
+	AllocatedBuffer buffer;
+
+private:
+	ResourceManager* resource_manager = nullptr;
+	VkDeviceSize alignment = 0;
+	VkDeviceSize frame_capacity = 0;
+	uint32_t frames_in_flight = 2;
+	//bump pointer and end of the current frame's region
+	VkDeviceSize head = 0;
+	VkDeviceSize region_end = 0;
+	VkDeviceSize region_start = 0;
+	VkDeviceSize peak_used = 0;
+	VkDeviceSize last_used = 0;
+	bool is_initialized = false;
+};
@@ -0,0 +1,402 @@
+#include "geometry_heap.h"
+#include "resource_manager.h"
+#include "vk_engine.h"
+#include "profiling.h"
+#include <algorithm>
+
+namespace {
+	constexpr VkBufferUsageFlags VERTEX_HEAP_USAGE = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT;
+	constexpr VkBufferUsageFlags INDEX_HEAP_USAGE = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+
+	//halve the capacity while the heap would still be at most half full afterwards,
+	//growing doubles, so a heap hovering around a size doesn't flip between the two
+	uint32_t ShrunkCapacity(uint32_t capacity, uint32_t extent, uint32_t minimum)
+	{
+		while (capacity / 2 >= minimum && extent <= capacity / 4)
+			capacity /= 2;
+		return capacity;
+	}
+
+	uint32_t GrownCapacity(uint32_t capacity, uint32_t extent, uint32_t required)
+	{
+		uint64_t grown = std::max<uint64_t>(uint64_t(capacity) * 2, uint64_t(extent) + required);
+		return static_cast<uint32_t>(std::min<uint64_t>(grown, OffsetAllocator::NO_SPACE - 1));
+	}
+}
+
+void GeometryHeap::Init(ResourceManager* rm, uint32_t vertexCapacity, uint32_t indexCapacity, uint32_t framesInFlight)
+{
+	resource_manager = rm;
+	frames_in_flight = framesInFlight;
+	initial_vertex_capacity = vertexCapacity;
+	initial_index_capacity = indexCapacity;
+
+	vertex_allocator.Init(vertexCapacity);
+	index_allocator.Init(indexCapacity);
+
+	vertexBuffer = CreateHeapBuffer(size_t(vertexCapacity) * sizeof(Vertex), VERTEX_HEAP_USAGE);
+	indexBuffer = CreateHeapBuffer(size_t(indexCapacity) * sizeof(uint32_t), INDEX_HEAP_USAGE);
+
+	VkBufferDeviceAddressInfo deviceAdressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,.buffer = vertexBuffer.buffer };
+	vertexBufferAddress = vkGetBufferDeviceAddress(resource_manager->engine->_device, &deviceAdressInfo);
+
+	is_initialized = true;
+}
+
+void GeometryHeap::Cleanup()
+{
+	if (!is_initialized)
+		return;
+
+	DestroyHeapBuffer(vertexBuffer);
+	DestroyHeapBuffer(indexBuffer);
+	is_initialized = false;
+}
+
+AllocatedBuffer GeometryHeap::CreateHeapBuffer(VkDeviceSize size, VkBufferUsageFlags usage)
+{
+	//the heap reallocates its buffers itself, so the resource manager doesn't own them
+	VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+	bufferInfo.size = size;
+	bufferInfo.usage = usage;
+
+	VmaAllocationCreateInfo vmaallocInfo = {};
+	vmaallocInfo.usage = VMA_MEMORY_USAGE_GPU_ONLY;
+
+	AllocatedBuffer newBuffer;
+	VK_CHECK(vmaCreateBuffer(resource_manager->engine->_allocator, &bufferInfo, &vmaallocInfo, &newBuffer.buffer, &newBuffer.allocation,
+		&newBuffer.info));
+	resource_manager->engine->_memoryBudget.Track(newBuffer.allocation, MemoryCategory::Geometry);
+	return newBuffer;
+}
+
+void GeometryHeap::DestroyHeapBuffer(const AllocatedBuffer& buffer)
+{
+	resource_manager->engine->_memoryBudget.Untrack(buffer.allocation);
+	vmaDestroyBuffer(resource_manager->engine->_allocator, buffer.buffer, buffer.allocation);
+}
+
+bool GeometryHeap::Allocate(uint32_t vertexCount, uint32_t indexWords, GeometryAllocation& allocation)
+{
+	assert(is_initialized);
+
+	const uint32_t vertexUnits = std::max(vertexCount, 1u);
+	const uint32_t indexUnits = std::max(indexWords, 1u);
+
+	OffsetAllocator::Allocation vertices = vertex_allocator.Allocate(vertexUnits);
+	OffsetAllocator::Allocation indices = index_allocator.Allocate(indexUnits);
+
+	if (!vertices.IsValid() || !indices.IsValid()) {
+		vertex_allocator.Free(vertices);
+		index_allocator.Free(indices);
+
+		//the free tail after the used extent is contiguous, so growing it by the request always fits
+		uint32_t vertexCapacity = vertex_allocator.GetSize();
+		uint32_t indexCapacity = index_allocator.GetSize();
+		if (!vertices.IsValid())
+			vertexCapacity = GrownCapacity(vertexCapacity, vertex_allocator.GetUsedExtent(), vertexUnits);
+		if (!indices.IsValid())
+			indexCapacity = GrownCapacity(indexCapacity, index_allocator.GetUsedExtent(), indexUnits);
+
+		resource_manager->engine->immediate_submit([&](VkCommandBuffer cmd) {
+			ReallocateBuffers(cmd, vertexCapacity, indexCapacity);
+			});
+
+		vertices = vertex_allocator.Allocate(vertexUnits);
+		indices = index_allocator.Allocate(indexUnits);
+		if (!vertices.IsValid() || !indices.IsValid()) {
+			vertex_allocator.Free(vertices);
+			index_allocator.Free(indices);
+			return false;
+		}
+	}
+
+	allocation.vertexOffset = vertices.offset;
+	allocation.vertexCount = vertexCount;
+	allocation.vertexNode = vertices.metadata;
+	allocation.indexOffset = indices.offset;
+	allocation.indexWords = indexWords;
+	allocation.indexNode = indices.metadata;
+
+	allocation_count++;
+	return true;
+}
+
+void GeometryHeap::Free(const GeometryAllocation& allocation)
+{
+	if (allocation.vertexNode == OffsetAllocator::NO_SPACE)
+		return;
+
+	pending_frees.push_back(PendingFree{
+		.allocator = &vertex_allocator,
+		.range = { .offset = allocation.vertexOffset, .metadata = allocation.vertexNode },
+		.retireFrame = current_frame + frames_in_flight
+		});
+	pending_frees.push_back(PendingFree{
+		.allocator = &index_allocator,
+		.range = { .offset = allocation.indexOffset, .metadata = allocation.indexNode },
+		.retireFrame = current_frame + frames_in_flight
+		});
+	allocation_count--;
+}
+
+void GeometryHeap::BeginFrame(uint64_t frameNumber)
+{
+	current_frame = frameNumber;
+
+	auto retired = std::partition(pending_frees.begin(), pending_frees.end(), [&](const PendingFree& pending) {
+		return pending.retireFrame > current_frame;
+		});
+	for (auto it = retired; it != pending_frees.end(); it++)
+		it->allocator->Free(it->range);
+	if (retired != pending_frees.end())
+		compaction_pending = true;
+	pending_frees.erase(retired, pending_frees.end());
+}
+
+void GeometryHeap::Track(GPUMeshBuffers* mesh)
+{
+	meshes.push_back(mesh);
+	compaction_pending = true;
+}
+
+void GeometryHeap::Untrack(GPUMeshBuffers* mesh)
+{
+	auto it = std::find(meshes.begin(), meshes.end(), mesh);
+	if (it != meshes.end()) {
+		*it = meshes.back();
+		meshes.pop_back();
+	}
+}
+
+void GeometryHeap::ReallocateBuffers(VkCommandBuffer cmd, uint32_t vertexCapacity, uint32_t indexCapacity)
+{
+	ZoneScoped;
+	const uint32_t vertexExtent = std::min(vertex_allocator.GetUsedExtent(), vertexCapacity);
+	const uint32_t indexExtent = std::min(index_allocator.GetUsedExtent(), indexCapacity);
+
+	//copies into the old buffers from earlier submissions have to land before they are read here
+	VkMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	AllocatedBuffer newVertexBuffer = CreateHeapBuffer(size_t(vertexCapacity) * sizeof(Vertex), VERTEX_HEAP_USAGE);
+	AllocatedBuffer newIndexBuffer = CreateHeapBuffer(size_t(indexCapacity) * sizeof(uint32_t), INDEX_HEAP_USAGE);
+
+	if (vertexExtent > 0) {
+		VkBufferCopy vertexCopy{ .srcOffset = 0, .dstOffset = 0, .size = size_t(vertexExtent) * sizeof(Vertex) };
+		vkCmdCopyBuffer(cmd, vertexBuffer.buffer, newVertexBuffer.buffer, 1, &vertexCopy);
+	}
+	if (indexExtent > 0) {
+		VkBufferCopy indexCopy{ .srcOffset = 0, .dstOffset = 0, .size = size_t(indexExtent) * sizeof(uint32_t) };
+		vkCmdCopyBuffer(cmd, indexBuffer.buffer, newIndexBuffer.buffer, 1, &indexCopy);
+	}
+
+	//frames already submitted keep drawing from the old buffers, the retire queue untracks them like DestroyHeapBuffer
+	resource_manager->retire_queue.Retire(vertexBuffer);
+	resource_manager->retire_queue.Retire(indexBuffer);
+
+	bool resized = vertex_allocator.Resize(vertexCapacity);
+	resized = index_allocator.Resize(indexCapacity) && resized;
+	assert(resized);
+
+	vertexBuffer = newVertexBuffer;
+	indexBuffer = newIndexBuffer;
+	VkBufferDeviceAddressInfo deviceAdressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,.buffer = vertexBuffer.buffer };
+	vertexBufferAddress = vkGetBufferDeviceAddress(resource_manager->engine->_device, &deviceAdressInfo);
+
+	for (GPUMeshBuffers* mesh : meshes) {
+		mesh->vertexBuffer = vertexBuffer;
+		mesh->indexBuffer = indexBuffer;
+		mesh->vertexBufferAddress = vertexBufferAddress;
+	}
+
+	bytes_moved += size_t(vertexExtent) * sizeof(Vertex) + size_t(indexExtent) * sizeof(uint32_t);
+	generation++;
+}
+
+void GeometryHeap::CompactVertices(VkDeviceSize& budget, std::vector<GeometryMove>& moves)
+{
+	compaction_order.assign(meshes.begin(), meshes.end());
+	std::sort(compaction_order.begin(), compaction_order.end(), [](const GPUMeshBuffers* a, const GPUMeshBuffers* b) {
+		return a->allocation.vertexOffset > b->allocation.vertexOffset;
+		});
+
+	//walk down from the end of the heap, each mesh takes the best fitting hole as long as it lies below it.
+	//The first mesh that can't move down ends the pass, whatever is below it can't shrink the extent
+	for (GPUMeshBuffers* mesh : compaction_order) {
+		GeometryAllocation& allocation = mesh->allocation;
+		const VkDeviceSize bytes = size_t(allocation.vertexCount) * sizeof(Vertex);
+		//a mesh bigger than the whole budget still moves, on its own
+		if (bytes > budget && !vertex_regions.empty())
+			break;
+
+		OffsetAllocator::Allocation target = vertex_allocator.Allocate(std::max(allocation.vertexCount, 1u));
+		if (!target.IsValid())
+			break;
+		if (target.offset > allocation.vertexOffset) {
+			vertex_allocator.Free(target);
+			break;
+		}
+
+		if (bytes > 0) {
+			vertex_regions.push_back(VkBufferCopy{
+				.srcOffset = size_t(allocation.vertexOffset) * sizeof(Vertex),
+				.dstOffset = size_t(target.offset) * sizeof(Vertex),
+				.size = bytes
+				});
+		}
+
+		pending_frees.push_back(PendingFree{
+			.allocator = &vertex_allocator,
+			.range = { .offset = allocation.vertexOffset, .metadata = allocation.vertexNode },
+			.retireFrame = current_frame + frames_in_flight
+			});
+
+		moves.push_back(GeometryMove{
+			.mesh = mesh,
+			.vertexDelta = int64_t(target.offset) - int64_t(allocation.vertexOffset),
+			.indexWordDelta = 0
+			});
+
+		allocation.vertexOffset = target.offset;
+		allocation.vertexNode = target.metadata;
+		mesh->firstVertex = target.offset;
+		budget -= std::min(budget, bytes);
+	}
+}
+
+void GeometryHeap::CompactIndices(VkDeviceSize& budget, std::vector<GeometryMove>& moves)
+{
+	compaction_order.assign(meshes.begin(), meshes.end());
+	std::sort(compaction_order.begin(), compaction_order.end(), [](const GPUMeshBuffers* a, const GPUMeshBuffers* b) {
+		return a->allocation.indexOffset > b->allocation.indexOffset;
+		});
+
+	for (GPUMeshBuffers* mesh : compaction_order) {
+		GeometryAllocation& allocation = mesh->allocation;
+		const VkDeviceSize bytes = size_t(allocation.indexWords) * sizeof(uint32_t);
+		if (bytes > budget && !index_regions.empty())
+			break;
+
+		OffsetAllocator::Allocation target = index_allocator.Allocate(std::max(allocation.indexWords, 1u));
+		if (!target.IsValid())
+			break;
+		if (target.offset > allocation.indexOffset) {
+			index_allocator.Free(target);
+			break;
+		}
+
+		if (bytes > 0) {
+			index_regions.push_back(VkBufferCopy{
+				.srcOffset = size_t(allocation.indexOffset) * sizeof(uint32_t),
+				.dstOffset = size_t(target.offset) * sizeof(uint32_t),
+				.size = bytes
+				});
+		}
+
+		pending_frees.push_back(PendingFree{
+			.allocator = &index_allocator,
+			.range = { .offset = allocation.indexOffset, .metadata = allocation.indexNode },
+			.retireFrame = current_frame + frames_in_flight
+			});
+
+		const int64_t delta = int64_t(target.offset) - int64_t(allocation.indexOffset);
+		moves.push_back(GeometryMove{
+			.mesh = mesh,
+			.vertexDelta = 0,
+			.indexWordDelta = delta
+			});
+
+		allocation.indexOffset = target.offset;
+		allocation.indexNode = target.metadata;
+		mesh->firstIndex16 = static_cast<uint32_t>(int64_t(mesh->firstIndex16) + delta * 2);
+		mesh->firstIndex32 = static_cast<uint32_t>(int64_t(mesh->firstIndex32) + delta);
+		budget -= std::min(budget, bytes);
+	}
+}
+
+bool GeometryHeap::TryShrink(VkCommandBuffer cmd)
+{
+	//ranges waiting to retire still count towards the extent, wait for them first
+	if (!pending_frees.empty())
+		return false;
+
+	const uint32_t vertexCapacity = vertex_allocator.GetSize();
+	const uint32_t indexCapacity = index_allocator.GetSize();
+	const uint32_t newVertexCapacity = ShrunkCapacity(vertexCapacity, vertex_allocator.GetUsedExtent(), initial_vertex_capacity);
+	const uint32_t newIndexCapacity = ShrunkCapacity(indexCapacity, index_allocator.GetUsedExtent(), initial_index_capacity);
+
+	if (newVertexCapacity == vertexCapacity && newIndexCapacity == indexCapacity)
+		return false;
+
+	ReallocateBuffers(cmd, newVertexCapacity, newIndexCapacity);
+	return true;
+}
+
+void GeometryHeap::Defragment(VkCommandBuffer cmd, VkDeviceSize byteBudget, std::vector<GeometryMove>& moves)
+{
+	ZoneScoped;
+	//nothing was freed since the last pass that had nothing to do
+	if (!is_initialized || !compaction_pending)
+		return;
+
+	VkDeviceSize budget = byteBudget;
+	vertex_regions.clear();
+	index_regions.clear();
+	CompactVertices(budget, moves);
+	CompactIndices(budget, moves);
+
+	bool copied = false;
+	if (!vertex_regions.empty() || !index_regions.empty()) {
+		//a mesh moved last frame is read from where that frame's copy wrote it
+		VkMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+		//sources are live ranges and destinations were free, so regions never overlap
+		if (!vertex_regions.empty())
+			vkCmdCopyBuffer(cmd, vertexBuffer.buffer, vertexBuffer.buffer, static_cast<uint32_t>(vertex_regions.size()), vertex_regions.data());
+		if (!index_regions.empty())
+			vkCmdCopyBuffer(cmd, indexBuffer.buffer, indexBuffer.buffer, static_cast<uint32_t>(index_regions.size()), index_regions.data());
+
+		bytes_moved += byteBudget - budget;
+		copied = true;
+	}
+	else {
+		copied = TryShrink(cmd);
+	}
+	//the ranges this pass moved out of set it again once they retire
+	if (!copied)
+		compaction_pending = false;
+
+	if (copied) {
+		VkMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+		barrier.dstAccessMask = VK_ACCESS_INDEX_READ_BIT | VK_ACCESS_SHADER_READ_BIT;
+		vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT,
+			0, 1, &barrier, 0, nullptr, 0, nullptr);
+	}
+}
+
+GeometryHeapStats GeometryHeap::GetStats() const
+{
+	OffsetAllocator::StorageReport vertexReport = vertex_allocator.GetStorageReport();
+	OffsetAllocator::StorageReport indexReport = index_allocator.GetStorageReport();
+
+	GeometryHeapStats stats;
+	stats.vertex_capacity = vertex_allocator.GetSize();
+	stats.vertices_used = stats.vertex_capacity - vertexReport.totalFreeSpace;
+	stats.vertex_extent = vertex_allocator.GetUsedExtent();
+	stats.largest_free_vertex_range = vertexReport.largestFreeRegion;
+	stats.index_capacity = index_allocator.GetSize();
+	stats.index_words_used = stats.index_capacity - indexReport.totalFreeSpace;
+	stats.index_extent = index_allocator.GetUsedExtent();
+	stats.largest_free_index_range = indexReport.largestFreeRegion;
+	stats.allocation_count = allocation_count;
+	stats.pending_frees = static_cast<uint32_t>(pending_frees.size());
+	stats.bytes_moved = bytes_moved;
+	return stats;
+}
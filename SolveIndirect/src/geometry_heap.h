@@ -0,0 +1,105 @@
+#pragma once
+#include "vk_types.h"
+#include "offset_allocator.h"
+
+struct ResourceManager;
+
+//Starting heap sizes, 256K vertices (16 MB) and 1M index words (4 MB). The heaps double when full
+//and shrink back once compaction leaves most of them unused
+constexpr uint32_t GEOMETRY_HEAP_INITIAL_VERTICES = 256 * 1024;
+constexpr uint32_t GEOMETRY_HEAP_INITIAL_INDEX_WORDS = 1024 * 1024;
+//How much geometry the defragmenter may copy per frame
+constexpr VkDeviceSize GEOMETRY_DEFRAG_BYTES_PER_FRAME = 4 * 1024 * 1024;
+
+struct GeometryHeapStats {
+	uint32_t vertex_capacity = 0;
+	uint32_t vertices_used = 0;
+	uint32_t vertex_extent = 0;
+	uint32_t largest_free_vertex_range = 0;
+	uint32_t index_capacity = 0;
+	uint32_t index_words_used = 0;
+	uint32_t index_extent = 0;
+	uint32_t largest_free_index_range = 0;
+	uint32_t allocation_count = 0;
+	uint32_t pending_frees = 0;
+	uint64_t bytes_moved = 0;
+};
+
+//A mesh whose ranges were moved by the defragmenter. Index deltas are in words,
+//so 16 bit surfaces move by twice as many indices as 32 bit ones
+struct GeometryMove {
+	GPUMeshBuffers* mesh;
+	int64_t vertexDelta;
+	int64_t indexWordDelta;
+};
+
+//One vertex and one index buffer shared by every mesh. Meshes upload straight into a slot handed out
+//by an offset allocator, so the indirect passes bind a single pair of buffers and loading or unloading
+//a glTF never has to rebuild or copy the rest of the geometry.
+//Index space is counted in 32 bit words so 16 and 32 bit index ranges can live side by side and both be
+//bound at offset 0, a 16 bit range starting at word w starts at index 2 * w
+struct GeometryHeap {
+	void Init(ResourceManager* rm, uint32_t vertexCapacity = GEOMETRY_HEAP_INITIAL_VERTICES, uint32_t indexCapacity = GEOMETRY_HEAP_INITIAL_INDEX_WORDS, uint32_t framesInFlight = 2);
+	void Cleanup();
+
+	//Grows the heap if needed, returns false only if the buffers can't be grown any further
+	bool Allocate(uint32_t vertexCount, uint32_t indexWords, GeometryAllocation& allocation);
+	//The range is only handed out again once every frame that could still be reading it has retired
+	void Free(const GeometryAllocation& allocation);
+	//Call once per frame after waiting on that frame's fence
+	void BeginFrame(uint64_t frameNumber);
+
+	//Meshes the defragmenter is allowed to move, their offsets and buffer handles are patched in place
+	void Track(GPUMeshBuffers* mesh);
+	void Untrack(GPUMeshBuffers* mesh);
+
+	//Moves the meshes at the end of each heap into holes further down, up to byteBudget of copies.
+	//Once nothing more can move and the heap is mostly empty the buffers are shrunk. Does nothing until a range
+	//is freed after a pass that found nothing to do. Must be recorded before anything in the frame reads the geometry
+	void Defragment(VkCommandBuffer cmd, VkDeviceSize byteBudget, std::vector<GeometryMove>& moves);
+
+	GeometryHeapStats GetStats() const;
+	//Changes whenever the buffers are reallocated and every handle or address taken from them is stale
+	uint32_t GetGeneration() const { return generation; }
+
+	AllocatedBuffer vertexBuffer;
+	AllocatedBuffer indexBuffer;
+	VkDeviceAddress vertexBufferAddress = 0;
+
+private:
+	struct PendingFree {
+		OffsetAllocator* allocator;
+		OffsetAllocator::Allocation range;
+		uint64_t retireFrame;
+	};
+
+	AllocatedBuffer CreateHeapBuffer(VkDeviceSize size, VkBufferUsageFlags usage);
+	void DestroyHeapBuffer(const AllocatedBuffer& buffer);
+	//Moves the used part of both heaps into buffers of the new size
+	void ReallocateBuffers(VkCommandBuffer cmd, uint32_t vertexCapacity, uint32_t indexCapacity);
+	void CompactVertices(VkDeviceSize& budget, std::vector<GeometryMove>& moves);
+	void CompactIndices(VkDeviceSize& budget, std::vector<GeometryMove>& moves);
+	bool TryShrink(VkCommandBuffer cmd);
+
+	ResourceManager* resource_manager = nullptr;
+	OffsetAllocator vertex_allocator;
+	OffsetAllocator index_allocator;
+	uint32_t initial_vertex_capacity = 0;
+	uint32_t initial_index_capacity = 0;
+
+	std::vector<GPUMeshBuffers*> meshes;
+	std::vector<PendingFree> pending_frees;
+	//scratch of the compaction passes, kept so a pass doesn't allocate
+	std::vector<GPUMeshBuffers*> compaction_order;
+	std::vector<VkBufferCopy> vertex_regions;
+	std::vector<VkBufferCopy> index_regions;
+	//set when freed ranges return to the allocators or a mesh is added, cleared by a pass with nothing to move or shrink
+	bool compaction_pending = false;
+
+	uint64_t current_frame = 0;
+	uint64_t bytes_moved = 0;
+	uint32_t frames_in_flight = 2;
+	uint32_t allocation_count = 0;
+	uint32_t generation = 0;
+	bool is_initialized = false;
+};
@@ -0,0 +1,137 @@
+#include "gpu_profiler.h"
+#include "vk_engine.h"
+#include <algorithm>
+#include <cstring>
+
+void GpuProfiler::Init(VulkanEngine* engine_ptr, uint32_t framesInFlight)
+{
+	engine = engine_ptr;
+	frames_in_flight = framesInFlight;
+	//calibrates on the immediate command buffer, which nothing is recording into yet
+	tracy_context = TracyVkContext(engine->_chosenGPU, engine->_device, engine->_graphicsQueue, engine->_immCommandBuffer);
+
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(engine->_chosenGPU, &properties);
+	timestamp_period = properties.limits.timestampPeriod;
+
+	uint32_t family_count = 0;
+	vkGetPhysicalDeviceQueueFamilyProperties(engine->_chosenGPU, &family_count, nullptr);
+	std::vector<VkQueueFamilyProperties> families(family_count);
+	vkGetPhysicalDeviceQueueFamilyProperties(engine->_chosenGPU, &family_count, families.data());
+	const uint32_t valid_bits = families[engine->_graphicsQueueFamily].timestampValidBits;
+	if (valid_bits == 0)
+	{
+		fmt::println("The graphics queue can't write timestamps, GPU pass timings are off");
+		return;
+	}
+	valid_mask = valid_bits >= 64 ? UINT64_MAX : (1ull << valid_bits) - 1;
+
+	VkQueryPoolCreateInfo pool_info = { .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	pool_info.queryType = VK_QUERY_TYPE_TIMESTAMP;
+	pool_info.queryCount = GPU_PROFILER_MAX_SCOPES * 2 * frames_in_flight;
+	VK_CHECK(vkCreateQueryPool(engine->_device, &pool_info, nullptr, &pool));
+
+	range_scopes.resize(frames_in_flight);
+	for (std::vector<const char*>& scopes : range_scopes)
+		scopes.reserve(GPU_PROFILER_MAX_SCOPES);
+	range_frames.resize(frames_in_flight);
+	results.resize(GPU_PROFILER_MAX_SCOPES * 2);
+	timings.reserve(GPU_PROFILER_MAX_SCOPES);
+	last_frame_timings.reserve(GPU_PROFILER_MAX_SCOPES);
+	supported = true;
+}
+
+void GpuProfiler::Cleanup()
+{
+	TracyVkDestroy(tracy_context);
+	if (pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(engine->_device, pool, nullptr);
+	pool = VK_NULL_HANDLE;
+	supported = false;
+}
+
+bool GpuProfiler::ReadResults(uint64_t frameNumber)
+{
+	if (!supported)
+		return false;
+
+	const uint32_t range = static_cast<uint32_t>(frameNumber % frames_in_flight);
+	std::vector<const char*>& scopes = range_scopes[range];
+	if (scopes.empty())
+		return false;
+
+	//the fence has been waited on, without the wait flag this only fails if the frame never got submitted
+	const uint32_t first = range * GPU_PROFILER_MAX_SCOPES * 2;
+	const uint32_t count = static_cast<uint32_t>(scopes.size() * 2);
+	const VkResult result = vkGetQueryPoolResults(engine->_device, pool, first, count, count * sizeof(uint64_t), results.data(),
+		sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+	if (result != VK_SUCCESS)
+	{
+		scopes.clear();
+		return false;
+	}
+
+	auto to_ms = [&](uint64_t begin, uint64_t end) {
+		return float(double((end - begin) & valid_mask) * timestamp_period / 1000000.0);
+	};
+	auto smooth = [](float& smoothed, float value) {
+		smoothed = smoothed == 0.0f ? value : smoothed + (value - smoothed) * GPU_PROFILER_SMOOTHING;
+	};
+
+	uint64_t frame_begin = UINT64_MAX;
+	uint64_t frame_end = 0;
+	last_frame_timings.clear();
+	for (size_t i = 0; i < scopes.size(); i++)
+	{
+		const uint64_t begin = results[i * 2] & valid_mask;
+		const uint64_t end = results[i * 2 + 1] & valid_mask;
+		frame_begin = std::min(frame_begin, begin);
+		frame_end = std::max(frame_end, end);
+
+		auto timing = std::find_if(timings.begin(), timings.end(), [&](const GpuScopeTiming& timing) {
+			return timing.name == scopes[i] || strcmp(timing.name, scopes[i]) == 0;
+			});
+		if (timing == timings.end())
+			timing = timings.insert(timings.end(), GpuScopeTiming{ .name = scopes[i] });
+		timing->last_ms = to_ms(begin, end);
+		smooth(timing->smoothed_ms, timing->last_ms);
+		last_frame_timings.push_back(GpuScopeTiming{ .name = scopes[i], .last_ms = timing->last_ms, .smoothed_ms = timing->smoothed_ms });
+	}
+	last_frame_ms = to_ms(frame_begin, frame_end);
+	last_frame_number = range_frames[range];
+	smooth(frame_ms, last_frame_ms);
+	scopes.clear();
+	return true;
+}
+
+void GpuProfiler::BeginFrame(VkCommandBuffer cmd, uint64_t frameNumber)
+{
+	TracyVkCollect(tracy_context, cmd);
+	if (!supported)
+		return;
+
+	current_range = static_cast<uint32_t>(frameNumber % frames_in_flight);
+	range_scopes[current_range].clear();
+	range_frames[current_range] = frameNumber;
+	vkCmdResetQueryPool(cmd, pool, current_range * GPU_PROFILER_MAX_SCOPES * 2, GPU_PROFILER_MAX_SCOPES * 2);
+}
+
+uint32_t GpuProfiler::BeginScope(VkCommandBuffer cmd, const char* name)
+{
+	if (!supported || range_scopes[current_range].size() >= GPU_PROFILER_MAX_SCOPES)
+		return UINT32_MAX;
+
+	std::vector<const char*>& scopes = range_scopes[current_range];
+
+	const uint32_t scope = static_cast<uint32_t>(scopes.size());
+	scopes.push_back(name);
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, pool, (current_range * GPU_PROFILER_MAX_SCOPES + scope) * 2);
+	return scope;
+}
+
+void GpuProfiler::EndScope(VkCommandBuffer cmd, uint32_t scope)
+{
+	if (scope == UINT32_MAX)
+		return;
+	vkCmdWriteTimestamp2(cmd, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, pool, (current_range * GPU_PROFILER_MAX_SCOPES + scope) * 2 + 1);
+}
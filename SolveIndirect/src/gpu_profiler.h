@@ -0,0 +1,93 @@
+#pragma once
+#include "vk_types.h"
+#include "profiling.h"
+
+class VulkanEngine;
+
+//Scopes a frame can time, each takes two timestamps
+constexpr uint32_t GPU_PROFILER_MAX_SCOPES = 32;
+//Weight of the newest frame in the smoothed timings
+constexpr float GPU_PROFILER_SMOOTHING = 0.1f;
+
+struct GpuScopeTiming {
+	const char* name = nullptr;
+	//milliseconds the scope took in the last frame read back and averaged over the recent ones
+	float last_ms = 0.0f;
+	float smoothed_ms = 0.0f;
+};
+
+//Timestamp queries around the passes of a frame, with a range of the query pool for each frame in flight. With Tracy on,
+//every scope is also sent to it as a GPU zone through a context of its own.
+//A frame's timestamps are read back after waiting on its fence the next time its range comes around, so reading never stalls
+//and the timings shown are FRAME_OVERLAP frames old. Scope names are kept by pointer and must outlive the profiler,
+//string literals are what it expects. Timestamps are taken outside rendering, a multiview pass would write one per view
+struct GpuProfiler {
+	void Init(VulkanEngine* engine_ptr, uint32_t framesInFlight = 2);
+	void Cleanup();
+
+	//Call after waiting on the frame's fence, reads back what the frame recorded the last time it used its range.
+	//Returns true if there was a frame to read
+	bool ReadResults(uint64_t frameNumber);
+	//Call at the start of the frame's command buffer, resets the frame's range
+	void BeginFrame(VkCommandBuffer cmd, uint64_t frameNumber);
+
+	//Returns the scope to end, scopes past GPU_PROFILER_MAX_SCOPES in a frame aren't timed
+	uint32_t BeginScope(VkCommandBuffer cmd, const char* name);
+	void EndScope(VkCommandBuffer cmd, uint32_t scope);
+
+	//One entry per scope name in the order they were first seen
+	const std::vector<GpuScopeTiming>& GetTimings() const { return timings; }
+	//Smoothed time from the first timestamp of a frame to the last
+	float GetFrameTime() const { return frame_ms; }
+	//Only the scopes of the frame read last, with the number it was recorded under
+	const std::vector<GpuScopeTiming>& GetLastFrameTimings() const { return last_frame_timings; }
+	float GetLastFrameTime() const { return last_frame_ms; }
+	uint64_t GetLastFrameNumber() const { return last_frame_number; }
+	bool IsSupported() const { return supported; }
+
+private:
+	VulkanEngine* engine = nullptr;
+	VkQueryPool pool = VK_NULL_HANDLE;
+	//nanoseconds per tick
+	float timestamp_period = 1.0f;
+	//mask of the bits the graphics queue writes
+	uint64_t valid_mask = 0;
+	uint32_t frames_in_flight = 2;
+	uint32_t current_range = 0;
+	bool supported = false;
+
+	//names of the scopes each range recorded, in query order, and the frame that recorded them
+	std::vector<std::vector<const char*>> range_scopes;
+	std::vector<uint64_t> range_frames;
+	std::vector<uint64_t> results;
+	std::vector<GpuScopeTiming> timings;
+	float frame_ms = 0.0f;
+	std::vector<GpuScopeTiming> last_frame_timings;
+	float last_frame_ms = 0.0f;
+	uint64_t last_frame_number = UINT64_MAX;
+
+	friend struct GpuProfileScope;
+	TracyVkCtx tracy_context = nullptr;
+};
+
+//Times the commands recorded while it is alive
+struct GpuProfileScope {
+	GpuProfileScope(GpuProfiler& gpuProfiler, VkCommandBuffer commandBuffer, const char* name)
+		: profiler(gpuProfiler), cmd(commandBuffer), scope(gpuProfiler.BeginScope(commandBuffer, name))
+#ifdef TRACY_ENABLE
+		, tracy_zone(gpuProfiler.tracy_context, __LINE__, __FILE__, strlen(__FILE__), __func__, strlen(__func__), name, strlen(name), commandBuffer, true)
+#endif
+	{}
+	~GpuProfileScope() { profiler.EndScope(cmd, scope); }
+
+	GpuProfileScope(const GpuProfileScope&) = delete;
+	GpuProfileScope& operator=(const GpuProfileScope&) = delete;
+
+private:
+	GpuProfiler& profiler;
+	VkCommandBuffer cmd;
+	uint32_t scope;
+#ifdef TRACY_ENABLE
+	tracy::VkCtxScope tracy_zone;
+#endif
+};
@@ -0,0 +1,180 @@
+#include "gpu_statistics.h"
+#include "resource_manager.h"
+#include "vk_engine.h"
+#include "vk_initializers.h"
+#include "profiling.h"
+#include <algorithm>
+#include <cstring>
+
+//Finds the entry with the name, adding it the first time the name is seen
+template<typename T>
+static T& find_entry(std::vector<T>& entries, const char* name)
+{
+	auto entry = std::find_if(entries.begin(), entries.end(), [&](const T& candidate) {
+		return candidate.name == name || strcmp(candidate.name, name) == 0;
+		});
+	if (entry == entries.end())
+		entry = entries.insert(entries.end(), T{ .name = name });
+	return *entry;
+}
+
+void GpuStatistics::Init(ResourceManager* rm, uint32_t framesInFlight)
+{
+	resource_manager = rm;
+	frames_in_flight = framesInFlight;
+
+	counter_buffer = resource_manager->CreateBuffer(GetCounterBufferSize(), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+		VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Buffers, false);
+	counter_readback.resize(frames_in_flight);
+	for (AllocatedBuffer& readback : counter_readback)
+		readback = resource_manager->CreateBuffer(sizeof(GPUCullCounters) * GPU_STATS_MAX_CULL_PASSES, VK_BUFFER_USAGE_TRANSFER_DST_BIT,
+			VMA_MEMORY_USAGE_GPU_TO_CPU, MemoryCategory::Staging, false);
+	range_cull_passes.resize(frames_in_flight);
+	range_queries.resize(frames_in_flight);
+	is_initialized = true;
+
+	if (!resource_manager->engine->_pipelineStatisticsSupported)
+		return;
+
+	VkQueryPoolCreateInfo pool_info = { .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO };
+	pool_info.queryType = VK_QUERY_TYPE_PIPELINE_STATISTICS;
+	pool_info.queryCount = GPU_STATS_MAX_QUERIES * frames_in_flight;
+	pool_info.pipelineStatistics = VK_QUERY_PIPELINE_STATISTIC_INPUT_ASSEMBLY_PRIMITIVES_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_VERTEX_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_CLIPPING_PRIMITIVES_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_FRAGMENT_SHADER_INVOCATIONS_BIT
+		| VK_QUERY_PIPELINE_STATISTIC_COMPUTE_SHADER_INVOCATIONS_BIT;
+	VK_CHECK(vkCreateQueryPool(resource_manager->engine->_device, &pool_info, nullptr, &pool));
+
+	for (std::vector<const char*>& queries : range_queries)
+		queries.reserve(GPU_STATS_MAX_QUERIES);
+	query_results.resize(GPU_STATS_MAX_QUERIES * static_cast<size_t>(PipelineStatistic::Count));
+}
+
+void GpuStatistics::Cleanup()
+{
+	if (!is_initialized)
+		return;
+
+	resource_manager->DestroyBuffer(counter_buffer);
+	for (const AllocatedBuffer& readback : counter_readback)
+		resource_manager->DestroyBuffer(readback);
+	counter_readback.clear();
+	if (pool != VK_NULL_HANDLE)
+		vkDestroyQueryPool(resource_manager->engine->_device, pool, nullptr);
+	pool = VK_NULL_HANDLE;
+	is_initialized = false;
+}
+
+void GpuStatistics::ReadResults(uint64_t frameNumber)
+{
+	ZoneScoped;
+	if (!is_initialized)
+		return;
+
+	const uint32_t range = static_cast<uint32_t>(frameNumber % frames_in_flight);
+
+	std::vector<const char*>& cull_passes = range_cull_passes[range];
+	if (!cull_passes.empty())
+	{
+		const AllocatedBuffer& readback = counter_readback[range];
+		vmaInvalidateAllocation(resource_manager->engine->_allocator, readback.allocation, 0, VK_WHOLE_SIZE);
+		const GPUCullCounters* counters = (const GPUCullCounters*)readback.info.pMappedData;
+		for (size_t i = 0; i < cull_passes.size(); i++)
+			find_entry(cull_stats, cull_passes[i]).counters = counters[i];
+		cull_passes.clear();
+	}
+
+	std::vector<const char*>& queries = range_queries[range];
+	if (queries.empty())
+		return;
+
+	//the fence has been waited on, without the wait flag this only fails if the frame never got submitted
+	constexpr size_t stride = sizeof(uint64_t) * static_cast<size_t>(PipelineStatistic::Count);
+	const uint32_t count = static_cast<uint32_t>(queries.size());
+	const VkResult result = vkGetQueryPoolResults(resource_manager->engine->_device, pool, range * GPU_STATS_MAX_QUERIES, count, count * stride,
+		query_results.data(), stride, VK_QUERY_RESULT_64_BIT);
+	if (result == VK_SUCCESS)
+	{
+		for (size_t i = 0; i < queries.size(); i++)
+		{
+			PipelinePassStats& stats = find_entry(pipeline_stats, queries[i]);
+			std::copy_n(query_results.begin() + i * stats.values.size(), stats.values.size(), stats.values.begin());
+		}
+	}
+	queries.clear();
+}
+
+void GpuStatistics::BeginFrame(VkCommandBuffer cmd, uint64_t frameNumber)
+{
+	if (!is_initialized)
+		return;
+
+	current_range = static_cast<uint32_t>(frameNumber % frames_in_flight);
+	range_cull_passes[current_range].clear();
+	range_queries[current_range].clear();
+	if (pool != VK_NULL_HANDLE)
+		vkCmdResetQueryPool(cmd, pool, current_range * GPU_STATS_MAX_QUERIES, GPU_STATS_MAX_QUERIES);
+
+	//the last frame's readback copy has to be done with the counters before they are cleared
+	VkBufferMemoryBarrier barrier = vkinit::buffer_barrier(counter_buffer.buffer, resource_manager->engine->_graphicsQueueFamily);
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	vkCmdFillBuffer(cmd, counter_buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void GpuStatistics::EndFrame(VkCommandBuffer cmd)
+{
+	if (!is_initialized || range_cull_passes[current_range].empty())
+		return;
+
+	VkBufferMemoryBarrier barrier = vkinit::buffer_barrier(counter_buffer.buffer, resource_manager->engine->_graphicsQueueFamily);
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+	const AllocatedBuffer& readback = counter_readback[current_range];
+	VkBufferCopy counterCopy{ 0 };
+	counterCopy.size = sizeof(GPUCullCounters) * range_cull_passes[current_range].size();
+	vkCmdCopyBuffer(cmd, counter_buffer.buffer, readback.buffer, 1, &counterCopy);
+
+	VkBufferMemoryBarrier readbackBarrier = vkinit::buffer_barrier(readback.buffer, resource_manager->engine->_graphicsQueueFamily);
+	readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &readbackBarrier, 0, nullptr);
+}
+
+uint32_t GpuStatistics::AddCullPass(const char* name)
+{
+	if (!is_initialized || range_cull_passes[current_range].size() >= GPU_STATS_MAX_CULL_PASSES)
+		return GPU_STATS_MAX_CULL_PASSES;
+
+	std::vector<const char*>& cull_passes = range_cull_passes[current_range];
+	cull_passes.push_back(name);
+	return static_cast<uint32_t>(cull_passes.size() - 1);
+}
+
+uint32_t GpuStatistics::BeginQuery(VkCommandBuffer cmd, const char* name)
+{
+	if (pool == VK_NULL_HANDLE || range_queries[current_range].size() >= GPU_STATS_MAX_QUERIES)
+		return UINT32_MAX;
+
+	std::vector<const char*>& queries = range_queries[current_range];
+	const uint32_t query = static_cast<uint32_t>(queries.size());
+	queries.push_back(name);
+	vkCmdBeginQuery(cmd, pool, current_range * GPU_STATS_MAX_QUERIES + query, 0);
+	return query;
+}
+
+void GpuStatistics::EndQuery(VkCommandBuffer cmd, uint32_t query)
+{
+	if (query == UINT32_MAX)
+		return;
+	vkCmdEndQuery(cmd, pool, current_range * GPU_STATS_MAX_QUERIES + query);
+}
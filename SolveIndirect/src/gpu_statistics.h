@@ -0,0 +1,109 @@
+#pragma once
+#include "vk_types.h"
+
+struct ResourceManager;
+
+//Cull dispatches a frame can count, the ones past it share a spare set of counters that is never read
+constexpr uint32_t GPU_STATS_MAX_CULL_PASSES = 8;
+//Passes a frame can gather pipeline statistics for
+constexpr uint32_t GPU_STATS_MAX_QUERIES = 16;
+
+//Counters one cull dispatch adds to, laid out as CullCounters in indirect_cull.comp
+struct GPUCullCounters {
+	uint32_t visible = 0;
+	uint32_t frustum_culled = 0;
+	uint32_t occlusion_culled = 0;
+	//triangles of the draws left visible
+	uint32_t triangles = 0;
+};
+static_assert(sizeof(GPUCullCounters) == 16, "GPUCullCounters must match the std430 layout of CullCounters");
+
+//The statistics the query pool counts, in the order of their flag bits, which is the order the results are written in
+enum class PipelineStatistic : uint32_t {
+	InputAssemblyPrimitives,
+	VertexShaderInvocations,
+	ClippingPrimitives,
+	FragmentShaderInvocations,
+	ComputeShaderInvocations,
+	Count
+};
+
+struct CullPassStats {
+	const char* name = nullptr;
+	GPUCullCounters counters;
+};
+
+struct PipelinePassStats {
+	const char* name = nullptr;
+	std::array<uint64_t, static_cast<size_t>(PipelineStatistic::Count)> values{};
+};
+
+//Counters the cull shader fills in and pipeline statistics queries around passes, read back without stalling.
+//The cull counters live in one device buffer cleared at the start of each frame and copied at the end into a
+//persistently mapped buffer of the frame's own, the queries get a range of the pool for each frame in flight.
+//Both are read after waiting on the frame's fence the next time it comes around, so what is shown is FRAME_OVERLAP
+//frames old. Without the pipelineStatisticsQuery feature only the cull counters are gathered.
+//Names are kept by pointer, as with the GPU profiler they must outlive it
+struct GpuStatistics {
+	void Init(ResourceManager* rm, uint32_t framesInFlight = 2);
+	void Cleanup();
+
+	//Call after waiting on the frame's fence, reads what the frame recorded the last time around
+	void ReadResults(uint64_t frameNumber);
+	//Call at the start of the frame's command buffer, before any cull dispatch
+	void BeginFrame(VkCommandBuffer cmd, uint64_t frameNumber);
+	//Call once the frame's last cull dispatch and query are recorded, copies the counters to the frame's readback buffer
+	void EndFrame(VkCommandBuffer cmd);
+
+	//Returns the counters a cull dispatch adds to, it goes to the shader in the push constants
+	uint32_t AddCullPass(const char* name);
+
+	//Returns the query to end, queries past GPU_STATS_MAX_QUERIES in a frame aren't gathered.
+	//Queries are begun outside rendering, they can't nest
+	uint32_t BeginQuery(VkCommandBuffer cmd, const char* name);
+	void EndQuery(VkCommandBuffer cmd, uint32_t query);
+
+	bool HasPipelineStatistics() const { return pool != VK_NULL_HANDLE; }
+
+	const AllocatedBuffer& GetCounterBuffer() const { return counter_buffer; }
+	VkDeviceSize GetCounterBufferSize() const { return sizeof(GPUCullCounters) * (GPU_STATS_MAX_CULL_PASSES + 1); }
+
+	//One entry per name in the order they were first seen
+	const std::vector<CullPassStats>& GetCullStats() const { return cull_stats; }
+	const std::vector<PipelinePassStats>& GetPipelineStats() const { return pipeline_stats; }
+
+private:
+	ResourceManager* resource_manager = nullptr;
+	uint32_t frames_in_flight = 2;
+	uint32_t current_range = 0;
+
+	AllocatedBuffer counter_buffer;
+	std::vector<AllocatedBuffer> counter_readback;
+	//names of the cull passes each frame counted, in counter order, cleared once read
+	std::vector<std::vector<const char*>> range_cull_passes;
+
+	//null when the device doesn't support pipeline statistics
+	VkQueryPool pool = VK_NULL_HANDLE;
+	//names of the queries each range recorded, in query order
+	std::vector<std::vector<const char*>> range_queries;
+	std::vector<uint64_t> query_results;
+
+	std::vector<CullPassStats> cull_stats;
+	std::vector<PipelinePassStats> pipeline_stats;
+	bool is_initialized = false;
+};
+
+//Gathers pipeline statistics for the commands recorded while it is alive
+struct GpuStatisticsScope {
+	GpuStatisticsScope(GpuStatistics& gpuStatistics, VkCommandBuffer commandBuffer, const char* name)
+		: statistics(gpuStatistics), cmd(commandBuffer), query(gpuStatistics.BeginQuery(commandBuffer, name)) {}
+	~GpuStatisticsScope() { statistics.EndQuery(cmd, query); }
+
+	GpuStatisticsScope(const GpuStatisticsScope&) = delete;
+	GpuStatisticsScope& operator=(const GpuStatisticsScope&) = delete;
+
+private:
+	GpuStatistics& statistics;
+	VkCommandBuffer cmd;
+	uint32_t query;
+};
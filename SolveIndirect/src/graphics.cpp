@@ -1,4 +1,5 @@
 #include "graphics.h"
+#include "profiling.h"
 #include "camera.h"
 #include "vk_initializers.h"
 #include "vk_images.h"
@@ -20,6 +21,7 @@ struct PushParams {
 };
 void black_key::build_clusters(VulkanEngine* engine, PipelineCreationInfo& info, DescriptorAllocator& descriptorAllocator)
 {
+	TRACE_SCOPE("build_clusters");
 	/*
 	VkPipelineLayoutCreateInfo ClusterLayoutInfo = {};
 	ClusterLayoutInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -59,7 +61,7 @@ void black_key::build_clusters(VulkanEngine* engine, PipelineCreationInfo& info,
 	VkPipeline clusterPipeline;
 	//default colors
 
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &clusterPipeline));
+	VK_CHECK(engine->_pipelineCache.CreateComputePipeline(computePipelineCreateInfo, "build clusters", &clusterPipeline));
 
 	VkDescriptorSet globalDescriptor = engine->globalDescriptorAllocator.allocate(engine->_device, info.layouts[0]);
 
@@ -123,6 +125,7 @@ bool black_key::is_visible(const RenderObject& obj, const glm::mat4& viewproj) {
 
 void black_key::generate_irradiance_cube(VulkanEngine* engine, IBLData& ibl)
 {
+	TRACE_SCOPE("generate_irradiance_cube");
 	/*
 	//Created irradiance cubemap mage
 	VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
@@ -215,7 +218,7 @@ void black_key::generate_irradiance_cube(VulkanEngine* engine, IBLData& ibl)
 	pipelineBuilder._pipelineLayout = irradianceLayout;
 	pipelineBuilder.set_color_attachment_format(drawImage.imageFormat);
 
-	auto irradiancePipeline = pipelineBuilder.build_pipeline(engine->_device);
+	auto irradiancePipeline = pipelineBuilder.build_pipeline(engine->_pipelineCache, "irradiance");
 
 	std::vector<glm::mat4> matrices = {
 		// POSITIVE_X
@@ -258,6 +261,7 @@ void black_key::generate_irradiance_cube(VulkanEngine* engine, IBLData& ibl)
 	
 	{
 		VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+		VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
 		
 		for (uint32_t m = 0; m < numMips; m++) {
 			for (uint32_t f = 0; f < 6; f++)
@@ -279,10 +283,11 @@ void black_key::generate_irradiance_cube(VulkanEngine* engine, IBLData& ibl)
 				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, irradiancePipeline);
 				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, irradianceLayout, 0, 1, &globalDescriptor, 0, NULL);
 
-				if (r.indexBuffer != lastIndexBuffer)
+				if (r.indexBuffer != lastIndexBuffer || r.indexType != lastIndexType)
 				{
 					lastIndexBuffer = r.indexBuffer;
-					vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+					lastIndexType = r.indexType;
+					vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, r.indexType);
 				}
 				
 				PushBlock pushBlock;
@@ -291,7 +296,7 @@ void black_key::generate_irradiance_cube(VulkanEngine* engine, IBLData& ibl)
 				pushBlock.mvp[1][1] *= -1;
 				pushBlock.vertexBuffer = r.vertexBufferAddress;
 				vkCmdPushConstants(cmd, irradianceLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(PushBlock), &pushBlock);
-				vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
+				vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, r.firstVertex, 0);
 
 				vkCmdEndRendering(cmd);
 				vkutil::transition_image(cmd, drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
@@ -392,7 +397,7 @@ void black_key::generate_irradiance_cube(VulkanEngine* engine, IBLData& ibl)
 	VkPipeline preFilterPipeline;
 	//default colors
 
-	VK_CHECK(vkCreateComputePipelines(engine->_device, VK_NULL_HANDLE, 1, &computePipelineCreateInfo, nullptr, &preFilterPipeline));
+	VK_CHECK(engine->_pipelineCache.CreateComputePipeline(computePipelineCreateInfo, "irradiance cube", &preFilterPipeline));
 
 	VkDescriptorSet globalDescriptor = engine->globalDescriptorAllocator.allocate(engine->_device, IBL_Layout);
 
@@ -427,6 +432,7 @@ void black_key::generate_irradiance_cube(VulkanEngine* engine, IBLData& ibl)
 
 void black_key::generate_brdf_lut(VulkanEngine* engine, IBLData& ibl)
 {
+	TRACE_SCOPE("generate_brdf_lut");
 	VkFormat format = VK_FORMAT_R16G16_SFLOAT;
 	uint32_t dim = 512;
 	uint32_t numMips = static_cast<uint32_t>(floor(log2(dim))) + 1;
@@ -484,7 +490,7 @@ void black_key::generate_brdf_lut(VulkanEngine* engine, IBLData& ibl)
 	pipelineBuilder._pipelineLayout = lutBRDFLayout;
 	pipelineBuilder.set_color_attachment_format(ibl._lutBRDF.imageFormat);
 
-	auto brdfPipeline = pipelineBuilder.build_pipeline(engine->_device);
+	auto brdfPipeline = pipelineBuilder.build_pipeline(engine->_pipelineCache, "brdf lut");
 
 	VkClearValue clearValues[1];
 	clearValues[0].color = { { 0.0f, 0.0f, 0.0f, 1.0f } };
@@ -554,6 +560,7 @@ void black_key::generate_brdf_lut(VulkanEngine* engine, IBLData& ibl)
 
 void black_key::generate_prefiltered_cubemap(VulkanEngine* engine, IBLData& ibl)
 {
+	TRACE_SCOPE("generate_prefiltered_cubemap");
 	/*
 	VkFormat format = VK_FORMAT_R16G16B16A16_SFLOAT;
 	uint32_t dim = 512;
@@ -632,7 +639,7 @@ void black_key::generate_prefiltered_cubemap(VulkanEngine* engine, IBLData& ibl)
 	pipelineBuilder._pipelineLayout = irradianceLayout;
 	pipelineBuilder.set_color_attachment_format(drawImage.imageFormat);
 
-	auto irradiancePipeline = pipelineBuilder.build_pipeline(engine->_device);
+	auto irradiancePipeline = pipelineBuilder.build_pipeline(engine->_pipelineCache, "pre filter envmap");
 
 	std::vector<glm::mat4> matrices = {
 		// POSITIVE_X
@@ -687,6 +694,7 @@ void black_key::generate_prefiltered_cubemap(VulkanEngine* engine, IBLData& ibl)
 
 	{
 		VkBuffer lastIndexBuffer = VK_NULL_HANDLE;
+		VkIndexType lastIndexType = VK_INDEX_TYPE_MAX_ENUM;
 		PushBlock pushBlock;
 		for (uint32_t m = 0; m < numMips; m++) {
 			pushBlock.roughness = (float)m / (float)(numMips - 1);
@@ -700,10 +708,11 @@ void black_key::generate_prefiltered_cubemap(VulkanEngine* engine, IBLData& ibl)
 				vkCmdBindPipeline(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, irradiancePipeline);
 				vkCmdBindDescriptorSets(cmd, VK_PIPELINE_BIND_POINT_GRAPHICS, irradianceLayout, 0, 1, &globalDescriptor, 0, NULL);
 
-				if (r.indexBuffer != lastIndexBuffer)
+				if (r.indexBuffer != lastIndexBuffer || r.indexType != lastIndexType)
 				{
 					lastIndexBuffer = r.indexBuffer;
-					vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, VK_INDEX_TYPE_UINT32);
+					lastIndexType = r.indexType;
+					vkCmdBindIndexBuffer(cmd, r.indexBuffer, 0, r.indexType);
 				}
 				// Update shader push constant block
 				pushBlock.mvp = glm::perspective((float)(M_PI / 2.0), 1.0f, 0.1f, 512.0f) * matrices[f];
@@ -711,7 +720,7 @@ void black_key::generate_prefiltered_cubemap(VulkanEngine* engine, IBLData& ibl)
 				pushBlock.vertexBuffer = r.vertexBufferAddress;
 				vkCmdPushConstants(cmd, irradianceLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(PushBlock), &pushBlock);
 				
-				vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, 0, 0);
+				vkCmdDrawIndexed(cmd, r.indexCount, 1, r.firstIndex, r.firstVertex, 0);
 				vkCmdEndRendering(cmd);
 	
 				vkutil::transition_image(cmd, drawImage.image, VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
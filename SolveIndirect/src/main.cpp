@@ -1,14 +1,59 @@
 #include "vk_engine.h"
 #include "Renderers/clustered_forward_renderer.h"
+#include "benchmark.h"
+#include "startup_trace.h"
 #include <memory>
+#include <cstring>
 
 int main(int argc, char* argv[])
 {
+	//--trace-startup <path> writes where the time up to the first frame went as a Chrome trace
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--trace-startup") == 0)
+			startup_trace::Enable(argv[i + 1]);
+	}
+
 	auto engine = std::make_shared<VulkanEngine>();
 	
-	std::unique_ptr<BaseRenderer> clusteredLightingDemo = std::make_unique<ClusteredForwardRenderer>();
+	//--benchmark <camera path> renders headless and writes a report instead of opening the window
+	std::optional<BenchmarkOptions> benchmark = BenchmarkOptions::Parse(argc, argv);
+	auto clusteredLightingDemo = std::make_unique<ClusteredForwardRenderer>();
+
+	//--stress instances=<n>,meshes=<n>,materials=<n>,lights=<n>,layout=<grid|city|interior>,seed=<n> draws a generated
+	//scene instead of the glTF, windowed or headless
+	for (int i = 1; i + 1 < argc; i++)
+	{
+		if (strcmp(argv[i], "--stress") != 0)
+			continue;
+		std::optional<StressSceneOptions> stress = StressSceneOptions::Parse(argv[i + 1]);
+		if (!stress.has_value())
+			return 1;
+		clusteredLightingDemo->SetStressScene(*stress);
+		if (benchmark.has_value())
+			benchmark->stress_scene = stress->ToString();
+	}
+
+	if (benchmark.has_value())
+		clusteredLightingDemo->SetBenchmark(*benchmark);
 	clusteredLightingDemo->Init(engine.get());
-	clusteredLightingDemo->Run();
+
+	//--record <capture> writes what the window draws each frame, --replay <capture> plays it back as a benchmark
+	bool succeeded = true;
+	if (benchmark.has_value())
+		succeeded = clusteredLightingDemo->RunBenchmark();
+	else
+	{
+		for (int i = 1; i + 1 < argc && succeeded; i++)
+		{
+			if (strcmp(argv[i], "--record") == 0)
+				succeeded = clusteredLightingDemo->SetRecording(argv[i + 1]);
+		}
+		if (succeeded)
+			clusteredLightingDemo->Run();
+	}
+	//written here instead when no frame was drawn
+	startup_trace::Finish();
 	clusteredLightingDemo->Cleanup();
 	engine->cleanup();	
 	
@@ -22,5 +67,5 @@ int main(int argc, char* argv[])
 
 	engine.cleanup();
 	*/
-	return 0;
+	return succeeded ? 0 : 1;
 }
@@ -0,0 +1,140 @@
+#include "memory_budget.h"
+#include <algorithm>
+#include <atomic>
+
+//VMA calls the callbacks from whichever thread allocates
+static std::atomic<uint64_t> device_allocations{ 0 };
+static std::atomic<VkDeviceSize> device_allocated_bytes{ 0 };
+
+//Every block VMA takes from the driver, the allocations inside them are tracked per category by the memory budget
+static void VKAPI_PTR count_device_allocate(VmaAllocator, uint32_t, VkDeviceMemory memory, VkDeviceSize size, void*)
+{
+	device_allocations.fetch_add(1, std::memory_order_relaxed);
+	device_allocated_bytes.fetch_add(size, std::memory_order_relaxed);
+	TracyAllocN((void*)memory, size, "VkDeviceMemory");
+}
+
+static void VKAPI_PTR count_device_free(VmaAllocator, uint32_t, VkDeviceMemory memory, VkDeviceSize size, void*)
+{
+	device_allocated_bytes.fetch_sub(size, std::memory_order_relaxed);
+	TracyFreeN((void*)memory, "VkDeviceMemory");
+}
+
+uint64_t GetDeviceMemoryAllocationCount()
+{
+	return device_allocations.load(std::memory_order_relaxed);
+}
+
+VkDeviceSize GetDeviceMemoryAllocatedBytes()
+{
+	return device_allocated_bytes.load(std::memory_order_relaxed);
+}
+
+VmaDeviceMemoryCallbacks GetDeviceMemoryCallbacks()
+{
+	return { .pfnAllocate = count_device_allocate, .pfnFree = count_device_free };
+}
+
+const char* MemoryCategoryName(MemoryCategory category)
+{
+	switch (category)
+	{
+	case MemoryCategory::Geometry:
+		return "Geometry";
+	case MemoryCategory::Textures:
+		return "Textures";
+	case MemoryCategory::RenderTargets:
+		return "Render targets";
+	case MemoryCategory::Buffers:
+		return "Buffers";
+	case MemoryCategory::Staging:
+		return "Staging";
+	case MemoryCategory::PerFrame:
+		return "Per frame";
+	default:
+		return "Unknown";
+	}
+}
+
+void MemoryBudget::Init(VmaAllocator vma_allocator, bool budget_extension)
+{
+	allocator = vma_allocator;
+	has_budget_extension = budget_extension;
+	Update(0);
+}
+
+void MemoryBudget::Track(VmaAllocation allocation, MemoryCategory category)
+{
+	if (allocation == VK_NULL_HANDLE)
+		return;
+
+	VmaAllocationInfo info;
+	vmaGetAllocationInfo(allocator, allocation, &info);
+
+	std::lock_guard<LockableBase(std::mutex)> lock(mutex);
+	auto [it, inserted] = allocations.try_emplace(allocation, TrackedAllocation{ category, info.size });
+	if (!inserted)
+		return;
+	category_bytes[size_t(category)] += info.size;
+	category_allocations[size_t(category)]++;
+	TracyAllocN(allocation, info.size, MemoryCategoryName(category));
+}
+
+void MemoryBudget::Untrack(VmaAllocation allocation)
+{
+	std::lock_guard<LockableBase(std::mutex)> lock(mutex);
+	auto it = allocations.find(allocation);
+	if (it == allocations.end())
+		return;
+	category_bytes[size_t(it->second.category)] -= it->second.size;
+	category_allocations[size_t(it->second.category)]--;
+	TracyFreeN(allocation, MemoryCategoryName(it->second.category));
+	allocations.erase(it);
+}
+
+void MemoryBudget::Update(uint32_t frameNumber)
+{
+	if (allocator == VK_NULL_HANDLE)
+		return;
+
+	//VMA only refetches the driver's numbers when the frame index changes
+	vmaSetCurrentFrameIndex(allocator, frameNumber);
+
+	const VkPhysicalDeviceMemoryProperties* memory_properties = nullptr;
+	vmaGetMemoryProperties(allocator, &memory_properties);
+
+	VmaBudget budgets[VK_MAX_MEMORY_HEAPS];
+	vmaGetHeapBudgets(allocator, budgets);
+
+	stats.heaps.resize(memory_properties->memoryHeapCount);
+	stats.device_local_usage = 0;
+	stats.device_local_budget = 0;
+	VkDeviceSize allocation_bytes = 0;
+	for (uint32_t i = 0; i < memory_properties->memoryHeapCount; i++)
+	{
+		MemoryHeapBudget& heap = stats.heaps[i];
+		heap.usage = budgets[i].usage;
+		heap.budget = budgets[i].budget;
+		heap.allocation_bytes = budgets[i].statistics.allocationBytes;
+		heap.device_local = (memory_properties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+
+		allocation_bytes += heap.allocation_bytes;
+		if (heap.device_local)
+		{
+			stats.device_local_usage += heap.usage;
+			stats.device_local_budget += heap.budget;
+		}
+	}
+
+	if (budget_limit != 0)
+		stats.device_local_budget = std::min(stats.device_local_budget, budget_limit);
+	stats.driver_budget = has_budget_extension;
+
+	std::lock_guard<LockableBase(std::mutex)> lock(mutex);
+	stats.category_bytes = category_bytes;
+	stats.category_allocations = category_allocations;
+	VkDeviceSize tracked_bytes = 0;
+	for (VkDeviceSize bytes : category_bytes)
+		tracked_bytes += bytes;
+	stats.untracked_bytes = allocation_bytes > tracked_bytes ? allocation_bytes - tracked_bytes : 0;
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include "vk_types.h"
+#include "profiling.h"
+#include <array>
+#include <mutex>
+#include <unordered_map>
+
+enum class MemoryCategory : uint8_t {
+	Geometry,
+	Textures,
+	RenderTargets,
+	Buffers,
+	Staging,
+	PerFrame,
+	Count
+};
+
+const char* MemoryCategoryName(MemoryCategory category);
+
+//Blocks of device memory VMA has taken from the driver since startup, and the bytes in them. Counted by the callbacks below,
+//which the engine hands to the allocator when it creates it. They also report every block to Tracy when it is on
+uint64_t GetDeviceMemoryAllocationCount();
+VkDeviceSize GetDeviceMemoryAllocatedBytes();
+VmaDeviceMemoryCallbacks GetDeviceMemoryCallbacks();
+
+struct MemoryHeapBudget {
+	//bytes this process has allocated from the heap, and the heap's share the driver grants us
+	VkDeviceSize usage = 0;
+	VkDeviceSize budget = 0;
+	//bytes inside VMA allocations, a subset of usage
+	VkDeviceSize allocation_bytes = 0;
+	bool device_local = false;
+};
+
+struct MemoryBudgetStats {
+	std::array<VkDeviceSize, size_t(MemoryCategory::Count)> category_bytes{};
+	std::array<uint32_t, size_t(MemoryCategory::Count)> category_allocations{};
+	//allocations made outside the tracked paths (imgui, one off images)
+	VkDeviceSize untracked_bytes = 0;
+
+	std::vector<MemoryHeapBudget> heaps;
+	VkDeviceSize device_local_usage = 0;
+	//driver budget, clamped to the configured limit
+	VkDeviceSize device_local_budget = 0;
+	bool driver_budget = false;
+};
+
+//Per category accounting on top of vmaGetHeapBudgets. Every allocation is tagged with a category when it is
+//created and untagged when destroyed, the heap numbers come from VMA, which reads them from
+//VK_EXT_memory_budget when the device supports it and estimates them otherwise
+struct MemoryBudget {
+	void Init(VmaAllocator vma_allocator, bool has_budget_extension);
+
+	void Track(VmaAllocation allocation, MemoryCategory category);
+	void Untrack(VmaAllocation allocation);
+
+	//Refreshes the heap budgets, call once per frame
+	void Update(uint32_t frameNumber);
+
+	//Caps the device local budget below what the driver offers, 0 removes the cap
+	void SetBudgetLimit(VkDeviceSize limit) { budget_limit = limit; }
+	VkDeviceSize GetBudgetLimit() const { return budget_limit; }
+
+	VkDeviceSize GetUsage() const { return stats.device_local_usage; }
+	VkDeviceSize GetBudget() const { return stats.device_local_budget; }
+	bool IsOverBudget() const { return stats.device_local_usage > stats.device_local_budget; }
+	const MemoryBudgetStats& GetStats() const { return stats; }
+
+private:
+	struct TrackedAllocation {
+		MemoryCategory category;
+		VkDeviceSize size;
+	};
+
+	VmaAllocator allocator = VK_NULL_HANDLE;
+	std::unordered_map<VmaAllocation, TrackedAllocation> allocations;
+	std::array<VkDeviceSize, size_t(MemoryCategory::Count)> category_bytes{};
+	std::array<uint32_t, size_t(MemoryCategory::Count)> category_allocations{};
+	//resources can be created off the render thread
+	TracyLockable(std::mutex, mutex);
+
+	VkDeviceSize budget_limit = 0;
+	bool has_budget_extension = false;
+	MemoryBudgetStats stats;
+};
@@ -0,0 +1,328 @@
+#include "mesh_optimizer.h"
+#include "profiling.h"
+#include <algorithm>
+#include <vector>
+
+namespace {
+	constexpr uint32_t INVALID_VERTEX = ~0u;
+
+	//Triangles touching each vertex, stored as one flat array with per vertex offsets
+	struct TriangleAdjacency {
+		std::vector<uint32_t> offsets;
+		std::vector<uint32_t> triangles;
+	};
+
+	TriangleAdjacency BuildAdjacency(std::span<const uint32_t> indices, size_t vertexCount)
+	{
+		TriangleAdjacency adjacency;
+		adjacency.offsets.assign(vertexCount + 1, 0);
+		adjacency.triangles.resize(indices.size());
+
+		for (uint32_t index : indices)
+			adjacency.offsets[index + 1]++;
+
+		for (size_t i = 0; i < vertexCount; i++)
+			adjacency.offsets[i + 1] += adjacency.offsets[i];
+
+		std::vector<uint32_t> fill(adjacency.offsets.begin(), adjacency.offsets.end() - 1);
+		for (size_t i = 0; i < indices.size(); i++)
+			adjacency.triangles[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+
+		return adjacency;
+	}
+
+	//FIFO cache modelled with timestamps, a vertex is resident if fewer than cacheSize
+	//vertices were inserted after it. Returns the number of misses for the triangle
+	uint32_t UpdateCache(uint32_t a, uint32_t b, uint32_t c, uint32_t cacheSize, std::vector<uint32_t>& timestamps, uint32_t& timestamp)
+	{
+		uint32_t misses = 0;
+		for (uint32_t v : { a, b, c }) {
+			if (timestamp - timestamps[v] > cacheSize) {
+				timestamps[v] = timestamp++;
+				misses++;
+			}
+		}
+		return misses;
+	}
+}
+
+BlackKey::VertexCacheStatistics BlackKey::AnalyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+	VertexCacheStatistics stats;
+	stats.triangle_count = static_cast<uint32_t>(indices.size() / 3);
+	if (stats.triangle_count == 0 || vertexCount == 0)
+		return stats;
+
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> referenced(vertexCount, false);
+	uint32_t timestamp = cacheSize + 1;
+
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		stats.vertices_transformed += UpdateCache(indices[i], indices[i + 1], indices[i + 2], cacheSize, timestamps, timestamp);
+	}
+
+	for (uint32_t index : indices) {
+		if (!referenced[index]) {
+			referenced[index] = true;
+			stats.vertex_count++;
+		}
+	}
+
+	stats.acmr = static_cast<float>(stats.vertices_transformed) / static_cast<float>(stats.triangle_count);
+	stats.atvr = static_cast<float>(stats.vertices_transformed) / static_cast<float>(stats.vertex_count);
+	return stats;
+}
+
+void BlackKey::OptimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize)
+{
+	const size_t triangleCount = indices.size() / 3;
+	if (triangleCount == 0 || vertexCount == 0)
+		return;
+
+	TriangleAdjacency adjacency = BuildAdjacency(indices, vertexCount);
+
+	std::vector<uint32_t> liveTriangles(vertexCount);
+	for (size_t v = 0; v < vertexCount; v++)
+		liveTriangles[v] = adjacency.offsets[v + 1] - adjacency.offsets[v];
+
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	deadEnd.reserve(indices.size());
+	result.reserve(indices.size());
+
+	uint32_t timestamp = cacheSize + 1;
+	uint32_t cursor = 0;
+
+	auto next_input_vertex = [&]() {
+		while (cursor < vertexCount) {
+			if (liveTriangles[cursor] > 0)
+				return cursor;
+			cursor++;
+		}
+		return INVALID_VERTEX;
+		};
+
+	uint32_t fanning = next_input_vertex();
+	while (fanning != INVALID_VERTEX) {
+		candidates.clear();
+
+		//emit every remaining triangle around the fanning vertex
+		for (uint32_t i = adjacency.offsets[fanning]; i < adjacency.offsets[fanning + 1]; i++) {
+			uint32_t triangle = adjacency.triangles[i];
+			if (emitted[triangle])
+				continue;
+
+			for (int k = 0; k < 3; k++) {
+				uint32_t v = indices[triangle * 3 + k];
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				liveTriangles[v]--;
+
+				if (timestamp - timestamps[v] > cacheSize)
+					timestamps[v] = timestamp++;
+			}
+			emitted[triangle] = true;
+		}
+
+		//prefer the oldest candidate that will still be resident after fanning out its own triangles
+		uint32_t best = INVALID_VERTEX;
+		int64_t bestPriority = -1;
+		for (uint32_t v : candidates) {
+			if (liveTriangles[v] == 0)
+				continue;
+
+			int64_t priority = 0;
+			if (timestamp - timestamps[v] + 2 * liveTriangles[v] <= cacheSize)
+				priority = timestamp - timestamps[v];
+
+			if (priority > bestPriority) {
+				bestPriority = priority;
+				best = v;
+			}
+		}
+
+		//dead end, walk back through recently emitted vertices and then fall back to input order
+		while (best == INVALID_VERTEX && !deadEnd.empty()) {
+			uint32_t v = deadEnd.back();
+			deadEnd.pop_back();
+			if (liveTriangles[v] > 0)
+				best = v;
+		}
+
+		if (best == INVALID_VERTEX)
+			best = next_input_vertex();
+
+		fanning = best;
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void BlackKey::OptimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold, uint32_t cacheSize)
+{
+	const uint32_t triangleCount = static_cast<uint32_t>(indices.size() / 3);
+	if (triangleCount < 2 || vertices.empty())
+		return;
+
+	std::vector<uint32_t> timestamps(vertices.size(), 0);
+	uint32_t timestamp = cacheSize + 1;
+
+	auto triangle_misses = [&](uint32_t triangle) {
+		return UpdateCache(indices[triangle * 3], indices[triangle * 3 + 1], indices[triangle * 3 + 2], cacheSize, timestamps, timestamp);
+		};
+	auto flush_cache = [&]() { timestamp += cacheSize + 1; };
+
+	//a triangle missing on all three vertices usually starts a new disjoint patch of the mesh
+	std::vector<uint32_t> hardBoundaries;
+	for (uint32_t i = 0; i < triangleCount; i++) {
+		if (triangle_misses(i) == 3 || i == 0)
+			hardBoundaries.push_back(i);
+	}
+	hardBoundaries.push_back(triangleCount);
+
+	//split each patch further wherever the running ACMR is already close to the patch's own ACMR,
+	//smaller clusters sort better but every split costs a few extra cache misses
+	std::vector<uint32_t> clusters;
+	for (size_t c = 0; c + 1 < hardBoundaries.size(); c++) {
+		uint32_t start = hardBoundaries[c];
+		uint32_t end = hardBoundaries[c + 1];
+
+		flush_cache();
+		uint32_t clusterMisses = 0;
+		for (uint32_t i = start; i < end; i++)
+			clusterMisses += triangle_misses(i);
+
+		float clusterThreshold = threshold * static_cast<float>(clusterMisses) / static_cast<float>(end - start);
+
+		flush_cache();
+		clusters.push_back(start);
+		uint32_t runningMisses = 0;
+		uint32_t runningTriangles = 0;
+		for (uint32_t i = start; i < end; i++) {
+			runningMisses += triangle_misses(i);
+			runningTriangles++;
+
+			if (i + 1 < end && static_cast<float>(runningMisses) / static_cast<float>(runningTriangles) <= clusterThreshold) {
+				clusters.push_back(i + 1);
+				flush_cache();
+				runningMisses = 0;
+				runningTriangles = 0;
+			}
+		}
+	}
+	clusters.push_back(triangleCount);
+
+	const size_t clusterCount = clusters.size() - 1;
+	if (clusterCount < 2)
+		return;
+
+	//area weighted centroid and normal for every cluster
+	std::vector<glm::vec3> clusterCentroids(clusterCount);
+	std::vector<glm::vec3> clusterNormals(clusterCount);
+	glm::vec3 meshCentroid(0.0f);
+	float meshArea = 0.0f;
+
+	for (size_t c = 0; c < clusterCount; c++) {
+		glm::vec3 centroid(0.0f);
+		glm::vec3 normal(0.0f);
+		float area = 0.0f;
+
+		for (uint32_t i = clusters[c]; i < clusters[c + 1]; i++) {
+			const glm::vec3& p0 = vertices[indices[i * 3]].position;
+			const glm::vec3& p1 = vertices[indices[i * 3 + 1]].position;
+			const glm::vec3& p2 = vertices[indices[i * 3 + 2]].position;
+
+			glm::vec3 n = glm::cross(p1 - p0, p2 - p0);
+			float a = glm::length(n);
+
+			centroid += (p0 + p1 + p2) * (a / 3.0f);
+			normal += n;
+			area += a;
+		}
+
+		meshCentroid += centroid;
+		meshArea += area;
+
+		clusterCentroids[c] = area > 0.0f ? centroid / area : vertices[indices[clusters[c] * 3]].position;
+		clusterNormals[c] = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3(0.0f);
+	}
+
+	if (meshArea > 0.0f)
+		meshCentroid /= meshArea;
+
+	struct ClusterSortData {
+		uint32_t cluster;
+		float key;
+	};
+
+	//clusters facing away from the mesh centre are more likely to occlude the rest, draw them first
+	std::vector<ClusterSortData> order(clusterCount);
+	for (size_t c = 0; c < clusterCount; c++) {
+		order[c].cluster = static_cast<uint32_t>(c);
+		order[c].key = glm::dot(clusterCentroids[c] - meshCentroid, clusterNormals[c]);
+	}
+
+	std::stable_sort(order.begin(), order.end(), [](const ClusterSortData& a, const ClusterSortData& b) {
+		return a.key > b.key;
+		});
+
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (const auto& sorted : order) {
+		uint32_t first = clusters[sorted.cluster] * 3;
+		uint32_t last = clusters[sorted.cluster + 1] * 3;
+		result.insert(result.end(), indices.begin() + first, indices.begin() + last);
+	}
+
+	std::copy(result.begin(), result.end(), indices.begin());
+}
+
+void BlackKey::OptimizeVertexFetch(std::span<uint32_t> indices, std::span<Vertex> vertices)
+{
+	std::vector<uint32_t> remap(vertices.size(), INVALID_VERTEX);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+
+	for (uint32_t& index : indices) {
+		if (remap[index] == INVALID_VERTEX) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+
+	//keep unreferenced vertices at the end so the surface vertex range stays the same size
+	for (size_t v = 0; v < vertices.size(); v++) {
+		if (remap[v] == INVALID_VERTEX)
+			reordered.push_back(vertices[v]);
+	}
+
+	std::copy(reordered.begin(), reordered.end(), vertices.begin());
+}
+
+BlackKey::MeshOptimizationResult BlackKey::OptimizeSurface(std::span<uint32_t> indices, std::span<Vertex> vertices, uint32_t baseVertex)
+{
+	ZoneScoped;
+	TRACE_SCOPE("OptimizeSurface");
+	MeshOptimizationResult result;
+
+	for (uint32_t& index : indices)
+		index -= baseVertex;
+
+	result.before = AnalyzeVertexCache(indices, vertices.size());
+
+	OptimizeVertexCache(indices, vertices.size());
+	OptimizeOverdraw(indices, vertices);
+	OptimizeVertexFetch(indices, vertices);
+
+	result.after = AnalyzeVertexCache(indices, vertices.size());
+
+	for (uint32_t& index : indices)
+		index += baseVertex;
+
+	return result;
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include "vk_types.h"
+
+//Size of the post transform cache the reordering targets. Real hardware varies,
+//16 entries is a safe lower bound that still gives most of the benefit on bigger caches
+constexpr uint32_t VERTEX_CACHE_SIZE = 16;
+
+namespace BlackKey {
+
+	struct VertexCacheStatistics {
+		uint32_t vertices_transformed = 0;
+		uint32_t triangle_count = 0;
+		uint32_t vertex_count = 0;
+		//average cache miss ratio, transformed vertices per triangle (0.5 - 3.0)
+		float acmr = 0.0f;
+		//average transform to vertex ratio, 1.0 means every vertex is shaded once
+		float atvr = 0.0f;
+	};
+
+	struct MeshOptimizationResult {
+		VertexCacheStatistics before;
+		VertexCacheStatistics after;
+	};
+
+	//Simulates a FIFO post transform cache over an index list without touching the GPU.
+	//Indices are expected to be relative to the first vertex of the surface
+	VertexCacheStatistics AnalyzeVertexCache(std::span<const uint32_t> indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	//Tipsify (Sander et al. 2007) triangle reordering for vertex cache locality
+	void OptimizeVertexCache(std::span<uint32_t> indices, size_t vertexCount, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	//Splits cache optimized output into clusters and sorts them so outward facing clusters draw first.
+	//threshold is how much worse than the cluster ACMR a split is allowed to make it
+	void OptimizeOverdraw(std::span<uint32_t> indices, std::span<const Vertex> vertices, float threshold = 1.05f, uint32_t cacheSize = VERTEX_CACHE_SIZE);
+
+	//Reorders the vertex array in first use order and remaps the indices to match
+	void OptimizeVertexFetch(std::span<uint32_t> indices, std::span<Vertex> vertices);
+
+	//Runs the full pipeline on one surface. indices are offset by baseVertex into the mesh vertex array,
+	//vertices is the surface's own range of that array
+	MeshOptimizationResult OptimizeSurface(std::span<uint32_t> indices, std::span<Vertex> vertices, uint32_t baseVertex);
+}
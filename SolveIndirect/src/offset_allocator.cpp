@@ -0,0 +1,353 @@
+#include "offset_allocator.h"
+#include <bit>
+#include <cassert>
+#include <algorithm>
+
+namespace {
+	constexpr uint32_t MANTISSA_BITS = 3;
+	constexpr uint32_t MANTISSA_VALUE = 1 << MANTISSA_BITS;
+	constexpr uint32_t MANTISSA_MASK = MANTISSA_VALUE - 1;
+
+	//Sizes are binned as a tiny float with a 5 bit exponent and 3 bit mantissa, so every power of two
+	//is split into 8 linearly spaced bins. Rounding up when allocating guarantees any node in the bin fits
+	uint32_t SizeToBinRoundUp(uint32_t size)
+	{
+		uint32_t exp = 0;
+		uint32_t mantissa = 0;
+
+		if (size < MANTISSA_VALUE) {
+			mantissa = size;
+		}
+		else {
+			uint32_t highestSetBit = 31 - std::countl_zero(size);
+			uint32_t mantissaStartBit = highestSetBit - MANTISSA_BITS;
+			exp = mantissaStartBit + 1;
+			mantissa = (size >> mantissaStartBit) & MANTISSA_MASK;
+
+			uint32_t lowBitsMask = (1u << mantissaStartBit) - 1;
+			if ((size & lowBitsMask) != 0)
+				mantissa++;
+		}
+		//mantissa overflow carries into the exponent
+		return (exp << MANTISSA_BITS) + mantissa;
+	}
+
+	//Free nodes are stored rounded down so a node never sits in a bin bigger than itself
+	uint32_t SizeToBinRoundDown(uint32_t size)
+	{
+		uint32_t exp = 0;
+		uint32_t mantissa = 0;
+
+		if (size < MANTISSA_VALUE) {
+			mantissa = size;
+		}
+		else {
+			uint32_t highestSetBit = 31 - std::countl_zero(size);
+			uint32_t mantissaStartBit = highestSetBit - MANTISSA_BITS;
+			exp = mantissaStartBit + 1;
+			mantissa = (size >> mantissaStartBit) & MANTISSA_MASK;
+		}
+		return (exp << MANTISSA_BITS) | mantissa;
+	}
+
+	uint32_t BinToSize(uint32_t bin)
+	{
+		uint32_t exp = bin >> MANTISSA_BITS;
+		uint32_t mantissa = bin & MANTISSA_MASK;
+		if (exp == 0)
+			return mantissa;
+		return (mantissa | MANTISSA_VALUE) << (exp - 1);
+	}
+
+	uint32_t FindLowestSetBitAfter(uint32_t mask, uint32_t startBit)
+	{
+		//past the last top bin, and shifting by 32 is undefined
+		if (startBit >= 32)
+			return OffsetAllocator::NO_SPACE;
+		uint32_t bits = mask & ~((1u << startBit) - 1);
+		if (bits == 0)
+			return OffsetAllocator::NO_SPACE;
+		return std::countr_zero(bits);
+	}
+}
+
+OffsetAllocator::OffsetAllocator(uint32_t size, uint32_t maxAllocations)
+{
+	Init(size, maxAllocations);
+}
+
+void OffsetAllocator::Init(uint32_t size, uint32_t maxAllocations)
+{
+	this->size = size;
+	maxAllocs = maxAllocations;
+	Reset();
+}
+
+void OffsetAllocator::Reset()
+{
+	freeStorage = 0;
+	usedBinsTop = 0;
+	std::fill(std::begin(usedBins), std::end(usedBins), uint8_t(0));
+	std::fill(std::begin(binIndices), std::end(binIndices), UNUSED);
+
+	nodes.assign(maxAllocs, Node{});
+	freeNodes.resize(maxAllocs);
+	//popped from the back, so node 0 is handed out first
+	for (uint32_t i = 0; i < maxAllocs; i++)
+		freeNodes[i] = maxAllocs - i - 1;
+
+	lastNode = InsertNodeIntoBin(size, 0);
+}
+
+OffsetAllocator::Allocation OffsetAllocator::Allocate(uint32_t size)
+{
+	//the remainder of a split needs a node of its own
+	if (size == 0 || freeNodes.empty())
+		return {};
+
+	uint32_t minBinIndex = SizeToBinRoundUp(size);
+	uint32_t minTopBinIndex = minBinIndex >> MANTISSA_BITS;
+	uint32_t minLeafBinIndex = minBinIndex & MANTISSA_MASK;
+
+	uint32_t topBinIndex = minTopBinIndex;
+	uint32_t leafBinIndex = NO_SPACE;
+
+	if (usedBinsTop & (1u << topBinIndex))
+		leafBinIndex = FindLowestSetBitAfter(usedBins[topBinIndex], minLeafBinIndex);
+
+	//nothing big enough in the same top bin, take the smallest node of the next used one
+	if (leafBinIndex == NO_SPACE) {
+		topBinIndex = FindLowestSetBitAfter(usedBinsTop, minTopBinIndex + 1);
+		if (topBinIndex == NO_SPACE)
+			return {};
+
+		leafBinIndex = std::countr_zero(static_cast<uint32_t>(usedBins[topBinIndex]));
+	}
+
+	uint32_t binIndex = (topBinIndex << MANTISSA_BITS) | leafBinIndex;
+
+	uint32_t nodeIndex = binIndices[binIndex];
+	Node& node = nodes[nodeIndex];
+	uint32_t nodeTotalSize = node.dataSize;
+	node.dataSize = size;
+	node.used = true;
+
+	binIndices[binIndex] = node.binListNext;
+	if (node.binListNext != UNUSED)
+		nodes[node.binListNext].binListPrev = UNUSED;
+	freeStorage -= nodeTotalSize;
+
+	if (binIndices[binIndex] == UNUSED) {
+		usedBins[topBinIndex] &= ~(1u << leafBinIndex);
+		if (usedBins[topBinIndex] == 0)
+			usedBinsTop &= ~(1u << topBinIndex);
+	}
+
+	//return the tail of the node to the free lists
+	uint32_t remainder = nodeTotalSize - size;
+	if (remainder > 0) {
+		uint32_t newNodeIndex = InsertNodeIntoBin(remainder, node.dataOffset + size);
+
+		if (node.neighborNext != UNUSED)
+			nodes[node.neighborNext].neighborPrev = newNodeIndex;
+		else
+			lastNode = newNodeIndex;
+		nodes[newNodeIndex].neighborPrev = nodeIndex;
+		nodes[newNodeIndex].neighborNext = node.neighborNext;
+		node.neighborNext = newNodeIndex;
+	}
+
+	return Allocation{ .offset = node.dataOffset, .metadata = nodeIndex };
+}
+
+void OffsetAllocator::Free(Allocation allocation)
+{
+	if (!allocation.IsValid() || allocation.metadata >= nodes.size())
+		return;
+
+	uint32_t nodeIndex = allocation.metadata;
+	Node& node = nodes[nodeIndex];
+	assert(node.used && "double free of an offset allocation");
+
+	uint32_t offset = node.dataOffset;
+	uint32_t size = node.dataSize;
+
+	//merge with free neighbours so the address space does not fragment into slivers
+	if (node.neighborPrev != UNUSED && !nodes[node.neighborPrev].used) {
+		Node& prevNode = nodes[node.neighborPrev];
+		offset = prevNode.dataOffset;
+		size += prevNode.dataSize;
+
+		RemoveNodeFromBin(node.neighborPrev);
+		node.neighborPrev = prevNode.neighborPrev;
+	}
+
+	if (node.neighborNext != UNUSED && !nodes[node.neighborNext].used) {
+		Node& nextNode = nodes[node.neighborNext];
+		size += nextNode.dataSize;
+
+		RemoveNodeFromBin(node.neighborNext);
+		node.neighborNext = nextNode.neighborNext;
+	}
+
+	uint32_t neighborNext = node.neighborNext;
+	uint32_t neighborPrev = node.neighborPrev;
+
+	freeNodes.push_back(nodeIndex);
+
+	uint32_t combinedNodeIndex = InsertNodeIntoBin(size, offset);
+	if (neighborNext != UNUSED) {
+		nodes[combinedNodeIndex].neighborNext = neighborNext;
+		nodes[neighborNext].neighborPrev = combinedNodeIndex;
+	}
+	else {
+		lastNode = combinedNodeIndex;
+	}
+	if (neighborPrev != UNUSED) {
+		nodes[combinedNodeIndex].neighborPrev = neighborPrev;
+		nodes[neighborPrev].neighborNext = combinedNodeIndex;
+	}
+}
+
+bool OffsetAllocator::Resize(uint32_t newSize)
+{
+	if (newSize == size)
+		return true;
+
+	Node& tail = nodes[lastNode];
+	uint32_t tailIndex = lastNode;
+
+	if (newSize > size) {
+		if (tail.used) {
+			//append a new free block after the last allocation
+			if (freeNodes.empty())
+				return false;
+
+			uint32_t newNodeIndex = InsertNodeIntoBin(newSize - size, size);
+			nodes[newNodeIndex].neighborPrev = tailIndex;
+			tail.neighborNext = newNodeIndex;
+			lastNode = newNodeIndex;
+		}
+		else {
+			//the free tail just gets longer, it has to move bins though
+			uint32_t offset = tail.dataOffset;
+			uint32_t neighborPrev = tail.neighborPrev;
+			RemoveNodeFromBin(tailIndex);
+
+			lastNode = InsertNodeIntoBin(newSize - offset, offset);
+			nodes[lastNode].neighborPrev = neighborPrev;
+			if (neighborPrev != UNUSED)
+				nodes[neighborPrev].neighborNext = lastNode;
+		}
+		size = newSize;
+		return true;
+	}
+
+	//shrinking only cuts into the free tail block
+	if (tail.used || tail.dataOffset > newSize)
+		return false;
+
+	uint32_t offset = tail.dataOffset;
+	uint32_t neighborPrev = tail.neighborPrev;
+	RemoveNodeFromBin(tailIndex);
+
+	if (offset == newSize) {
+		//the cut lands exactly on the last allocation
+		lastNode = neighborPrev;
+		if (neighborPrev != UNUSED)
+			nodes[neighborPrev].neighborNext = UNUSED;
+	}
+	else {
+		lastNode = InsertNodeIntoBin(newSize - offset, offset);
+		nodes[lastNode].neighborPrev = neighborPrev;
+		if (neighborPrev != UNUSED)
+			nodes[neighborPrev].neighborNext = lastNode;
+	}
+	size = newSize;
+	return true;
+}
+
+uint32_t OffsetAllocator::GetUsedExtent() const
+{
+	if (lastNode == UNUSED)
+		return size;
+
+	const Node& tail = nodes[lastNode];
+	return tail.used ? size : tail.dataOffset;
+}
+
+uint32_t OffsetAllocator::AllocationSize(Allocation allocation) const
+{
+	if (!allocation.IsValid() || allocation.metadata >= nodes.size())
+		return 0;
+	return nodes[allocation.metadata].dataSize;
+}
+
+OffsetAllocator::StorageReport OffsetAllocator::GetStorageReport() const
+{
+	StorageReport report;
+	report.totalFreeSpace = freeNodes.empty() ? 0 : freeStorage;
+
+	//the largest free region is only known down to its bin size
+	if (usedBinsTop && !freeNodes.empty()) {
+		uint32_t topBinIndex = 31 - std::countl_zero(usedBinsTop);
+		uint32_t leafBinIndex = 31 - std::countl_zero(static_cast<uint32_t>(usedBins[topBinIndex]));
+		report.largestFreeRegion = BinToSize((topBinIndex << MANTISSA_BITS) | leafBinIndex);
+	}
+	return report;
+}
+
+uint32_t OffsetAllocator::InsertNodeIntoBin(uint32_t size, uint32_t dataOffset)
+{
+	uint32_t binIndex = SizeToBinRoundDown(size);
+	uint32_t topBinIndex = binIndex >> MANTISSA_BITS;
+	uint32_t leafBinIndex = binIndex & MANTISSA_MASK;
+
+	if (binIndices[binIndex] == UNUSED) {
+		usedBins[topBinIndex] |= 1u << leafBinIndex;
+		usedBinsTop |= 1u << topBinIndex;
+	}
+
+	uint32_t topNodeIndex = binIndices[binIndex];
+	uint32_t nodeIndex = freeNodes.back();
+	freeNodes.pop_back();
+
+	nodes[nodeIndex] = Node{ .dataOffset = dataOffset, .dataSize = size, .binListNext = topNodeIndex };
+	if (topNodeIndex != UNUSED)
+		nodes[topNodeIndex].binListPrev = nodeIndex;
+	binIndices[binIndex] = nodeIndex;
+
+	freeStorage += size;
+	return nodeIndex;
+}
+
+void OffsetAllocator::RemoveNodeFromBin(uint32_t nodeIndex)
+{
+	Node& node = nodes[nodeIndex];
+
+	if (node.binListPrev != UNUSED) {
+		//in the middle of a bin list, just unlink it
+		nodes[node.binListPrev].binListNext = node.binListNext;
+		if (node.binListNext != UNUSED)
+			nodes[node.binListNext].binListPrev = node.binListPrev;
+	}
+	else {
+		//head of its bin, the bin may become empty
+		uint32_t binIndex = SizeToBinRoundDown(node.dataSize);
+		uint32_t topBinIndex = binIndex >> MANTISSA_BITS;
+		uint32_t leafBinIndex = binIndex & MANTISSA_MASK;
+
+		binIndices[binIndex] = node.binListNext;
+		if (node.binListNext != UNUSED)
+			nodes[node.binListNext].binListPrev = UNUSED;
+
+		if (binIndices[binIndex] == UNUSED) {
+			usedBins[topBinIndex] &= ~(1u << leafBinIndex);
+			if (usedBins[topBinIndex] == 0)
+				usedBinsTop &= ~(1u << topBinIndex);
+		}
+	}
+
+	freeNodes.push_back(nodeIndex);
+	freeStorage -= node.dataSize;
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+
+//Two level segregated fit (TLSF) allocator for ranges inside a fixed size address space.
+//It never touches memory itself, offsets are handed out in whatever unit the caller uses
+//(vertices, index words, bytes) and map onto a buffer the caller owns. Allocation and free are O(1)
+struct OffsetAllocator {
+	static constexpr uint32_t NO_SPACE = ~0u;
+
+	struct Allocation {
+		uint32_t offset = NO_SPACE;
+		//node index, needed to free the range again
+		uint32_t metadata = NO_SPACE;
+
+		bool IsValid() const { return offset != NO_SPACE; }
+	};
+
+	struct StorageReport {
+		uint32_t totalFreeSpace = 0;
+		uint32_t largestFreeRegion = 0;
+	};
+
+	OffsetAllocator() {}
+	OffsetAllocator(uint32_t size, uint32_t maxAllocations = 128 * 1024);
+
+	void Init(uint32_t size, uint32_t maxAllocations = 128 * 1024);
+	void Reset();
+
+	Allocation Allocate(uint32_t size);
+	void Free(Allocation allocation);
+
+	//Grows the address space, or shrinks it when everything past newSize is free
+	bool Resize(uint32_t newSize);
+
+	uint32_t AllocationSize(Allocation allocation) const;
+	uint32_t GetSize() const { return size; }
+	//End of the highest range still in use, everything past it is one free block
+	uint32_t GetUsedExtent() const;
+	StorageReport GetStorageReport() const;
+
+private:
+	static constexpr uint32_t NUM_TOP_BINS = 32;
+	static constexpr uint32_t BINS_PER_LEAF = 8;
+	static constexpr uint32_t NUM_LEAF_BINS = NUM_TOP_BINS * BINS_PER_LEAF;
+	static constexpr uint32_t UNUSED = ~0u;
+
+	struct Node {
+		uint32_t dataOffset = 0;
+		uint32_t dataSize = 0;
+		uint32_t binListPrev = UNUSED;
+		uint32_t binListNext = UNUSED;
+		uint32_t neighborPrev = UNUSED;
+		uint32_t neighborNext = UNUSED;
+		bool used = false;
+	};
+
+	uint32_t InsertNodeIntoBin(uint32_t size, uint32_t dataOffset);
+	void RemoveNodeFromBin(uint32_t nodeIndex);
+
+	uint32_t size = 0;
+	uint32_t maxAllocs = 0;
+	uint32_t freeStorage = 0;
+	//node at the end of the address space
+	uint32_t lastNode = UNUSED;
+
+	uint32_t usedBinsTop = 0;
+	uint8_t usedBins[NUM_TOP_BINS] = {};
+	uint32_t binIndices[NUM_LEAF_BINS] = {};
+
+	std::vector<Node> nodes;
+	std::vector<uint32_t> freeNodes;
+};
@@ -0,0 +1,186 @@
+#include "pipeline_cache.h"
+#include "profiling.h"
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+
+//"SIPC"
+constexpr uint32_t PIPELINE_CACHE_MAGIC = 0x43504953;
+//bump when FileHeader changes
+constexpr uint32_t PIPELINE_CACHE_VERSION = 1;
+
+void PipelineCache::Init(VkDevice vk_device, VkPhysicalDevice physicalDevice, std::string_view cachePath)
+{
+	TRACE_SCOPE("PipelineCache::Init", cachePath);
+	device = vk_device;
+	path = std::string(cachePath);
+
+	VkPhysicalDeviceVulkan11Properties properties11{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_1_PROPERTIES };
+	VkPhysicalDeviceProperties2 properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &properties11 };
+	vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+
+	header.magic = PIPELINE_CACHE_MAGIC;
+	header.version = PIPELINE_CACHE_VERSION;
+	header.vendor_id = properties.properties.vendorID;
+	header.device_id = properties.properties.deviceID;
+	header.driver_version = properties.properties.driverVersion;
+	memcpy(header.device_uuid, properties11.deviceUUID, VK_UUID_SIZE);
+	memcpy(header.pipeline_cache_uuid, properties.properties.pipelineCacheUUID, VK_UUID_SIZE);
+
+	const std::vector<uint8_t> data = Load();
+	VkPipelineCacheCreateInfo info{ .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+	info.initialDataSize = data.size();
+	info.pInitialData = data.data();
+	if (vkCreatePipelineCache(device, &info, nullptr, &cache) != VK_SUCCESS)
+	{
+		//the header matched but the driver still refused the data, start over with an empty cache
+		fmt::println("Pipeline cache {} was rejected by the driver", path);
+		info.initialDataSize = 0;
+		info.pInitialData = nullptr;
+		VK_CHECK(vkCreatePipelineCache(device, &info, nullptr, &cache));
+	}
+	else
+		stats.loaded_bytes = data.size();
+}
+
+std::vector<uint8_t> PipelineCache::Load() const
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		return {};
+
+	FileHeader stored;
+	file.read(reinterpret_cast<char*>(&stored), sizeof(stored));
+	if (!file || stored.magic != header.magic || stored.version != header.version)
+	{
+		fmt::println("Pipeline cache {} isn't one of ours, ignoring it", path);
+		return {};
+	}
+	if (stored.vendor_id != header.vendor_id || stored.device_id != header.device_id || stored.driver_version != header.driver_version ||
+		memcmp(stored.device_uuid, header.device_uuid, VK_UUID_SIZE) != 0 ||
+		memcmp(stored.pipeline_cache_uuid, header.pipeline_cache_uuid, VK_UUID_SIZE) != 0)
+	{
+		fmt::println("Pipeline cache {} was written for another device or driver, rebuilding it", path);
+		return {};
+	}
+
+	//checked before allocating, a damaged header could ask for anything
+	std::error_code error;
+	const uint64_t file_size = std::filesystem::file_size(path, error);
+	if (error || file_size != sizeof(stored) + stored.data_size)
+	{
+		fmt::println("Pipeline cache {} is truncated, ignoring it", path);
+		return {};
+	}
+
+	std::vector<uint8_t> data(stored.data_size);
+	file.read(reinterpret_cast<char*>(data.data()), data.size());
+	if (!file)
+		return {};
+	return data;
+}
+
+bool PipelineCache::Save()
+{
+	if (cache == VK_NULL_HANDLE)
+		return false;
+
+	size_t size = 0;
+	VK_CHECK(vkGetPipelineCacheData(device, cache, &size, nullptr));
+	std::vector<uint8_t> data(size);
+	VK_CHECK(vkGetPipelineCacheData(device, cache, &size, data.data()));
+
+	FileHeader written = header;
+	written.data_size = size;
+	const std::string temporary = path + ".tmp";
+	{
+		std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+		if (!file.is_open())
+		{
+			fmt::println("Failed to open {}", temporary);
+			return false;
+		}
+		file.write(reinterpret_cast<const char*>(&written), sizeof(written));
+		file.write(reinterpret_cast<const char*>(data.data()), size);
+		if (!file.good())
+		{
+			fmt::println("Failed to write {}", temporary);
+			return false;
+		}
+	}
+
+	//replaces the old file in one step, a reader sees either the old cache or the new one
+	std::error_code error;
+	std::filesystem::rename(temporary, path, error);
+	if (error)
+	{
+		fmt::println("Failed to replace {}: {}", path, error.message());
+		std::filesystem::remove(temporary, error);
+		return false;
+	}
+
+	const PipelineCacheStats totals = GetStats();
+	fmt::println("Pipeline cache: {} of {} pipelines found in the cache this run, {:.1f} KB written to {}", totals.cache_hits, totals.pipelines,
+		size / 1024.0f, path);
+	return true;
+}
+
+void PipelineCache::Cleanup()
+{
+	if (cache == VK_NULL_HANDLE)
+		return;
+	Save();
+	vkDestroyPipelineCache(device, cache, nullptr);
+	cache = VK_NULL_HANDLE;
+}
+
+VkResult PipelineCache::CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info, const char* name, VkPipeline* pipeline)
+{
+	TRACE_SCOPE("vkCreateGraphicsPipelines", name);
+	VkPipelineCreationFeedback feedback{};
+	VkPipelineCreationFeedbackCreateInfo feedback_info{ .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO };
+	feedback_info.pNext = info.pNext;
+	feedback_info.pPipelineCreationFeedback = &feedback;
+
+	VkGraphicsPipelineCreateInfo chained = info;
+	chained.pNext = &feedback_info;
+	const auto start = std::chrono::steady_clock::now();
+	const VkResult result = vkCreateGraphicsPipelines(device, cache, 1, &chained, nullptr, pipeline);
+	Record(feedback, std::chrono::steady_clock::now() - start);
+	return result;
+}
+
+VkResult PipelineCache::CreateComputePipeline(const VkComputePipelineCreateInfo& info, const char* name, VkPipeline* pipeline)
+{
+	TRACE_SCOPE("vkCreateComputePipelines", name);
+	VkPipelineCreationFeedback feedback{};
+	VkPipelineCreationFeedbackCreateInfo feedback_info{ .sType = VK_STRUCTURE_TYPE_PIPELINE_CREATION_FEEDBACK_CREATE_INFO };
+	feedback_info.pNext = info.pNext;
+	feedback_info.pPipelineCreationFeedback = &feedback;
+
+	VkComputePipelineCreateInfo chained = info;
+	chained.pNext = &feedback_info;
+	const auto start = std::chrono::steady_clock::now();
+	const VkResult result = vkCreateComputePipelines(device, cache, 1, &chained, nullptr, pipeline);
+	Record(feedback, std::chrono::steady_clock::now() - start);
+	return result;
+}
+
+void PipelineCache::Record(const VkPipelineCreationFeedback& feedback, std::chrono::steady_clock::duration elapsed)
+{
+	const bool valid = (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_VALID_BIT) != 0;
+	//the driver's own duration when it gave one
+	const float ms = valid ? feedback.duration / 1'000'000.0f : std::chrono::duration<float, std::milli>(elapsed).count();
+
+	std::lock_guard lock(stats_mutex);
+	stats.pipelines++;
+	if (valid && (feedback.flags & VK_PIPELINE_CREATION_FEEDBACK_APPLICATION_PIPELINE_CACHE_HIT_BIT) != 0)
+		stats.cache_hits++;
+	stats.creation_ms += ms;
+}
+
+PipelineCacheStats PipelineCache::GetStats() const
+{
+	std::lock_guard lock(stats_mutex);
+	return stats;
+}
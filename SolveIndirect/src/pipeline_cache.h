@@ -0,0 +1,61 @@
+#pragma once
+#include "vk_types.h"
+#include <chrono>
+#include <mutex>
+
+//Where the cache is kept between runs, in the working directory like the benchmark reports
+constexpr const char* PIPELINE_CACHE_DEFAULT_PATH = "pipeline_cache.bin";
+
+struct PipelineCacheStats {
+	uint32_t pipelines = 0;
+	//pipelines the driver reported through creation feedback as found in the cache, nothing was compiled for them
+	uint32_t cache_hits = 0;
+	//the creation times added up, above the wall time when pipelines were created in parallel
+	float creation_ms = 0.0f;
+	//bytes handed to the driver at startup, 0 when there was no file or it was written for another device or driver
+	size_t loaded_bytes = 0;
+};
+
+//A VkPipelineCache kept on disk between runs, so a warm start skips most shader compilation.
+//The file starts with the vendor, device, driver version, device UUID and pipelineCacheUUID it was written under, a file from
+//another GPU or driver is dropped instead of being handed to the driver. Every pipeline is created through here with creation
+//feedback chained on, which tells whether the driver found it in the cache
+struct PipelineCache {
+	void Init(VkDevice device, VkPhysicalDevice physicalDevice, std::string_view path = PIPELINE_CACHE_DEFAULT_PATH);
+	//Writes the cache to a temporary file and renames it over the old one, a crash while saving leaves the old file whole
+	bool Save();
+	//Saves the cache and destroys it, call before the device is destroyed
+	void Cleanup();
+
+	//Safe to call from several threads at once, the cache is synchronized by the driver. name is shown in the startup trace
+	VkResult CreateGraphicsPipeline(const VkGraphicsPipelineCreateInfo& info, const char* name, VkPipeline* pipeline);
+	VkResult CreateComputePipeline(const VkComputePipelineCreateInfo& info, const char* name, VkPipeline* pipeline);
+
+	PipelineCacheStats GetStats() const;
+	VkPipelineCache Get() const { return cache; }
+
+private:
+	//Identifies what a cache file was written for, stored in front of the driver's data
+	struct FileHeader {
+		uint32_t magic = 0;
+		uint32_t version = 0;
+		uint32_t vendor_id = 0;
+		uint32_t device_id = 0;
+		uint32_t driver_version = 0;
+		uint8_t device_uuid[VK_UUID_SIZE] = {};
+		uint8_t pipeline_cache_uuid[VK_UUID_SIZE] = {};
+		uint64_t data_size = 0;
+	};
+
+	//Reads the file and returns the driver's data if the header matches this device
+	std::vector<uint8_t> Load() const;
+	void Record(const VkPipelineCreationFeedback& feedback, std::chrono::steady_clock::duration elapsed);
+
+	VkDevice device = VK_NULL_HANDLE;
+	VkPipelineCache cache = VK_NULL_HANDLE;
+	std::string path;
+	FileHeader header;
+
+	mutable std::mutex stats_mutex;
+	PipelineCacheStats stats;
+};
@@ -0,0 +1,9 @@
+#pragma once
+#include <vulkan/vulkan.h>
+
+//Tracy is compiled in when TRACY_ENABLE is defined, building with /p:EnableTracy=true defines it and builds the client.
+//Without it every Tracy macro expands to nothing, zones, lock markers and allocation hooks cost nothing
+#include "../../tracy/public/tracy/Tracy.hpp"
+#include "../../tracy/public/tracy/TracyVulkan.hpp"
+//TRACE_SCOPE records into the startup trace, which is written out once the first frame is submitted
+#include "startup_trace.h"
@@ -1,18 +1,57 @@
 #include "resource_manager.h"
 #include "stb_image.h"
 #include "vk_engine.h"
+#include "mesh_optimizer.h"
+#include "vk_buffer.h"
+#include "profiling.h"
+#include <future>
+#include <limits>
 
 #define USE_BINDLESS
 
+//First mip of the chain small enough to be resident from the start
+static uint32_t streaming_tail_mip(const TextureMipChain& mipChain)
+{
+    const uint32_t extent = std::max(mipChain.extent.width, mipChain.extent.height);
+    uint32_t mip = 0;
+    while (mip + 1 < mipChain.mips.size() && (extent >> mip) > TEXTURE_STREAMING_TAIL_EXTENT)
+        mip++;
+    return mip;
+}
+
+static VkDeviceSize mip_chain_bytes(const TextureMipChain& mipChain, uint32_t firstMip, uint32_t endMip)
+{
+    VkDeviceSize bytes = 0;
+    for (uint32_t mip = firstMip; mip < endMip; mip++)
+        bytes += mipChain.mips[mip].size();
+    return bytes;
+}
+
+//Copies mips [firstMip, endMip) of the chain into the staging memory at offset, imageFirstMip being the
+//chain mip the image starts at. Returns the offset past the copied data
+static VkDeviceSize stage_mips(const TextureMipChain& mipChain, uint32_t firstMip, uint32_t endMip, uint32_t imageFirstMip,
+    uint8_t* staging, VkDeviceSize offset, std::vector<VkBufferImageCopy>& regions)
+{
+    for (uint32_t mip = firstMip; mip < endMip; mip++) {
+        memcpy(staging + offset, mipChain.mips[mip].data(), mipChain.mips[mip].size());
+
+        VkBufferImageCopy region = {};
+        region.bufferOffset = offset;
+        region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+        region.imageSubresource.mipLevel = mip - imageFirstMip;
+        region.imageSubresource.baseArrayLayer = 0;
+        region.imageSubresource.layerCount = 1;
+        region.imageExtent = vkutil::mip_extent(mipChain.extent, mip);
+        regions.push_back(region);
+
+        offset += mipChain.mips[mip].size();
+    }
+    return offset;
+}
+
 void ResourceManager::init(VulkanEngine* engine_ptr) {
     engine = engine_ptr;
-
-    std::vector<DescriptorAllocator::PoolSizeRatio> bindless_sizes = {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
-    };
-    bindless_material_descriptor.init_pool(engine->_device, 65536, bindless_sizes, true);
+    retire_queue.Init(engine);
 
     //Create default images
     uint32_t white = glm::packUnorm4x8(glm::vec4(1, 1, 1, 1));
@@ -48,19 +87,16 @@ void ResourceManager::init(VulkanEngine* engine_ptr) {
     sampl.magFilter = VK_FILTER_LINEAR;
     sampl.minFilter = VK_FILTER_LINEAR;
     vkCreateSampler(engine->_device, &sampl, nullptr, &defaultSamplerLinear);
+
+    geometry_heap.Init(this);
+    deletionQueue.push_function([this]() { geometry_heap.Cleanup(); });
     
 }
 
 ResourceManager::ResourceManager(VulkanEngine* engine)
 {
     this->engine = engine;
-
-    std::vector<DescriptorAllocator::PoolSizeRatio> bindless_sizes = {
-        { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 1 },
-        { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 1 },
-        { VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, 1 },
-    };
-    bindless_material_descriptor.init_pool(engine->_device, 65536, bindless_sizes, true);
+    retire_queue.Init(engine);
 
     //Create default images
     uint32_t white = glm::packUnorm4x8(glm::vec4(1, 1, 1, 1));
@@ -100,6 +136,9 @@ ResourceManager::ResourceManager(VulkanEngine* engine)
     sampl.magFilter = VK_FILTER_LINEAR;
     sampl.minFilter = VK_FILTER_LINEAR;
     vkCreateSampler(engine->_device, &sampl, nullptr, &defaultSamplerLinear);
+
+    geometry_heap.Init(this);
+    deletionQueue.push_function([this]() { geometry_heap.Cleanup(); });
 }
 VkFilter ResourceManager::extract_filter(fastgltf::Filter filter)
 {
@@ -149,9 +188,112 @@ MaterialInstance ResourceManager::SetMaterialProperties(const vkutil::MaterialPa
     return matData;
 }
 
+GLTFMetallic_Roughness::MaterialResources ResourceManager::DefaultMaterialResources() const
+{
+    GLTFMetallic_Roughness::MaterialResources resources;
+    resources.colorImage = _whiteImage;
+    resources.colorSampler = defaultSamplerLinear;
+    resources.metalRoughImage = _whiteImage;
+    resources.metalRoughSampler = defaultSamplerLinear;
+    resources.normalImage = _whiteImage;
+    resources.normalSampler = defaultSamplerLinear;
+    resources.occlusionImage = _whiteImage;
+    resources.occlusionSampler = defaultSamplerLinear;
+    return resources;
+}
+
+std::shared_ptr<GLTFMaterial> ResourceManager::AddMaterial(LoadedGLTF& scene, const std::string& name, GPUMaterial gpuMaterial,
+    const GLTFMetallic_Roughness::MaterialResources& resources, vkutil::MaterialPass passType)
+{
+    std::shared_ptr<GLTFMaterial> newMat = std::make_shared<GLTFMaterial>();
+    scene.materials[name] = newMat;
+
+    //Store each textures Materials, identical textures share a slot
+    gpuMaterial.textures = MaterialTextureSlots{
+        .color = bindless_table.AcquireTexture(resources.colorImage.imageView, resources.colorSampler),
+        .metalRough = bindless_table.AcquireTexture(resources.metalRoughImage.imageView, resources.metalRoughSampler),
+        .normal = bindless_table.AcquireTexture(resources.normalImage.imageView, resources.normalSampler),
+        .occlusion = bindless_table.AcquireTexture(resources.occlusionImage.imageView, resources.occlusionSampler)
+    };
+    const uint32_t material_index = bindless_table.AllocateMaterial(gpuMaterial);
+    if (material_index >= bindless_resources.size())
+        bindless_resources.resize(material_index + 1);
+    bindless_resources[material_index] = resources;
+    scene.bindlessMaterials.push_back(material_index);
+    newMat->material_index = material_index;
+    newMat->data = SetMaterialProperties(passType, newMat->material_index);
+    return newMat;
+}
+
 
 std::optional<std::shared_ptr<LoadedGLTF>> ResourceManager::loadGltf(VulkanEngine* engine, std::string_view filePath, bool isPBRMaterial)
 {
+    ZoneScoped;
+    std::shared_ptr<GltfSource> source = ParseGltf(filePath);
+    if (!source)
+        return {};
+    return UploadGltf(engine, *source, isPBRMaterial);
+}
+
+//Converts every primitive of the mesh into one vertex and index array, reorders each surface for the post transform
+//cache and overdraw and splits the indices into the 16 and 32 bit arrays. The statistics are added to the source's
+static GltfMeshSource convert_mesh(GltfSource& source, const fastgltf::Mesh& mesh)
+{
+    TRACE_SCOPE("convert_mesh", std::string_view(mesh.name.data(), mesh.name.size()));
+    GltfMeshSource result;
+    std::vector<uint32_t> indices;
+    for (auto&& p : mesh.primitives) {
+        result.surfaces.push_back(ResourceManager::ConvertPrimitive(source.asset, p, indices, result.vertices));
+        result.surface_materials.push_back(p.materialIndex.value_or(0));
+    }
+
+    //surfaces own disjoint ranges of both arrays so they can be processed in parallel
+    std::vector<std::future<BlackKey::MeshOptimizationResult>> optimizations;
+    for (const GeoSurface& surface : result.surfaces) {
+        std::span<uint32_t> surfaceIndices(indices.data() + surface.startIndex, surface.count);
+        std::span<Vertex> surfaceVertices(result.vertices.data() + surface.firstVertex, surface.vertex_count);
+        uint32_t baseVertex = surface.firstVertex;
+
+        optimizations.push_back(std::async(std::launch::async, [=] {
+            return BlackKey::OptimizeSurface(surfaceIndices, surfaceVertices, baseVertex);
+            }));
+    }
+
+    for (auto& optimization : optimizations) {
+        BlackKey::MeshOptimizationResult optimized = optimization.get();
+        source.cache_before.vertices_transformed += optimized.before.vertices_transformed;
+        source.cache_before.triangle_count += optimized.before.triangle_count;
+        source.cache_before.vertex_count += optimized.before.vertex_count;
+        source.cache_after.vertices_transformed += optimized.after.vertices_transformed;
+    }
+
+    //store indices relative to the surface's first vertex, so any surface with up to 65536 vertices
+    //can use 16 bit indices and is drawn with its first vertex as the vertexOffset
+    for (GeoSurface& surface : result.surfaces) {
+        std::span<uint32_t> surfaceIndices(indices.data() + surface.startIndex, surface.count);
+
+        if (surface.vertex_count <= std::numeric_limits<uint16_t>::max() + 1) {
+            surface.indexType = VK_INDEX_TYPE_UINT16;
+            surface.startIndex = (uint32_t)result.indices16.size();
+            for (uint32_t idx : surfaceIndices)
+                result.indices16.push_back(static_cast<uint16_t>(idx - surface.firstVertex));
+        }
+        else {
+            surface.indexType = VK_INDEX_TYPE_UINT32;
+            surface.startIndex = (uint32_t)result.indices32.size();
+            for (uint32_t idx : surfaceIndices)
+                result.indices32.push_back(idx - surface.firstVertex);
+        }
+    }
+    source.index_bytes += result.indices16.size() * sizeof(uint16_t) + result.indices32.size() * sizeof(uint32_t);
+    source.index_bytes_32 += indices.size() * sizeof(uint32_t);
+    return result;
+}
+
+std::shared_ptr<GltfSource> ResourceManager::ParseGltf(std::string_view filePath)
+{
+    ZoneScoped;
+    TRACE_SCOPE("ParseGltf", filePath);
     std::string rootPath(filePath.begin(), filePath.end());
     rootPath = rootPath.substr(0, rootPath.find_last_of('/') + 1);
     auto name = filePath.substr(filePath.find_last_of('/') + 1, filePath.size() - (filePath.find_last_of('.') -1 ));
@@ -160,9 +302,8 @@ std::optional<std::shared_ptr<LoadedGLTF>> ResourceManager::loadGltf(VulkanEngin
     //> load_1
     fmt::println("Loading GLTF: {}", std::string(name) + ".gltf");
 
-    std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
-    scene->creator = this;
-    LoadedGLTF& file = *scene.get();
+    std::shared_ptr<GltfSource> source = std::make_shared<GltfSource>();
+    source->path = std::string(filePath);
 
     fastgltf::Parser parser{};
 
@@ -172,7 +313,7 @@ std::optional<std::shared_ptr<LoadedGLTF>> ResourceManager::loadGltf(VulkanEngin
     fastgltf::GltfDataBuffer data;
     data.loadFromFile(filePath);
 
-    fastgltf::Asset gltf;
+    fastgltf::Asset& gltf = source->asset;
 
     std::filesystem::path path = filePath;
 
@@ -202,6 +343,122 @@ std::optional<std::shared_ptr<LoadedGLTF>> ResourceManager::loadGltf(VulkanEngin
         return {};
     }
     //< load_1
+
+    //decoding and building the mip chains is most of the cost of loading, none of it needs the device
+    source->images.reserve(gltf.images.size());
+    for (fastgltf::Image& image : gltf.images) {
+        source->images.push_back(decode_image(gltf, image, rootPath));
+    }
+
+    //neither does converting and reordering the meshes, UploadGltf only copies the results into the geometry heap
+    source->meshes.reserve(gltf.meshes.size());
+    for (fastgltf::Mesh& mesh : gltf.meshes) {
+        source->meshes.push_back(convert_mesh(*source, mesh));
+    }
+    return source;
+}
+
+GeoSurface ResourceManager::ConvertPrimitive(const fastgltf::Asset& gltf, const fastgltf::Primitive& p, std::vector<uint32_t>& indices, std::vector<Vertex>& vertices)
+{
+    GeoSurface newSurface;
+    newSurface.startIndex = (uint32_t)indices.size();
+    newSurface.count = (uint32_t)gltf.accessors[p.indicesAccessor.value()].count;
+
+    size_t initial_vtx = vertices.size();
+    newSurface.firstVertex = (uint32_t)initial_vtx;
+
+    // load indexes
+    {
+        const fastgltf::Accessor& indexaccessor = gltf.accessors[p.indicesAccessor.value()];
+        indices.reserve(indices.size() + indexaccessor.count);
+
+        fastgltf::iterateAccessor<std::uint32_t>(gltf, indexaccessor,
+            [&](std::uint32_t idx) {
+                indices.push_back(idx + initial_vtx);
+            });
+    }
+
+    // load vertex positions
+    {
+        const fastgltf::Accessor& posAccessor = gltf.accessors[p.findAttribute("POSITION")->second];
+        vertices.resize(vertices.size() + posAccessor.count);
+
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, posAccessor,
+            [&](glm::vec3 v, size_t index) {
+                Vertex newvtx;
+                newvtx.position = v;
+                newvtx.normal = { 1, 0, 0 };
+                newvtx.color = glm::vec4{ 1.f };
+                newvtx.uv_x = 0;
+                newvtx.uv_y = 0;
+                vertices[initial_vtx + index] = newvtx;
+            });
+    }
+
+    // load vertex normals
+    auto normals = p.findAttribute("NORMAL");
+    if (normals != p.attributes.end()) {
+
+        fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, gltf.accessors[(*normals).second],
+            [&](glm::vec3 v, size_t index) {
+                vertices[initial_vtx + index].normal = v;
+            });
+    }
+
+    // load UVs
+    auto uv = p.findAttribute("TEXCOORD_0");
+    if (uv != p.attributes.end()) {
+
+        fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf, gltf.accessors[(*uv).second],
+            [&](glm::vec2 v, size_t index) {
+                vertices[initial_vtx + index].uv_x = v.x;
+                vertices[initial_vtx + index].uv_y = v.y;
+            });
+    }
+
+    // load vertex colors
+    auto colors = p.findAttribute("COLOR_0");
+    if (colors != p.attributes.end()) {
+
+        fastgltf::iterateAccessorWithIndex<glm::vec4>(gltf, gltf.accessors[(*colors).second],
+            [&](glm::vec4 v, size_t index) {
+                vertices[initial_vtx + index].color = v;
+            });
+    }
+
+    auto tangent = p.findAttribute("TANGENT");
+    if (tangent != p.attributes.end()) {
+
+        fastgltf::iterateAccessorWithIndex<glm::vec4>(gltf, gltf.accessors[(*tangent).second],
+            [&](glm::vec4 v, size_t index) {
+                vertices[initial_vtx + index].tangents = glm::vec4(v);
+            });
+    }
+
+    glm::vec3 minpos = vertices[initial_vtx].position;
+    glm::vec3 maxpos = vertices[initial_vtx].position;
+    for (int i = initial_vtx; i < vertices.size(); i++) {
+        minpos = glm::min(minpos, vertices[i].position);
+        maxpos = glm::max(maxpos, vertices[i].position);
+    }
+
+    newSurface.bounds.origin = (maxpos + minpos) / 2.f;
+    newSurface.bounds.extents = (maxpos - minpos) / 2.f;
+    newSurface.bounds.sphereRadius = glm::length(newSurface.bounds.extents);
+    newSurface.vertex_count = vertices.size() - initial_vtx;
+    return newSurface;
+}
+
+std::optional<std::shared_ptr<LoadedGLTF>> ResourceManager::UploadGltf(VulkanEngine* engine, GltfSource& source, bool isPBRMaterial)
+{
+    ZoneScoped;
+    TRACE_SCOPE("UploadGltf", source.path);
+    fastgltf::Asset& gltf = source.asset;
+
+    std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
+    scene->creator = this;
+    LoadedGLTF& file = *scene.get();
+
     //> load_2
         // we can estimate the descriptors we will need accurately
     std::vector<DescriptorAllocatorGrowable::PoolSizeRatio> sizes = { { VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, 3 },
@@ -240,74 +497,49 @@ std::optional<std::shared_ptr<LoadedGLTF>> ResourceManager::loadGltf(VulkanEngin
 
     int count = 0;
     // load all textures
-    for (fastgltf::Image& image : gltf.images) {
-        std::optional<AllocatedImage> img = load_image(engine, gltf, image, rootPath);
-
-        if (img.has_value()) {
-            images.push_back(*img);
-            file.images["image" + std::to_string(count)] = *img;
+    for (size_t i = 0; i < gltf.images.size(); i++) {
+        std::optional<TextureMipChain>& mipChain = source.images[i];
+
+        if (mipChain.has_value()) {
+            //only the tail is uploaded now, the streamer brings in the larger mips once they are needed
+            const uint32_t tailMip = streaming_tail_mip(*mipChain);
+            AllocatedImage img = CreateStreamedTexture(*mipChain, tailMip);
+            images.push_back(img);
+            file.images["image" + std::to_string(count)] = img;
+            RegisterTexture(img, &file, "image" + std::to_string(count), std::move(*mipChain), tailMip);
             count++;
         }
         else {
             // we failed to load, so lets give the slot a default white texture to not
             // completely break loading
             images.push_back(errorCheckerboardImage);
-            std::cout << "gltf failed to load texture " << image.name << std::endl;
+            std::cout << "gltf failed to load texture " << gltf.images[i].name << std::endl;
         }
     }
 
-    //> load_buffer
-        // create buffer to hold the material data
-    file.materialDataBuffer = CreateBuffer(sizeof(GLTFMetallic_Roughness::MaterialConstants) * gltf.materials.size(),
-        VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
-
-    int material_index = last_material_index;
-    int data_index = 0;
-
-    GLTFMetallic_Roughness::MaterialConstants* sceneMaterialConstants = (GLTFMetallic_Roughness::MaterialConstants*)file.materialDataBuffer.info.pMappedData;
-    //< load_buffer
-        //
     //> load_material
     //std::vector< GLTFMetallic_Roughness::MaterialResources> bindless_resources;
     //bindless_resources.reserve(gltf.materials.size());
 
     for (fastgltf::Material& mat : gltf.materials) {
-        std::shared_ptr<GLTFMaterial> newMat = std::make_shared<GLTFMaterial>();
-        materials.push_back(newMat);
-        file.materials[mat.name.c_str()] = newMat;
-
+        //the constants go into the global material table with the texture slots
+        GPUMaterial gpuMaterial;
+        gpuMaterial.colorFactors.x = mat.pbrData.baseColorFactor[0];
+        gpuMaterial.colorFactors.y = mat.pbrData.baseColorFactor[1];
+        gpuMaterial.colorFactors.z = mat.pbrData.baseColorFactor[2];
+        gpuMaterial.colorFactors.w = mat.pbrData.baseColorFactor[3];
 
-        GLTFMetallic_Roughness::MaterialConstants constants;
-        constants.colorFactors.x = mat.pbrData.baseColorFactor[0];
-        constants.colorFactors.y = mat.pbrData.baseColorFactor[1];
-        constants.colorFactors.z = mat.pbrData.baseColorFactor[2];
-        constants.colorFactors.w = mat.pbrData.baseColorFactor[3];
-
-        constants.metal_rough_factors.x = mat.pbrData.metallicFactor;
-        constants.metal_rough_factors.y = mat.pbrData.roughnessFactor;
-        // write material parameters to buffer
-        sceneMaterialConstants[data_index] = constants;
+        gpuMaterial.metalRoughFactors.x = mat.pbrData.metallicFactor;
+        gpuMaterial.metalRoughFactors.y = mat.pbrData.roughnessFactor;
 
         vkutil::MaterialPass passType = vkutil::MaterialPass::forward;
         if (mat.alphaMode == fastgltf::AlphaMode::Blend) {
             passType = vkutil::MaterialPass::transparency;
         }
 
-        GLTFMetallic_Roughness::MaterialResources materialResources;
         // default the material textures
-        materialResources.colorImage = _whiteImage;
-        materialResources.colorSampler = defaultSamplerLinear;
-        materialResources.metalRoughImage = _whiteImage;
-        materialResources.metalRoughSampler = defaultSamplerLinear;
-        materialResources.normalImage = _whiteImage;
-        materialResources.normalSampler = defaultSamplerLinear;
-        materialResources.occlusionImage = _whiteImage;
-        materialResources.occlusionSampler = defaultSamplerLinear;
-
-
-        // set the uniform buffer for the material data
-        materialResources.dataBuffer = file.materialDataBuffer.buffer;
-        materialResources.dataBufferOffset = data_index * sizeof(GLTFMetallic_Roughness::MaterialConstants);
+        GLTFMetallic_Roughness::MaterialResources materialResources = DefaultMaterialResources();
+
         // grab textures from gltf file
         if (mat.pbrData.baseColorTexture.has_value()) {
             size_t img = gltf.textures[mat.pbrData.baseColorTexture.value().textureIndex].imageIndex.value();
@@ -350,134 +582,40 @@ std::optional<std::shared_ptr<LoadedGLTF>> ResourceManager::loadGltf(VulkanEngin
 
         // build material
 #if USE_BINDLESS 1
-        //Store each textures Materials
-        bindless_resources.push_back(materialResources);
-        newMat->material_index = material_index * 4;
-        newMat->data = SetMaterialProperties(passType, newMat->material_index);
+        materials.push_back(AddMaterial(file, mat.name.c_str(), gpuMaterial, materialResources, passType));
 #else
+        std::shared_ptr<GLTFMaterial> newMat = std::make_shared<GLTFMaterial>();
+        materials.push_back(newMat);
+        file.materials[mat.name.c_str()] = newMat;
         newMat->data = engine->metalRoughMaterial.write_material(engine->_device, passType, materialResources, file.descriptorPool);
 #endif
-        data_index++;
-        material_index++;
     }
-    last_material_index += material_index;
 
     //< load_material
 
-        // use the same vectors for all meshes so that the memory doesnt reallocate as
-        // often
-    std::vector<uint32_t> indices;
-    std::vector<Vertex> vertices;
-
-    for (fastgltf::Mesh& mesh : gltf.meshes) {
+    //the meshes were converted and optimized by ParseGltf, only the upload is left
+    for (size_t meshIndex = 0; meshIndex < gltf.meshes.size(); meshIndex++) {
+        fastgltf::Mesh& mesh = gltf.meshes[meshIndex];
+        GltfMeshSource& meshSource = source.meshes[meshIndex];
         std::shared_ptr<MeshAsset> newmesh = std::make_shared<MeshAsset>();
         meshes.push_back(newmesh);
         file.meshes[mesh.name.c_str()] = newmesh;
         newmesh->name = mesh.name;
 
-        // clear the mesh arrays each mesh, we dont want to merge them by error
-        indices.clear();
-        vertices.clear();
-
-        for (auto&& p : mesh.primitives) {
-            GeoSurface newSurface;
-            newSurface.startIndex = (uint32_t)indices.size();
-            newSurface.count = (uint32_t)gltf.accessors[p.indicesAccessor.value()].count;
-
-
-            size_t initial_vtx = vertices.size();
-
-            // load indexes
-            {
-                fastgltf::Accessor& indexaccessor = gltf.accessors[p.indicesAccessor.value()];
-                indices.reserve(indices.size() + indexaccessor.count);
-
-                fastgltf::iterateAccessor<std::uint32_t>(gltf, indexaccessor,
-                    [&](std::uint32_t idx) {
-                        indices.push_back(idx + initial_vtx);
-                    });
-            }
-
-            // load vertex positions
-            {
-                fastgltf::Accessor& posAccessor = gltf.accessors[p.findAttribute("POSITION")->second];
-                vertices.resize(vertices.size() + posAccessor.count);
-
-                fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, posAccessor,
-                    [&](glm::vec3 v, size_t index) {
-                        Vertex newvtx;
-                        newvtx.position = v;
-                        newvtx.normal = { 1, 0, 0 };
-                        newvtx.color = glm::vec4{ 1.f };
-                        newvtx.uv_x = 0;
-                        newvtx.uv_y = 0;
-                        vertices[initial_vtx + index] = newvtx;
-                    });
-            }
-
-            // load vertex normals
-            auto normals = p.findAttribute("NORMAL");
-            if (normals != p.attributes.end()) {
-
-                fastgltf::iterateAccessorWithIndex<glm::vec3>(gltf, gltf.accessors[(*normals).second],
-                    [&](glm::vec3 v, size_t index) {
-                        vertices[initial_vtx + index].normal = v;
-                    });
-            }
-
-            // load UVs
-            auto uv = p.findAttribute("TEXCOORD_0");
-            if (uv != p.attributes.end()) {
-
-                fastgltf::iterateAccessorWithIndex<glm::vec2>(gltf, gltf.accessors[(*uv).second],
-                    [&](glm::vec2 v, size_t index) {
-                        vertices[initial_vtx + index].uv_x = v.x;
-                        vertices[initial_vtx + index].uv_y = v.y;
-                    });
-            }
-
-            // load vertex colors
-            auto colors = p.findAttribute("COLOR_0");
-            if (colors != p.attributes.end()) {
-
-                fastgltf::iterateAccessorWithIndex<glm::vec4>(gltf, gltf.accessors[(*colors).second],
-                    [&](glm::vec4 v, size_t index) {
-                        vertices[initial_vtx + index].color = v;
-                    });
-            }
-
-            auto tangent = p.findAttribute("TANGENT");
-            if (tangent != p.attributes.end()) {
-
-                fastgltf::iterateAccessorWithIndex<glm::vec4>(gltf, gltf.accessors[(*tangent).second],
-                    [&](glm::vec4 v, size_t index) {
-                        vertices[initial_vtx + index].tangents = glm::vec4(v);
-                    });
-            }
-
-
-            if (p.materialIndex.has_value()) {
-                newSurface.material = materials[p.materialIndex.value()];
-            }
-            else {
-                newSurface.material = materials[0];
-            }
-
-            glm::vec3 minpos = vertices[initial_vtx].position;
-            glm::vec3 maxpos = vertices[initial_vtx].position;
-            for (int i = initial_vtx; i < vertices.size(); i++) {
-                minpos = glm::min(minpos, vertices[i].position);
-                maxpos = glm::max(maxpos, vertices[i].position);
-            }
-
-            newSurface.bounds.origin = (maxpos + minpos) / 2.f;
-            newSurface.bounds.extents = (maxpos - minpos) / 2.f;
-            newSurface.bounds.sphereRadius = glm::length(newSurface.bounds.extents);
-            newSurface.vertex_count = vertices.size() - initial_vtx; 
-            newmesh->surfaces.push_back(newSurface);
+        newmesh->surfaces = std::move(meshSource.surfaces);
+        for (size_t i = 0; i < newmesh->surfaces.size(); i++) {
+            newmesh->surfaces[i].material = materials[meshSource.surface_materials[i]];
         }
 
-        newmesh->meshBuffers = UploadMesh(indices, vertices);
+        newmesh->meshBuffers = UploadMesh(meshSource.indices32, meshSource.indices16, meshSource.vertices);
+        geometry_heap.Track(&newmesh->meshBuffers);
+    }
+    const BlackKey::VertexCacheStatistics& cacheBefore = source.cache_before;
+    if (log_mesh_optimization && cacheBefore.triangle_count > 0) {
+        fmt::println("{}: ACMR {:.3f} -> {:.3f}, ATVR {:.3f} -> {:.3f}, index data {} KB ({} KB as 32 bit)", source.path,
+            (float)cacheBefore.vertices_transformed / cacheBefore.triangle_count, (float)source.cache_after.vertices_transformed / cacheBefore.triangle_count,
+            (float)cacheBefore.vertices_transformed / cacheBefore.vertex_count, (float)source.cache_after.vertices_transformed / cacheBefore.vertex_count,
+            source.index_bytes / 1024, source.index_bytes_32 / 1024);
     }
     //> load_nodes
         // load all nodes and their meshes
@@ -538,9 +676,10 @@ std::optional<std::shared_ptr<LoadedGLTF>> ResourceManager::loadGltf(VulkanEngin
     return scene;
 }
 
-std::optional<AllocatedImage> ResourceManager::load_image(VulkanEngine* engine, fastgltf::Asset& asset, fastgltf::Image& image, const std::string& rootPath)
+std::optional<TextureMipChain> ResourceManager::decode_image(fastgltf::Asset& asset, fastgltf::Image& image, const std::string& rootPath)
 {
-    AllocatedImage newImage{};
+    TRACE_SCOPE("decode_image", std::string_view(image.name.data(), image.name.size()));
+    TextureMipChain mipChain;
 
     int width, height, nrChannels;
 
@@ -563,7 +702,7 @@ std::optional<AllocatedImage> ResourceManager::load_image(VulkanEngine* engine,
                     imagesize.height = height;
                     imagesize.depth = 1;
 
-                    newImage = vkutil::create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, engine, true);
+                    mipChain = vkutil::build_mip_chain(data, imagesize);
 
                     stbi_image_free(data);
                 }
@@ -577,7 +716,7 @@ std::optional<AllocatedImage> ResourceManager::load_image(VulkanEngine* engine,
         imagesize.height = height;
         imagesize.depth = 1;
 
-        newImage = vkutil::create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, engine, true);
+        mipChain = vkutil::build_mip_chain(data, imagesize);
 
         stbi_image_free(data);
     }
@@ -600,7 +739,7 @@ std::optional<AllocatedImage> ResourceManager::load_image(VulkanEngine* engine,
         imagesize.height = height;
         imagesize.depth = 1;
 
-        newImage = vkutil::create_image(data, imagesize, VK_FORMAT_R8G8B8A8_UNORM, VK_IMAGE_USAGE_SAMPLED_BIT, engine, true);
+        mipChain = vkutil::build_mip_chain(data, imagesize);
 
         stbi_image_free(data);
     }
@@ -610,57 +749,84 @@ buffer.data);
         },
         image.data);
 
-    // if any of the attempts to load the data failed, we havent written the image
-    // so handle is null
-    if (newImage.image == VK_NULL_HANDLE) {
+    // if any of the attempts to load the data failed, we havent built the chain
+    if (mipChain.mips.empty()) {
         return {};
     }
     else {
-        return newImage;
+        return mipChain;
     }
 }
 
 void ResourceManager::cleanup()
 {
-    vkDestroyDescriptorPool(engine->_device, bindless_material_descriptor.pool, nullptr);
+    bindless_table.Cleanup();
+    if (readBackBufferInitialized)
+        DestroyBuffer(readableBuffer);
+    //the teardown closures destroy some owned images themselves, they go first
     deletionQueue.flush();
+
+    //whatever is still owned was never destroyed by its user
+    while (!owned_images.empty()) {
+        AllocatedImage image = owned_images.begin()->second;
+        DestroyImage(image);
+    }
+    while (!owned_buffers.empty()) {
+        AllocatedBuffer buffer = owned_buffers.begin()->second;
+        DestroyBuffer(buffer);
+    }
+    retire_queue.Flush();
 }
 
 
 
+void ResourceManager::InitBindless()
+{
+    bindless_table.Init(this, bindless_descriptor_layout, _whiteImage.imageView, defaultSamplerLinear);
+}
+
 void ResourceManager::write_material_array()
 {
-    writer.clear();
-    for (int i = 0; i < bindless_resources.size(); i++)
-    {
-        int offset = i * 4;
-        writer.write_buffer(0, bindless_resources[i].dataBuffer, sizeof(GLTFMetallic_Roughness::MaterialConstants), bindless_resources[i].dataBufferOffset, VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER, 2);
-        writer.write_image(1, bindless_resources[i].colorImage.imageView, bindless_resources[i].colorSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offset);
-        writer.write_image(1, bindless_resources[i].metalRoughImage.imageView, bindless_resources[i].metalRoughSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offset + 1);
-        writer.write_image(1, bindless_resources[i].normalImage.imageView, bindless_resources[i].normalSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offset + 2);
-        writer.write_image(1, bindless_resources[i].occlusionImage.imageView, bindless_resources[i].occlusionSampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, offset + 3);
-        writer.write_image(2, storageImage.imageView, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_GENERAL, VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, i);
-    }
+    bindless_table.Flush();
+}
 
-    bindless_set = bindless_material_descriptor.allocate(engine->_device, bindless_descriptor_layout);
-    writer.update_set(engine->_device, bindless_set);
+void ResourceManager::ReleaseMaterials(const LoadedGLTF& gltf)
+{
+    for (uint32_t material_index : gltf.bindlessMaterials) {
+        bindless_table.FreeMaterial(material_index);
+
+        //the residency lookups of the feedback and eviction passes must not find the destroyed images
+        GLTFMetallic_Roughness::MaterialResources& resources = bindless_resources[material_index];
+        resources.colorImage = _whiteImage;
+        resources.metalRoughImage = _whiteImage;
+        resources.normalImage = _whiteImage;
+        resources.occlusionImage = _whiteImage;
+        resources.colorSampler = defaultSamplerLinear;
+        resources.metalRoughSampler = defaultSamplerLinear;
+        resources.normalSampler = defaultSamplerLinear;
+        resources.occlusionSampler = defaultSamplerLinear;
+    }
 }
 
 VkDescriptorSet* ResourceManager::GetBindlessSet()
 {
-    VkDescriptorSet* desc = &bindless_set;
-    return desc;
+    return bindless_table.GetSet();
 }
 
 void ResourceManager::ReadBackBufferData(VkCommandBuffer cmd, AllocatedBuffer* buffer)
 {
-    if (readBackBufferInitialized == true)
+    //kept between reads and only replaced by a bigger one, a frame in flight may still be copying into the old one
+    if (readBackBufferInitialized && readableBuffer.info.size < buffer->info.size)
     {
-        DestroyBuffer(readableBuffer);
+        RetireBuffer(readableBuffer);
+        readBackBufferInitialized = false;
     }
 
-    readableBuffer =  CreateBuffer(buffer->info.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
-    readBackBufferInitialized = true;
+    if (!readBackBufferInitialized)
+    {
+        readableBuffer = CreateBuffer(buffer->info.size, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Staging);
+        readBackBufferInitialized = true;
+    }
 
     VkBufferCopy dataCopy{ 0 };
     dataCopy.dstOffset = 0;
@@ -677,7 +843,7 @@ AllocatedBuffer* ResourceManager::GetReadBackBuffer()
 }
 
 
-AllocatedBuffer ResourceManager::CreateBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage)
+AllocatedBuffer ResourceManager::CreateBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, MemoryCategory category, bool destroyOnCleanup)
 {
     // allocate buffer
     VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
@@ -689,29 +855,31 @@ AllocatedBuffer ResourceManager::CreateBuffer(size_t allocSize, VkBufferUsageFla
 
     VmaAllocationCreateInfo vmaallocInfo = {};
     vmaallocInfo.usage = memoryUsage;
-    vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+    vmaallocInfo.flags = vkutil::mapped_allocation_flags(memoryUsage);
     AllocatedBuffer newBuffer;
 
     // allocate the buffer
     VK_CHECK(vmaCreateBuffer(engine->_allocator, &bufferInfo, &vmaallocInfo, &newBuffer.buffer, &newBuffer.allocation,
         &newBuffer.info));
+    engine->_memoryBudget.Track(newBuffer.allocation, category);
 
-    deletionQueue.push_function([=]() {
-        DestroyBuffer(newBuffer);
-      });
+    if (category != MemoryCategory::Staging && destroyOnCleanup) {
+        owned_buffers.emplace(newBuffer.buffer, newBuffer);
+    }
     return newBuffer;
 }
 
-AllocatedBuffer ResourceManager::CreateAndUpload(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, void* data)
+AllocatedBuffer ResourceManager::CreateAndUpload(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, void* data, MemoryCategory category, bool destroyOnCleanup)
 {
-    AllocatedBuffer stagingBuffer = CreateBuffer(allocSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    ZoneScoped;
+    AllocatedBuffer stagingBuffer = CreateBuffer(allocSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Staging);
 
 
     void* bufferData = nullptr;
     vmaMapMemory(engine->_allocator, stagingBuffer.allocation, &bufferData);
     memcpy(bufferData, data, allocSize);
 
-    AllocatedBuffer dataBuffer = CreateBuffer(allocSize, usage, memoryUsage);
+    AllocatedBuffer dataBuffer = CreateBuffer(allocSize, usage, memoryUsage, category, destroyOnCleanup);
 
     engine->immediate_submit([&](VkCommandBuffer cmd) {
         VkBufferCopy dataCopy{ 0 };
@@ -724,59 +892,81 @@ AllocatedBuffer ResourceManager::CreateAndUpload(size_t allocSize, VkBufferUsage
     vmaUnmapMemory(engine->_allocator, stagingBuffer.allocation);
     DestroyBuffer(stagingBuffer);
 
-    deletionQueue.push_function([=]() {
-        DestroyBuffer(dataBuffer);
-        });
-
     return dataBuffer;
 }
 
 void ResourceManager::DestroyBuffer(const AllocatedBuffer& buffer)
 {
+    owned_buffers.erase(buffer.buffer);
+    engine->_memoryBudget.Untrack(buffer.allocation);
     vmaDestroyBuffer(engine->_allocator, buffer.buffer, buffer.allocation);
 }
 
-
-GPUMeshBuffers ResourceManager::UploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices)
+void ResourceManager::RetireBuffer(const AllocatedBuffer& buffer)
 {
-    const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
-    const size_t indexBufferSize = indices.size() * sizeof(uint32_t);
+    owned_buffers.erase(buffer.buffer);
+    retire_queue.Retire(buffer);
+}
 
-    GPUMeshBuffers newSurface;
 
-    newSurface.vertexBuffer = CreateBuffer(vertexBufferSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY);
+GPUMeshBuffers ResourceManager::UploadMesh(std::span<uint32_t> indices, std::span<uint16_t> indices16, std::span<Vertex> vertices)
+{
+    ZoneScoped;
+    TRACE_SCOPE("UploadMesh");
+    //the mesh's slot holds its 16 bit indices first, padded to a whole word, then the 32 bit ones
+    const uint32_t index16Words = static_cast<uint32_t>((indices16.size() + 1) / 2);
+    const uint32_t indexWords = index16Words + static_cast<uint32_t>(indices.size());
 
+    GPUMeshBuffers newSurface;
+    newSurface.mesh_info.mesh_vert_count = (uint32_t)vertices.size();
+    newSurface.mesh_info.mesh_indice_count = (uint32_t)indices.size();
+    newSurface.mesh_info.mesh_indice16_count = (uint32_t)indices16.size();
+
+    if (!geometry_heap.Allocate((uint32_t)vertices.size(), indexWords, newSurface.allocation)) {
+        GeometryHeapStats stats = geometry_heap.GetStats();
+        fmt::println("Geometry heap can't grow, {} vertices and {} index words requested, capacity {} vertices and {} index words",
+            vertices.size(), indexWords, stats.vertex_capacity, stats.index_capacity);
+        abort();
+    }
 
-    VkBufferDeviceAddressInfo deviceAdressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,.buffer = newSurface.vertexBuffer.buffer };
-    newSurface.vertexBufferAddress = vkGetBufferDeviceAddress(engine->_device, &deviceAdressInfo);
+    newSurface.firstVertex = newSurface.allocation.vertexOffset;
+    newSurface.firstIndex16 = newSurface.allocation.indexOffset * 2;
+    newSurface.firstIndex32 = newSurface.allocation.indexOffset + index16Words;
+    newSurface.vertexBuffer = geometry_heap.vertexBuffer;
+    newSurface.indexBuffer = geometry_heap.indexBuffer;
+    newSurface.vertexBufferAddress = geometry_heap.vertexBufferAddress;
 
-    newSurface.indexBuffer = CreateBuffer(indexBufferSize, VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT,
-        VMA_MEMORY_USAGE_GPU_ONLY);
+    const size_t vertexBufferSize = vertices.size() * sizeof(Vertex);
+    const size_t index16Size = indices16.size() * sizeof(uint16_t);
+    const size_t indexBufferSize = size_t(indexWords) * sizeof(uint32_t);
 
-    AllocatedBuffer staging = CreateBuffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY);
+    AllocatedBuffer staging = CreateBuffer(vertexBufferSize + indexBufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_ONLY, MemoryCategory::Staging);
 
     void* data = nullptr;
     vmaMapMemory(engine->_allocator, staging.allocation, &data);
     // copy vertex buffer
     memcpy(data, vertices.data(), vertexBufferSize);
     // copy index buffer
-    memcpy((char*)data + vertexBufferSize, indices.data(), indexBufferSize);
+    memset((char*)data + vertexBufferSize, 0, indexBufferSize);
+    memcpy((char*)data + vertexBufferSize, indices16.data(), index16Size);
+    memcpy((char*)data + vertexBufferSize + index16Words * sizeof(uint32_t), indices.data(), indices.size() * sizeof(uint32_t));
 
     engine->immediate_submit([&](VkCommandBuffer cmd) {
         VkBufferCopy vertexCopy{ 0 };
-        vertexCopy.dstOffset = 0;
+        vertexCopy.dstOffset = size_t(newSurface.allocation.vertexOffset) * sizeof(Vertex);
         vertexCopy.srcOffset = 0;
         vertexCopy.size = vertexBufferSize;
 
-        vkCmdCopyBuffer(cmd, staging.buffer, newSurface.vertexBuffer.buffer, 1, &vertexCopy);
+        if (vertexCopy.size > 0)
+            vkCmdCopyBuffer(cmd, staging.buffer, geometry_heap.vertexBuffer.buffer, 1, &vertexCopy);
 
         VkBufferCopy indexCopy{ 0 };
-        indexCopy.dstOffset = 0;
+        indexCopy.dstOffset = size_t(newSurface.allocation.indexOffset) * sizeof(uint32_t);
         indexCopy.srcOffset = vertexBufferSize;
         indexCopy.size = indexBufferSize;
 
-        vkCmdCopyBuffer(cmd, staging.buffer, newSurface.indexBuffer.buffer, 1, &indexCopy);
+        if (indexCopy.size > 0)
+            vkCmdCopyBuffer(cmd, staging.buffer, geometry_heap.indexBuffer.buffer, 1, &indexCopy);
         });
 
     vmaUnmapMemory(engine->_allocator, staging.allocation);
@@ -786,6 +976,13 @@ GPUMeshBuffers ResourceManager::UploadMesh(std::span<uint32_t> indices, std::spa
 
 }
 
+void ResourceManager::FreeMesh(GPUMeshBuffers& mesh)
+{
+    geometry_heap.Untrack(&mesh);
+    geometry_heap.Free(mesh.allocation);
+    mesh.allocation = GeometryAllocation{};
+}
+
 AllocatedImage ResourceManager::CreateImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped)
 {
     AllocatedImage newImage;
@@ -804,6 +1001,7 @@ AllocatedImage ResourceManager::CreateImage(VkExtent3D size, VkFormat format, Vk
 
     // allocate and create the image
     VK_CHECK(vmaCreateImage(engine->_allocator, &img_info, &allocinfo, &newImage.image, &newImage.allocation, nullptr));
+    engine->_memoryBudget.Track(newImage.allocation, vkutil::image_memory_category(img_info.usage));
 
     // if the format is a depth format, we will need to have it use the correct
     // aspect flag
@@ -818,9 +1016,7 @@ AllocatedImage ResourceManager::CreateImage(VkExtent3D size, VkFormat format, Vk
 
     VK_CHECK(vkCreateImageView(engine->_device, &view_info, nullptr, &newImage.imageView));
 
-    deletionQueue.push_function([=]() {
-        DestroyImage(newImage);
-        });
+    owned_images.emplace(newImage.image, newImage);
     return newImage;
 }
 
@@ -843,6 +1039,7 @@ AllocatedImage ResourceManager::CreateImageEmpty(VkExtent3D size, VkFormat forma
 
     // allocate and create the image
     VK_CHECK(vmaCreateImage(engine->_allocator, &img_info, &allocinfo, &newImage.image, &newImage.allocation, nullptr));
+    engine->_memoryBudget.Track(newImage.allocation, vkutil::image_memory_category(img_info.usage));
 
     // if the format is a depth format, we will need to have it use the correct
     // aspect flag
@@ -857,14 +1054,17 @@ AllocatedImage ResourceManager::CreateImageEmpty(VkExtent3D size, VkFormat forma
 
     VK_CHECK(vkCreateImageView(engine->_device, &view_info, nullptr, &newImage.imageView));
 
+    owned_images.emplace(newImage.image, newImage);
     return newImage;
 }
 
 
 AllocatedImage ResourceManager::CreateImage(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped)
 {
+    ZoneScoped;
+    TRACE_SCOPE("CreateImage");
     size_t data_size = size.depth * size.width * size.height * 4;
-    AllocatedBuffer uploadbuffer = CreateBuffer(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU);
+    AllocatedBuffer uploadbuffer = CreateBuffer(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Staging);
 
     memcpy(uploadbuffer.info.pMappedData, data, data_size);
 
@@ -911,6 +1111,386 @@ AllocatedImage ResourceManager::CreateImage(void* data, VkExtent3D size, VkForma
 
 void ResourceManager::DestroyImage(const AllocatedImage& img)
 {
+    ReleaseImage(img);
+    engine->_memoryBudget.Untrack(img.allocation);
     vkDestroyImageView(engine->_device, img.imageView, nullptr);
     vmaDestroyImage(engine->_allocator, img.image, img.allocation);
-}
\ No newline at end of file
+}
+
+void ResourceManager::RetireImage(const AllocatedImage& img)
+{
+    ReleaseImage(img);
+    retire_queue.Retire(img);
+}
+
+void ResourceManager::ReleaseImage(const AllocatedImage& img)
+{
+    owned_images.erase(img.image);
+    auto residency = texture_residency.find(img.image);
+    if (residency != texture_residency.end()) {
+        const TextureMipChain& mipChain = residency->second.mipChain;
+        streaming_stats.cpu_bytes -= mip_chain_bytes(mipChain, 0, static_cast<uint32_t>(mipChain.mips.size()));
+        texture_residency.erase(residency);
+        eviction_stats.resident_textures = static_cast<uint32_t>(texture_residency.size());
+    }
+}
+
+const MemoryBudgetStats& ResourceManager::GetMemoryStats() const
+{
+    return engine->_memoryBudget.GetStats();
+}
+
+void ResourceManager::RegisterTexture(const AllocatedImage& image, LoadedGLTF* owner, const std::string& name, TextureMipChain&& mipChain, uint32_t residentMip)
+{
+    const uint32_t mipLevels = static_cast<uint32_t>(mipChain.mips.size());
+    streaming_stats.cpu_bytes += mip_chain_bytes(mipChain, 0, mipLevels);
+    texture_residency[image.image] = TextureResidency{
+        .image = image,
+        .owner = owner,
+        .name = name,
+        .mipLevels = mipLevels - residentMip,
+        .residentMip = residentMip,
+        .wantedMip = mipLevels,
+        .mipChain = std::move(mipChain)
+    };
+    eviction_stats.resident_textures = static_cast<uint32_t>(texture_residency.size());
+}
+
+void ResourceManager::ReplaceTexture(const AllocatedImage& oldImage, const AllocatedImage& newImage, uint32_t residentMip)
+{
+    for (auto& resources : bindless_resources) {
+        for (AllocatedImage* image : { &resources.colorImage, &resources.metalRoughImage, &resources.normalImage, &resources.occlusionImage }) {
+            if (image->image == oldImage.image)
+                *image = newImage;
+        }
+    }
+    bindless_table.ReplaceView(oldImage.imageView, newImage.imageView);
+
+    auto it = texture_residency.find(oldImage.image);
+    TextureResidency residency = std::move(it->second);
+    texture_residency.erase(it);
+
+    residency.owner->images[residency.name] = newImage;
+    residency.image = newImage;
+    residency.residentMip = residentMip;
+    residency.mipLevels = static_cast<uint32_t>(residency.mipChain.mips.size()) - residentMip;
+    texture_residency.emplace(newImage.image, std::move(residency));
+}
+
+uint32_t ResourceManager::EnforceMemoryBudget(uint64_t frame)
+{
+    ZoneScoped;
+    MemoryBudget& budget = engine->_memoryBudget;
+    if (!budget.IsOverBudget())
+        return 0;
+
+    const VkDeviceSize target = static_cast<VkDeviceSize>(budget.GetBudget() * MEMORY_BUDGET_EVICTION_TARGET);
+    VkDeviceSize excess = budget.GetUsage() - std::min(budget.GetUsage(), target);
+
+    std::vector<TextureResidency*>& candidates = texture_candidates;
+    candidates.clear();
+    for (auto& [image, residency] : texture_residency) {
+        const VkExtent3D extent = residency.image.imageExtent;
+        if (residency.mipLevels < 2 || std::max(extent.width, extent.height) / 2 < TEXTURE_EVICTION_MIN_EXTENT)
+            continue;
+        if (residency.lastVisibleFrame + TEXTURE_EVICTION_GRACE_FRAMES > frame)
+            continue;
+        candidates.push_back(&residency);
+    }
+
+    //least recently visible first, the larger texture first when tied
+    std::sort(candidates.begin(), candidates.end(), [](const TextureResidency* a, const TextureResidency* b) {
+        if (a->lastVisibleFrame != b->lastVisibleFrame)
+            return a->lastVisibleFrame < b->lastVisibleFrame;
+        return a->image.imageExtent.width * a->image.imageExtent.height > b->image.imageExtent.width * b->image.imageExtent.height;
+        });
+
+    std::vector<TextureRebuild>& evictions = texture_rebuilds;
+    evictions.clear();
+    VkDeviceSize released = 0;
+    for (TextureResidency* candidate : candidates) {
+        if (released >= excess || evictions.size() >= TEXTURE_EVICTIONS_PER_FRAME)
+            break;
+
+        //the top mip holds about three quarters of the chain
+        VmaAllocationInfo info;
+        vmaGetAllocationInfo(engine->_allocator, candidate->image.allocation, &info);
+        released += info.size * 3 / 4;
+        evictions.push_back(TextureRebuild{ candidate->image.image, candidate->residentMip + 1 });
+    }
+    if (evictions.empty())
+        return 0;
+
+    //counted in the eviction stats
+    RebuildTextures(evictions);
+    return static_cast<uint32_t>(evictions.size());
+}
+
+AllocatedImage ResourceManager::CreateStreamedTexture(const TextureMipChain& mipChain, uint32_t firstMip)
+{
+    TRACE_SCOPE("CreateStreamedTexture");
+    const uint32_t endMip = static_cast<uint32_t>(mipChain.mips.size());
+    AllocatedImage newImage = vkutil::create_image_empty(vkutil::mip_extent(mipChain.extent, firstMip), VK_FORMAT_R8G8B8A8_UNORM,
+        VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, engine,
+        VK_IMAGE_VIEW_TYPE_2D, true, 1, VK_SAMPLE_COUNT_1_BIT, endMip - firstMip);
+
+    AllocatedBuffer uploadbuffer = CreateBuffer(mip_chain_bytes(mipChain, firstMip, endMip), VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Staging);
+    std::vector<VkBufferImageCopy> regions;
+    stage_mips(mipChain, firstMip, endMip, firstMip, (uint8_t*)uploadbuffer.info.pMappedData, 0, regions);
+
+    engine->immediate_submit([&](VkCommandBuffer cmd) {
+        vkutil::transition_image(cmd, newImage.image, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        vkCmdCopyBufferToImage(cmd, uploadbuffer.buffer, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            static_cast<uint32_t>(regions.size()), regions.data());
+        vkutil::transition_image(cmd, newImage.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+        });
+    DestroyBuffer(uploadbuffer);
+    return newImage;
+}
+
+void ResourceManager::RebuildTextures(const std::vector<TextureRebuild>& rebuilds)
+{
+    ZoneScoped;
+    if (rebuilds.empty())
+        return;
+
+    std::vector<AllocatedImage>& replacements = texture_replacements;
+    replacements.clear();
+    VkDeviceSize uploadSize = 0;
+    for (const TextureRebuild& rebuild : rebuilds) {
+        const TextureResidency& residency = texture_residency.at(rebuild.image);
+        const uint32_t endMip = static_cast<uint32_t>(residency.mipChain.mips.size());
+        replacements.push_back(vkutil::create_image_empty(vkutil::mip_extent(residency.mipChain.extent, rebuild.targetMip), residency.image.imageFormat,
+            VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT, engine,
+            VK_IMAGE_VIEW_TYPE_2D, true, 1, VK_SAMPLE_COUNT_1_BIT, endMip - rebuild.targetMip));
+        if (rebuild.targetMip < residency.residentMip)
+            uploadSize += mip_chain_bytes(residency.mipChain, rebuild.targetMip, residency.residentMip);
+    }
+
+    //the copies are recorded into this frame by RecordTextureUpdates, the frame's fence covers the staging buffer
+    AllocatedBuffer uploadbuffer{};
+    if (uploadSize > 0)
+        uploadbuffer = CreateBuffer(uploadSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU, MemoryCategory::Staging);
+
+    VkDeviceSize uploadOffset = 0;
+    for (size_t i = 0; i < rebuilds.size(); i++) {
+        const TextureResidency& residency = texture_residency.at(rebuilds[i].image);
+        const AllocatedImage oldImage = residency.image;
+        const uint32_t residentMip = residency.residentMip;
+        const uint32_t targetMip = rebuilds[i].targetMip;
+
+        TextureCopy copy{ .source = oldImage.image, .destination = replacements[i].image, .uploadBuffer = uploadbuffer.buffer };
+        //mips both images hold move across on the GPU, mip n of the chain is mip n - firstMip of an image
+        copy.firstImageCopy = static_cast<uint32_t>(texture_image_copies.size());
+        for (uint32_t mip = std::max(targetMip, residentMip); mip < residency.mipChain.mips.size(); mip++) {
+            VkImageCopy region{};
+            region.srcSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - residentMip, 0, 1 };
+            region.dstSubresource = { VK_IMAGE_ASPECT_COLOR_BIT, mip - targetMip, 0, 1 };
+            region.extent = vkutil::mip_extent(residency.mipChain.extent, mip);
+            texture_image_copies.push_back(region);
+        }
+        copy.imageCopyCount = static_cast<uint32_t>(texture_image_copies.size()) - copy.firstImageCopy;
+
+        //mips larger than the old image held come from the CPU chain
+        copy.firstUpload = static_cast<uint32_t>(texture_uploads.size());
+        if (targetMip < residentMip)
+            uploadOffset = stage_mips(residency.mipChain, targetMip, residentMip, targetMip, (uint8_t*)uploadbuffer.info.pMappedData, uploadOffset, texture_uploads);
+        copy.uploadCount = static_cast<uint32_t>(texture_uploads.size()) - copy.firstUpload;
+        texture_copies.push_back(copy);
+
+        if (targetMip > residentMip) {
+            VmaAllocationInfo oldInfo, newInfo;
+            vmaGetAllocationInfo(engine->_allocator, oldImage.allocation, &oldInfo);
+            vmaGetAllocationInfo(engine->_allocator, replacements[i].allocation, &newInfo);
+            eviction_stats.bytes_released += oldInfo.size - std::min(oldInfo.size, newInfo.size);
+            eviction_stats.dropped_mips += targetMip - residentMip;
+        }
+        else {
+            streaming_stats.bytes_uploaded += mip_chain_bytes(residency.mipChain, targetMip, residentMip);
+            streaming_stats.streamed_mips += residentMip - targetMip;
+        }
+
+        ReplaceTexture(oldImage, replacements[i], targetMip);
+        //the frame still in flight may be sampling it, and this frame copies out of it
+        RetireImage(oldImage);
+    }
+
+    if (uploadSize > 0)
+        RetireBuffer(uploadbuffer);
+    write_material_array();
+}
+
+void ResourceManager::RecordTextureUpdates(VkCommandBuffer cmd)
+{
+    ZoneScoped;
+    //in the order they were rebuilt, a texture rebuilt twice in a frame copies out of the first replacement
+    for (const TextureCopy& copy : texture_copies) {
+        vkutil::transition_image(cmd, copy.source, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL);
+        vkutil::transition_image(cmd, copy.destination, VK_IMAGE_LAYOUT_UNDEFINED, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
+        vkCmdCopyImage(cmd, copy.source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+            copy.imageCopyCount, texture_image_copies.data() + copy.firstImageCopy);
+        if (copy.uploadCount > 0)
+            vkCmdCopyBufferToImage(cmd, copy.uploadBuffer, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+                copy.uploadCount, texture_uploads.data() + copy.firstUpload);
+        vkutil::transition_image(cmd, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+    }
+    texture_copies.clear();
+    texture_image_copies.clear();
+    texture_uploads.clear();
+
+    //after the copies, nothing reads the new slots before the materials point at them
+    bindless_table.RecordMaterialWrites(cmd);
+}
+
+void ResourceManager::InitTextureFeedback(uint32_t framesInFlight)
+{
+    const size_t feedbackSize = TEXTURE_FEEDBACK_MAX_MATERIALS * sizeof(uint32_t);
+    texture_feedback_buffer = CreateBuffer(feedbackSize, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+
+    texture_feedback_readback.resize(framesInFlight);
+    for (AllocatedBuffer& readback : texture_feedback_readback)
+        readback = CreateBuffer(feedbackSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_TO_CPU);
+    texture_feedback_pending.assign(framesInFlight, false);
+}
+
+void ResourceManager::ResetTextureFeedback(VkCommandBuffer cmd)
+{
+    if (texture_feedback_readback.empty())
+        return;
+
+    //the last frame's readback copy has to be done with the buffer before it is cleared
+    VkBufferMemoryBarrier barrier = vkinit::buffer_barrier(texture_feedback_buffer.buffer, engine->_graphicsQueueFamily);
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    vkCmdFillBuffer(cmd, texture_feedback_buffer.buffer, 0, VK_WHOLE_SIZE, 0);
+
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+}
+
+void ResourceManager::CopyTextureFeedback(VkCommandBuffer cmd, uint32_t frameIndex)
+{
+    if (frameIndex >= texture_feedback_readback.size())
+        return;
+
+    VkBufferMemoryBarrier barrier = vkinit::buffer_barrier(texture_feedback_buffer.buffer, engine->_graphicsQueueFamily);
+    barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_TRANSFER_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 0, nullptr, 1, &barrier, 0, nullptr);
+
+    const AllocatedBuffer& readback = texture_feedback_readback[frameIndex];
+    VkBufferCopy feedbackCopy{ 0 };
+    feedbackCopy.size = TEXTURE_FEEDBACK_MAX_MATERIALS * sizeof(uint32_t);
+    vkCmdCopyBuffer(cmd, texture_feedback_buffer.buffer, readback.buffer, 1, &feedbackCopy);
+
+    VkBufferMemoryBarrier readbackBarrier = vkinit::buffer_barrier(readback.buffer, engine->_graphicsQueueFamily);
+    readbackBarrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    readbackBarrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 0, nullptr, 1, &readbackBarrier, 0, nullptr);
+
+    texture_feedback_pending[frameIndex] = true;
+}
+
+void ResourceManager::ReadTextureFeedback(uint32_t frameIndex, uint64_t frame)
+{
+    ZoneScoped;
+    if (frameIndex >= texture_feedback_pending.size() || !texture_feedback_pending[frameIndex])
+        return;
+    texture_feedback_pending[frameIndex] = false;
+
+    const AllocatedBuffer& readback = texture_feedback_readback[frameIndex];
+    vmaInvalidateAllocation(engine->_allocator, readback.allocation, 0, VK_WHOLE_SIZE);
+    const uint32_t* feedback = (const uint32_t*)readback.info.pMappedData;
+
+    //textures no material asked for want nothing beyond the chain
+    for (auto& [image, residency] : texture_residency)
+        residency.wantedMip = static_cast<uint32_t>(residency.mipChain.mips.size());
+
+    const size_t materialCount = std::min(bindless_resources.size(), size_t(TEXTURE_FEEDBACK_MAX_MATERIALS));
+    for (size_t i = 0; i < materialCount; i++) {
+        //size at which one texel covers one pixel, 0 when no pixel of the material was sampled
+        const uint32_t wantedExtent = feedback[i];
+        if (wantedExtent == 0)
+            continue;
+
+        const auto& resources = bindless_resources[i];
+        for (VkImage image : { resources.colorImage.image, resources.metalRoughImage.image, resources.normalImage.image, resources.occlusionImage.image }) {
+            auto it = texture_residency.find(image);
+            if (it == texture_residency.end())
+                continue;
+
+            TextureResidency& residency = it->second;
+            residency.lastVisibleFrame = frame;
+
+            //the smallest mip that is still at least as large as wanted
+            const uint32_t extent = std::max(residency.mipChain.extent.width, residency.mipChain.extent.height);
+            uint32_t mip = 0;
+            while (mip + 1 < residency.mipChain.mips.size() && (extent >> (mip + 1)) >= wantedExtent)
+                mip++;
+            residency.wantedMip = std::min(residency.wantedMip, mip);
+        }
+    }
+
+    uint32_t pending = 0;
+    for (auto& [image, residency] : texture_residency) {
+        if (residency.wantedMip <= residency.residentMip)
+            residency.lastWantedFrame = frame;
+        if (residency.wantedMip < residency.residentMip)
+            pending++;
+    }
+    streaming_stats.pending_textures = pending;
+}
+
+uint32_t ResourceManager::StreamTextures(uint64_t frame)
+{
+    ZoneScoped;
+    if (frame < last_stream_frame + TEXTURE_STREAMING_INTERVAL_FRAMES)
+        return 0;
+
+    std::vector<TextureResidency*>& requests = texture_candidates;
+    std::vector<TextureRebuild>& rebuilds = texture_rebuilds;
+    requests.clear();
+    rebuilds.clear();
+    for (auto& [image, residency] : texture_residency) {
+        if (residency.wantedMip < residency.residentMip) {
+            requests.push_back(&residency);
+        }
+        //nothing has sampled the top mip for a while, drop it until the texture is back to its tail
+        else if (residency.lastWantedFrame + TEXTURE_EVICTION_GRACE_FRAMES <= frame && residency.residentMip < streaming_tail_mip(residency.mipChain)
+            && rebuilds.size() < TEXTURE_EVICTIONS_PER_FRAME) {
+            rebuilds.push_back(TextureRebuild{ image, residency.residentMip + 1 });
+        }
+    }
+
+    //the textures furthest from what they need first
+    std::sort(requests.begin(), requests.end(), [](const TextureResidency* a, const TextureResidency* b) {
+        return a->residentMip - a->wantedMip > b->residentMip - b->wantedMip;
+        });
+
+    //streaming in never pushes usage past the point the memory budget starts evicting from
+    MemoryBudget& budget = engine->_memoryBudget;
+    const VkDeviceSize target = static_cast<VkDeviceSize>(budget.GetBudget() * MEMORY_BUDGET_EVICTION_TARGET);
+    VkDeviceSize usage = budget.GetUsage();
+    VkDeviceSize uploaded = 0;
+    for (TextureResidency* request : requests) {
+        const VkDeviceSize bytes = mip_chain_bytes(request->mipChain, request->wantedMip, request->residentMip);
+        if (uploaded > 0 && uploaded + bytes > TEXTURE_STREAMING_BYTES_PER_BATCH)
+            break;
+        if (usage + bytes > target)
+            continue;
+
+        uploaded += bytes;
+        usage += bytes;
+        rebuilds.push_back(TextureRebuild{ request->image.image, request->wantedMip });
+    }
+
+    if (rebuilds.empty())
+        return 0;
+
+    last_stream_frame = frame;
+    RebuildTextures(rebuilds);
+    return static_cast<uint32_t>(rebuilds.size());
+}
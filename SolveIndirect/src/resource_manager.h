@@ -7,6 +7,7 @@
 #include "vk_types.h"
 #include "vk_images.h"
 #include "vk_loader.h"
+#include "mesh_optimizer.h"
 #include <glm/gtx/quaternion.hpp>
 
 
@@ -18,11 +19,78 @@
 #include <fastgltf/types.hpp>
 #include <iostream>
 #include <string>
+#include <memory>
+#include <optional>
 
 #include "engine_util.h"
+#include "geometry_heap.h"
+#include "bindless_table.h"
+#include "memory_budget.h"
+#include "retire_queue.h"
+#include <unordered_map>
 
 class VulkanEngine;
 
+//Once over budget, textures are shrunk until usage is back under this fraction of the budget
+constexpr float MEMORY_BUDGET_EVICTION_TARGET = 0.9f;
+//Textures seen within this many frames keep all their mips
+constexpr uint64_t TEXTURE_EVICTION_GRACE_FRAMES = 120;
+//Mips are never dropped below this size
+constexpr uint32_t TEXTURE_EVICTION_MIN_EXTENT = 64;
+//Bounds how many textures one frame rebuilds to drop a mip
+constexpr uint32_t TEXTURE_EVICTIONS_PER_FRAME = 8;
+
+//Mips up to this size are uploaded when a texture loads, larger ones are streamed in once the GPU asks for them
+constexpr uint32_t TEXTURE_STREAMING_TAIL_EXTENT = 64;
+//Mip data uploaded per streaming batch, a single texture is always allowed through
+constexpr VkDeviceSize TEXTURE_STREAMING_BYTES_PER_BATCH = 32 * 1024 * 1024;
+//Frames between streaming batches, so the uploads are spread out instead of landing in one frame
+constexpr uint64_t TEXTURE_STREAMING_INTERVAL_FRAMES = 8;
+//One feedback word per material table entry
+constexpr uint32_t TEXTURE_FEEDBACK_MAX_MATERIALS = BINDLESS_MATERIAL_CAPACITY;
+
+struct TextureEvictionStats {
+	uint32_t resident_textures = 0;
+	uint32_t dropped_mips = 0;
+	VkDeviceSize bytes_released = 0;
+};
+
+struct TextureStreamingStats {
+	//textures the last feedback asked for more mips than are resident
+	uint32_t pending_textures = 0;
+	uint32_t streamed_mips = 0;
+	VkDeviceSize bytes_uploaded = 0;
+	//CPU copies of the mip chains kept around to stream from
+	VkDeviceSize cpu_bytes = 0;
+};
+
+//A glTF mesh with its vertices converted and every surface reordered for the vertex cache, ready to upload
+struct GltfMeshSource {
+	//materials aren't set, they only exist once the glTF is uploaded
+	std::vector<GeoSurface> surfaces;
+	//index into the glTF's materials of each surface
+	std::vector<size_t> surface_materials;
+	std::vector<uint32_t> indices32;
+	std::vector<uint16_t> indices16;
+	std::vector<Vertex> vertices;
+};
+
+//A glTF parsed, with its images decoded and its meshes converted, but with nothing uploaded yet. Producing one touches no
+//Vulkan state, so it can be built on a worker thread and handed to UploadGltf on the render thread
+struct GltfSource {
+	std::string path;
+	fastgltf::Asset asset;
+	//one entry per glTF image, empty when decoding failed
+	std::vector<std::optional<TextureMipChain>> images;
+	//one entry per glTF mesh
+	std::vector<GltfMeshSource> meshes;
+	//vertex cache of every surface before and after the reorder, for log_mesh_optimization
+	BlackKey::VertexCacheStatistics cache_before;
+	BlackKey::VertexCacheStatistics cache_after;
+	size_t index_bytes = 0;
+	size_t index_bytes_32 = 0;
+};
+
 struct ResourceManager
 {
 	ResourceManager() {}
@@ -31,10 +99,24 @@ struct ResourceManager
 
 	//Gltf loading functions
 	std::optional<std::shared_ptr<LoadedGLTF>> loadGltf(VulkanEngine* engine, std::string_view filePath, bool isPBRMaterial = false);
-	std::optional<AllocatedImage> load_image(VulkanEngine* engine, fastgltf::Asset& asset, fastgltf::Image& image, const std::string& rootPath);
+	//Parses the file, decodes its images and converts and optimizes its meshes, safe to call from any thread
+	static std::shared_ptr<GltfSource> ParseGltf(std::string_view filePath);
+	//Creates the GPU resources of a parsed glTF: materials, textures and the mesh uploads. Uploads only the tail of each
+	//mip chain, the rest is kept for the streamer
+	std::optional<std::shared_ptr<LoadedGLTF>> UploadGltf(VulkanEngine* engine, GltfSource& source, bool isPBRMaterial = false);
+	//Decodes an image of the glTF into a full mip chain
+	static std::optional<TextureMipChain> decode_image(fastgltf::Asset& asset, fastgltf::Image& image, const std::string& rootPath);
+	//Appends the primitive's vertices and its indices, offset by its first vertex, to the mesh arrays. Returns its surface
+	//without a material or index type, those are settled once the whole mesh is read
+	static GeoSurface ConvertPrimitive(const fastgltf::Asset& gltf, const fastgltf::Primitive& p, std::vector<uint32_t>& indices, std::vector<Vertex>& vertices);
 	
 	//Bindless helper functions
+	//Allocates the bindless set, call once bindless_descriptor_layout exists
+	void InitBindless();
+	//Writes the bindless slots acquired or changed since the last call
 	void write_material_array();
+	//Returns the bindless slots of a glTF's materials to the table, called when the glTF is destroyed
+	void ReleaseMaterials(const LoadedGLTF& gltf);
 	VkDescriptorSet* GetBindlessSet();
 	//Displays the contents of a GPU only buffer
 	void ReadBackBufferData(VkCommandBuffer cmd, AllocatedBuffer* buffer);
@@ -42,37 +124,146 @@ struct ResourceManager
 	void cleanup();
 
 	//Resource management
-	AllocatedBuffer CreateBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage);
+	//Buffers created with destroyOnCleanup and images made by CreateImage without data or CreateImageEmpty are owned by the
+	//resource manager until they are destroyed or retired, cleanup destroys whatever it still owns. Staging buffers and buffers created with destroyOnCleanup false
+	//belong to whoever created them
+	AllocatedBuffer CreateBuffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, MemoryCategory category = MemoryCategory::Buffers, bool destroyOnCleanup = true);
 	void DestroyBuffer(const AllocatedBuffer& buffer);
-	AllocatedBuffer CreateAndUpload(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, void* data);
+	//Destroys the buffer once the frames in flight are done with it
+	void RetireBuffer(const AllocatedBuffer& buffer);
+	AllocatedBuffer CreateAndUpload(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, void* data, MemoryCategory category = MemoryCategory::Buffers, bool destroyOnCleanup = true);
 	AllocatedImage CreateImage(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
 	AllocatedImage CreateImage(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
-	GPUMeshBuffers UploadMesh(std::span<uint32_t> indices, std::span<Vertex> vertices);
+	//Copies a mesh into its own slot of the geometry heap
+	GPUMeshBuffers UploadMesh(std::span<uint32_t> indices, std::span<uint16_t> indices16, std::span<Vertex> vertices);
+	void FreeMesh(GPUMeshBuffers& mesh);
 	AllocatedImage CreateImageEmpty(VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VkImageViewType viewType, bool mipmapped, int layers, VkSampleCountFlagBits msaaSamples = VK_SAMPLE_COUNT_1_BIT, int mipLevels = -1);
 	void DestroyImage(const AllocatedImage& img);
+	//Destroys the image and its view once the frames in flight are done with them
+	void RetireImage(const AllocatedImage& img);
 	VkSamplerMipmapMode extract_mipmap_mode(fastgltf::Filter filter);
 	VkFilter extract_filter(fastgltf::Filter filter);
 	MaterialInstance SetMaterialProperties(const vkutil::MaterialPass pass, int mat_index);
+	//The default textures a material falls back to where it has none of its own
+	GLTFMetallic_Roughness::MaterialResources DefaultMaterialResources() const;
+	//Puts a material and its textures in the bindless table, the entry is released with the scene
+	std::shared_ptr<GLTFMaterial> AddMaterial(LoadedGLTF& scene, const std::string& name, GPUMaterial gpuMaterial,
+		const GLTFMetallic_Roughness::MaterialResources& resources, vkutil::MaterialPass passType);
+
+	//Memory budget
+	const MemoryBudgetStats& GetMemoryStats() const;
+	TextureEvictionStats GetTextureEvictionStats() const { return eviction_stats; }
+	//Drops the largest mip of the textures the feedback hasn't seen on screen for the longest while over budget.
+	//Returns the number of textures shrunk
+	uint32_t EnforceMemoryBudget(uint64_t frame);
+
+	//Texture streaming
+	//The forward pass writes the texture size each material could use into the feedback buffer,
+	//one host readable copy per frame in flight is read back once that frame's fence has signalled
+	void InitTextureFeedback(uint32_t framesInFlight);
+	AllocatedBuffer* GetTextureFeedbackBuffer() { return &texture_feedback_buffer; }
+	//Clears the feedback, record before the forward pass
+	void ResetTextureFeedback(VkCommandBuffer cmd);
+	//Copies the feedback into this frame's readback buffer, record after the forward pass
+	void CopyTextureFeedback(VkCommandBuffer cmd, uint32_t frameIndex);
+	//Turns the feedback of the last frame that used this slot into a wanted mip per texture, and marks the textures of
+	//every material a pixel sampled as visible for the eviction pass
+	void ReadTextureFeedback(uint32_t frameIndex, uint64_t frame);
+	//Streams in the mips the feedback asked for and drops top mips it hasn't asked for within the grace period.
+	//Returns the number of textures rebuilt, their uploads are recorded by RecordTextureUpdates
+	uint32_t StreamTextures(uint64_t frame);
+	//Records the copies and uploads of this frame's texture rebuilds and points the materials at the new images.
+	//Record before anything samples the bindless set
+	void RecordTextureUpdates(VkCommandBuffer cmd);
+	TextureStreamingStats GetTextureStreamingStats() const { return streaming_stats; }
 
+	//Teardown of objects created once at startup, run by cleanup
 	DeletionQueue deletionQueue;
+	RetireQueue retire_queue;
 	VkDescriptorSetLayout bindless_descriptor_layout;
 	VulkanEngine* engine = nullptr;
 	AllocatedImage errorCheckerboardImage;
 	GLTFMetallic_Roughness* PBRpipeline;
+	GeometryHeap geometry_heap;
+	BindlessTable bindless_table;
+	//Prints one line per glTF with what the vertex cache and index compaction gained
+	bool log_mesh_optimization = false;
 private:
+	//Stops owning the image and drops its streaming state, the image itself is left alone
+	void ReleaseImage(const AllocatedImage& img);
+
+	std::unordered_map<VkBuffer, AllocatedBuffer> owned_buffers;
+	std::unordered_map<VkImage, AllocatedImage> owned_images;
+
+	struct TextureResidency {
+		AllocatedImage image;
+		//glTF that owns the image and its key there, patched when the image is replaced
+		LoadedGLTF* owner;
+		std::string name;
+		//mips the image holds, the largest being mip residentMip of the full chain
+		uint32_t mipLevels;
+		uint32_t residentMip;
+		uint64_t lastVisibleFrame = 0;
+		//smallest mip of the full chain the last feedback asked for, and the last frame it asked
+		//for the resident top mip or a larger one
+		uint32_t wantedMip;
+		uint64_t lastWantedFrame = 0;
+		TextureMipChain mipChain;
+	};
+
+	struct TextureRebuild {
+		VkImage image;
+		uint32_t targetMip;
+	};
+
+	//A rebuild waiting for RecordTextureUpdates, its regions are ranges of texture_image_copies and texture_uploads
+	struct TextureCopy {
+		VkImage source;
+		VkImage destination;
+		VkBuffer uploadBuffer;
+		uint32_t firstImageCopy = 0;
+		uint32_t imageCopyCount = 0;
+		uint32_t firstUpload = 0;
+		uint32_t uploadCount = 0;
+	};
+
+	void RegisterTexture(const AllocatedImage& image, LoadedGLTF* owner, const std::string& name, TextureMipChain&& mipChain, uint32_t residentMip);
+	void ReplaceTexture(const AllocatedImage& oldImage, const AllocatedImage& newImage, uint32_t residentMip);
+	//Creates an image holding mips firstMip and up of the chain
+	AllocatedImage CreateStreamedTexture(const TextureMipChain& mipChain, uint32_t firstMip);
+	//Recreates each texture with targetMip as its largest mip. Mips both images share are copied on the GPU,
+	//mips only the new one has are staged from the CPU chain, both are recorded later by RecordTextureUpdates. The new image
+	//gets its own bindless slot, the old one, its slot and the staging buffer are retired with the frame
+	void RebuildTextures(const std::vector<TextureRebuild>& rebuilds);
+
 	bool readBackBufferInitialized = false;
 	VkSampler defaultSamplerNearest;
 	VkSampler defaultSamplerLinear;
 	std::unordered_map<std::string, std::shared_ptr<LoadedGLTF>> loadedScenes;
+	//indexed by material_index, freed entries point at the default textures
 	std::vector< GLTFMetallic_Roughness::MaterialResources> bindless_resources{};
-	DescriptorAllocator bindless_material_descriptor;
-	DescriptorWriter writer;
 
-	int last_material_index{ 0 };
 	AllocatedImage _whiteImage;
 	AllocatedImage _greyImage;
 	AllocatedImage _blackImage;
 	AllocatedImage storageImage;
-	VkDescriptorSet bindless_set;
 	AllocatedBuffer readableBuffer;
+
+	std::unordered_map<VkImage, TextureResidency> texture_residency;
+	TextureEvictionStats eviction_stats;
+
+	AllocatedBuffer texture_feedback_buffer;
+	std::vector<AllocatedBuffer> texture_feedback_readback;
+	//set when a readback copy was recorded and hasn't been read yet
+	std::vector<bool> texture_feedback_pending;
+	uint64_t last_stream_frame = 0;
+	TextureStreamingStats streaming_stats;
+	//rebuilds of this frame not recorded yet, the vectors keep their capacity between frames
+	std::vector<TextureCopy> texture_copies;
+	std::vector<VkImageCopy> texture_image_copies;
+	std::vector<VkBufferImageCopy> texture_uploads;
+	//scratch of the eviction and streaming passes, kept between frames like the copies above
+	std::vector<TextureResidency*> texture_candidates;
+	std::vector<TextureRebuild> texture_rebuilds;
+	std::vector<AllocatedImage> texture_replacements;
 };
\ No newline at end of file
@@ -0,0 +1,83 @@
+#include "retire_queue.h"
+#include "vk_engine.h"
+#include <algorithm>
+
+void RetireQueue::Init(VulkanEngine* engine_ptr, uint32_t framesInFlight)
+{
+	engine = engine_ptr;
+	frames_in_flight = framesInFlight;
+}
+
+template<typename T, typename Destroy>
+void RetireQueue::Collect(std::vector<Retired<T>>& list, uint64_t frame, Destroy&& destroy)
+{
+	auto last = std::find_if(list.begin(), list.end(), [&](const Retired<T>& retired) {
+		return retired.retireFrame > frame;
+		});
+	for (auto it = list.begin(); it != last; it++)
+		destroy(it->handle);
+	destroyed += last - list.begin();
+	list.erase(list.begin(), last);
+}
+
+void RetireQueue::Flush()
+{
+	Collect(buffers, UINT64_MAX, [&](const BufferHandle& buffer) { DestroyBuffer(buffer); });
+	Collect(images, UINT64_MAX, [&](const ImageHandle& image) { DestroyImage(image); });
+	Collect(image_views, UINT64_MAX, [&](VkImageView view) { vkDestroyImageView(engine->_device, view, nullptr); });
+	Collect(samplers, UINT64_MAX, [&](VkSampler sampler) { vkDestroySampler(engine->_device, sampler, nullptr); });
+}
+
+void RetireQueue::BeginFrame(uint64_t frameNumber)
+{
+	current_frame = frameNumber;
+
+	Collect(buffers, current_frame, [&](const BufferHandle& buffer) { DestroyBuffer(buffer); });
+	Collect(images, current_frame, [&](const ImageHandle& image) { DestroyImage(image); });
+	Collect(image_views, current_frame, [&](VkImageView view) { vkDestroyImageView(engine->_device, view, nullptr); });
+	Collect(samplers, current_frame, [&](VkSampler sampler) { vkDestroySampler(engine->_device, sampler, nullptr); });
+}
+
+void RetireQueue::Retire(const AllocatedBuffer& buffer)
+{
+	buffers.push_back({ BufferHandle{ buffer.buffer, buffer.allocation }, current_frame + frames_in_flight });
+}
+
+void RetireQueue::Retire(const AllocatedImage& image)
+{
+	images.push_back({ ImageHandle{ image.image, image.imageView, image.allocation }, current_frame + frames_in_flight });
+}
+
+void RetireQueue::Retire(VkImageView view)
+{
+	image_views.push_back({ view, current_frame + frames_in_flight });
+}
+
+void RetireQueue::Retire(VkSampler sampler)
+{
+	samplers.push_back({ sampler, current_frame + frames_in_flight });
+}
+
+void RetireQueue::DestroyBuffer(const BufferHandle& buffer)
+{
+	engine->_memoryBudget.Untrack(buffer.allocation);
+	vmaDestroyBuffer(engine->_allocator, buffer.buffer, buffer.allocation);
+}
+
+void RetireQueue::DestroyImage(const ImageHandle& image)
+{
+	engine->_memoryBudget.Untrack(image.allocation);
+	vkDestroyImageView(engine->_device, image.view, nullptr);
+	vmaDestroyImage(engine->_allocator, image.image, image.allocation);
+}
+
+RetireQueueStats RetireQueue::GetStats() const
+{
+	RetireQueueStats stats;
+	stats.pending_buffers = static_cast<uint32_t>(buffers.size());
+	stats.pending_images = static_cast<uint32_t>(images.size());
+	stats.pending_views = static_cast<uint32_t>(image_views.size());
+	stats.pending_samplers = static_cast<uint32_t>(samplers.size());
+	stats.destroyed = destroyed;
+	return stats;
+}
@@ -0,0 +1,69 @@
+#pragma once
+#include "vk_types.h"
+
+class VulkanEngine;
+
+struct RetireQueueStats {
+	uint32_t pending_buffers = 0;
+	uint32_t pending_images = 0;
+	uint32_t pending_views = 0;
+	uint32_t pending_samplers = 0;
+	uint64_t destroyed = 0;
+};
+
+//Vulkan objects that frames in flight may still be reading, destroyed once every one of those frames has finished.
+//Each kind of object has its own list of plain handles tagged with the frame number whose fence wait frees them, which is
+//what a timeline value would be with one submit per frame. The lists keep their capacity, so once they've grown to the
+//busiest frame's worth retiring allocates nothing
+struct RetireQueue {
+	void Init(VulkanEngine* engine_ptr, uint32_t framesInFlight = 2);
+	//Destroys everything still queued, the device must be idle
+	void Flush();
+
+	//Call once per frame after waiting on that frame's fence, destroys everything retired framesInFlight or more frames ago
+	void BeginFrame(uint64_t frameNumber);
+
+	//The allocation stays tracked by the memory budget until it is destroyed
+	void Retire(const AllocatedBuffer& buffer);
+	//Destroys the image and its view
+	void Retire(const AllocatedImage& image);
+	void Retire(VkImageView view);
+	void Retire(VkSampler sampler);
+
+	RetireQueueStats GetStats() const;
+
+private:
+	template<typename T>
+	struct Retired {
+		T handle;
+		uint64_t retireFrame;
+	};
+
+	struct BufferHandle {
+		VkBuffer buffer;
+		VmaAllocation allocation;
+	};
+
+	struct ImageHandle {
+		VkImage image;
+		VkImageView view;
+		VmaAllocation allocation;
+	};
+
+	//Destroys the front of the list up to the first entry retired after frame, entries are queued in frame order
+	template<typename T, typename Destroy>
+	void Collect(std::vector<Retired<T>>& list, uint64_t frame, Destroy&& destroy);
+
+	void DestroyBuffer(const BufferHandle& buffer);
+	void DestroyImage(const ImageHandle& image);
+
+	VulkanEngine* engine = nullptr;
+	uint64_t current_frame = 0;
+	uint32_t frames_in_flight = 2;
+	uint64_t destroyed = 0;
+
+	std::vector<Retired<BufferHandle>> buffers;
+	std::vector<Retired<ImageHandle>> images;
+	std::vector<Retired<VkImageView>> image_views;
+	std::vector<Retired<VkSampler>> samplers;
+};
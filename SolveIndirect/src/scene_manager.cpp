@@ -2,13 +2,16 @@
 #include "vk_engine.h"
 #include "resource_manager.h"
 #include "engine_util.h"
+#include "profiling.h"
 #include <algorithm>
 #include <future>
+#include <unordered_map>
 
-void SceneManager::Init(std::shared_ptr<ResourceManager> rm, VulkanEngine* engine_ptr)
+void SceneManager::Init(std::shared_ptr<ResourceManager> rm, VulkanEngine* engine_ptr, uint32_t framesInFlight)
 {
 	resource_manager = rm;
 	engine = engine_ptr;
+	frames_in_flight = framesInFlight;
 
 	forward_pass.type = vkutil::MeshPassType::Forward;
 	shadow_pass.type = vkutil::MeshPassType::Shadow;
@@ -20,147 +23,131 @@ void SceneManager::Init(std::shared_ptr<ResourceManager> rm, VulkanEngine* engin
 	shadow_pass.needs_materials = false;
 }
 
-void SceneManager::MergeMeshes()
+void SceneManager::Cleanup()
 {
-	size_t total_vertices = 0;
-	size_t total_indices = 0;
+	//the device is idle, the buffers go straight away
+	RetireBuffers();
+	resource_manager->retire_queue.Flush();
+	scenes.clear();
+	for (MeshPass* pass : { &forward_pass, &transparency_pass })
+		pass->objects.Clear();
+	objects.Clear();
+	meshes.Clear();
+	mesh_handles.clear();
+}
 
-	size_t last_mesh_vert_size = 0;
-	size_t last_mesh_indice_size = 0;
-	mesh_count = renderables.size();
-	GPUMeshBuffers* mesh_buffer = renderables[0].meshBuffer;
-	RenderObject* previous_obj = nullptr;
-	for (auto& m : renderables)
+void SceneManager::AddScene(uint64_t id, std::weak_ptr<LoadedGLTF> scene, const glm::mat4& transform)
+{
+	TRACE_SCOPE("SceneManager::AddScene");
+	RemoveScene(id);
+
+	SceneInstance& instance = scenes[id];
+	instance.scene = scene;
+	instance.transform = transform;
+	//the scene is only walked here, commits lay out the surfaces already registered
+	if (std::shared_ptr<LoadedGLTF> loaded = scene.lock())
 	{
-		m.firstIndex = static_cast<uint32_t>(total_indices);
-		m.firstVertex = static_cast<uint32_t>(total_vertices);
+		DrawContext ctx;
+		loaded->Draw(transform, ctx);
+		for (const RenderObject& surface : ctx.OpaqueSurfaces)
+			instance.objects.push_back(RegisterSurface(surface, &forward_pass));
+		for (const RenderObject& surface : ctx.TransparentSurfaces)
+			instance.objects.push_back(RegisterSurface(surface, &transparency_pass));
+	}
+	scenes_changed = true;
+}
 
-		total_vertices += m.vertexCount;
-		total_indices += m.indexCount;
-		if (mesh_buffer == m.meshBuffer)
-		{
-			last_mesh_vert_size += m.vertexCount;
-			last_mesh_indice_size += m.indexCount;
+void SceneManager::RemoveScene(uint64_t id)
+{
+	auto it = scenes.find(id);
+	if (it == scenes.end())
+		return;
 
-			m.meshBuffer->mesh_info.mesh_vert_count = last_mesh_vert_size;
-			m.meshBuffer->mesh_info.mesh_indice_count = last_mesh_indice_size;
-			//m.meshAssetVertexCount += last_mesh_vert_size;
-			//m.meshAssetIndexCount += last_mesh_indice_size;
-		}
-		else
-		{
-			last_mesh_vert_size = 0;
-			last_mesh_indice_size = 0;
-		}
-		mesh_buffer = m.meshBuffer;
-	}
-	assert(total_vertices && total_indices);
+	for (const SceneObject& object : it->second.objects)
+		UnregisterSurface(object);
+	scenes.erase(it);
+	scenes_changed = true;
+}
 
-	merged_vertex_buffer = resource_manager->CreateBuffer(total_vertices * sizeof(Vertex), VK_BUFFER_USAGE_STORAGE_BUFFER_BIT| VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
-	merged_index_buffer = resource_manager->CreateBuffer(total_indices * sizeof(uint32_t), VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT| VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT, VMA_MEMORY_USAGE_GPU_ONLY);
+SceneManager::SceneObject SceneManager::RegisterSurface(const RenderObject& surface, MeshPass* pass)
+{
+	auto [mesh, inserted] = mesh_handles.try_emplace(surface.meshBuffer);
+	if (inserted)
+		mesh->second = meshes.Insert(DrawMesh{ .original = surface.meshBuffer });
+	meshes.Get(mesh->second)->references++;
+
+	SceneObject object;
+	object.object = objects.Insert(surface);
+	object.pass_object = pass->objects.Insert(PassObject{ .meshID = mesh->second, .original = object.object, .builtbatch = -1, .customKey = 0 });
+	object.pass = pass;
+	return object;
+}
 
-	VkBufferDeviceAddressInfo deviceAdressInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO,.buffer = merged_vertex_buffer.buffer };
-	mergedVertexAddress = vkGetBufferDeviceAddress(engine->_device, &deviceAdressInfo);
+void SceneManager::UnregisterSurface(const SceneObject& object)
+{
+	const Handle<DrawMesh> mesh_handle = object.pass->get(object.pass_object)->meshID;
+	DrawMesh* mesh = meshes.Get(mesh_handle);
+	if (--mesh->references == 0)
+	{
+		mesh_handles.erase(mesh->original);
+		meshes.Erase(mesh_handle);
+	}
+	object.pass->objects.Erase(object.pass_object);
+	objects.Erase(object.object);
+}
 
+SceneManager::PassObject* SceneManager::MeshPass::get(Handle<PassObject> handle)
+{
+	return objects.Get(handle);
+}
 
-	engine->immediate_submit([&](VkCommandBuffer cmd)
-		{
-			GPUMeshBuffers* last_mesh_buffer = nullptr;
-			uint32_t vert_dst_off = 0;
-			uint32_t index_dst_off = 0;
-			int same_buffer_count = 0;
-			
-			for (auto& m : renderables)
-			{
-				
-				
-				/*VkBufferCopy vertex_copy;
-				vertex_copy.dstOffset = sizeof(Vertex) * m.firstVertex;
-				vertex_copy.size = sizeof(Vertex) * m.vertexCount;
-				vertex_copy.srcOffset = 0;
-				vkCmdCopyBuffer(cmd, m.vertexBuffer, merged_vertex_buffer.buffer, 1, &vertex_copy);
-				
-				
-				VkBufferCopy index_copy;
-				index_copy.dstOffset = sizeof(uint32_t) * m.firstIndex;
-				index_copy.size = sizeof(uint32_t) * m.indexCount;
-				index_copy.srcOffset = 0;
-				vkCmdCopyBuffer(cmd, m.indexBuffer, merged_index_buffer.buffer, 1, &index_copy);
-				*/
-
-				if (last_mesh_buffer != m.meshBuffer)
-				{
-					//m.meshBuffer->vertexBuffer.info.size;
-					/*VkBufferCopy vertex_copy;
-					vertex_copy.dstOffset = sizeof(Vertex) * m.firstVertex;
-					vertex_copy.size = sizeof(Vertex) * m.vertexCount;
-					vertex_copy.srcOffset = 0;
-					vkCmdCopyBuffer(cmd, m.vertexBuffer, merged_vertex_buffer.buffer, 1, &vertex_copy);
-
-					VkBufferCopy index_copy;
-					index_copy.dstOffset = sizeof(uint32_t) * m.firstIndex;
-					index_copy.size = sizeof(uint32_t) * m.indexCount;
-					index_copy.srcOffset = 0;
-					vkCmdCopyBuffer(cmd, m.indexBuffer, merged_index_buffer.buffer, 1, &index_copy);*/
-					//last_vertex_buffer = &m.vertexBuffer;
-					
-
-					
-					VkBufferCopy vertex_copy;
-					vertex_copy.dstOffset = vert_dst_off;
-					vertex_copy.size = m.meshBuffer->mesh_info.mesh_vert_count * sizeof(Vertex);
-					vertex_copy.srcOffset = 0;
-					vkCmdCopyBuffer(cmd, m.vertexBuffer, merged_vertex_buffer.buffer, 1, &vertex_copy);
-					
-					VkBufferCopy index_copy;
-					index_copy.dstOffset = index_dst_off;
-					index_copy.size = m.meshBuffer->mesh_info.mesh_indice_count * sizeof(uint32_t);
-					index_copy.srcOffset = 0;
-					vkCmdCopyBuffer(cmd, m.indexBuffer, merged_index_buffer.buffer, 1, &index_copy);
-					
-
-					vert_dst_off += vertex_copy.size;
-					index_dst_off += m.meshBuffer->indexBuffer.info.size;
-				}
-				last_mesh_buffer = m.meshBuffer;
-			}
-		}
-	);
+void SceneManager::CommitSceneChanges()
+{
+	ZoneScoped;
+	assert(!forward_pass.objects.Empty() || !transparency_pass.objects.Empty());
 
-	std::vector<vkutil::GPUModelInformation> scene_indirect_data;
-	for (auto& m : renderables)
+	RetireBuffers();
+	for (MeshPass* pass : { &forward_pass, &shadow_pass, &early_depth_pass, &transparency_pass })
 	{
-		scene_indirect_data.emplace_back(vkutil::GPUModelInformation
-			{
-			.local_transform = m.transform,
-			.sphereBounds = BlackKey::Vec3Tovec4(m.bounds.origin, m.bounds.sphereRadius),
-			.texture_index = m.material->material_index,
-			.firstIndex = m.firstIndex / ((uint32_t)sizeof(uint32_t)),
-			.indexCount = m.indexCount,
-			.firstVertex = m.firstVertex,
-			.vertexCount = m.vertexCount,
-			.firstInstance = 0,
-			.vertexBuffer = m.vertexBufferAddress,
-			.pad = glm::vec4(0)
-			});
+		pass->flat_objects.clear();
+		pass->batches.clear();
+		pass->multibatches.clear();
 	}
-	object_data_buffer = resource_manager->CreateAndUpload(scene_indirect_data.size() * sizeof(vkutil::GPUModelInformation),
-		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, scene_indirect_data.data());
+	object_commands.clear();
+
+	RegisterObjectBatch();
+	UpdateObjectDataBuffers();
+	PrepareIndirectBuffers();
+	BuildBatches();
+	scenes_changed = false;
+	buffer_generation++;
+}
 
+void SceneManager::RetireBuffers()
+{
+	for (AllocatedBuffer* buffer : { &object_data_buffer, &indirect_command_buffer, &clear_indirect_command_buffer, &address_buffer,
+		&forward_pass.drawIndirectBuffer, &shadow_pass.drawIndirectBuffer, &transparency_pass.drawIndirectBuffer, &early_depth_pass.drawIndirectBuffer })
+	{
+		if (buffer->buffer == VK_NULL_HANDLE)
+			continue;
+		resource_manager->RetireBuffer(*buffer);
+		*buffer = AllocatedBuffer{};
+	}
 }
 
-AllocatedBuffer* SceneManager::GetMergedIndexBuffer()
+AllocatedBuffer* SceneManager::GetGeometryIndexBuffer()
 {
-	return &merged_index_buffer;
+	return &resource_manager->geometry_heap.indexBuffer;
 }
 
-AllocatedBuffer* SceneManager::GetMergedVertexBuffer()
+AllocatedBuffer* SceneManager::GetGeometryVertexBuffer()
 {
-	return &merged_vertex_buffer;
+	return &resource_manager->geometry_heap.vertexBuffer;
 }
 
 void SceneManager::PrepareIndirectBuffers()
 {
+	ZoneScoped;
 	uint32_t index = 0;
 	for (const auto& r : renderables)
 	{
@@ -170,22 +157,30 @@ void SceneManager::PrepareIndirectBuffers()
 		indirectCommand.objectID = index;
 		indirectCommand.command.instanceCount = 0;
 		indirectCommand.command.firstIndex = r.firstIndex;
-		indirectCommand.command.vertexOffset = 0;
+		indirectCommand.command.vertexOffset = static_cast<int32_t>(r.firstVertex);
 		indirectCommand.command.firstInstance = index;
 		index++;
 		object_commands.push_back(indirectCommand);
 	}
 
+	//opaque objects come first in the indirect buffers followed by the transparent ones
+	const uint32_t opaque_count = static_cast<uint32_t>(forward_pass.flat_objects.size());
+	BuildDrawRanges(&forward_pass, 0, opaque_count);
+	BuildDrawRanges(&shadow_pass, 0, opaque_count);
+	BuildDrawRanges(&early_depth_pass, 0, static_cast<uint32_t>(renderables.size()));
+	BuildDrawRanges(&transparency_pass, opaque_count, static_cast<uint32_t>(transparency_pass.flat_objects.size()));
+
 	auto indirect_buffer_flags = VK_BUFFER_USAGE_TRANSFER_SRC_BIT |VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
 
-	indirect_command_buffer = resource_manager->CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * mesh_count, indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY);
+	//rebuilt on every scene commit, the scene manager destroys them itself
+	indirect_command_buffer = resource_manager->CreateBuffer(sizeof(VkDrawIndexedIndirectCommand) * mesh_count, indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Buffers, false);
 
-	clear_indirect_command_buffer = resource_manager->CreateBuffer(sizeof(GPUIndirectObject) * mesh_count, indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY);
+	clear_indirect_command_buffer = resource_manager->CreateBuffer(sizeof(GPUIndirectObject) * mesh_count, indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, MemoryCategory::Buffers, false);
 	
-	forward_pass.drawIndirectBuffer = resource_manager->CreateAndUpload(sizeof(GPUIndirectObject) * object_commands.size(), indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, object_commands.data());
-	shadow_pass.drawIndirectBuffer = resource_manager->CreateAndUpload(sizeof(GPUIndirectObject) * object_commands.size(), indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, object_commands.data());
-	transparency_pass.drawIndirectBuffer = resource_manager->CreateAndUpload(sizeof(GPUIndirectObject) * object_commands.size(), indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, object_commands.data());
-	early_depth_pass.drawIndirectBuffer = resource_manager->CreateAndUpload(sizeof(GPUIndirectObject) * object_commands.size(), indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, object_commands.data());
+	forward_pass.drawIndirectBuffer = resource_manager->CreateAndUpload(sizeof(GPUIndirectObject) * object_commands.size(), indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, object_commands.data(), MemoryCategory::Buffers, false);
+	shadow_pass.drawIndirectBuffer = resource_manager->CreateAndUpload(sizeof(GPUIndirectObject) * object_commands.size(), indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, object_commands.data(), MemoryCategory::Buffers, false);
+	transparency_pass.drawIndirectBuffer = resource_manager->CreateAndUpload(sizeof(GPUIndirectObject) * object_commands.size(), indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, object_commands.data(), MemoryCategory::Buffers, false);
+	early_depth_pass.drawIndirectBuffer = resource_manager->CreateAndUpload(sizeof(GPUIndirectObject) * object_commands.size(), indirect_buffer_flags, VMA_MEMORY_USAGE_GPU_ONLY, object_commands.data(), MemoryCategory::Buffers, false);
 
 	VkBufferDeviceAddressInfoKHR address_info{ VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO_KHR };
 	address_info.buffer = indirect_command_buffer.buffer;
@@ -193,10 +188,28 @@ void SceneManager::PrepareIndirectBuffers()
 	
 	const size_t address_buffer_size = sizeof(VkDeviceAddress);
 
-	address_buffer = resource_manager->CreateAndUpload(address_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &srcPtr);
+	address_buffer = resource_manager->CreateAndUpload(address_buffer_size, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, VMA_MEMORY_USAGE_GPU_ONLY, &srcPtr, MemoryCategory::Buffers, false);
 	
 }
 
+void SceneManager::BuildDrawRanges(MeshPass* pass, uint32_t first, uint32_t count)
+{
+	pass->draw_ranges.clear();
+	for (uint32_t i = first; i < first + count; i++)
+	{
+		VkIndexType index_type = renderables[i].indexType;
+		if (pass->draw_ranges.empty() || pass->draw_ranges.back().indexType != index_type)
+		{
+			pass->draw_ranges.push_back(IndirectDrawRange{
+				.indexType = index_type,
+				.first = i,
+				.count = 0
+				});
+		}
+		pass->draw_ranges.back().count++;
+	}
+}
+
 void SceneManager::ClearIndirectBuffers(MeshPass* pass)
 {
 	engine->immediate_submit([&](VkCommandBuffer cmd)
@@ -210,8 +223,9 @@ void SceneManager::ClearIndirectBuffers(MeshPass* pass)
 	);
 }
 
-void SceneManager::RefreshPass(MeshPass* pass)
+void SceneManager::RefreshPass(MeshPass* pass, std::span<const RenderObject> renderables)
 {
+	ZoneScoped;
 	//ClearIndirectBuffers(pass);
 	if (pass->needs_materials == false)
 	{
@@ -235,7 +249,7 @@ void SceneManager::RefreshPass(MeshPass* pass)
 	indirect_draw_call.count = 0;
 	indirect_draw_call.first = 0;
 	size_t last_index = 0;
-	for (auto& render_object : renderables)
+	for (const RenderObject& render_object : renderables)
 	{
 		if (last_mat != render_object.material)
 		{
@@ -255,16 +269,19 @@ void SceneManager::RefreshPass(MeshPass* pass)
 
 void SceneManager::BuildBatches()
 {
-	auto fwd = std::async(std::launch::async, [&] {RefreshPass(&forward_pass); });
-	auto shadow = std::async(std::launch::async, [&] {RefreshPass(&shadow_pass); });
-	auto trans = std::async(std::launch::async, [&] {RefreshPass(&transparency_pass); });
-	auto early_z = std::async(std::launch::async, [&] {RefreshPass(&early_depth_pass); });
-
+	ZoneScoped;
+	const std::array<MeshPass*, 4> passes = { &forward_pass, &shadow_pass, &transparency_pass, &early_depth_pass };
+	BuildBatches(passes, renderables);
+}
 
-	fwd.get();
-	shadow.get();
-	trans.get();
-	early_z.get();
+void SceneManager::BuildBatches(std::span<MeshPass* const> passes, std::span<const RenderObject> renderables)
+{
+	std::vector<std::future<void>> refreshes;
+	refreshes.reserve(passes.size());
+	for (MeshPass* pass : passes)
+		refreshes.push_back(std::async(std::launch::async, [=] { RefreshPass(pass, renderables); }));
+	for (std::future<void>& refresh : refreshes)
+		refresh.get();
 }
 
 SceneManager::MeshPass* SceneManager::GetMeshPass(vkutil::MaterialPass passType)
@@ -284,22 +301,33 @@ SceneManager::MeshPass* SceneManager::GetMeshPass(vkutil::MaterialPass passType)
 	}
 }
 
-void SceneManager::RegisterObjectBatch(DrawContext ctx)
+void SceneManager::RegisterObjectBatch()
 {
+	ZoneScoped;
 	renderables.clear();
-	for (const auto& object: ctx.OpaqueSurfaces)
-	{
-		forward_pass.flat_objects.push_back(object);
-	}
-	
-	for (const auto& object : ctx.TransparentSurfaces)
+	//uploads since the last step may have grown the heap into new buffers, meshes only move during UpdateGeometry
+	const GeometryHeap& heap = resource_manager->geometry_heap;
+	for (RenderObject& object : objects)
 	{
-		transparency_pass.flat_objects.push_back(object);
+		object.indexBuffer = heap.indexBuffer.buffer;
+		object.vertexBuffer = heap.vertexBuffer.buffer;
+		object.vertexBufferAddress = heap.vertexBufferAddress;
 	}
+
+	for (const PassObject& object : forward_pass.objects)
+		forward_pass.flat_objects.push_back(*objects.Get(object.original));
+	for (const PassObject& object : transparency_pass.objects)
+		transparency_pass.flat_objects.push_back(*objects.Get(object.original));
+
+	//group 16 bit surfaces ahead of 32 bit ones so each pass only needs one indirect range per index type
+	auto is_16bit = [](const RenderObject& object) { return object.indexType == VK_INDEX_TYPE_UINT16; };
+	std::stable_partition(forward_pass.flat_objects.begin(), forward_pass.flat_objects.end(), is_16bit);
+	std::stable_partition(transparency_pass.flat_objects.begin(), transparency_pass.flat_objects.end(), is_16bit);
 	std::copy(forward_pass.flat_objects.begin(), forward_pass.flat_objects.end(), std::back_inserter(renderables));
 	std::copy(transparency_pass.flat_objects.begin(), transparency_pass.flat_objects.end(), std::back_inserter(renderables));
 	early_depth_pass.flat_objects = renderables;
 	shadow_pass.flat_objects = forward_pass.flat_objects;
+	mesh_count = renderables.size();
 }
 
 void SceneManager::RegisterMeshAssetReference(std::string_view mesh_reference)
@@ -308,7 +336,149 @@ void SceneManager::RegisterMeshAssetReference(std::string_view mesh_reference)
 }
 void SceneManager::UpdateObjectDataBuffers()
 {
+	ZoneScoped;
+	//surfaces already point at their slots in the geometry heap, only the per object data needs uploading
+	object_data.clear();
+	for (auto& m : renderables)
+	{
+		object_data.emplace_back(vkutil::GPUModelInformation
+			{
+			.local_transform = m.transform,
+			.sphereBounds = BlackKey::Vec3Tovec4(m.bounds.origin, m.bounds.sphereRadius),
+			.texture_index = m.material->material_index,
+			.firstIndex = m.firstIndex,
+			.indexCount = m.indexCount,
+			.firstVertex = m.firstVertex,
+			.vertexCount = m.vertexCount,
+			.firstInstance = 0,
+			.vertexBuffer = m.vertexBufferAddress,
+			.pad = glm::vec4(0)
+			});
+	}
+	object_data_buffer = resource_manager->CreateAndUpload(object_data.size() * sizeof(vkutil::GPUModelInformation),
+		VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, VMA_MEMORY_USAGE_GPU_ONLY, object_data.data(), MemoryCategory::Buffers, false);
+	geometry_generation = resource_manager->geometry_heap.GetGeneration();
+}
+
+void SceneManager::UpdateGeometry(VkCommandBuffer cmd)
+{
+	ZoneScoped;
+	GeometryHeap& heap = resource_manager->geometry_heap;
+	geometry_moves.clear();
+	heap.Defragment(cmd, GEOMETRY_DEFRAG_BYTES_PER_FRAME, geometry_moves);
 
+	const bool reallocated = geometry_generation != heap.GetGeneration();
+	if (geometry_moves.empty() && !reallocated)
+		return;
+	geometry_generation = heap.GetGeneration();
+
+	//a mesh can move in both heaps during the same step, sorted by mesh its moves are merged in place
+	std::sort(geometry_moves.begin(), geometry_moves.end(), [](const GeometryMove& a, const GeometryMove& b) { return a.mesh < b.mesh; });
+	size_t merged = 0;
+	for (const GeometryMove& move : geometry_moves)
+	{
+		if (merged > 0 && geometry_moves[merged - 1].mesh == move.mesh)
+		{
+			geometry_moves[merged - 1].vertexDelta += move.vertexDelta;
+			geometry_moves[merged - 1].indexWordDelta += move.indexWordDelta;
+		}
+		else
+			geometry_moves[merged++] = move;
+	}
+	geometry_moves.resize(merged);
+
+	auto patch_object = [&](RenderObject& object) {
+		object.indexBuffer = heap.indexBuffer.buffer;
+		object.vertexBuffer = heap.vertexBuffer.buffer;
+		object.vertexBufferAddress = heap.vertexBufferAddress;
+
+		auto it = std::lower_bound(geometry_moves.begin(), geometry_moves.end(), object.meshBuffer,
+			[](const GeometryMove& move, const GPUMeshBuffers* mesh) { return move.mesh < mesh; });
+		if (it == geometry_moves.end() || it->mesh != object.meshBuffer)
+			return false;
+		//16 bit indices are counted in half words
+		const int64_t index_scale = object.indexType == VK_INDEX_TYPE_UINT16 ? 2 : 1;
+		object.firstVertex = static_cast<uint32_t>(int64_t(object.firstVertex) + it->vertexDelta);
+		object.firstIndex = static_cast<uint32_t>(int64_t(object.firstIndex) + it->indexWordDelta * index_scale);
+		return true;
+	};
+
+	//the next commit lays these out again, registered or not they have to follow the moves
+	for (RenderObject& object : objects)
+		patch_object(object);
+	if (object_data.empty())
+		return;
+
+	for (MeshPass* pass : { &forward_pass, &shadow_pass, &early_depth_pass, &transparency_pass })
+	{
+		for (RenderObject& object : pass->flat_objects)
+			patch_object(object);
+	}
+
+	moved_objects.clear();
+	for (uint32_t i = 0; i < renderables.size(); i++)
+	{
+		RenderObject& object = renderables[i];
+		if (patch_object(object))
+		{
+			moved_objects.push_back(i);
+			object_commands[i].command.firstIndex = object.firstIndex;
+			object_commands[i].command.vertexOffset = static_cast<int32_t>(object.firstVertex);
+		}
+		object_data[i].firstIndex = object.firstIndex;
+		object_data[i].firstVertex = object.firstVertex;
+		object_data[i].vertexBuffer = object.vertexBufferAddress;
+	}
+
+	//previous frames may still be culling with or drawing from these buffers
+	VkMemoryBarrier barrier = { .sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER };
+	barrier.srcAccessMask = VK_ACCESS_SHADER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		VK_PIPELINE_STAGE_TRANSFER_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+
+	//vkCmdUpdateBuffer is capped at 64 KB per call
+	const size_t max_update_objects = 65536 / sizeof(vkutil::GPUModelInformation);
+	auto update_object_data = [&](uint32_t first, uint32_t count) {
+		for (uint32_t offset = 0; offset < count; offset += max_update_objects)
+		{
+			const uint32_t update_count = std::min<uint32_t>(max_update_objects, count - offset);
+			vkCmdUpdateBuffer(cmd, object_data_buffer.buffer, (first + offset) * sizeof(vkutil::GPUModelInformation),
+				update_count * sizeof(vkutil::GPUModelInformation), &object_data[first + offset]);
+		}
+	};
+
+	if (reallocated)
+	{
+		//every object holds the vertex buffer address
+		update_object_data(0, static_cast<uint32_t>(object_data.size()));
+	}
+	else
+	{
+		for (size_t i = 0; i < moved_objects.size();)
+		{
+			size_t run_end = i + 1;
+			while (run_end < moved_objects.size() && moved_objects[run_end] == moved_objects[run_end - 1] + 1)
+				run_end++;
+			update_object_data(moved_objects[i], static_cast<uint32_t>(run_end - i));
+			i = run_end;
+		}
+	}
+
+	//only firstIndex and vertexOffset are rewritten, instanceCount belongs to the cull pass
+	for (uint32_t object_index : moved_objects)
+	{
+		const VkDeviceSize offset = object_index * sizeof(GPUIndirectObject) + offsetof(VkDrawIndexedIndirectCommand, firstIndex);
+		const uint32_t command[2] = { object_commands[object_index].command.firstIndex, static_cast<uint32_t>(object_commands[object_index].command.vertexOffset) };
+		for (MeshPass* pass : { &forward_pass, &shadow_pass, &early_depth_pass, &transparency_pass })
+			vkCmdUpdateBuffer(cmd, pass->drawIndirectBuffer.buffer, offset, sizeof(command), command);
+	}
+
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT | VK_ACCESS_SHADER_WRITE_BIT | VK_ACCESS_INDIRECT_COMMAND_READ_BIT;
+	vkCmdPipelineBarrier(cmd, VK_PIPELINE_STAGE_TRANSFER_BIT,
+		VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_VERTEX_SHADER_BIT | VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
+		0, 1, &barrier, 0, nullptr, 0, nullptr);
 }
 
 AllocatedBuffer* SceneManager::GetObjectDataBuffer()
@@ -325,6 +495,6 @@ size_t SceneManager::GetModelCount()
 	return renderables.size();
 }
 
-VkDeviceAddress* SceneManager::GetMergedDeviceAddress() {
-	return &mergedVertexAddress;
-}
\ No newline at end of file
+VkDeviceAddress SceneManager::GetGeometryDeviceAddress() {
+	return resource_manager->geometry_heap.vertexBufferAddress;
+}
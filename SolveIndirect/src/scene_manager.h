@@ -4,20 +4,21 @@
 #include "vk_util.h"
 #include "vk_loader.h"
 #include "engine_util.h"
+#include "slot_map.h"
+#include "geometry_heap.h"
+#include <map>
 #include <memory>
 #include <string_view>
+#include <unordered_map>
 
 class VulkanEngine;
 class ResourceManager;
 
+//A mesh drawn by the registered surfaces. Its ranges are read from the mesh buffers, the geometry heap moves them
 struct DrawMesh {
-	uint32_t firstVertex;
-	uint32_t firstIndex;
-	uint32_t indexCount;
-	uint32_t vertexCount;
-	bool isMerged;
-
 	GPUMeshBuffers* original;
+	//registered surfaces drawing the mesh, it is dropped with the last one
+	uint32_t references = 0;
 };
 
 
@@ -52,7 +53,7 @@ struct SceneManager {
 
 		bool operator==(const RenderBatch& other) const
 		{
-			return object.handle == other.object.handle && sortKey == other.sortKey;
+			return object == other.object && sortKey == other.sortKey;
 		}
 	};
 	struct GPUIndirectObject {
@@ -72,22 +73,26 @@ struct SceneManager {
 		uint32_t count;
 	};
 
+	//Run of consecutive draws in a pass' indirect buffer that share an index type
+	struct IndirectDrawRange {
+		VkIndexType indexType;
+		uint32_t first;
+		uint32_t count;
+	};
+
 
 	struct MeshPass {
 		std::vector<SceneManager::Multibatch> multibatches;
 
 		std::vector<SceneManager::IndirectBatch> batches;
 
-		std::vector<Handle<RenderObject>> unbatchedObjects;
-
 		std::vector<SceneManager::RenderBatch> flat_batches;
 		std::vector<RenderObject>flat_objects;
 
-		std::vector<PassObject> objects;
+		//one per registered surface the pass batches, the flat objects are laid out from these on a commit
+		SlotMap<PassObject> objects;
 
-		std::vector<Handle<PassObject>> reusableObjects;
-
-		std::vector<Handle<PassObject>> objectsToDelete;
+		std::vector<SceneManager::IndirectDrawRange> draw_ranges;
 
 
 		AllocatedBuffer compactedInstanceBuffer;
@@ -107,24 +112,66 @@ struct SceneManager {
 
 	SceneManager() {}
 	~SceneManager() {}
-	void Init(std::shared_ptr<ResourceManager> rm,VulkanEngine* engine_ptr);
-	void MergeMeshes();
+	void Init(std::shared_ptr<ResourceManager> rm,VulkanEngine* engine_ptr, uint32_t framesInFlight = 2);
+	void Cleanup();
+	//Scenes drawn into the indirect passes. A scene's surfaces are registered when it is added and unregistered when it is
+	//removed, the passes pick the change up on the next commit. The scene manager doesn't keep them alive so the owner has to
+	//remove a scene before releasing it, adding an id that is already registered replaces that scene
+	void AddScene(uint64_t id, std::weak_ptr<LoadedGLTF> scene, const glm::mat4& transform = glm::mat4{ 1.f });
+	void RemoveScene(uint64_t id);
+	bool HasPendingSceneChanges() const { return scenes_changed; }
+	//Changes whenever a commit replaces the object data and indirect buffers, descriptors pointing at them are stale
+	uint32_t GetBufferGeneration() const { return buffer_generation; }
+	//Rebuilds the passes, object data and indirect buffers from the registered surfaces. The old buffers are
+	//destroyed once every frame that could still be reading them has retired. At least one surface has to stay
+	//registered, the passes can't be empty.
+	//The rebuild is deliberately whole: the cull shader finds an object's data and draw by its position in the flat
+	//arrays, and each pass draws those arrays as one range per index type, opaque ahead of transparent. Patching a
+	//changed slot in place would shift every object after it, so the stable handles end at the flat arrays
+	void CommitSceneChanges();
 	void BuildBatches();
-	void RefreshPass(MeshPass* pass);
+	//Appends the batches of the objects to the pass. Touches nothing but the pass, so passes can be refreshed in parallel
+	static void RefreshPass(MeshPass* pass, std::span<const RenderObject> renderables);
+	//Refreshes every pass from the same objects, one thread per pass
+	static void BuildBatches(std::span<MeshPass* const> passes, std::span<const RenderObject> renderables);
 	void PrepareIndirectBuffers();
-	void RegisterObjectBatch(DrawContext ctx);
+	//Lays the registered surfaces out in the flat object arrays of every pass
+	void RegisterObjectBatch();
 	void RegisterMeshAssetReference(std::string_view mesh_reference);
 	void UpdateObjectDataBuffers();
+	//Runs a step of the geometry heap defragmenter and patches the object data and indirect commands of
+	//every surface it moved. Record before anything else in the frame reads them
+	void UpdateGeometry(VkCommandBuffer cmd);
 	size_t GetModelCount();
 	MeshPass* GetMeshPass(vkutil::MaterialPass passType);
 	void ClearIndirectBuffers(MeshPass* pass);
+	void BuildDrawRanges(MeshPass* pass, uint32_t first, uint32_t count);
 	AllocatedBuffer* GetObjectDataBuffer();
 	AllocatedBuffer* GetIndirectCommandBuffer();
-	AllocatedBuffer* GetMergedVertexBuffer();
-	AllocatedBuffer* GetMergedIndexBuffer();
-	VkDeviceAddress* GetMergedDeviceAddress();
+	AllocatedBuffer* GetGeometryVertexBuffer();
+	AllocatedBuffer* GetGeometryIndexBuffer();
+	VkDeviceAddress GetGeometryDeviceAddress();
 
 private:
+	//A registered surface and its entry in the pass that batches it, the opaque or the transparent one
+	struct SceneObject {
+		Handle<RenderObject> object;
+		Handle<PassObject> pass_object;
+		MeshPass* pass;
+	};
+
+	struct SceneInstance {
+		std::weak_ptr<LoadedGLTF> scene;
+		glm::mat4 transform;
+		std::vector<SceneObject> objects;
+	};
+
+	SceneObject RegisterSurface(const RenderObject& surface, MeshPass* pass);
+	void UnregisterSurface(const SceneObject& object);
+
+	//Hands every buffer built from the current scenes to the resource manager's retire queue
+	void RetireBuffers();
+
 	MeshPass early_depth_pass;
 	MeshPass shadow_pass;
 	MeshPass forward_pass;
@@ -134,8 +181,6 @@ private:
 
 	int mesh_count = 0;
 	bool is_initialized = false;
-	AllocatedBuffer merged_vertex_buffer;
-	AllocatedBuffer merged_index_buffer;
 	AllocatedBuffer object_data_buffer;
 	AllocatedBuffer staging_address_buffer;
 	AllocatedBuffer address_buffer;
@@ -145,9 +190,23 @@ private:
 
 	VulkanEngine* engine;
 	std::shared_ptr<ResourceManager> resource_manager;
-	VkDeviceAddress mergedVertexAddress;
 	
+	//surfaces of every registered scene, kept up to date with the geometry heap between commits
+	SlotMap<RenderObject> objects;
+	SlotMap<DrawMesh> meshes;
+	std::unordered_map<const GPUMeshBuffers*, Handle<DrawMesh>> mesh_handles;
+
 	std::vector<RenderObject> renderables;
 	std::vector<GPUIndirectObject> object_commands;
+	std::vector<vkutil::GPUModelInformation> object_data;
+	uint32_t geometry_generation = 0;
+	//scratch of UpdateGeometry, kept so a frame without moves doesn't allocate
+	std::vector<GeometryMove> geometry_moves;
+	std::vector<uint32_t> moved_objects;
+
+	std::map<uint64_t, SceneInstance> scenes;
+	uint32_t frames_in_flight = 2;
+	bool scenes_changed = false;
+	uint32_t buffer_generation = 0;
 };
 #endif
@@ -0,0 +1,102 @@
+#pragma once
+#include "vk_types.h"
+
+//Values kept densely in one array behind handles that stay valid while the values move around in it.
+//A handle names a slot holding its value's position in the array and a generation that is bumped when the value is erased,
+//so a handle to an erased value is recognised as stale even after its slot is reused. Erasing moves the last value into the
+//hole, iteration goes over the array in no particular order
+template<typename T>
+struct SlotMap {
+	Handle<T> Insert(T value)
+	{
+		uint32_t slot;
+		if (free_slots.empty())
+		{
+			slot = static_cast<uint32_t>(slots.size());
+			slots.push_back(Slot{});
+		}
+		else
+		{
+			slot = free_slots.back();
+			free_slots.pop_back();
+		}
+
+		slots[slot].value = static_cast<uint32_t>(values.size());
+		values.push_back(std::move(value));
+		value_slots.push_back(slot);
+		return Handle<T>{ .handle = slot, .generation = slots[slot].generation };
+	}
+
+	//Returns false for a stale handle
+	bool Erase(Handle<T> handle)
+	{
+		if (!Contains(handle))
+			return false;
+
+		Slot& slot = slots[handle.handle];
+		const uint32_t last = static_cast<uint32_t>(values.size() - 1);
+		if (slot.value != last)
+		{
+			values[slot.value] = std::move(values[last]);
+			value_slots[slot.value] = value_slots[last];
+			slots[value_slots[last]].value = slot.value;
+		}
+		values.pop_back();
+		value_slots.pop_back();
+
+		slot.generation++;
+		free_slots.push_back(handle.handle);
+		return true;
+	}
+
+	bool Contains(Handle<T> handle) const
+	{
+		return handle.handle < slots.size() && slots[handle.handle].generation == handle.generation;
+	}
+
+	//nullptr for a stale handle
+	T* Get(Handle<T> handle) { return Contains(handle) ? &values[slots[handle.handle].value] : nullptr; }
+	const T* Get(Handle<T> handle) const { return Contains(handle) ? &values[slots[handle.handle].value] : nullptr; }
+
+	//Handle of the value at an index of the dense array
+	Handle<T> HandleAt(uint32_t index) const
+	{
+		const uint32_t slot = value_slots[index];
+		return Handle<T>{ .handle = slot, .generation = slots[slot].generation };
+	}
+
+	//Erases everything, handles given out before stay stale
+	void Clear()
+	{
+		for (uint32_t slot : value_slots)
+		{
+			slots[slot].generation++;
+			free_slots.push_back(slot);
+		}
+		values.clear();
+		value_slots.clear();
+	}
+
+	size_t Size() const { return values.size(); }
+	bool Empty() const { return values.empty(); }
+	T* Data() { return values.data(); }
+	const T* Data() const { return values.data(); }
+
+	auto begin() { return values.begin(); }
+	auto end() { return values.end(); }
+	auto begin() const { return values.begin(); }
+	auto end() const { return values.end(); }
+
+private:
+	struct Slot {
+		//index of the slot's value in values
+		uint32_t value = 0;
+		uint32_t generation = 0;
+	};
+
+	std::vector<T> values;
+	//slot of each value, moved along with it
+	std::vector<uint32_t> value_slots;
+	std::vector<Slot> slots;
+	std::vector<uint32_t> free_slots;
+};
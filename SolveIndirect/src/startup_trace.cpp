@@ -0,0 +1,173 @@
+#include "startup_trace.h"
+#include <fmt/core.h>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <string>
+
+constexpr size_t TRACE_DETAIL_SIZE = 112;
+constexpr size_t TRACE_CHUNK_EVENTS = 256;
+
+struct TraceEvent {
+	const char* name;
+	char detail[TRACE_DETAIL_SIZE];
+	int64_t start_us;
+	//negative for a mark
+	int64_t duration_us;
+};
+
+//Only the owning thread writes to a chunk, count is published after the event it covers so Finish can read
+//up to it from the main thread while workers are still appending
+struct TraceChunk {
+	std::array<TraceEvent, TRACE_CHUNK_EVENTS> events;
+	std::atomic<uint32_t> count{ 0 };
+	std::atomic<TraceChunk*> next{ nullptr };
+};
+
+struct TraceThread {
+	uint32_t id = 0;
+	TraceChunk* head = nullptr;
+	TraceChunk* tail = nullptr;
+	std::atomic<TraceThread*> next{ nullptr };
+};
+
+//Threads push themselves on the front when they record their first event. Buffers live until the process exits,
+//a worker's events have to survive the worker
+static std::atomic<TraceThread*> threads{ nullptr };
+static std::atomic<uint32_t> thread_count{ 0 };
+static std::atomic<bool> enabled{ false };
+static std::chrono::steady_clock::time_point origin;
+static std::string output_path;
+static thread_local TraceThread* this_thread = nullptr;
+
+static TraceThread* get_thread()
+{
+	if (this_thread)
+		return this_thread;
+
+	TraceThread* thread = new TraceThread();
+	thread->id = thread_count.fetch_add(1, std::memory_order_relaxed);
+	thread->head = thread->tail = new TraceChunk();
+	TraceThread* first = threads.load(std::memory_order_relaxed);
+	do {
+		thread->next.store(first, std::memory_order_relaxed);
+	} while (!threads.compare_exchange_weak(first, thread, std::memory_order_release, std::memory_order_relaxed));
+	this_thread = thread;
+	return thread;
+}
+
+void startup_trace::Enable(std::string_view outputPath)
+{
+	output_path = std::string(outputPath);
+	origin = std::chrono::steady_clock::now();
+	//the main thread takes the first id and the first track
+	get_thread();
+	enabled.store(true, std::memory_order_release);
+}
+
+bool startup_trace::IsEnabled()
+{
+	return enabled.load(std::memory_order_acquire);
+}
+
+int64_t startup_trace::Now()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - origin).count();
+}
+
+void startup_trace::Record(const char* name, std::string_view detail, int64_t start_us, int64_t duration_us)
+{
+	if (!IsEnabled())
+		return;
+
+	TraceThread* thread = get_thread();
+	TraceChunk* chunk = thread->tail;
+	uint32_t index = chunk->count.load(std::memory_order_relaxed);
+	if (index == TRACE_CHUNK_EVENTS)
+	{
+		TraceChunk* next = new TraceChunk();
+		chunk->next.store(next, std::memory_order_release);
+		thread->tail = chunk = next;
+		index = 0;
+	}
+
+	TraceEvent& event = chunk->events[index];
+	event.name = name;
+	const size_t length = std::min(detail.size(), TRACE_DETAIL_SIZE - 1);
+	memcpy(event.detail, detail.data(), length);
+	event.detail[length] = '\0';
+	event.start_us = start_us;
+	event.duration_us = duration_us;
+	chunk->count.store(index + 1, std::memory_order_release);
+}
+
+void startup_trace::Mark(const char* name)
+{
+	if (IsEnabled())
+		Record(name, {}, Now(), -1);
+}
+
+static std::string json_escape(std::string_view text)
+{
+	std::string escaped;
+	for (char c : text)
+	{
+		if (c == '"' || c == '\\')
+			escaped += '\\';
+		if (static_cast<unsigned char>(c) < 0x20)
+			escaped += fmt::format("\\u{:04x}", int(c));
+		else
+			escaped += c;
+	}
+	return escaped;
+}
+
+bool startup_trace::Finish()
+{
+	if (!enabled.exchange(false, std::memory_order_acq_rel))
+		return true;
+
+	std::string json = "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+	bool first = true;
+	auto append = [&](const std::string& event) {
+		json += first ? "\t" : ",\n\t";
+		json += event;
+		first = false;
+	};
+
+	uint32_t events = 0;
+	for (TraceThread* thread = threads.load(std::memory_order_acquire); thread; thread = thread->next.load(std::memory_order_relaxed))
+	{
+		append(fmt::format("{{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 1, \"tid\": {}, \"args\": {{\"name\": \"{}\"}}}}",
+			thread->id, thread->id == 0 ? std::string("main") : fmt::format("worker {}", thread->id)));
+		for (TraceChunk* chunk = thread->head; chunk; chunk = chunk->next.load(std::memory_order_acquire))
+		{
+			const uint32_t count = chunk->count.load(std::memory_order_acquire);
+			for (uint32_t i = 0; i < count; i++)
+			{
+				const TraceEvent& event = chunk->events[i];
+				std::string args = event.detail[0] == '\0' ? std::string() : fmt::format(", \"args\": {{\"detail\": \"{}\"}}", json_escape(event.detail));
+				if (event.duration_us < 0)
+					append(fmt::format("{{\"name\": \"{}\", \"ph\": \"i\", \"s\": \"g\", \"ts\": {}, \"pid\": 1, \"tid\": {}{}}}", event.name, event.start_us, thread->id, args));
+				else
+					append(fmt::format("{{\"name\": \"{}\", \"ph\": \"X\", \"ts\": {}, \"dur\": {}, \"pid\": 1, \"tid\": {}{}}}",
+						event.name, event.start_us, event.duration_us, thread->id, args));
+				events++;
+			}
+		}
+	}
+	json += "\n]}\n";
+
+	std::ofstream file(output_path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		fmt::println("Failed to open {}", output_path);
+		return false;
+	}
+	file << json;
+	fmt::println("Startup trace: {} events over {:.1f} ms written to {}", events, Now() / 1000.0, output_path);
+	return file.good();
+}
@@ -0,0 +1,47 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+
+//Records where startup time goes, from main to the first frame, as Chrome trace events that chrome://tracing and
+//ui.perfetto.dev open. Each thread appends to its own buffer without taking a lock, so the loader's worker threads
+//show up on their own tracks. Nothing is recorded unless Enable was called
+namespace startup_trace {
+	//Starts recording, the trace's time zero is now. Call on the main thread, it becomes the first track
+	void Enable(std::string_view outputPath);
+	bool IsEnabled();
+	//A single point in time on the calling thread
+	void Mark(const char* name);
+	//Stops recording and writes the trace to the path given to Enable. Call once the traced work is done, events
+	//still open on other threads are left out. Does nothing if recording was never enabled or has already finished
+	bool Finish();
+
+	//Appends a completed event to the calling thread's buffer, times are microseconds since Enable
+	void Record(const char* name, std::string_view detail, int64_t start_us, int64_t duration_us);
+	int64_t Now();
+}
+
+//Records the time from its construction to its destruction. name must outlive the trace, a string literal.
+//detail, a file path or a pipeline's shader, is shown as the event's argument. It is copied when the scope ends
+//and has to stay valid until then
+struct TraceScope {
+	explicit TraceScope(const char* name, std::string_view detail = {})
+		: name(name), detail(detail), start(startup_trace::IsEnabled() ? startup_trace::Now() : -1) {}
+	~TraceScope()
+	{
+		if (start >= 0)
+			startup_trace::Record(name, detail, start, startup_trace::Now() - start);
+	}
+
+	TraceScope(const TraceScope&) = delete;
+	TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+	const char* name;
+	std::string_view detail;
+	int64_t start;
+};
+
+#define TRACE_SCOPE_CONCAT_INNER(a, b) a##b
+#define TRACE_SCOPE_CONCAT(a, b) TRACE_SCOPE_CONCAT_INNER(a, b)
+//TRACE_SCOPE("name") or TRACE_SCOPE("name", detail), for the rest of the enclosing block
+#define TRACE_SCOPE(...) TraceScope TRACE_SCOPE_CONCAT(trace_scope_, __LINE__)(__VA_ARGS__)
@@ -0,0 +1,351 @@
+#include "stress_scene.h"
+#include "resource_manager.h"
+#include "profiling.h"
+#include <glm/gtc/constants.hpp>
+#include <algorithm>
+#include <charconv>
+#include <cmath>
+#include <random>
+#include <unordered_map>
+
+static const char* layout_name(StressLayout layout)
+{
+	switch (layout)
+	{
+	case StressLayout::City: return "city";
+	case StressLayout::Interior: return "interior";
+	default: return "grid";
+	}
+}
+
+static bool parse_count(std::string_view value, uint32_t max, uint32_t& count)
+{
+	uint32_t parsed = 0;
+	const auto [end, error] = std::from_chars(value.data(), value.data() + value.size(), parsed);
+	if (error != std::errc() || end != value.data() + value.size())
+		return false;
+	count = std::min(parsed, max);
+	return true;
+}
+
+std::optional<StressSceneOptions> StressSceneOptions::Parse(std::string_view description)
+{
+	StressSceneOptions options;
+	while (!description.empty())
+	{
+		const size_t comma = description.find(',');
+		const std::string_view pair = description.substr(0, comma);
+		description = comma == std::string_view::npos ? std::string_view() : description.substr(comma + 1);
+		if (pair.empty())
+			continue;
+
+		const size_t equals = pair.find('=');
+		const std::string_view name = pair.substr(0, equals);
+		const std::string_view value = equals == std::string_view::npos ? std::string_view() : pair.substr(equals + 1);
+		bool valid = true;
+		if (name == "instances")
+			valid = parse_count(value, STRESS_MAX_INSTANCES, options.instances);
+		else if (name == "meshes")
+			valid = parse_count(value, STRESS_MAX_MESHES, options.meshes);
+		else if (name == "materials")
+			valid = parse_count(value, STRESS_MAX_MATERIALS, options.materials);
+		else if (name == "lights")
+			valid = parse_count(value, STRESS_MAX_LIGHTS, options.lights);
+		else if (name == "seed")
+			valid = parse_count(value, UINT32_MAX, options.seed);
+		else if (name == "layout" && value == "grid")
+			options.layout = StressLayout::Grid;
+		else if (name == "layout" && value == "city")
+			options.layout = StressLayout::City;
+		else if (name == "layout" && value == "interior")
+			options.layout = StressLayout::Interior;
+		else
+			valid = false;
+
+		if (!valid)
+		{
+			fmt::println("Bad stress scene option {}", pair);
+			return std::nullopt;
+		}
+	}
+	//a scene needs something to draw and something to draw it with
+	options.instances = std::max(options.instances, 1u);
+	options.meshes = std::max(options.meshes, 1u);
+	options.materials = std::max(options.materials, 1u);
+	return options;
+}
+
+std::string StressSceneOptions::ToString() const
+{
+	return fmt::format("instances={},meshes={},materials={},lights={},layout={},seed={}", instances, meshes, materials, lights, layout_name(layout), seed);
+}
+
+//City blocks are BLOCK_SIDE by BLOCK_SIDE buildings with a street between them
+constexpr uint32_t BLOCK_SIDE = 8;
+constexpr float BUILDING_SPACING = 3.0f;
+constexpr float STREET_WIDTH = 12.0f;
+constexpr float GRID_SPACING = 4.0f;
+//room for each instance of the interior layout, small enough that they intersect
+constexpr float INTERIOR_CELL = 1.5f;
+
+//Half the width and depth of the ground the layout covers and the height it reaches, centered on the origin
+static glm::vec3 layout_extent(const StressSceneOptions& options)
+{
+	switch (options.layout)
+	{
+	case StressLayout::City:
+	{
+		const uint32_t blocks = (options.instances + BLOCK_SIDE * BLOCK_SIDE - 1) / (BLOCK_SIDE * BLOCK_SIDE);
+		const float side = std::ceil(std::sqrt(float(blocks)));
+		const float pitch = BLOCK_SIDE * BUILDING_SPACING + STREET_WIDTH;
+		return glm::vec3(side * pitch * 0.5f, 20.0f, side * pitch * 0.5f);
+	}
+	case StressLayout::Interior:
+	{
+		//twice as wide as it is tall, like a hall
+		const float width = std::cbrt(options.instances * 2.0f) * INTERIOR_CELL;
+		return glm::vec3(width * 0.5f, width * 0.25f, width * 0.5f);
+	}
+	default:
+	{
+		const float side = std::ceil(std::sqrt(float(options.instances)));
+		return glm::vec3(side * GRID_SPACING * 0.5f, 4.0f, side * GRID_SPACING * 0.5f);
+	}
+	}
+}
+
+//The meshes span -1 to 1 on every axis, the transforms place their bottom on the ground
+static glm::mat4 instance_transform(const StressSceneOptions& options, uint32_t index, const glm::vec3& extent, std::mt19937& rng)
+{
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const float angle = unit(rng) * glm::two_pi<float>();
+	switch (options.layout)
+	{
+	case StressLayout::City:
+	{
+		const uint32_t block = index / (BLOCK_SIDE * BLOCK_SIDE);
+		const uint32_t building = index % (BLOCK_SIDE * BLOCK_SIDE);
+		const uint32_t blocks_per_row = static_cast<uint32_t>(extent.x * 2.0f / (BLOCK_SIDE * BUILDING_SPACING + STREET_WIDTH) + 0.5f);
+		const float pitch = BLOCK_SIDE * BUILDING_SPACING + STREET_WIDTH;
+		const glm::vec3 position(
+			(block % blocks_per_row) * pitch + (building % BLOCK_SIDE) * BUILDING_SPACING - extent.x,
+			0.0f,
+			(block / blocks_per_row) * pitch + (building / BLOCK_SIDE) * BUILDING_SPACING - extent.z);
+		//buildings are upright and axis aligned, their heights vary the most
+		const glm::vec3 scale(0.6f + unit(rng) * 0.6f, 1.0f + unit(rng) * 19.0f, 0.6f + unit(rng) * 0.6f);
+		return glm::translate(glm::mat4(1.0f), position + glm::vec3(0.0f, scale.y, 0.0f)) * glm::scale(glm::mat4(1.0f), scale);
+	}
+	case StressLayout::Interior:
+	{
+		const glm::vec3 position(
+			(unit(rng) * 2.0f - 1.0f) * extent.x,
+			unit(rng) * extent.y * 2.0f,
+			(unit(rng) * 2.0f - 1.0f) * extent.z);
+		const glm::vec3 axis = glm::normalize(glm::vec3(unit(rng) - 0.5f, unit(rng) - 0.5f, unit(rng) - 0.5f) + glm::vec3(0.0f, 1e-3f, 0.0f));
+		const float scale = 0.3f + unit(rng) * 0.7f;
+		return glm::translate(glm::mat4(1.0f), position) * glm::rotate(glm::mat4(1.0f), angle, axis) * glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+	}
+	default:
+	{
+		const uint32_t side = static_cast<uint32_t>(extent.x * 2.0f / GRID_SPACING + 0.5f);
+		const glm::vec3 position((index % side) * GRID_SPACING - extent.x, 0.0f, (index / side) * GRID_SPACING - extent.z);
+		const float scale = 0.6f + unit(rng) * 0.8f;
+		return glm::translate(glm::mat4(1.0f), position + glm::vec3(0.0f, scale, 0.0f)) * glm::rotate(glm::mat4(1.0f), angle, glm::vec3(0.0f, 1.0f, 0.0f))
+			* glm::scale(glm::mat4(1.0f), glm::vec3(scale));
+	}
+	}
+}
+
+struct SurfacePoint {
+	glm::vec3 position;
+	glm::vec3 normal;
+	glm::vec3 tangent;
+};
+
+//Appends a grid of columns by rows quads over the surface, which maps s and t in 0 to 1 to a point on it.
+//Triangles wind counter clockwise seen from the normal when s cross t points along it
+template<typename Surface>
+static void add_patch(std::vector<Vertex>& vertices, std::vector<uint16_t>& indices, uint32_t columns, uint32_t rows, Surface&& surface)
+{
+	const uint16_t first = static_cast<uint16_t>(vertices.size());
+	for (uint32_t y = 0; y <= rows; y++)
+	{
+		for (uint32_t x = 0; x <= columns; x++)
+		{
+			const float s = float(x) / columns;
+			const float t = float(y) / rows;
+			const SurfacePoint point = surface(s, t);
+			Vertex vertex;
+			vertex.position = point.position;
+			vertex.normal = point.normal;
+			vertex.uv_x = s;
+			vertex.uv_y = t;
+			vertex.color = glm::vec4(1.0f);
+			vertex.tangents = glm::vec4(point.tangent, 1.0f);
+			vertices.push_back(vertex);
+		}
+	}
+	const uint16_t row = static_cast<uint16_t>(columns + 1);
+	for (uint32_t y = 0; y < rows; y++)
+	{
+		for (uint32_t x = 0; x < columns; x++)
+		{
+			const uint16_t corner = static_cast<uint16_t>(first + y * row + x);
+			indices.insert(indices.end(), { corner, uint16_t(corner + 1), uint16_t(corner + row + 1), corner, uint16_t(corner + row + 1), uint16_t(corner + row) });
+		}
+	}
+}
+
+//Boxes, spheres and cylinders, tessellated differently for each index so no two meshes are alike.
+//Every shape stays well under 65536 vertices and uses 16 bit indices
+static void build_mesh(uint32_t index, std::vector<Vertex>& vertices, std::vector<uint16_t>& indices)
+{
+	const uint32_t variant = index / 3;
+	switch (index % 3)
+	{
+	case 0:
+	{
+		const uint32_t divisions = 1 + variant % 16;
+		const glm::vec3 normals[6] = { { 1, 0, 0 }, { -1, 0, 0 }, { 0, 1, 0 }, { 0, -1, 0 }, { 0, 0, 1 }, { 0, 0, -1 } };
+		for (const glm::vec3& normal : normals)
+		{
+			const glm::vec3 v = normal.y != 0.0f ? glm::vec3(0.0f, 0.0f, 1.0f) : glm::vec3(0.0f, 1.0f, 0.0f);
+			const glm::vec3 u = glm::cross(v, normal);
+			add_patch(vertices, indices, divisions, divisions, [&](float s, float t) {
+				return SurfacePoint{ normal + u * (s * 2.0f - 1.0f) + v * (t * 2.0f - 1.0f), normal, u };
+				});
+		}
+		break;
+	}
+	case 1:
+	{
+		const uint32_t segments = 8 + (variant * 5) % 57;
+		add_patch(vertices, indices, segments, segments / 2, [](float s, float t) {
+			const float theta = s * glm::two_pi<float>();
+			const float phi = t * glm::pi<float>();
+			const glm::vec3 normal(std::sin(phi) * std::cos(theta), std::cos(phi), std::sin(phi) * std::sin(theta));
+			return SurfacePoint{ normal, normal, glm::vec3(-std::sin(theta), 0.0f, std::cos(theta)) };
+			});
+		break;
+	}
+	default:
+	{
+		const uint32_t segments = 6 + (variant * 7) % 59;
+		const uint32_t rings = 1 + variant % 8;
+		add_patch(vertices, indices, segments, rings, [](float s, float t) {
+			const float theta = s * glm::two_pi<float>();
+			const glm::vec3 normal(std::cos(theta), 0.0f, std::sin(theta));
+			return SurfacePoint{ normal + glm::vec3(0.0f, 1.0f - t * 2.0f, 0.0f), normal, glm::vec3(-std::sin(theta), 0.0f, std::cos(theta)) };
+			});
+		//the caps are discs from the rim in to the center, the bottom one runs out so it faces down
+		for (float side : { 1.0f, -1.0f })
+		{
+			add_patch(vertices, indices, segments, 1, [side](float s, float t) {
+				const float theta = s * glm::two_pi<float>();
+				const float radius = side > 0.0f ? t : 1.0f - t;
+				return SurfacePoint{ glm::vec3(radius * std::cos(theta), side, radius * std::sin(theta)), glm::vec3(0.0f, side, 0.0f), glm::vec3(1.0f, 0.0f, 0.0f) };
+				});
+		}
+		break;
+	}
+	}
+}
+
+std::shared_ptr<LoadedGLTF> BuildStressScene(ResourceManager* resource_manager, const StressSceneOptions& options)
+{
+	ZoneScoped;
+	TRACE_SCOPE("BuildStressScene");
+	std::shared_ptr<LoadedGLTF> scene = std::make_shared<LoadedGLTF>();
+	scene->creator = resource_manager;
+	std::mt19937 rng(options.seed);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+
+	std::vector<std::shared_ptr<MeshAsset>> meshes;
+	std::vector<Vertex> vertices;
+	std::vector<uint16_t> indices;
+	for (uint32_t i = 0; i < options.meshes; i++)
+	{
+		vertices.clear();
+		indices.clear();
+		build_mesh(i, vertices, indices);
+
+		std::shared_ptr<MeshAsset> mesh = std::make_shared<MeshAsset>();
+		mesh->name = "stress_mesh" + std::to_string(i);
+		GeoSurface surface{};
+		surface.startIndex = 0;
+		surface.count = static_cast<uint32_t>(indices.size());
+		surface.firstVertex = 0;
+		surface.vertex_count = static_cast<uint32_t>(vertices.size());
+		surface.indexType = VK_INDEX_TYPE_UINT16;
+		//every shape fills the -1 to 1 cube
+		surface.bounds.origin = glm::vec3(0.0f);
+		surface.bounds.extents = glm::vec3(1.0f);
+		surface.bounds.sphereRadius = glm::length(surface.bounds.extents);
+		mesh->surfaces.push_back(surface);
+
+		mesh->meshBuffers = resource_manager->UploadMesh({}, indices, vertices);
+		resource_manager->geometry_heap.Track(&mesh->meshBuffers);
+		scene->meshes[mesh->name] = mesh;
+		meshes.push_back(std::move(mesh));
+	}
+
+	//untextured, the factors alone tell them apart
+	std::vector<std::shared_ptr<GLTFMaterial>> materials;
+	const GLTFMetallic_Roughness::MaterialResources resources = resource_manager->DefaultMaterialResources();
+	for (uint32_t i = 0; i < options.materials; i++)
+	{
+		GPUMaterial material;
+		material.colorFactors = glm::vec4(0.2f + unit(rng) * 0.8f, 0.2f + unit(rng) * 0.8f, 0.2f + unit(rng) * 0.8f, 1.0f);
+		material.metalRoughFactors = glm::vec4(unit(rng), 0.2f + unit(rng) * 0.8f, 0.0f, 0.0f);
+		materials.push_back(resource_manager->AddMaterial(*scene, "stress_material" + std::to_string(i), material, resources, vkutil::MaterialPass::forward));
+	}
+
+	//a node per mesh and material pair in use, holding the transforms of all its instances
+	const glm::vec3 extent = layout_extent(options);
+	std::unordered_map<uint64_t, std::shared_ptr<InstancedMeshNode>> groups;
+	std::uniform_int_distribution<uint32_t> pick_mesh(0, options.meshes - 1);
+	std::uniform_int_distribution<uint32_t> pick_material(0, options.materials - 1);
+	for (uint32_t i = 0; i < options.instances; i++)
+	{
+		const uint32_t mesh = pick_mesh(rng);
+		const uint32_t material = pick_material(rng);
+		std::shared_ptr<InstancedMeshNode>& group = groups[uint64_t(mesh) * options.materials + material];
+		if (!group)
+		{
+			group = std::make_shared<InstancedMeshNode>();
+			group->mesh = meshes[mesh];
+			group->material = materials[material];
+			group->localTransform = glm::mat4(1.0f);
+			scene->nodes[fmt::format("stress_group{}_{}", mesh, material)] = group;
+			scene->topNodes.push_back(group);
+		}
+		group->instances.push_back(instance_transform(options, i, extent, rng));
+	}
+	for (auto& node : scene->topNodes)
+		node->refreshTransform(glm::mat4{ 1.f });
+
+	fmt::println("Stress scene: {} instances of {} meshes with {} materials in {} nodes, {} layout", options.instances, options.meshes,
+		options.materials, scene->topNodes.size(), layout_name(options.layout));
+	return scene;
+}
+
+std::vector<PointLight> BuildStressLights(const StressSceneOptions& options)
+{
+	//seeded apart from the scene so changing the light count leaves the instances where they were
+	std::mt19937 rng(options.seed ^ 0x9e3779b9u);
+	std::uniform_real_distribution<float> unit(0.0f, 1.0f);
+	const glm::vec3 extent = layout_extent(options);
+	//reaching a few neighbours at the spacing the layout packs instances at
+	const float range = options.layout == StressLayout::City ? 15.0f : options.layout == StressLayout::Interior ? 6.0f : 12.0f;
+
+	std::vector<PointLight> lights;
+	lights.reserve(options.lights);
+	for (uint32_t i = 0; i < options.lights; i++)
+	{
+		const glm::vec4 position((unit(rng) * 2.0f - 1.0f) * extent.x, 1.0f + unit(rng) * (extent.y * 2.0f - 1.0f), (unit(rng) * 2.0f - 1.0f) * extent.z, 1.0f);
+		glm::vec3 color(unit(rng), unit(rng), unit(rng));
+		color /= std::max(std::max(color.r, color.g), std::max(color.b, 1e-3f));
+		lights.push_back(PointLight(position, glm::vec4(color, 1.0f), range, 1.0f));
+	}
+	return lights;
+}
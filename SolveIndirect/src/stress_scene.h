@@ -0,0 +1,46 @@
+#pragma once
+#include "vk_types.h"
+#include "Lights.h"
+
+struct ResourceManager;
+struct LoadedGLTF;
+
+constexpr uint32_t STRESS_MAX_INSTANCES = 1'000'000;
+constexpr uint32_t STRESS_MAX_MESHES = 1024;
+//well under the material table's capacity, the skybox and any streamed cells still need their entries
+constexpr uint32_t STRESS_MAX_MATERIALS = 4096;
+constexpr uint32_t STRESS_MAX_LIGHTS = 100'000;
+
+//How the instances of a stress scene are spread out
+enum class StressLayout {
+	//evenly spaced on the ground, nothing overlaps
+	Grid,
+	//tall boxes packed into blocks between streets, the nearest blocks hide most of the scene
+	City,
+	//a room filled from floor to ceiling, every pixel is covered many times over
+	Interior,
+};
+
+//A scene generated from a handful of counts, to measure how the renderer scales with each of them
+struct StressSceneOptions {
+	uint32_t instances = 10000;
+	//unique meshes the instances pick from, each uploaded once
+	uint32_t meshes = 16;
+	uint32_t materials = 32;
+	uint32_t lights = 100;
+	StressLayout layout = StressLayout::Grid;
+	//the same seed places everything in the same spot
+	uint32_t seed = 1;
+
+	//Reads comma separated name=value pairs: instances, meshes, materials, lights, layout (grid, city or interior) and seed.
+	//Counts are clamped to the limits above. Returns nothing on an unknown name or a bad value
+	static std::optional<StressSceneOptions> Parse(std::string_view description);
+	//The options in the form Parse reads
+	std::string ToString() const;
+};
+
+//Uploads the meshes and adds the materials through the resource manager, the scene releases them like a loaded glTF.
+//Instances sharing a mesh and a material are drawn by one node
+std::shared_ptr<LoadedGLTF> BuildStressScene(ResourceManager* resource_manager, const StressSceneOptions& options);
+//Point lights spread over the area the instances cover
+std::vector<PointLight> BuildStressLights(const StressSceneOptions& options);
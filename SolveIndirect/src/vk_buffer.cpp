@@ -9,7 +9,21 @@
 //#define VMA_IMPLEMENTATION
 //#define TRACY_ENABLE
 
-AllocatedBuffer vkutil::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VulkanEngine* engine)
+VmaAllocationCreateFlags vkutil::mapped_allocation_flags(VmaMemoryUsage memoryUsage)
+{
+	switch (memoryUsage)
+	{
+	case VMA_MEMORY_USAGE_CPU_ONLY:
+	case VMA_MEMORY_USAGE_CPU_TO_GPU:
+	case VMA_MEMORY_USAGE_GPU_TO_CPU:
+	case VMA_MEMORY_USAGE_CPU_COPY:
+		return VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	default:
+		return 0;
+	}
+}
+
+AllocatedBuffer vkutil::create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, VulkanEngine* engine, MemoryCategory category)
 {
 	// allocate buffer
 	VkBufferCreateInfo bufferInfo = { .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
@@ -20,13 +34,14 @@ AllocatedBuffer vkutil::create_buffer(size_t allocSize, VkBufferUsageFlags usage
 
 	VmaAllocationCreateInfo vmaallocInfo = {};
 	vmaallocInfo.usage = memoryUsage;
-	vmaallocInfo.flags = VMA_ALLOCATION_CREATE_MAPPED_BIT;
+	vmaallocInfo.flags = mapped_allocation_flags(memoryUsage);
 	AllocatedBuffer newBuffer;
 
 
 	// allocate the buffer
 	VK_CHECK(vmaCreateBuffer(engine->_allocator, &bufferInfo, &vmaallocInfo, &newBuffer.buffer, &newBuffer.allocation,
 		&newBuffer.info));
+	engine->_memoryBudget.Track(newBuffer.allocation, category);
 
 	return newBuffer;
 }
@@ -58,5 +73,6 @@ AllocatedBuffer vkutil::create_and_upload(size_t allocSize, VkBufferUsageFlags u
 
 void vkutil::destroy_buffer(const AllocatedBuffer& buffer, VulkanEngine* engine)
 {
+	engine->_memoryBudget.Untrack(buffer.allocation);
 	vmaDestroyBuffer(engine->_allocator, buffer.buffer, buffer.allocation);
 }
\ No newline at end of file
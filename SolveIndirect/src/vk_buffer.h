@@ -1,11 +1,14 @@
 #pragma once
 #include "vk_types.h"
 #include <vma/vk_mem_alloc.h>
+#include "memory_budget.h"
 
 class VulkanEngine;
 
 namespace vkutil {
-	AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,VulkanEngine* engine);
+	AllocatedBuffer create_buffer(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage,VulkanEngine* engine, MemoryCategory category = MemoryCategory::Buffers);
+	//Only host visible memory can stay mapped, GPU_ONLY buffers don't ask for it
+	VmaAllocationCreateFlags mapped_allocation_flags(VmaMemoryUsage memoryUsage);
 	void destroy_buffer(const AllocatedBuffer& buffer, VulkanEngine* engine);
 	AllocatedBuffer create_and_upload(size_t allocSize, VkBufferUsageFlags usage, VmaMemoryUsage memoryUsage, void* data, VulkanEngine* engine);
 }
@@ -1,4 +1,5 @@
 ﻿#include "vk_descriptors.h"
+#include <atomic>
 
 void DescriptorLayoutBuilder::add_binding(uint32_t binding, VkDescriptorType type, uint32_t count)
 {
@@ -29,9 +30,11 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device, VkShaderSt
     info.bindingCount = (uint32_t)bindings.size();
     info.flags = flags;
 
+    //both have to outlive the create call
+    VkDescriptorSetLayoutBindingFlagsCreateInfoEXT extended_info{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT };
+    std::vector<VkDescriptorBindingFlagsEXT> binding_flags;
     if ((flags & VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT) == VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT_EXT)
     {
-        VkDescriptorSetLayoutBindingFlagsCreateInfoEXT extended_info{.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO_EXT };
         extended_info.pNext = nullptr;
         extended_info.bindingCount = (uint32_t)bindings.size();
         VkDescriptorBindingFlagsEXT bindless_flags =
@@ -39,12 +42,9 @@ VkDescriptorSetLayout DescriptorLayoutBuilder::build(VkDevice device, VkShaderSt
             VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT_EXT |
             VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT_EXT;
         
-        VkDescriptorBindingFlagsEXT binding_flags[3];
-        binding_flags[0] = bindless_flags;
-        binding_flags[1] = bindless_flags;
-        binding_flags[2] = bindless_flags;
+        binding_flags.assign(bindings.size(), bindless_flags);
 
-        extended_info.pBindingFlags = binding_flags;
+        extended_info.pBindingFlags = binding_flags.data();
         info.pNext = &extended_info;
     }
     VkDescriptorSetLayout set;
@@ -160,8 +160,16 @@ VkDescriptorPool DescriptorAllocatorGrowable::get_pool(VkDevice device)
     return newPool;
 }
 
+static std::atomic<uint64_t> descriptor_pool_creations{ 0 };
+
+uint64_t GetDescriptorPoolCreationCount()
+{
+    return descriptor_pool_creations.load(std::memory_order_relaxed);
+}
+
 VkDescriptorPool DescriptorAllocatorGrowable::create_pool(VkDevice device, uint32_t setCount, std::span<PoolSizeRatio> poolRatios)
 {
+    descriptor_pool_creations.fetch_add(1, std::memory_order_relaxed);
     std::vector<VkDescriptorPoolSize> poolSizes;
     for (PoolSizeRatio ratio : poolRatios) {
         poolSizes.push_back(VkDescriptorPoolSize{
@@ -309,4 +317,123 @@ void DescriptorWriter::update_set(VkDevice device, VkDescriptorSet set)
     }
 
     vkUpdateDescriptorSets(device, (uint32_t)writes.size(), writes.data(), 0, nullptr);
+}
+
+void InlineDescriptorWriter::write_buffer(int binding, VkBuffer buffer, size_t size, size_t offset, VkDescriptorType type, int arr_index)
+{
+    assert(writeCount < CAPACITY);
+    VkDescriptorBufferInfo& info = bufferInfos[bufferCount++];
+    info = VkDescriptorBufferInfo{
+        .buffer = buffer,
+        .offset = offset,
+        .range = size
+    };
+
+    VkWriteDescriptorSet& write = writes[writeCount++];
+    write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pBufferInfo = &info;
+    if (arr_index >= 0)
+        write.dstArrayElement = arr_index;
+}
+
+void InlineDescriptorWriter::write_image(int binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type, int arr_index)
+{
+    assert(writeCount < CAPACITY);
+    VkDescriptorImageInfo& info = imageInfos[imageCount++];
+    info = VkDescriptorImageInfo{
+        .sampler = sampler,
+        .imageView = image,
+        .imageLayout = layout
+    };
+
+    VkWriteDescriptorSet& write = writes[writeCount++];
+    write = { .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET };
+    write.dstBinding = binding;
+    write.descriptorCount = 1;
+    write.descriptorType = type;
+    write.pImageInfo = &info;
+    if (arr_index >= 0)
+        write.dstArrayElement = arr_index;
+}
+
+void InlineDescriptorWriter::clear()
+{
+    imageCount = 0;
+    bufferCount = 0;
+    writeCount = 0;
+}
+
+void InlineDescriptorWriter::update_set(VkDevice device, VkDescriptorSet set)
+{
+    for (uint32_t i = 0; i < writeCount; i++) {
+        writes[i].dstSet = set;
+    }
+
+    vkUpdateDescriptorSets(device, writeCount, writes.data(), 0, nullptr);
+}
+
+DescriptorUpdateTemplate DescriptorLayoutBuilder::build_template(VkDevice device, VkDescriptorSetLayout layout) const
+{
+    DescriptorUpdateTemplate result;
+    std::vector<VkDescriptorUpdateTemplateEntry> entries;
+    entries.reserve(bindings.size());
+
+    for (const VkDescriptorSetLayoutBinding& b : bindings) {
+        if (b.binding >= result.firstEntry.size())
+            result.firstEntry.resize(b.binding + 1, UINT32_MAX);
+        result.firstEntry[b.binding] = result.entryCount;
+
+        entries.push_back(VkDescriptorUpdateTemplateEntry{
+            .dstBinding = b.binding,
+            .dstArrayElement = 0,
+            .descriptorCount = b.descriptorCount,
+            .descriptorType = b.descriptorType,
+            .offset = result.entryCount * sizeof(DescriptorTemplateEntry),
+            .stride = sizeof(DescriptorTemplateEntry)
+            });
+        result.entryCount += b.descriptorCount;
+    }
+
+    VkDescriptorUpdateTemplateCreateInfo info = { .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_UPDATE_TEMPLATE_CREATE_INFO };
+    info.descriptorUpdateEntryCount = (uint32_t)entries.size();
+    info.pDescriptorUpdateEntries = entries.data();
+    info.templateType = VK_DESCRIPTOR_UPDATE_TEMPLATE_TYPE_DESCRIPTOR_SET;
+    info.descriptorSetLayout = layout;
+
+    VK_CHECK(vkCreateDescriptorUpdateTemplate(device, &info, nullptr, &result.handle));
+    return result;
+}
+
+void DescriptorUpdateTemplate::write_image(DescriptorTemplateEntry* entries, uint32_t binding, VkImageView image, VkSampler sampler, VkImageLayout layout, uint32_t arr_index) const
+{
+    assert(binding < firstEntry.size() && firstEntry[binding] != UINT32_MAX);
+    entries[firstEntry[binding] + arr_index].image = VkDescriptorImageInfo{
+        .sampler = sampler,
+        .imageView = image,
+        .imageLayout = layout
+    };
+}
+
+void DescriptorUpdateTemplate::write_buffer(DescriptorTemplateEntry* entries, uint32_t binding, VkBuffer buffer, size_t size, size_t offset, uint32_t arr_index) const
+{
+    assert(binding < firstEntry.size() && firstEntry[binding] != UINT32_MAX);
+    entries[firstEntry[binding] + arr_index].buffer = VkDescriptorBufferInfo{
+        .buffer = buffer,
+        .offset = offset,
+        .range = size
+    };
+}
+
+void DescriptorUpdateTemplate::update_set(VkDevice device, VkDescriptorSet set, const DescriptorTemplateEntry* entries) const
+{
+    vkUpdateDescriptorSetWithTemplate(device, set, handle, entries);
+}
+
+void DescriptorUpdateTemplate::destroy(VkDevice device)
+{
+    vkDestroyDescriptorUpdateTemplate(device, handle, nullptr);
+    handle = VK_NULL_HANDLE;
 }
\ No newline at end of file
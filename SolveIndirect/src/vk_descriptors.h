@@ -2,6 +2,8 @@
 
 #include "vk_types.h"
 
+struct DescriptorUpdateTemplate;
+
 struct DescriptorLayoutBuilder {
 
     std::vector<VkDescriptorSetLayoutBinding> bindings;
@@ -9,6 +11,8 @@ struct DescriptorLayoutBuilder {
     void add_binding(uint32_t binding, VkDescriptorType type, uint32_t count = 1);
     void clear();
     VkDescriptorSetLayout build(VkDevice device, VkShaderStageFlags shaderStages, void* pNext = nullptr, VkDescriptorSetLayoutCreateFlags flags = 0);
+    //An update template writing every binding added so far to sets of layout, which must have been built from them
+    DescriptorUpdateTemplate build_template(VkDevice device, VkDescriptorSetLayout layout) const;
 };
 
 struct DescriptorAllocatorBindless {
@@ -36,6 +40,10 @@ struct DescriptorAllocator {
     VkDescriptorSet allocate(VkDevice device, VkDescriptorSetLayout layout);
 };
 
+//Pools the growable allocators have created since startup, from any thread. Once every frame's allocator has grown
+//to the busiest frame this stops moving, a jump means a frame ran out of descriptors
+uint64_t GetDescriptorPoolCreationCount();
+
 struct DescriptorAllocatorGrowable {
 public:
     struct PoolSizeRatio {
@@ -69,4 +77,50 @@ struct DescriptorWriter {
 
     void clear();
     void update_set(VkDevice device, VkDescriptorSet set);
+};
+
+//Same interface as DescriptorWriter with the infos and writes stored inline, it never allocates.
+//Holds at most CAPACITY descriptors, the infos are pointed at directly so it can't be copied
+struct InlineDescriptorWriter {
+    static constexpr uint32_t CAPACITY = 16;
+
+    std::array<VkDescriptorImageInfo, CAPACITY> imageInfos;
+    std::array<VkDescriptorBufferInfo, CAPACITY> bufferInfos;
+    std::array<VkWriteDescriptorSet, CAPACITY> writes;
+    uint32_t imageCount = 0;
+    uint32_t bufferCount = 0;
+    uint32_t writeCount = 0;
+
+    InlineDescriptorWriter() = default;
+    InlineDescriptorWriter(const InlineDescriptorWriter&) = delete;
+    InlineDescriptorWriter& operator=(const InlineDescriptorWriter&) = delete;
+
+    void write_image(int binding, VkImageView image, VkSampler sampler, VkImageLayout layout, VkDescriptorType type, int arr_index = -1);
+    void write_buffer(int binding, VkBuffer buffer, size_t size, size_t offset, VkDescriptorType type, int arr_index = -1);
+
+    void clear();
+    void update_set(VkDevice device, VkDescriptorSet set);
+};
+
+//One descriptor in the data of an update template, image and buffer infos share the slot so every entry has the same stride
+union DescriptorTemplateEntry {
+    VkDescriptorImageInfo image;
+    VkDescriptorBufferInfo buffer;
+};
+
+//Writes every binding of a set layout in one vkUpdateDescriptorSetWithTemplate call, reading the descriptors from a
+//packed array of entries. Bindings take consecutive entries in the order they were added to the builder, an array
+//binding takes one per element
+struct DescriptorUpdateTemplate {
+    VkDescriptorUpdateTemplate handle = VK_NULL_HANDLE;
+    //first entry of each binding, indexed by binding number
+    std::vector<uint32_t> firstEntry;
+    uint32_t entryCount = 0;
+
+    void write_image(DescriptorTemplateEntry* entries, uint32_t binding, VkImageView image, VkSampler sampler, VkImageLayout layout, uint32_t arr_index = 0) const;
+    void write_buffer(DescriptorTemplateEntry* entries, uint32_t binding, VkBuffer buffer, size_t size, size_t offset, uint32_t arr_index = 0) const;
+
+    //entries must hold entryCount descriptors, every one of them written
+    void update_set(VkDevice device, VkDescriptorSet set, const DescriptorTemplateEntry* entries) const;
+    void destroy(VkDevice device);
 };
\ No newline at end of file
@@ -17,6 +17,7 @@
 #include <thread>
 #include <iostream>
 #include <random>
+#include <algorithm>
 
 #ifdef _DEBUG
 constexpr bool bUseValidationLayers = true;
@@ -24,7 +25,7 @@ constexpr bool bUseValidationLayers = true;
 constexpr bool bUseValidationLayers = false;
 #endif
 
-#include "../../tracy/public/tracy/Tracy.hpp"
+#include "profiling.h"
 #include <vma/vk_mem_alloc.h>
 
 
@@ -41,21 +42,28 @@ VulkanEngine* loadedEngine = nullptr;
 
 
 VulkanEngine& VulkanEngine::Get() { return *loadedEngine; }
-void VulkanEngine::init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13)
+void VulkanEngine::init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13, bool headless)
 {
 
 	assert(loadedEngine == nullptr);
 	loadedEngine = this;
-
-	glfwInit();
-	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
-	glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
-
-	window = glfwCreateWindow(_windowExtent.width, _windowExtent.height, "Black key", nullptr, nullptr);
-	if (window == nullptr)
-		throw std::exception("FATAL ERROR: Failed to create window");
+	_headless = headless;
+
+	//GLFW isn't initialized headless, it fails on machines without a display
+	if (!_headless)
+	{
+		glfwInit();
+		glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
+		glfwWindowHint(GLFW_RESIZABLE, GLFW_TRUE);
+
+		TRACE_SCOPE("glfwCreateWindow");
+		window = glfwCreateWindow(_windowExtent.width, _windowExtent.height, "Black key", nullptr, nullptr);
+		if (window == nullptr)
+			throw std::exception("FATAL ERROR: Failed to create window");
+	}
 
 	init_vulkan(baseFeatures, features11, features12, features13);
+	_pipelineCache.Init(_device, _chosenGPU);
 	init_commands();
 	init_sync_structures();
 
@@ -66,6 +74,7 @@ void VulkanEngine::init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceV
 
 void VulkanEngine::init_commands()
 {
+	TRACE_SCOPE("init_commands");
 	//create a command pool for commands submitted to the graphics queue.
 	//we also want the pool to allow for resetting of individual command buffers
 	VkCommandPoolCreateInfo commandPoolInfo = vkinit::command_pool_create_info(_graphicsQueueFamily, VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT);
@@ -171,22 +180,31 @@ void VulkanEngine::cleanup()
 		// make sure the gpu has stopped doing its things
 		vkDeviceWaitIdle(_device);
 
-		vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		if (_surface != VK_NULL_HANDLE)
+			vkDestroySurfaceKHR(_instance, _surface, nullptr);
+		_pipelineCache.Cleanup();
 		vmaDestroyAllocator(_allocator);
 
 		vkDestroyDevice(_device, nullptr);
 		vkb::destroy_debug_utils_messenger(_instance, _debug_messenger);
 		vkDestroyInstance(_instance, nullptr);
+		//the renderer's cleanup and main both call this
+		_isInitialized = false;
 
 	}
-	glfwDestroyWindow(window);
+	if (window != nullptr)
+	{
+		glfwDestroyWindow(window);
+		glfwTerminate();
+		window = nullptr;
+	}
 	// clear engine pointer
 	loadedEngine = nullptr;
-	glfwTerminate();
 }
 
 void VulkanEngine::init_sync_structures()
 {
+	TRACE_SCOPE("init_sync_structures");
 	VkFenceCreateInfo fenceCreateInfo = vkinit::fence_create_info(VK_FENCE_CREATE_SIGNALED_BIT);
 	VK_CHECK(vkCreateFence(_device, &fenceCreateInfo, nullptr, &_immFence));
 
@@ -197,6 +215,7 @@ void VulkanEngine::init_sync_structures()
 
 void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& function)
 {
+	ZoneScoped;
 	VK_CHECK(vkResetFences(_device, 1, &_immFence));
 	VK_CHECK(vkResetCommandBuffer(_immCommandBuffer, 0));
 
@@ -224,6 +243,7 @@ void VulkanEngine::immediate_submit(std::function<void(VkCommandBuffer cmd)>&& f
 
 void VulkanEngine::init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13)
 {
+	TRACE_SCOPE("init_vulkan");
 	vkb::InstanceBuilder builder;
 
 	//make the vulkan instance, with basic debug features
@@ -231,6 +251,7 @@ void VulkanEngine::init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysical
 		.request_validation_layers(bUseValidationLayers)
 		.use_default_debug_messenger()
 		.require_api_version(1, 3, 0)
+		.set_headless(_headless)
 		.build();
 
 	vkb::Instance vkb_inst = inst_ret.value();
@@ -242,21 +263,29 @@ void VulkanEngine::init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysical
 	//< init_instance
 	// 
 	//> init_device
-	glfwCreateWindowSurface(_instance, window, nullptr, &_surface);
+	if (!_headless)
+		glfwCreateWindowSurface(_instance, window, nullptr, &_surface);
 
 
 	//use vkbootstrap to select a gpu. 
 	//We want a gpu that can write to the glfw surface and supports vulkan 1.3 with the correct features
 	vkb::PhysicalDeviceSelector selector{ vkb_inst };
-	vkb::PhysicalDevice physicalDevice = selector
+	selector
 		.set_minimum_version(1, 3)
 		.set_required_features(baseFeatures)
 		.set_required_features_13(features13)
 		.set_required_features_12(features12)
 		.set_required_features_11(features11)
-		.set_surface(_surface)
-		.select()
-		.value();
+		.add_desired_extension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	if (!_headless)
+		selector.set_surface(_surface);
+	vkb::PhysicalDevice physicalDevice = selector.select().value();
+
+	//pipeline statistics are only for profiling, enabled where the device has them instead of ruling the device out
+	VkPhysicalDeviceFeatures supported_features;
+	vkGetPhysicalDeviceFeatures(physicalDevice.physical_device, &supported_features);
+	_pipelineStatisticsSupported = supported_features.pipelineStatisticsQuery == VK_TRUE;
+	physicalDevice.features.pipelineStatisticsQuery = supported_features.pipelineStatisticsQuery;
 
 
 	msaa_samples = vkinit::getMaxAvailableSampleCount(physicalDevice.properties);
@@ -282,7 +311,23 @@ void VulkanEngine::init_vulkan(VkPhysicalDeviceFeatures baseFeatures, VkPhysical
 	allocatorInfo.physicalDevice = _chosenGPU;
 	allocatorInfo.device = _device;
 	allocatorInfo.instance = _instance;
+	allocatorInfo.vulkanApiVersion = VK_API_VERSION_1_3;
 	allocatorInfo.flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT;
 
+	//without the extension VMA estimates the budget from the heap sizes
+	uint32_t extension_count = 0;
+	vkEnumerateDeviceExtensionProperties(_chosenGPU, nullptr, &extension_count, nullptr);
+	std::vector<VkExtensionProperties> extensions(extension_count);
+	vkEnumerateDeviceExtensionProperties(_chosenGPU, nullptr, &extension_count, extensions.data());
+	const bool has_memory_budget = std::any_of(extensions.begin(), extensions.end(), [](const VkExtensionProperties& extension) {
+		return strcmp(extension.extensionName, VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) == 0;
+		});
+	if (has_memory_budget)
+		allocatorInfo.flags |= VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT;
+
+	VmaDeviceMemoryCallbacks memory_callbacks = GetDeviceMemoryCallbacks();
+	allocatorInfo.pDeviceMemoryCallbacks = &memory_callbacks;
+
 	vmaCreateAllocator(&allocatorInfo, &_allocator);
+	_memoryBudget.Init(_allocator, has_memory_budget);
 }
\ No newline at end of file
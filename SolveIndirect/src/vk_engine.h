@@ -15,6 +15,8 @@
 #include <chrono>
 #include "scene_manager.h"
 #include "resource_manager.h"
+#include "memory_budget.h"
+#include "pipeline_cache.h"
 #include <ktxvulkan.h>
 
 struct FrameData {
@@ -32,8 +34,9 @@ struct FrameData {
 };
 class VulkanEngine {
 public:
-	//initializes everything in the engine
-	void init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13);
+	//initializes everything in the engine. Headless there is no window, surface or swapchain support, any device that
+	//has the features is taken, software rasterizers included
+	void init(VkPhysicalDeviceFeatures baseFeatures, VkPhysicalDeviceVulkan11Features features11, VkPhysicalDeviceVulkan12Features features12, VkPhysicalDeviceVulkan13Features features13, bool headless = false);
 
 	//shuts down the engine
 	void cleanup();
@@ -44,7 +47,7 @@ public:
 	VkDebugUtilsMessengerEXT _debug_messenger;// Vulkan debug output handle
 	VkPhysicalDevice _chosenGPU;// GPU chosen as the default device
 	VkDevice _device; // Vulkan device for commands
-	VkSurfaceKHR _surface;// Vulkan window surface
+	VkSurfaceKHR _surface{ VK_NULL_HANDLE };// Vulkan window surface, none when headless
 
 	VkSwapchainKHR _swapchain;
 	VkFormat _swapchainImageFormat;
@@ -54,6 +57,9 @@ public:
 
 
 	bool _isInitialized{ false };
+	bool _headless{ false };
+	//pipelineStatisticsQuery is enabled, it's optional
+	bool _pipelineStatisticsSupported{ false };
 
 	VkExtent2D _windowExtent{ 1920,1080 };
 	float _aspect_width = 1920;
@@ -67,6 +73,9 @@ public:
 	VkQueue _graphicsQueue;
 	uint32_t _graphicsQueueFamily;
 	VmaAllocator _allocator;
+	MemoryBudget _memoryBudget;
+	//every pipeline is created through it, saved to disk when the engine shuts down
+	PipelineCache _pipelineCache;
 	
 	VkFence _immFence;
 	VkCommandBuffer _immCommandBuffer;
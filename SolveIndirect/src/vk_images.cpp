@@ -2,6 +2,7 @@
 #include "vk_initializers.h"
 #include "vk_buffer.h"
 #include "vk_engine.h"
+#include "profiling.h"
 
 #include <stb_image.h>
 #include <ktx.h>
@@ -162,6 +163,7 @@ AllocatedImage vkutil::create_image_empty(VkExtent3D size, VkFormat format, VkIm
 
     // allocate and create the image
     VK_CHECK(vmaCreateImage(engine->_allocator, &img_info, &allocinfo, &newImage.image, &newImage.allocation, nullptr));
+    engine->_memoryBudget.Track(newImage.allocation, image_memory_category(img_info.usage));
 
     // if the format is a depth format, we will need to have it use the correct
     // aspect flag
@@ -182,7 +184,7 @@ AllocatedImage vkutil::create_image_empty(VkExtent3D size, VkFormat format, VkIm
 AllocatedImage vkutil::create_image(void* data, VkExtent3D size, VkFormat format, VkImageUsageFlags usage, VulkanEngine* engine, bool mipmapped)
 {
     size_t data_size = size.depth * size.width * size.height * 4;
-    AllocatedBuffer uploadbuffer = create_buffer(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,engine);
+    AllocatedBuffer uploadbuffer = create_buffer(data_size, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,engine, MemoryCategory::Staging);
 
     memcpy(uploadbuffer.info.pMappedData, data, data_size);
 
@@ -243,6 +245,7 @@ AllocatedImage vkutil::create_cubemap_image(VkExtent3D size, VulkanEngine* engin
 
     // allocate and create the image
     VK_CHECK(vmaCreateImage(engine->_allocator, &img_info, &allocinfo, &newImage.image, &newImage.allocation, nullptr));
+    engine->_memoryBudget.Track(newImage.allocation, image_memory_category(img_info.usage));
 
     // build a image-view for the image
 
@@ -262,6 +265,7 @@ AllocatedImage vkutil::create_cubemap_image(VkExtent3D size, VulkanEngine* engin
 
 AllocatedImage vkutil::load_cubemap_image(std::string_view path, VkExtent3D size,VulkanEngine* engine, VkFormat format, VkImageUsageFlags usage, bool mipmapped)
 {
+    TRACE_SCOPE("load_cubemap_image", path);
     ktxResult result;
     ktxTexture* texture;
     
@@ -291,6 +295,7 @@ AllocatedImage vkutil::load_cubemap_image(std::string_view path, VkExtent3D size
 
     // allocate and create the image
     VK_CHECK(vmaCreateImage(engine->_allocator, &img_info, &allocinfo, &newImage.image, &newImage.allocation, nullptr));
+    engine->_memoryBudget.Track(newImage.allocation, image_memory_category(img_info.usage));
 
     // build a image-view for the image
     
@@ -306,7 +311,7 @@ AllocatedImage vkutil::load_cubemap_image(std::string_view path, VkExtent3D size
 
     VK_CHECK(vkCreateImageView(engine->_device, &view_info, nullptr, &newImage.imageView));
 
-    AllocatedBuffer uploadbuffer = vkutil::create_buffer(ktxTextureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,engine);
+    AllocatedBuffer uploadbuffer = vkutil::create_buffer(ktxTextureSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT, VMA_MEMORY_USAGE_CPU_TO_GPU,engine, MemoryCategory::Staging);
     memcpy(uploadbuffer.info.pMappedData, ktxTextureData, ktxTextureSize);
 
     engine->immediate_submit([&](VkCommandBuffer cmd)
@@ -353,8 +358,54 @@ AllocatedImage vkutil::load_cubemap_image(std::string_view path, VkExtent3D size
 }
 
 
+MemoryCategory vkutil::image_memory_category(VkImageUsageFlags usage)
+{
+    const VkImageUsageFlags target_usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_STORAGE_BIT;
+    return (usage & target_usage) ? MemoryCategory::RenderTargets : MemoryCategory::Textures;
+}
+
+VkExtent3D vkutil::mip_extent(VkExtent3D size, uint32_t mip)
+{
+    return VkExtent3D{ std::max(size.width >> mip, 1u), std::max(size.height >> mip, 1u), 1 };
+}
+
+TextureMipChain vkutil::build_mip_chain(const uint8_t* pixels, VkExtent3D size)
+{
+    TextureMipChain chain;
+    chain.extent = size;
+
+    const uint32_t mipLevels = static_cast<uint32_t>(std::floor(std::log2(std::max(size.width, size.height)))) + 1;
+    chain.mips.resize(mipLevels);
+    chain.mips[0].assign(pixels, pixels + size_t(size.width) * size.height * 4);
+
+    for (uint32_t mip = 1; mip < mipLevels; mip++) {
+        const VkExtent3D src = mip_extent(size, mip - 1);
+        const VkExtent3D dst = mip_extent(size, mip);
+        const std::vector<uint8_t>& source = chain.mips[mip - 1];
+        std::vector<uint8_t>& destination = chain.mips[mip];
+        destination.resize(size_t(dst.width) * dst.height * 4);
+
+        //odd sizes clamp to the last row or column instead of reading past it
+        for (uint32_t y = 0; y < dst.height; y++) {
+            const uint32_t y0 = std::min(y * 2, src.height - 1);
+            const uint32_t y1 = std::min(y * 2 + 1, src.height - 1);
+            for (uint32_t x = 0; x < dst.width; x++) {
+                const uint32_t x0 = std::min(x * 2, src.width - 1);
+                const uint32_t x1 = std::min(x * 2 + 1, src.width - 1);
+                for (uint32_t c = 0; c < 4; c++) {
+                    const uint32_t sum = source[(size_t(y0) * src.width + x0) * 4 + c] + source[(size_t(y0) * src.width + x1) * 4 + c] +
+                        source[(size_t(y1) * src.width + x0) * 4 + c] + source[(size_t(y1) * src.width + x1) * 4 + c];
+                    destination[(size_t(y) * dst.width + x) * 4 + c] = static_cast<uint8_t>((sum + 2) / 4);
+                }
+            }
+        }
+    }
+    return chain;
+}
+
 void vkutil::destroy_image(const AllocatedImage& img, VulkanEngine* engine)
 {
+    engine->_memoryBudget.Untrack(img.allocation);
     vkDestroyImageView(engine->_device, img.imageView, nullptr);
     vmaDestroyImage(engine->_allocator, img.image, img.allocation);
 }
@@ -1,9 +1,16 @@
 #pragma once 
 #include<vulkan/vulkan.h>
 #include "vk_types.h"
+#include "memory_budget.h"
 
 class VulkanEngine;
 
+//CPU copy of every mip of an RGBA8 texture, mip 0 first
+struct TextureMipChain {
+	VkExtent3D extent{};
+	std::vector<std::vector<uint8_t>> mips;
+};
+
 namespace vkutil {
 
 	void transition_image(VkCommandBuffer cmd, VkImage image, VkImageLayout currentLayout, VkImageLayout newLayout);
@@ -15,5 +22,10 @@ namespace vkutil {
 	AllocatedImage load_cubemap_image(std::string_view path, VkExtent3D size, VulkanEngine* engine, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
 	AllocatedImage create_cubemap_image(VkExtent3D size, VulkanEngine* engine, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
 	AllocatedImage create_array_image(VkExtent3D size, VulkanEngine* engine, VkFormat format, VkImageUsageFlags usage, bool mipmapped = false);
+	//Attachments and storage images count as render targets, everything else as textures
+	MemoryCategory image_memory_category(VkImageUsageFlags usage);
+	//Box filters RGBA8 pixels down to 1x1, mip count matches the GPU chain of create_image
+	TextureMipChain build_mip_chain(const uint8_t* pixels, VkExtent3D size);
+	VkExtent3D mip_extent(VkExtent3D size, uint32_t mip);
 	
 };
\ No newline at end of file
@@ -8,6 +8,7 @@
 #include "vk_types.h"
 #include "vk_images.h"
 #include "resource_manager.h"
+#include "profiling.h"
 #include <glm/gtx/quaternion.hpp>
 
 
@@ -22,6 +23,7 @@
 
 void GLTFMetallic_Roughness::build_pipelines(VulkanEngine* engine, PipelineCreationInfo& info)
 {
+    TRACE_SCOPE("GLTFMetallic_Roughness::build_pipelines");
     VkShaderModule meshFragShader;
     if (!vkutil::load_shader_module("shaders/indirect_forward.frag.spv", engine->_device, &meshFragShader)) {
         fmt::println("Error when building the triangle fragment shader module");
@@ -77,17 +79,17 @@ void GLTFMetallic_Roughness::build_pipelines(VulkanEngine* engine, PipelineCreat
     pipelineBuilder._pipelineLayout = newLayout;
 
     // finally build the pipeline
-    opaquePipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
+    info.batch->add_graphics("opaque", pipelineBuilder, &opaquePipeline.pipeline);
 
     // create the transparent variant
     pipelineBuilder.enable_blending_additive();
 
     pipelineBuilder.enable_depthtest(false, true, VK_COMPARE_OP_GREATER_OR_EQUAL);
 
-    transparentPipeline.pipeline = pipelineBuilder.build_pipeline(engine->_device);
+    info.batch->add_graphics("transparent", pipelineBuilder, &transparentPipeline.pipeline);
 
-    vkDestroyShaderModule(engine->_device, meshFragShader, nullptr);
-    vkDestroyShaderModule(engine->_device, meshVertexShader, nullptr);
+    info.batch->add_shader_module(meshFragShader);
+    info.batch->add_shader_module(meshVertexShader);
 }
 
 MaterialInstance GLTFMetallic_Roughness::SetMaterialProperties(const vkutil::MaterialPass pass, int mat_index)
@@ -155,10 +157,11 @@ void LoadedGLTF::clearAll()
 {
     VkDevice dv = creator->engine->_device;
 
+    creator->ReleaseMaterials(*this);
+
     for (auto& [k, v] : meshes) {
 
-        creator->DestroyBuffer(v->meshBuffers.indexBuffer);
-        creator->DestroyBuffer(v->meshBuffers.vertexBuffer);
+        creator->FreeMesh(v->meshBuffers);
     }
 
     for (auto& [k, v] : images) {
@@ -174,25 +177,24 @@ void LoadedGLTF::clearAll()
         vkDestroySampler(dv, sampler, nullptr);
     }
 
-    auto materialBuffer = materialDataBuffer;
     auto samplersToDestroy = samplers;
 
     descriptorPool.destroy_pools(dv);
-
-    creator->DestroyBuffer(materialBuffer);
 }
 
 
-void MeshNode::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
+//Emits a render object for each surface of the mesh, material overrides the surfaces' own when set
+static void draw_mesh(const std::shared_ptr<MeshAsset>& mesh, GLTFMaterial* material, const glm::mat4& nodeMatrix, DrawContext& ctx)
 {
-    glm::mat4 nodeMatrix = topMatrix * worldTransform;
-
     for (auto& s : mesh->surfaces) {
+        GLTFMaterial* surfaceMaterial = material ? material : s.material.get();
         RenderObject def;
         def.indexCount = s.count;
-        def.firstIndex = s.startIndex;
+        def.firstIndex = s.startIndex + (s.indexType == VK_INDEX_TYPE_UINT16 ? mesh->meshBuffers.firstIndex16 : mesh->meshBuffers.firstIndex32);
+        def.firstVertex = s.firstVertex + mesh->meshBuffers.firstVertex;
+        def.indexType = s.indexType;
         def.indexBuffer = mesh->meshBuffers.indexBuffer.buffer;
-        def.material = &s.material->data;
+        def.material = &surfaceMaterial->data;
         def.bounds = s.bounds;
         def.vertexCount = s.vertex_count;
         def.transform = nodeMatrix;
@@ -200,14 +202,29 @@ void MeshNode::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
         def.vertexBufferAddress = mesh->meshBuffers.vertexBufferAddress;
         def.meshBuffer = &mesh->meshBuffers;
 
-        if (s.material->data.passType == vkutil::MaterialPass::transparency) {
+        if (surfaceMaterial->data.passType == vkutil::MaterialPass::transparency) {
             ctx.TransparentSurfaces.push_back(def);
         }
         else {
             ctx.OpaqueSurfaces.push_back(def);
         }
     }
+}
+
+void MeshNode::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
+{
+    draw_mesh(mesh, nullptr, topMatrix * worldTransform, ctx);
 
     // recurse down
+    Node::Draw(topMatrix, ctx);
+}
+
+void InstancedMeshNode::Draw(const glm::mat4& topMatrix, DrawContext& ctx)
+{
+    glm::mat4 nodeMatrix = topMatrix * worldTransform;
+    for (const glm::mat4& instance : instances) {
+        draw_mesh(mesh, material.get(), nodeMatrix * instance, ctx);
+    }
+
     Node::Draw(topMatrix, ctx);
 }
\ No newline at end of file
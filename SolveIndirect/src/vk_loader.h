@@ -15,9 +15,12 @@ struct GLTFMaterial {
 
 
 struct GeoSurface {
+    //start in the index range matching indexType, indices are relative to firstVertex
     uint32_t startIndex;
     uint32_t count;
+    uint32_t firstVertex;
     uint32_t vertex_count;
+    VkIndexType indexType;
     Bounds bounds;
     std::shared_ptr<GLTFMaterial> material;
 };
@@ -66,6 +69,18 @@ struct MeshNode : public Node {
     virtual void Draw(const glm::mat4& topMatrix, DrawContext& ctx) override;
 };
 
+// draws one mesh at many transforms relative to the node, for scenes built in code
+// where a node per copy would cost more than the copies themselves
+struct InstancedMeshNode : public Node {
+
+    std::shared_ptr<MeshAsset> mesh;
+    // replaces the material of every surface when set
+    std::shared_ptr<GLTFMaterial> material;
+    std::vector<glm::mat4> instances;
+
+    virtual void Draw(const glm::mat4& topMatrix, DrawContext& ctx) override;
+};
+
 struct LoadedGLTF : public IRenderable {
 
     // storage for all the data on a given glTF file
@@ -80,7 +95,8 @@ struct LoadedGLTF : public IRenderable {
     std::vector<VkSampler> samplers;
 
     DescriptorAllocatorGrowable descriptorPool;;
-    AllocatedBuffer materialDataBuffer;
+    //material table entries of the materials, released with the glTF
+    std::vector<uint32_t> bindlessMaterials;
 
     ResourceManager* creator;
 
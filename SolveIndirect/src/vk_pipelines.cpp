@@ -1,9 +1,14 @@
 ﻿#include "vk_pipelines.h"
+#include <atomic>
 #include <fstream>
+#include <future>
+#include <thread>
 #include "vk_initializers.h"
+#include "profiling.h"
 
 bool vkutil::load_shader_module(const char* filePath, VkDevice device, VkShaderModule* outShaderModule)
 {
+    TRACE_SCOPE("load_shader_module", filePath);
     std::ifstream file(filePath, std::ios::ate | std::ios::binary);
 
     if (!file.is_open()) {
@@ -70,8 +75,23 @@ void PipelineBuilder::clear()
     _shaderStages.clear();
 }
 
-VkPipeline PipelineBuilder::build_pipeline(VkDevice device)
+VkPipeline PipelineBuilder::build_pipeline(PipelineCache& cache, const char* name)
 {
+    VkPipeline newPipeline;
+    if (create_pipeline(cache, name, &newPipeline) != VK_SUCCESS) {
+        fmt::println("failed to create pipeline {}", name);
+        return VK_NULL_HANDLE; // failed to create graphics pipeline
+    }
+    else {
+        return newPipeline;
+    }
+}
+
+VkResult PipelineBuilder::create_pipeline(PipelineCache& cache, const char* name, VkPipeline* pipeline)
+{
+    // a copied builder still points at the format of the one it was copied from
+    _renderInfo.pColorAttachmentFormats = _renderInfo.colorAttachmentCount > 0 ? &_colorAttachmentformat : nullptr;
+
     // make viewport state from our stored viewport and scissor.
     // at the moment we wont support multiple viewports or scissors
     VkPipelineViewportStateCreateInfo viewportState = {};
@@ -115,16 +135,10 @@ VkPipeline PipelineBuilder::build_pipeline(VkDevice device)
 
     pipelineInfo.pDynamicState = &dynamicInfo;
 
-    VkPipeline newPipeline;
-    if (vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineInfo,
-        nullptr, &newPipeline)
-        != VK_SUCCESS) {
-        fmt::println("failed to create pipeline");
-        return VK_NULL_HANDLE; // failed to create graphics pipeline
-    }
-    else {
-        return newPipeline;
-    }
+    const VkResult result = cache.CreateGraphicsPipeline(pipelineInfo, name, pipeline);
+    if (result != VK_SUCCESS)
+        *pipeline = VK_NULL_HANDLE;
+    return result;
 }
 
 void PipelineBuilder::set_shaders(VkShaderModule vertexShader, VkShaderModule fragmentShader, VkShaderModule geometryShader)
@@ -259,4 +273,70 @@ void PipelineBuilder::set_depth_format(VkFormat format)
 void PipelineBuilder::set_vertex_input_state(VkPipelineVertexInputStateCreateInfo vertexInfo)
 {
     _vertexInputInfo = vertexInfo;
+}
+
+void PipelineBatch::add_graphics(const char* name, const PipelineBuilder& builder, VkPipeline* pipeline)
+{
+    requests.push_back(Request{ .name = name, .builder = builder, .layout = VK_NULL_HANDLE, .module = VK_NULL_HANDLE, .pipeline = pipeline });
+}
+
+void PipelineBatch::add_compute(const char* name, VkPipelineLayout layout, VkShaderModule module, VkPipeline* pipeline)
+{
+    requests.push_back(Request{ .name = name, .builder = std::nullopt, .layout = layout, .module = module, .pipeline = pipeline });
+}
+
+void PipelineBatch::add_shader_module(VkShaderModule module)
+{
+    modules.push_back(module);
+}
+
+void PipelineBatch::create(VkDevice device, PipelineCache& cache)
+{
+    TRACE_SCOPE("PipelineBatch::create");
+    const auto start = std::chrono::steady_clock::now();
+    const PipelineCacheStats before = cache.GetStats();
+
+    // drivers compile a pipeline on the thread that asks for it, one worker per hardware thread takes the requests in turn.
+    // The workers only record the results, failures are reported from here
+    std::vector<VkResult> results(requests.size(), VK_SUCCESS);
+    std::atomic<size_t> next = 0;
+    const size_t workerCount = std::min<size_t>(requests.size(), std::max(std::thread::hardware_concurrency(), 1u));
+    std::vector<std::future<void>> workers;
+    for (size_t worker = 0; worker < workerCount; worker++) {
+        workers.push_back(std::async(std::launch::async, [&] {
+            for (size_t i = next++; i < requests.size(); i = next++) {
+                Request& request = requests[i];
+                if (request.builder) {
+                    results[i] = request.builder->create_pipeline(cache, request.name, request.pipeline);
+                    continue;
+                }
+                VkComputePipelineCreateInfo info = { .sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO };
+                info.layout = request.layout;
+                info.stage = vkinit::pipeline_shader_stage_create_info(VK_SHADER_STAGE_COMPUTE_BIT, request.module);
+                results[i] = cache.CreateComputePipeline(info, request.name, request.pipeline);
+                if (results[i] != VK_SUCCESS)
+                    *request.pipeline = VK_NULL_HANDLE;
+            }
+        }));
+    }
+    for (std::future<void>& worker : workers)
+        worker.wait();
+
+    for (VkShaderModule module : modules)
+        vkDestroyShaderModule(device, module, nullptr);
+
+    uint32_t failures = 0;
+    for (size_t i = 0; i < requests.size(); i++) {
+        if (results[i] == VK_SUCCESS)
+            continue;
+        fmt::println("failed to create pipeline {}: {}", requests[i].name, string_VkResult(results[i]));
+        failures++;
+    }
+
+    const PipelineCacheStats after = cache.GetStats();
+    const float elapsed = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+    fmt::println("Created {} pipelines in {:.1f} ms ({:.1f} ms of compilation) on {} threads, {} found in the pipeline cache, {} failed",
+        requests.size() - failures, elapsed, after.creation_ms - before.creation_ms, workerCount, after.cache_hits - before.cache_hits, failures);
+    requests.clear();
+    modules.clear();
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 ﻿#pragma once 
 #include "vk_types.h"
+#include "pipeline_cache.h"
 
 namespace vkutil {
 
@@ -24,7 +25,10 @@ public:
 
     void clear();
 
-    VkPipeline build_pipeline(VkDevice device);
+    //Creates the pipeline through the cache, name is what it shows up as in the startup trace
+    VkPipeline build_pipeline(PipelineCache& cache, const char* name);
+    //Same as build_pipeline but leaves reporting a failure to the caller, pipeline is VK_NULL_HANDLE unless it succeeds
+    VkResult create_pipeline(PipelineCache& cache, const char* name, VkPipeline* pipeline);
 
     void set_vertex_input_state(VkPipelineVertexInputStateCreateInfo vertexInfo);
     void set_input_topology(VkPrimitiveTopology topology);
@@ -40,4 +44,29 @@ public:
     void enable_depthtest(bool depthWriteEnable, bool depthTestEnable, VkCompareOp op);
     void enable_blending_additive();
     void enable_blending_alphablend();
+};
+
+//Pipelines declared up front and then created together on one worker thread per hardware thread. Builders are copied in, one builder
+//can be changed and added again for a variant. Shader modules handed over are destroyed once every pipeline is created
+struct PipelineBatch {
+    void add_graphics(const char* name, const PipelineBuilder& builder, VkPipeline* pipeline);
+    void add_compute(const char* name, VkPipelineLayout layout, VkShaderModule module, VkPipeline* pipeline);
+    void add_shader_module(VkShaderModule module);
+
+    //Creates everything added through the cache and waits for it, then empties the batch. The pipelines are written to where
+    //they were added with, which has to stay put until then. A pipeline that fails is printed by name and left VK_NULL_HANDLE
+    void create(VkDevice device, PipelineCache& cache);
+
+private:
+    struct Request {
+        const char* name;
+        //none for a compute pipeline
+        std::optional<PipelineBuilder> builder;
+        VkPipelineLayout layout;
+        VkShaderModule module;
+        VkPipeline* pipeline;
+    };
+
+    std::vector<Request> requests;
+    std::vector<VkShaderModule> modules;
 };
\ No newline at end of file
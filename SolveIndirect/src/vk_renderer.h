@@ -10,6 +10,7 @@ struct RenderObject {
     uint32_t firstVertex;
     VkBuffer indexBuffer;
     VkBuffer vertexBuffer;
+    VkIndexType indexType;
     GPUMeshBuffers* meshBuffer;
 
     MaterialInstance* material;
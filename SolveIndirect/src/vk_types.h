@@ -81,12 +81,19 @@ namespace vkutil{
         float aabbmax_x;
         float aabbmax_y;
         float aabbmax_z;
+        //counters of the dispatch in the cull statistics buffer
+        uint32_t counterIndex;
     };
 }
 
+//Names a value in a SlotMap<T>, the generation tells a handle to an erased value apart from one to the value
+//that took its slot
 template<typename T>
 struct Handle {
-    uint32_t handle;
+    uint32_t handle = UINT32_MAX;
+    uint32_t generation = 0;
+
+    bool operator==(const Handle& other) const = default;
 };
 
 struct Bounds {
@@ -144,10 +151,14 @@ struct VolumeTileAABB {
     glm::vec4 maxPoint;
 };
 
+struct PipelineBatch;
+
 struct PipelineCreationInfo {
     std::vector<VkDescriptorSetLayout> layouts;
     VkFormat depthFormat = VK_FORMAT_MAX_ENUM;
     VkFormat imageFormat = VK_FORMAT_MAX_ENUM;
+    //the pipelines are added to it and created with the rest of the batch, the shader modules along with them
+    PipelineBatch* batch = nullptr;
 };
 
 struct clusterParams {
@@ -198,10 +209,29 @@ struct IndirectMesh {
 struct MeshAssetInfo {
     uint32_t mesh_vert_count = 0;
     uint32_t mesh_indice_count = 0;
+    uint32_t mesh_indice16_count = 0;
 };
+// range a mesh occupies in the geometry heap
+struct GeometryAllocation {
+    uint32_t vertexOffset = 0; //in vertices
+    uint32_t vertexCount = 0;
+    uint32_t indexOffset = 0; //in 32 bit words
+    uint32_t indexWords = 0;
+    //offset allocator nodes, needed to free the ranges
+    uint32_t vertexNode = ~0u;
+    uint32_t indexNode = ~0u;
+};
+
 // holds the resources needed for a mesh
 struct GPUMeshBuffers {
-    MeshAssetInfo mesh_info;//Turns out VMA adds padding to certain allocations so the info struct is incorrect
+    MeshAssetInfo mesh_info;
+    GeometryAllocation allocation;
+    //first vertex and first index of each index range inside the heap buffers.
+    //16 bit indices come first in the mesh's slot, the 32 bit ones follow on the next word
+    uint32_t firstVertex = 0;
+    uint32_t firstIndex16 = 0;
+    uint32_t firstIndex32 = 0;
+    //shared geometry heap buffers, not owned by the mesh
     AllocatedBuffer indexBuffer;
     AllocatedBuffer vertexBuffer;
     VkDeviceAddress vertexBufferAddress;
@@ -266,14 +296,11 @@ struct MeshObject {
 
 struct EngineStats {
     float frametime;
-    int triangle_count;
-    int drawcall_count;
     int shadow_drawcall_count;
     float scene_update_time;
-    float mesh_draw_time;
-    float ui_draw_time;
     float update_time;
-    float shadow_pass_time;
+    //global operator new calls over the whole frame, UI included
+    uint32_t heap_allocations;
 };
 #define VK_CHECK(x)                                                     \
     do {                                                                \
@@ -0,0 +1,289 @@
+#include "world_partition.h"
+#include "vk_engine.h"
+#include "profiling.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+//Distance from the position to the bounds of the cell, 0 inside them
+static float cell_distance(const glm::vec3& position, const WorldCell& cell)
+{
+	return std::max(0.0f, glm::length(position - cell.position) - cell.radius);
+}
+
+void WorldPartition::Init(VulkanEngine* engine_ptr, std::shared_ptr<ResourceManager> rm, std::shared_ptr<SceneManager> sm, std::string_view manifestPath, uint32_t framesInFlight)
+{
+	TRACE_SCOPE("WorldPartition::Init", manifestPath);
+	engine = engine_ptr;
+	resource_manager = rm;
+	scene_manager = sm;
+	frames_in_flight = framesInFlight;
+
+	std::ifstream file{ std::string(manifestPath) };
+	if (!file.is_open())
+	{
+		fmt::println("No world manifest at {}, the world is empty", manifestPath);
+		return;
+	}
+
+	std::string line;
+	while (std::getline(file, line))
+	{
+		if (line.empty() || line[0] == '#')
+			continue;
+
+		WorldCell cell;
+		std::istringstream stream(line);
+		if (!(stream >> cell.path >> cell.position.x >> cell.position.y >> cell.position.z >> cell.radius))
+		{
+			fmt::println("Skipping malformed world cell: {}", line);
+			continue;
+		}
+
+		const int32_t grid_x = static_cast<int32_t>(std::floor(cell.position.x / WORLD_GRID_CELL_SIZE));
+		const int32_t grid_z = static_cast<int32_t>(std::floor(cell.position.z / WORLD_GRID_CELL_SIZE));
+		grid[GridKey(grid_x, grid_z)].push_back(static_cast<uint32_t>(cells.size()));
+		max_cell_radius = std::max(max_cell_radius, cell.radius);
+		cells.push_back(std::move(cell));
+	}
+	fmt::println("World partition: {} cells in {} grid cells", cells.size(), grid.size());
+}
+
+void WorldPartition::Cleanup()
+{
+	for (PendingLoad& load : pending_loads)
+		load.source.wait();
+	pending_loads.clear();
+
+	for (uint32_t index : resident_cells)
+	{
+		scene_manager->RemoveScene(WORLD_SCENE_ID_BASE + index);
+		cells[index].scene.reset();
+		cells[index].state = WorldCellState::Unloaded;
+	}
+	resident_cells.clear();
+	retired_scenes.clear();
+	loading_files.clear();
+	file_cache.clear();
+}
+
+uint64_t WorldPartition::GridKey(int32_t x, int32_t z)
+{
+	return (uint64_t(uint32_t(x)) << 32) | uint32_t(z);
+}
+
+void WorldPartition::GatherCells(const glm::vec3& position, float radius, std::vector<uint32_t>& found) const
+{
+	//the grid is flat, cells are only spread out along x and z
+	const int32_t min_x = static_cast<int32_t>(std::floor((position.x - radius) / WORLD_GRID_CELL_SIZE));
+	const int32_t max_x = static_cast<int32_t>(std::floor((position.x + radius) / WORLD_GRID_CELL_SIZE));
+	const int32_t min_z = static_cast<int32_t>(std::floor((position.z - radius) / WORLD_GRID_CELL_SIZE));
+	const int32_t max_z = static_cast<int32_t>(std::floor((position.z + radius) / WORLD_GRID_CELL_SIZE));
+
+	for (int32_t x = min_x; x <= max_x; x++)
+	{
+		for (int32_t z = min_z; z <= max_z; z++)
+		{
+			auto it = grid.find(GridKey(x, z));
+			if (it != grid.end())
+				found.insert(found.end(), it->second.begin(), it->second.end());
+		}
+	}
+}
+
+void WorldPartition::Update(const glm::vec3& cameraPos, uint64_t frame)
+{
+	ZoneScoped;
+	current_frame = frame;
+
+	//dropping the last reference to a file destroys it, every frame that drew it has finished by now
+	auto retired = std::partition(retired_scenes.begin(), retired_scenes.end(), [&](const RetiredScene& scene) {
+		return scene.retireFrame > current_frame;
+		});
+	if (retired != retired_scenes.end())
+	{
+		retired_scenes.erase(retired, retired_scenes.end());
+		std::erase_if(file_cache, [](const auto& entry) { return entry.second.expired(); });
+	}
+
+	if (cells.empty())
+		return;
+
+	//walked backwards so unloading, which swaps the last cell into the current slot, doesn't skip any
+	for (size_t i = resident_cells.size(); i-- > 0;)
+	{
+		const uint32_t index = resident_cells[i];
+		WorldCell& cell = cells[index];
+		cell.distance = cell_distance(cameraPos, cell);
+		if (cell.state == WorldCellState::Loaded && cell.distance > WORLD_CELL_UNLOAD_RADIUS)
+			UnloadCell(index);
+	}
+
+	FinishLoads();
+	RequestLoads(cameraPos);
+
+	if (scene_manager->HasPendingSceneChanges())
+		scene_manager->CommitSceneChanges();
+}
+
+void WorldPartition::RequestLoads(const glm::vec3& cameraPos)
+{
+	std::vector<uint32_t> candidates;
+	GatherCells(cameraPos, WORLD_CELL_LOAD_RADIUS + max_cell_radius, candidates);
+	std::erase_if(candidates, [&](uint32_t index) {
+		WorldCell& cell = cells[index];
+		if (cell.state != WorldCellState::Unloaded || cell.failed)
+			return true;
+		cell.distance = cell_distance(cameraPos, cell);
+		return cell.distance > WORLD_CELL_LOAD_RADIUS;
+		});
+
+	//nearest first
+	std::sort(candidates.begin(), candidates.end(), [&](uint32_t a, uint32_t b) {
+		return cells[a].distance < cells[b].distance;
+		});
+
+	for (uint32_t index : candidates)
+	{
+		WorldCell& cell = cells[index];
+		//another cell is already parsing the file, this one finds it in the cache once it is uploaded
+		if (loading_files.contains(cell.path))
+			continue;
+
+		auto cached = file_cache.find(cell.path);
+		std::shared_ptr<LoadedGLTF> shared = cached != file_cache.end() ? cached->second.lock() : nullptr;
+		if (!shared && pending_loads.size() >= WORLD_MAX_LOADS_IN_FLIGHT)
+			continue;
+		if (resident_cells.size() >= WORLD_MAX_RESIDENT_CELLS && !EvictFurther(cell.distance))
+			break;
+
+		if (shared)
+		{
+			LoadCell(index, shared);
+			continue;
+		}
+
+		cell.state = WorldCellState::Loading;
+		resident_cells.push_back(index);
+		loading_files.insert(cell.path);
+		pending_loads.push_back(PendingLoad{
+			.cell = index,
+			.source = std::async(std::launch::async, [path = cell.path]() { return ResourceManager::ParseGltf(path); })
+			});
+	}
+}
+
+bool WorldPartition::FinishLoads()
+{
+	ZoneScoped;
+	uint32_t uploads = 0;
+	bool loaded = false;
+	for (size_t i = 0; i < pending_loads.size();)
+	{
+		PendingLoad& load = pending_loads[i];
+		if (uploads >= WORLD_UPLOADS_PER_FRAME || load.source.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+		{
+			i++;
+			continue;
+		}
+
+		const uint32_t index = load.cell;
+		WorldCell& cell = cells[index];
+		std::shared_ptr<GltfSource> source = load.source.get();
+		pending_loads.erase(pending_loads.begin() + i);
+		loading_files.erase(cell.path);
+
+		//the camera may have moved away while the file was parsing
+		if (source && cell.distance <= WORLD_CELL_UNLOAD_RADIUS)
+		{
+			std::optional<std::shared_ptr<LoadedGLTF>> scene = resource_manager->UploadGltf(engine, *source, true);
+			uploads++;
+			if (scene.has_value())
+			{
+				LoadCell(index, *scene);
+				loaded = true;
+				continue;
+			}
+		}
+
+		cell.failed = !source;
+		cell.state = WorldCellState::Unloaded;
+		RemoveResident(index);
+	}
+
+	//only the new slots are written, no frame in flight reads them
+	if (loaded)
+		resource_manager->write_material_array();
+	return loaded;
+}
+
+bool WorldPartition::EvictFurther(float distance)
+{
+	uint32_t furthest = UINT32_MAX;
+	for (uint32_t index : resident_cells)
+	{
+		const WorldCell& cell = cells[index];
+		if (cell.state == WorldCellState::Loaded && cell.distance > distance && (furthest == UINT32_MAX || cell.distance > cells[furthest].distance))
+			furthest = index;
+	}
+
+	if (furthest == UINT32_MAX)
+		return false;
+	UnloadCell(furthest);
+	return true;
+}
+
+void WorldPartition::LoadCell(uint32_t index, std::shared_ptr<LoadedGLTF> scene)
+{
+	WorldCell& cell = cells[index];
+	if (cell.state == WorldCellState::Unloaded)
+		resident_cells.push_back(index);
+
+	cell.state = WorldCellState::Loaded;
+	cell.scene = scene;
+	file_cache[cell.path] = scene;
+	scene_manager->AddScene(WORLD_SCENE_ID_BASE + index, scene, glm::translate(glm::mat4{ 1.f }, cell.position));
+	loads++;
+}
+
+void WorldPartition::UnloadCell(uint32_t index)
+{
+	WorldCell& cell = cells[index];
+	scene_manager->RemoveScene(WORLD_SCENE_ID_BASE + index);
+	retired_scenes.push_back(RetiredScene{ .scene = std::move(cell.scene), .retireFrame = current_frame + frames_in_flight });
+	cell.state = WorldCellState::Unloaded;
+	RemoveResident(index);
+	unloads++;
+}
+
+void WorldPartition::RemoveResident(uint32_t index)
+{
+	auto it = std::find(resident_cells.begin(), resident_cells.end(), index);
+	if (it == resident_cells.end())
+		return;
+	*it = resident_cells.back();
+	resident_cells.pop_back();
+}
+
+WorldPartitionStats WorldPartition::GetStats() const
+{
+	WorldPartitionStats stats;
+	stats.cells = static_cast<uint32_t>(cells.size());
+	for (uint32_t index : resident_cells)
+	{
+		if (cells[index].state == WorldCellState::Loaded)
+			stats.loaded_cells++;
+		else
+			stats.loading_cells++;
+	}
+	for (const auto& [path, scene] : file_cache)
+	{
+		if (!scene.expired())
+			stats.resident_files++;
+	}
+	stats.loads = loads;
+	stats.unloads = unloads;
+	return stats;
+}
@@ -0,0 +1,114 @@
+#pragma once
+#include "vk_types.h"
+#include "resource_manager.h"
+#include "scene_manager.h"
+#include <future>
+#include <unordered_map>
+#include <unordered_set>
+
+class VulkanEngine;
+
+//Cells closer than the load radius start loading and cells further than the unload radius are released.
+//The gap keeps a camera moving along the edge of a cell from loading and unloading it every frame
+constexpr float WORLD_CELL_LOAD_RADIUS = 150.0f;
+constexpr float WORLD_CELL_UNLOAD_RADIUS = 200.0f;
+//Size of the grid the cells are hashed into, each update only looks at the grid cells around the camera
+constexpr float WORLD_GRID_CELL_SIZE = 100.0f;
+//Files parsed, decoded and converted on worker threads at once
+constexpr uint32_t WORLD_MAX_LOADS_IN_FLIGHT = 2;
+//Parsed files uploaded per frame, an upload only copies the prepared meshes and textures to the device but still blocks the render thread
+constexpr uint32_t WORLD_UPLOADS_PER_FRAME = 1;
+//Cells loaded or loading at once, the furthest make room for nearer ones
+constexpr uint32_t WORLD_MAX_RESIDENT_CELLS = 64;
+//Scene manager ids of the cells start here, below it is left for scenes registered by the renderer
+constexpr uint64_t WORLD_SCENE_ID_BASE = 1ull << 32;
+
+enum class WorldCellState : uint8_t {
+	Unloaded,
+	Loading,
+	Loaded
+};
+
+struct WorldCell {
+	std::string path;
+	glm::vec3 position;
+	float radius;
+	//distance from the camera to the cell's bounds, refreshed while the cell is near
+	float distance = 0.0f;
+	WorldCellState state = WorldCellState::Unloaded;
+	//set once the file failed to parse or upload, the cell isn't retried
+	bool failed = false;
+	std::shared_ptr<LoadedGLTF> scene;
+};
+
+struct WorldPartitionStats {
+	uint32_t cells = 0;
+	uint32_t loaded_cells = 0;
+	uint32_t loading_cells = 0;
+	//distinct glTF files alive, cells sharing a file share one copy
+	uint32_t resident_files = 0;
+	uint32_t loads = 0;
+	uint32_t unloads = 0;
+};
+
+//Splits the world into cells, each placing a glTF file at a position. Cells around the camera are parsed on
+//worker threads, uploaded on the render thread and registered with the scene manager, cells the camera moved
+//away from are unregistered and released once the frames still drawing them have retired.
+//Files are shared between cells through a cache of weak references, so a file used by many cells is loaded once
+struct WorldPartition {
+	//Reads the cell manifest, one "path x y z radius" line per cell. A missing manifest is an empty world
+	void Init(VulkanEngine* engine_ptr, std::shared_ptr<ResourceManager> rm, std::shared_ptr<SceneManager> sm, std::string_view manifestPath, uint32_t framesInFlight = 2);
+	//Waits for the parses still running and releases every cell, the device must be idle
+	void Cleanup();
+
+	//Call once per frame after waiting on that frame's fence, before the frame's commands are recorded
+	void Update(const glm::vec3& cameraPos, uint64_t frame);
+
+	WorldPartitionStats GetStats() const;
+
+private:
+	struct PendingLoad {
+		uint32_t cell;
+		std::future<std::shared_ptr<GltfSource>> source;
+	};
+
+	struct RetiredScene {
+		std::shared_ptr<LoadedGLTF> scene;
+		uint64_t retireFrame;
+	};
+
+	static uint64_t GridKey(int32_t x, int32_t z);
+	//Cells whose bounds might be within radius of the position
+	void GatherCells(const glm::vec3& position, float radius, std::vector<uint32_t>& found) const;
+	void LoadCell(uint32_t index, std::shared_ptr<LoadedGLTF> scene);
+	void UnloadCell(uint32_t index);
+	//Starts parsing the nearest unloaded cells
+	void RequestLoads(const glm::vec3& cameraPos);
+	//Uploads the parses that finished, returns true if a cell was added
+	bool FinishLoads();
+	//Unloads the loaded cell furthest from the camera if it is further than distance
+	bool EvictFurther(float distance);
+	void RemoveResident(uint32_t index);
+
+	VulkanEngine* engine = nullptr;
+	std::shared_ptr<ResourceManager> resource_manager;
+	std::shared_ptr<SceneManager> scene_manager;
+
+	std::vector<WorldCell> cells;
+	//cells by the grid cell holding their position
+	std::unordered_map<uint64_t, std::vector<uint32_t>> grid;
+	//largest cell radius, how far past the load radius a cell's position can be and still need loading
+	float max_cell_radius = 0.0f;
+
+	//cells that aren't unloaded, only these are checked for unloading
+	std::vector<uint32_t> resident_cells;
+	std::vector<PendingLoad> pending_loads;
+	std::unordered_set<std::string> loading_files;
+	std::unordered_map<std::string, std::weak_ptr<LoadedGLTF>> file_cache;
+	std::vector<RetiredScene> retired_scenes;
+
+	uint64_t current_frame = 0;
+	uint32_t frames_in_flight = 2;
+	uint32_t loads = 0;
+	uint32_t unloads = 0;
+};
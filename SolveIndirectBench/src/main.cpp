@@ -0,0 +1,21 @@
+#include "microbench.h"
+#include <fmt/core.h>
+
+void RegisterSceneBenchmarks();
+void RegisterResourceBenchmarks();
+
+//Times the engine's CPU side hot paths on synthetic data. Nothing here creates a window or a device,
+//the engine code linked in is only called where it doesn't touch either
+int main(int argc, char* argv[])
+{
+	std::optional<MicroBenchmarkOptions> options = MicroBenchmarkOptions::Parse(argc, argv);
+	if (!options.has_value())
+	{
+		fmt::println("usage: SolveIndirectBench [--filter <text>] [--min-time <seconds>] [--repetitions <n>] [--json <path>]");
+		return 1;
+	}
+
+	RegisterSceneBenchmarks();
+	RegisterResourceBenchmarks();
+	return RunBenchmarks(*options) ? 0 : 1;
+}
@@ -0,0 +1,153 @@
+#include "microbench.h"
+#include <fmt/core.h>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <fstream>
+#include <thread>
+
+const void* volatile microbench::sink = nullptr;
+
+struct RegisteredBenchmark {
+	std::string name;
+	BenchmarkFunction function;
+};
+
+//in the order they were registered, which is the order they run in
+static std::vector<RegisteredBenchmark> registry;
+
+void RegisterBenchmark(std::string name, BenchmarkFunction function)
+{
+	registry.push_back(RegisteredBenchmark{ std::move(name), std::move(function) });
+}
+
+std::optional<MicroBenchmarkOptions> MicroBenchmarkOptions::Parse(int argc, char* argv[])
+{
+	MicroBenchmarkOptions options;
+	for (int i = 1; i < argc; i++)
+	{
+		const bool has_value = i + 1 < argc;
+		if (strcmp(argv[i], "--filter") == 0 && has_value)
+			options.filter = argv[++i];
+		else if (strcmp(argv[i], "--min-time") == 0 && has_value)
+			options.min_time = std::stod(argv[++i]);
+		else if (strcmp(argv[i], "--repetitions") == 0 && has_value)
+			options.repetitions = std::max(static_cast<uint32_t>(std::stoul(argv[++i])), 1u);
+		else if (strcmp(argv[i], "--json") == 0 && has_value)
+			options.json_path = argv[++i];
+		else
+		{
+			fmt::println("Unknown argument {}", argv[i]);
+			return std::nullopt;
+		}
+	}
+	return options;
+}
+
+struct BenchmarkResult {
+	std::string name;
+	uint64_t iterations = 0;
+	//nanoseconds per iteration over the repetitions
+	double median_ns = 0.0;
+	double mean_ns = 0.0;
+	double min_ns = 0.0;
+	double max_ns = 0.0;
+	double items_per_second = 0.0;
+};
+
+static BenchmarkResult run_benchmark(const RegisteredBenchmark& benchmark, const MicroBenchmarkOptions& options)
+{
+	constexpr uint64_t max_iterations = 1'000'000'000;
+
+	//grow the iteration count until a run is long enough for the clock, aiming a little past the minimum
+	uint64_t iterations = 1;
+	for (;;)
+	{
+		BenchmarkState state(iterations);
+		benchmark.function(state);
+		const double elapsed = state.GetElapsedSeconds();
+		if (elapsed >= options.min_time || iterations >= max_iterations)
+			break;
+		const double multiplier = elapsed > 0.0 ? std::min(options.min_time * 1.4 / elapsed, 10.0) : 10.0;
+		iterations = static_cast<uint64_t>(std::clamp(iterations * multiplier, iterations + 1.0, double(max_iterations)));
+	}
+
+	BenchmarkResult result{ .name = benchmark.name, .iterations = iterations };
+	std::vector<double> samples;
+	uint64_t items = 0;
+	for (uint32_t i = 0; i < options.repetitions; i++)
+	{
+		BenchmarkState state(iterations);
+		benchmark.function(state);
+		samples.push_back(state.GetElapsedSeconds() * 1e9 / iterations);
+		items = state.GetItemsPerIteration();
+	}
+
+	std::sort(samples.begin(), samples.end());
+	const size_t middle = samples.size() / 2;
+	result.median_ns = samples.size() % 2 == 1 ? samples[middle] : (samples[middle - 1] + samples[middle]) * 0.5;
+	double total = 0.0;
+	for (double sample : samples)
+		total += sample;
+	result.mean_ns = total / samples.size();
+	result.min_ns = samples.front();
+	result.max_ns = samples.back();
+	if (items > 0)
+		result.items_per_second = items * 1e9 / result.median_ns;
+	return result;
+}
+
+static bool write_json(const std::vector<BenchmarkResult>& results, const MicroBenchmarkOptions& options)
+{
+	const auto timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+#ifdef NDEBUG
+	constexpr const char* build_type = "release";
+#else
+	constexpr const char* build_type = "debug";
+#endif
+
+	std::string json = "{\n\t\"context\": {\n";
+	json += fmt::format("\t\t\"timestamp\": {},\n\t\t\"build_type\": \"{}\",\n\t\t\"num_cpus\": {},\n", timestamp, build_type, std::thread::hardware_concurrency());
+	json += fmt::format("\t\t\"min_time\": {},\n\t\t\"repetitions\": {}\n\t}},\n", options.min_time, options.repetitions);
+	json += "\t\"benchmarks\": [";
+	for (size_t i = 0; i < results.size(); i++)
+	{
+		const BenchmarkResult& result = results[i];
+		//benchmark names are the literals they were registered with, nothing in them needs escaping
+		json += fmt::format("{}\n\t\t{{ \"name\": \"{}\", \"iterations\": {}, \"time_unit\": \"ns\", \"real_time\": {:.3f}, \"mean_time\": {:.3f}, \"min_time\": {:.3f}, \"max_time\": {:.3f}",
+			i == 0 ? "" : ",", result.name, result.iterations, result.median_ns, result.mean_ns, result.min_ns, result.max_ns);
+		if (result.items_per_second > 0.0)
+			json += fmt::format(", \"items_per_second\": {:.1f}", result.items_per_second);
+		json += " }";
+	}
+	json += "\n\t]\n}\n";
+
+	std::ofstream file(options.json_path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+	{
+		fmt::println("Failed to open {}", options.json_path);
+		return false;
+	}
+	file << json;
+	return file.good();
+}
+
+bool RunBenchmarks(const MicroBenchmarkOptions& options)
+{
+	fmt::println("{:<44} {:>14} {:>14} {:>12} {:>16}", "benchmark", "median ns", "min ns", "iterations", "items/s");
+	std::vector<BenchmarkResult> results;
+	for (const RegisteredBenchmark& benchmark : registry)
+	{
+		if (!options.filter.empty() && benchmark.name.find(options.filter) == std::string::npos)
+			continue;
+
+		const BenchmarkResult& result = results.emplace_back(run_benchmark(benchmark, options));
+		fmt::println("{:<44} {:>14.1f} {:>14.1f} {:>12} {:>16.0f}", result.name, result.median_ns, result.min_ns, result.iterations, result.items_per_second);
+	}
+
+	if (results.empty())
+		fmt::println("No benchmark matches {}", options.filter);
+	if (options.json_path.empty())
+		return true;
+	return write_json(results, options);
+}
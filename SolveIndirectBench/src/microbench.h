@@ -0,0 +1,73 @@
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <optional>
+#include <string>
+#include <vector>
+
+//Handed to a benchmark's body, which sets up its data and then repeats the measured work while KeepRunning returns true.
+//Only the time between the first and the last call of KeepRunning is counted
+struct BenchmarkState {
+	explicit BenchmarkState(uint64_t iterationCount) : iterations(iterationCount) {}
+
+	bool KeepRunning()
+	{
+		if (completed == 0)
+			start = std::chrono::steady_clock::now();
+		if (completed == iterations)
+		{
+			stop = std::chrono::steady_clock::now();
+			return false;
+		}
+		completed++;
+		return true;
+	}
+
+	//Items each iteration works through, reported as a rate next to the time
+	void SetItemsPerIteration(uint64_t items) { items_per_iteration = items; }
+
+	uint64_t GetIterations() const { return iterations; }
+	double GetElapsedSeconds() const { return std::chrono::duration<double>(stop - start).count(); }
+	uint64_t GetItemsPerIteration() const { return items_per_iteration; }
+
+private:
+	uint64_t iterations;
+	uint64_t completed = 0;
+	uint64_t items_per_iteration = 0;
+	std::chrono::steady_clock::time_point start;
+	std::chrono::steady_clock::time_point stop;
+};
+
+namespace microbench {
+	extern const void* volatile sink;
+}
+
+//Keeps the compiler from dropping the work that produced the value, it has to be in memory by the time this returns
+template<typename T>
+inline void DoNotOptimize(const T& value)
+{
+	microbench::sink = &value;
+	std::atomic_signal_fence(std::memory_order_seq_cst);
+}
+
+using BenchmarkFunction = std::function<void(BenchmarkState&)>;
+
+//Names are "<area>/<case>", the filter on the command line matches any part of them
+void RegisterBenchmark(std::string name, BenchmarkFunction function);
+
+struct MicroBenchmarkOptions {
+	std::string filter;
+	//a benchmark's iteration count is grown until one run takes at least this long
+	double min_time = 0.5;
+	uint32_t repetitions = 5;
+	//empty only prints the table
+	std::string json_path;
+
+	//Reads --filter <text>, --min-time <seconds>, --repetitions <n> and --json <path>. Returns nothing on a bad argument
+	static std::optional<MicroBenchmarkOptions> Parse(int argc, char* argv[]);
+};
+
+//Runs every registered benchmark the filter matches, returns false if the JSON couldn't be written
+bool RunBenchmarks(const MicroBenchmarkOptions& options);
@@ -0,0 +1,166 @@
+#include "microbench.h"
+#include "resource_manager.h"
+#include "vk_descriptors.h"
+#include "engine_util.h"
+
+//Copies the values into the single buffer of the asset and adds an accessor over them
+template<typename T>
+static size_t add_accessor(fastgltf::Asset& asset, std::vector<uint8_t>& bytes, const std::vector<T>& values, fastgltf::AccessorType type,
+	fastgltf::ComponentType componentType)
+{
+	fastgltf::BufferView view{};
+	view.bufferIndex = 0;
+	view.byteOffset = bytes.size();
+	view.byteLength = values.size() * sizeof(T);
+	const uint8_t* data = reinterpret_cast<const uint8_t*>(values.data());
+	bytes.insert(bytes.end(), data, data + view.byteLength);
+	asset.bufferViews.push_back(std::move(view));
+
+	fastgltf::Accessor accessor{};
+	accessor.byteOffset = 0;
+	accessor.count = values.size();
+	accessor.type = type;
+	accessor.componentType = componentType;
+	accessor.normalized = false;
+	accessor.bufferViewIndex = asset.bufferViews.size() - 1;
+	asset.accessors.push_back(std::move(accessor));
+	return asset.accessors.size() - 1;
+}
+
+//A flat grid of side by side vertices with every attribute loadGltf reads, each in its own buffer view
+static void build_grid_primitive(fastgltf::Asset& asset, fastgltf::Primitive& primitive, uint32_t side)
+{
+	std::vector<glm::vec3> positions;
+	std::vector<glm::vec3> normals;
+	std::vector<glm::vec2> uvs;
+	std::vector<glm::vec4> tangents;
+	for (uint32_t y = 0; y < side; y++)
+	{
+		for (uint32_t x = 0; x < side; x++)
+		{
+			positions.emplace_back(float(x), 0.0f, float(y));
+			normals.emplace_back(0.0f, 1.0f, 0.0f);
+			uvs.emplace_back(float(x) / (side - 1), float(y) / (side - 1));
+			tangents.emplace_back(1.0f, 0.0f, 0.0f, 1.0f);
+		}
+	}
+	std::vector<uint32_t> indices;
+	for (uint32_t y = 0; y + 1 < side; y++)
+	{
+		for (uint32_t x = 0; x + 1 < side; x++)
+		{
+			const uint32_t corner = y * side + x;
+			indices.insert(indices.end(), { corner, corner + side, corner + 1, corner + 1, corner + side, corner + side + 1 });
+		}
+	}
+
+	std::vector<uint8_t> bytes;
+	primitive.type = fastgltf::PrimitiveType::Triangles;
+	primitive.indicesAccessor = add_accessor(asset, bytes, indices, fastgltf::AccessorType::Scalar, fastgltf::ComponentType::UnsignedInt);
+	primitive.attributes.emplace_back("POSITION", add_accessor(asset, bytes, positions, fastgltf::AccessorType::Vec3, fastgltf::ComponentType::Float));
+	primitive.attributes.emplace_back("NORMAL", add_accessor(asset, bytes, normals, fastgltf::AccessorType::Vec3, fastgltf::ComponentType::Float));
+	primitive.attributes.emplace_back("TEXCOORD_0", add_accessor(asset, bytes, uvs, fastgltf::AccessorType::Vec2, fastgltf::ComponentType::Float));
+	primitive.attributes.emplace_back("TANGENT", add_accessor(asset, bytes, tangents, fastgltf::AccessorType::Vec4, fastgltf::ComponentType::Float));
+
+	fastgltf::Buffer buffer{};
+	buffer.byteLength = bytes.size();
+	buffer.data = fastgltf::sources::Vector{ std::move(bytes), fastgltf::MimeType::None };
+	asset.buffers.push_back(std::move(buffer));
+}
+
+//Fills the writer the way a pass set is written each frame, without handing it to a device
+template<typename Writer>
+static void write_pass_set(Writer& writer)
+{
+	//never dereferenced, nothing is written to a set
+	const VkBuffer buffer = (VkBuffer)uintptr_t(0x1000);
+	const VkImageView view = (VkImageView)uintptr_t(0x2000);
+	const VkSampler sampler = (VkSampler)uintptr_t(0x3000);
+	for (int binding = 0; binding < 8; binding++)
+		writer.write_buffer(binding, buffer, 256, binding * 256, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER);
+	for (int binding = 8; binding < 14; binding++)
+		writer.write_image(binding, view, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL, VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER);
+}
+
+//The same set filled through an update template's entries
+static void write_pass_entries(const DescriptorUpdateTemplate& passTemplate, DescriptorTemplateEntry* entries)
+{
+	const VkBuffer buffer = (VkBuffer)uintptr_t(0x1000);
+	const VkImageView view = (VkImageView)uintptr_t(0x2000);
+	const VkSampler sampler = (VkSampler)uintptr_t(0x3000);
+	for (uint32_t binding = 0; binding < 8; binding++)
+		passTemplate.write_buffer(entries, binding, buffer, 256, binding * 256);
+	for (uint32_t binding = 8; binding < 14; binding++)
+		passTemplate.write_image(entries, binding, view, sampler, VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
+}
+
+void RegisterResourceBenchmarks()
+{
+	RegisterBenchmark("gltf/convert_primitive/65536", [](BenchmarkState& state) {
+		fastgltf::Asset asset;
+		fastgltf::Primitive primitive{};
+		build_grid_primitive(asset, primitive, 256);
+		std::vector<uint32_t> indices;
+		std::vector<Vertex> vertices;
+		state.SetItemsPerIteration(256 * 256);
+		while (state.KeepRunning())
+		{
+			//loadGltf clears them for each mesh and keeps the capacity
+			indices.clear();
+			vertices.clear();
+			GeoSurface surface = ResourceManager::ConvertPrimitive(asset, primitive, indices, vertices);
+			DoNotOptimize(surface.bounds);
+		}
+	});
+
+	RegisterBenchmark("descriptors/writer/14", [](BenchmarkState& state) {
+		DescriptorWriter writer;
+		state.SetItemsPerIteration(14);
+		while (state.KeepRunning())
+		{
+			writer.clear();
+			write_pass_set(writer);
+			DoNotOptimize(writer.writes.back());
+		}
+	});
+	RegisterBenchmark("descriptors/inline_writer/14", [](BenchmarkState& state) {
+		InlineDescriptorWriter writer;
+		state.SetItemsPerIteration(14);
+		while (state.KeepRunning())
+		{
+			writer.clear();
+			write_pass_set(writer);
+			DoNotOptimize(writer.writes[writer.writeCount - 1]);
+		}
+	});
+	RegisterBenchmark("descriptors/template/14", [](BenchmarkState& state) {
+		//laid out the way build_template lays out one descriptor per binding, the handle is never used
+		DescriptorUpdateTemplate passTemplate;
+		for (uint32_t binding = 0; binding < 14; binding++)
+			passTemplate.firstEntry.push_back(passTemplate.entryCount++);
+		DescriptorTemplateEntry entries[14];
+		state.SetItemsPerIteration(14);
+		while (state.KeepRunning())
+		{
+			write_pass_entries(passTemplate, entries);
+			DoNotOptimize(entries[13]);
+		}
+	});
+
+	RegisterBenchmark("deletion_queue/flush/1024", [](BenchmarkState& state) {
+		DeletionQueue queue;
+		uint64_t destroyed = 0;
+		state.SetItemsPerIteration(1024);
+		while (state.KeepRunning())
+		{
+			//captures the size of a typical buffer deletion, a handle and an allocation
+			for (uint64_t i = 0; i < 1024; i++)
+			{
+				const AllocatedBuffer buffer{ .buffer = (VkBuffer)uintptr_t(i + 1) };
+				queue.push_function([buffer, &destroyed]() { destroyed += uint64_t(buffer.buffer); });
+			}
+			queue.flush();
+			DoNotOptimize(destroyed);
+		}
+	});
+}
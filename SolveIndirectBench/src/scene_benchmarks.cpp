@@ -0,0 +1,139 @@
+#include "microbench.h"
+#include "graphics.h"
+#include "scene_manager.h"
+#include "Shadows.h"
+#include <glm/gtc/matrix_transform.hpp>
+#include <random>
+
+//Objects scattered over a few hundred units in front of the camera, seeded so every run sees the same ones
+struct SyntheticScene {
+	explicit SyntheticScene(uint32_t count)
+		: materials(64)
+	{
+		std::mt19937 rng(1234);
+		std::uniform_real_distribution<float> position(-200.0f, 200.0f);
+		std::uniform_real_distribution<float> size(0.5f, 8.0f);
+
+		objects.resize(count);
+		for (uint32_t i = 0; i < count; i++)
+		{
+			RenderObject& object = objects[i];
+			object = RenderObject{};
+			object.transform = glm::translate(glm::mat4(1.0f), glm::vec3(position(rng), position(rng) * 0.1f, position(rng)));
+			object.bounds.origin = glm::vec3(0.0f);
+			object.bounds.extents = glm::vec3(size(rng), size(rng), size(rng));
+			object.bounds.sphereRadius = glm::length(object.bounds.extents);
+			//runs of surfaces share a material the way a glTF's do
+			object.material = &materials[(i / 16) % materials.size()];
+		}
+	}
+
+	static glm::mat4 ViewProjection()
+	{
+		const glm::mat4 view = glm::lookAt(glm::vec3(0.0f, 20.0f, -150.0f), glm::vec3(0.0f), glm::vec3(0.0f, 1.0f, 0.0f));
+		return glm::perspective(glm::radians(70.0f), 16.0f / 9.0f, 0.1f, 1000.0f) * view;
+	}
+
+	std::vector<MaterialInstance> materials;
+	std::vector<RenderObject> objects;
+};
+
+//A parent with children nested depth levels below it, each node with the same number of children
+static std::shared_ptr<Node> build_tree(uint32_t depth, uint32_t children)
+{
+	std::shared_ptr<Node> node = std::make_shared<Node>();
+	node->localTransform = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.5f, 0.25f));
+	if (depth == 0)
+		return node;
+
+	node->children.reserve(children);
+	for (uint32_t i = 0; i < children; i++)
+	{
+		std::shared_ptr<Node> child = build_tree(depth - 1, children);
+		child->parent = node;
+		node->children.push_back(std::move(child));
+	}
+	return node;
+}
+
+static void benchmark_refresh_transform(BenchmarkState& state, uint32_t depth, uint32_t children, uint64_t nodes)
+{
+	std::shared_ptr<Node> root = build_tree(depth, children);
+	const glm::mat4 top = glm::rotate(glm::mat4(1.0f), 0.5f, glm::vec3(0.0f, 1.0f, 0.0f));
+	state.SetItemsPerIteration(nodes);
+	while (state.KeepRunning())
+	{
+		root->refreshTransform(top);
+		DoNotOptimize(root->worldTransform);
+	}
+}
+
+void RegisterSceneBenchmarks()
+{
+	RegisterBenchmark("culling/is_visible/10000", [](BenchmarkState& state) {
+		SyntheticScene scene(10000);
+		const glm::mat4 viewproj = SyntheticScene::ViewProjection();
+		state.SetItemsPerIteration(scene.objects.size());
+		while (state.KeepRunning())
+		{
+			uint32_t visible = 0;
+			for (const RenderObject& object : scene.objects)
+				visible += black_key::is_visible(object, viewproj) ? 1 : 0;
+			DoNotOptimize(visible);
+		}
+	});
+
+	//a chain is the worst case for the recursion, a single parent the worst case for the child loop
+	RegisterBenchmark("transform/refresh_deep/1024", [](BenchmarkState& state) { benchmark_refresh_transform(state, 1023, 1, 1024); });
+	RegisterBenchmark("transform/refresh_wide/16385", [](BenchmarkState& state) { benchmark_refresh_transform(state, 1, 16384, 16385); });
+	RegisterBenchmark("transform/refresh_balanced/37449", [](BenchmarkState& state) { benchmark_refresh_transform(state, 5, 8, 37449); });
+
+	RegisterBenchmark("batching/refresh_pass/10000", [](BenchmarkState& state) {
+		SyntheticScene scene(10000);
+		SceneManager::MeshPass pass;
+		state.SetItemsPerIteration(scene.objects.size());
+		while (state.KeepRunning())
+		{
+			//a commit starts every pass over from empty
+			pass.batches.clear();
+			SceneManager::RefreshPass(&pass, scene.objects);
+			DoNotOptimize(pass.batches.back());
+		}
+	});
+	RegisterBenchmark("batching/build_batches/10000", [](BenchmarkState& state) {
+		SyntheticScene scene(10000);
+		std::array<SceneManager::MeshPass, 4> passes;
+		//forward, shadow, transparency and early depth, the depth only passes draw everything as one batch
+		passes[1].needs_materials = false;
+		passes[3].needs_materials = false;
+		const std::array<SceneManager::MeshPass*, 4> pass_pointers = { &passes[0], &passes[1], &passes[2], &passes[3] };
+		state.SetItemsPerIteration(scene.objects.size());
+		while (state.KeepRunning())
+		{
+			for (SceneManager::MeshPass& pass : passes)
+			{
+				pass.batches.clear();
+				pass.multibatches.clear();
+			}
+			SceneManager::BuildBatches(pass_pointers, scene.objects);
+			DoNotOptimize(passes[0].batches.back());
+		}
+	});
+
+	RegisterBenchmark("shadows/get_cascades", [](BenchmarkState& state) {
+		Camera camera;
+		camera.setPerspective(70.0f, 16.0f / 9.0f, 0.1f, 500.0f);
+		camera.setPosition(glm::vec3(0.0f, -5.0f, -20.0f));
+		camera.setRotation(glm::vec3(-15.0f, 30.0f, 0.0f));
+		GPUSceneData scene_data{};
+		scene_data.sunlightDirection = glm::vec4(-0.3f, -1.0f, -0.2f, 1.0f);
+		ShadowCascades shadows;
+		shadows.SetShadowMapTextureSize(2048);
+		while (state.KeepRunning())
+		{
+			//the engine is only passed along, nothing in the split reads it
+			Cascade cascades = shadows.getCascades(nullptr, camera, scene_data);
+			DoNotOptimize(cascades);
+		}
+	});
+}